@@ -0,0 +1,64 @@
+// Minimal benchmark harness for the host build.
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace bench {
+
+using SuiteFn = void (*)();
+
+struct Suite {
+    const char *name;
+    SuiteFn fn;
+    Suite *next;
+};
+
+/// Adds a suite to the global list; used by BENCH_SUITE.
+Suite *register_suite(Suite *suite);
+
+/// printf-style line written to stdout and to the results file.
+void report(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/// Marks a suite as failed; the runner exits non-zero at the end.
+void fail(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/// malloc/calloc/realloc/free calls so far in the whole process (bench_memory
+/// interposes them).
+uint64_t heap_calls();
+
+/// Monotonic wall clock in nanoseconds.
+inline uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// Raw CPU cycle counter where the host has one, otherwise nanoseconds.
+inline uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t v;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    return now_ns();
+#endif
+}
+
+/// Keeps the compiler from discarding a computed value.
+template <typename T>
+inline void keep(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace bench
+
+#define BENCH_SUITE(name)                                                   \
+    static void bench_suite_##name();                                       \
+    static bench::Suite bench_suite_entry_##name{#name, bench_suite_##name, \
+                                                 nullptr};                  \
+    static bench::Suite *bench_suite_reg_##name =                           \
+        bench::register_suite(&bench_suite_entry_##name);                   \
+    static void bench_suite_##name()
@@ -0,0 +1,164 @@
+// PID autotuning against a battery of simulated houses (sim/house_model.h), from
+// a small flat with fast radiators to a heavy house with underfloor-like lag
+// and a long sensor dead time. Each house is controlled twice through the
+// same day: with the firmware's fixed default gains, and with the gains its
+// own relay-feedback autotune found. Reports overshoot and settling time
+// after a cold start and after a setpoint step, and the tuning run itself.
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+
+#include "bench.h"
+#include "house_model.h"
+#include "thermostat.h"
+
+using namespace thermo;
+using sim::House;
+using sim::HouseParams;
+
+namespace {
+
+const HouseParams houses[] = {
+    // name              c_air   c_em   ua_em ua_loss power  dead outside
+    {"flat, fast rads", 2.0e6, 1.0e5, 400, 90, 3000, 30, 5},
+    {"terrace", 4.0e6, 2.5e5, 450, 160, 6000, 60, 2},
+    {"detached, cold", 6.0e6, 3.0e5, 500, 260, 9000, 60, -5},
+    {"old, oversized", 5.0e6, 4.0e5, 600, 220, 14000, 90, 0},
+    {"heavy, slow", 9.0e6, 9.0e5, 350, 180, 7000, 120, 3},
+    {"long dead time", 4.0e6, 2.0e5, 400, 150, 6000, 240, 4},
+    {"well insulated", 5.0e6, 2.0e5, 300, 70, 5000, 60, 0},
+    {"drafty", 3.0e6, 2.0e5, 500, 300, 9000, 45, -2},
+};
+
+constexpr double band_c = 0.3;  // "settled": within this of the setpoint
+constexpr uint32_t segment_s = 8 * 3600;
+
+struct Segment {
+    double overshoot_c = 0;  // worst excursion above the setpoint after reaching it
+    uint32_t settle_s = 0;   // until the room stays within band_c for good
+};
+
+struct Score {
+    Segment cold;  // 16 C start, setpoint 20
+    Segment step;  // then 20 -> 21
+    double kwh = 0;
+    uint32_t switches = 0;
+};
+
+Segment run_segment(Thermostat &t, House &h, float setpoint, bool &last_relay,
+                    uint32_t &switches) {
+    t.set_setpoint(setpoint);
+    Segment s;
+    bool reached = false;
+    uint32_t last_out = 0;
+    for (uint32_t i = 0; i < segment_s; i++) {
+        const bool relay = t.step(real_t(float(h.sensor())));
+        switches += relay != last_relay;
+        last_relay = relay;
+        h.step(relay);
+        const double err = h.air_c() - setpoint;
+        if (err >= 0) reached = true;
+        if (reached && err > s.overshoot_c) s.overshoot_c = err;
+        if (std::fabs(err) > band_c) last_out = i + 1;
+    }
+    s.settle_s = last_out;
+    return s;
+}
+
+Score score(const HouseParams &p, const Thermostat &proto) {
+    Thermostat t = proto;
+    House h(p);
+    Score sc;
+    bool relay = false;
+    sc.cold = run_segment(t, h, 20.0f, relay, sc.switches);
+    sc.step = run_segment(t, h, 21.0f, relay, sc.switches);
+    sc.kwh = h.energy_kwh();
+    return sc;
+}
+
+void print(const char *label, const Score &s) {
+    bench::report("    %-6s cold start: overshoot %.2f C, settled %5.1f h | step: overshoot "
+                  "%.2f C, settled %5.1f h | %.1f kWh, %u switches",
+                  label, s.cold.overshoot_c, s.cold.settle_s / 3600.0, s.step.overshoot_c,
+                  s.step.settle_s / 3600.0, s.kwh, s.switches);
+}
+
+} // namespace
+
+BENCH_SUITE(autotune) {
+    ThermostatConfig fixed_config;
+    fixed_config.mode = ControlMode::pid;
+    const Thermostat fixed(fixed_config);
+
+    double overshoot_fixed = 0, overshoot_tuned = 0, settle_fixed = 0, settle_tuned = 0;
+    uint32_t failed = 0;
+    for (const HouseParams &p : houses) {
+        // Tune from a cold room, as on an install day.
+        ThermostatConfig config;
+        Thermostat tuner(config);
+        tuner.set_setpoint(20.0f);
+        tuner.start_autotune();
+        House h(p);
+        uint32_t ticks = 0;
+        while (tuner.autotune_state() == AutotuneState::running) {
+            h.step(tuner.step(real_t(float(h.sensor()))));
+            ticks++;
+        }
+        const AutotuneResult &r = tuner.autotune_result();
+        bench::report("%-15s tune %s in %.1f h (%u cycles): Ku %.2f/C Pu %.0f min a %.2f C "
+                      "bias %.2f -> kp %.3f ki %.5f",
+                      p.name, tuner.autotune_state() == AutotuneState::done ? "done" : "FAILED",
+                      ticks / 3600.0, r.cycles, r.ku, r.pu_s / 60, r.amplitude_c, r.bias,
+                      tuner.config().kp, tuner.config().ki);
+        if (tuner.autotune_state() != AutotuneState::done) {
+            failed++;
+            continue;
+        }
+        bench::report("    model: gain %.1f C (house %.1f C), tau %.0f min, dead time %.1f min",
+                      r.gain_c, p.power / p.ua_loss, r.tau_s / 60, r.dead_s / 60);
+
+        ThermostatConfig tuned_config = fixed_config;
+        tuned_config.kp = tuner.config().kp;
+        tuned_config.ki = tuner.config().ki;
+        tuned_config.kd = tuner.config().kd;
+        const Score a = score(p, fixed);
+        const Score b = score(p, Thermostat(tuned_config));
+        print("fixed", a);
+        print("tuned", b);
+        overshoot_fixed += a.cold.overshoot_c + a.step.overshoot_c;
+        overshoot_tuned += b.cold.overshoot_c + b.step.overshoot_c;
+        settle_fixed += a.cold.settle_s + a.step.settle_s;
+        settle_tuned += b.cold.settle_s + b.step.settle_s;
+    }
+    const double n = 2.0 * (std::size(houses) - failed);
+    bench::report("mean over %zu houses: overshoot %.2f C fixed vs %.2f C tuned; settling %.1f h "
+                  "fixed vs %.1f h tuned",
+                  std::size(houses), overshoot_fixed / n, overshoot_tuned / n,
+                  settle_fixed / n / 3600, settle_tuned / n / 3600);
+    if (failed) bench::fail("autotune did not converge on %u houses", failed);
+
+    // A heater that cannot reach the setpoint never oscillates: the tuner
+    // must give up on time and leave the controller as it was.
+    {
+        const HouseParams weak = {"undersized", 4.0e6, 2.0e5, 400, 200, 600, 60, 0};
+        ThermostatConfig config;
+        config.autotune_max_s = 12 * 3600;
+        Thermostat tuner(config);
+        tuner.start_autotune();
+        House h(weak);
+        uint32_t ticks = 0;
+        while (tuner.autotune_state() == AutotuneState::running && ticks < 13 * 3600) {
+            h.step(tuner.step(real_t(float(h.sensor()))));
+            ticks++;
+        }
+        bench::report("undersized heater: gave up after %.1f h, mode %s", ticks / 3600.0,
+                      tuner.config().mode == ControlMode::pid ? "pid" : "hysteresis");
+        if (tuner.autotune_state() != AutotuneState::failed ||
+            tuner.config().mode != ControlMode::hysteresis) {
+            bench::fail("autotune on an undersized heater did not fail cleanly");
+        }
+    }
+    if (overshoot_tuned > overshoot_fixed || settle_tuned > settle_fixed) {
+        bench::fail("tuned gains do worse than the fixed defaults");
+    }
+}
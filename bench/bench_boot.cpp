@@ -0,0 +1,213 @@
+// Boot timeline (boot.h): the firmware's own init sequence, from main() to
+// the first control decision on a real reading and the history index
+// rebuilt after it, booted again and again in
+// fresh child processes, with an empty log and with one holding weeks of
+// history. Reports each stage's median and worst, and fails if a stage is
+// missing or out of order, or if time to first control grows past its
+// budget. One more boot runs with telemetry, as device images do, and checks
+// the timeline arrives there as a record.
+//
+// app_init() can only run once per process (the arenas seal, and the host
+// display keeps the clock it was given), so each boot is a fork() of a
+// process that has not booted yet: this suite must run before any other that
+// calls app_init(), which its place first in the runner guarantees.
+#include <algorithm>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "app.h"
+#include "arena.h"
+#include "bench.h"
+#include "boot.h"
+#include "flash_device.h"
+#include "flash_log.h"
+#include "history.h"
+#include "sensing_core.h"
+#include "sensor.h"
+#include "telemetry.h"
+
+using namespace thermo;
+
+namespace {
+
+constexpr const char *flash_path = "/tmp/thermostat_bench_boot_flash.bin";
+constexpr size_t stage_count = size_t(BootStage::count);
+constexpr int boots = 15;
+// Give up on a boot that has not rebuilt its history index by then.
+constexpr uint64_t boot_timeout_us = 2'000'000;
+// Time to first control, worst boot. The host needs about 1 ms with weeks of
+// history, most of it mounting the log (the rollup is rebuilt after the
+// decision); ten times that leaves room for a loaded machine but not for a
+// scan that went linear or moved back in front of control.
+constexpr uint32_t first_control_budget_us = 10'000;
+
+struct Timeline {
+    uint32_t us[stage_count];
+};
+
+// Decodes the telemetry stream as it is written, keeping the boot record.
+class BootSink final : public TelemetrySink {
+public:
+    size_t write(const uint8_t *data, size_t len) override {
+        decoder_.feed(data, len);
+        return len;
+    }
+    bool received() const { return received_; }
+    const Timeline &timeline() const { return timeline_; }
+
+private:
+    static void on_record(void *ctx, const TelemetryDecoder::Frame &, uint8_t type,
+                          const uint8_t *p, size_t len) {
+        auto *self = static_cast<BootSink *>(ctx);
+        if (type != telemetry::record_boot || len != 1 + 4 * stage_count || p[0] != stage_count) {
+            return;
+        }
+        for (size_t i = 0; i < stage_count; i++) {
+            const uint8_t *b = p + 1 + 4 * i;
+            self->timeline_.us[i] = uint32_t(b[0] | b[1] << 8 | b[2] << 16) | uint32_t(b[3]) << 24;
+        }
+        self->received_ = true;
+    }
+
+    TelemetryDecoder decoder_{on_record, this};
+    Timeline timeline_ = {};
+    bool received_ = false;
+};
+
+// One boot, in a child process. Returns false if it failed or timed out.
+// With `telemetry`, the timeline returned is the one the boot record carried,
+// and the boot fails unless it matches the marks.
+bool boot_once(Timeline &out, bool telemetry = false) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    const pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        // As main() does on the host, with stdio already up.
+        boot_restart();
+        boot_mark(BootStage::main);
+        boot_mark(BootStage::stdio);
+        boot_mark(BootStage::network);
+        FileFlash flash(flash_path, THERMO_FLASH_LOG_BYTES);
+        static SystemClock clock;
+        static BootSink sink;
+        AppConfig config;
+        config.status_output = false;
+        config.flash = &flash;
+        if (telemetry) config.telemetry = &sink;
+        Scheduler &scheduler = app_init(clock, config);
+        sensor_host_set_celsius(19.0f);
+        app_start();
+        const uint64_t deadline = clock.now_us() + boot_timeout_us;
+        while (!boot_time_us(BootStage::history_index) && clock.now_us() < deadline) {
+            scheduler.run_once();
+        }
+        Timeline t;
+        for (size_t i = 0; i < stage_count; i++) t.us[i] = boot_time_us(BootStage(i));
+        bool ok = true;
+        if (telemetry) {
+            // The record waits in the open frame for up to a second.
+            const uint64_t sent_by = clock.now_us() + 2 * boot_timeout_us;
+            while (!sink.received() && clock.now_us() < sent_by) scheduler.run_once();
+            ok = sink.received() && !memcmp(&sink.timeline(), &t, sizeof(t));
+        }
+        ok = write(fds[1], &t, sizeof(t)) == ssize_t(sizeof(t)) && ok;
+        sensing_core_stop();
+        _exit(ok ? 0 : 1);
+    }
+    close(fds[1]);
+    const bool got = read(fds[0], &out, sizeof(out)) == ssize_t(sizeof(out));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return got && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Weeks of minute samples in the history, as a board has after a while.
+uint64_t fill_log(uint32_t days) {
+    FileFlash flash(flash_path, THERMO_FLASH_LOG_BYTES);
+    FlashLog log(flash);
+    log.mount();
+    HistoryStore store(log);
+    for (uint32_t m = 0; m < days * 24 * 60; m++) {
+        store.append(m * 60, int16_t(2000 + (m * 7) % 300 - 150));
+    }
+    store.flush();
+    return log.stats().payload_bytes;
+}
+
+void run(const char *name) {
+    Timeline runs[boots];
+    for (int i = 0; i < boots; i++) {
+        if (!boot_once(runs[i])) {
+            bench::fail("boot %s: boot %d failed or was not done in %u ms", name, i,
+                        unsigned(boot_timeout_us / 1000));
+            return;
+        }
+    }
+    uint32_t prev_median = 0;
+    for (size_t s = 0; s < stage_count; s++) {
+        uint32_t us[boots];
+        for (int i = 0; i < boots; i++) {
+            us[i] = runs[i].us[s];
+            if (!us[i]) {
+                bench::fail("boot %s: stage %s not reached", name, boot_stage_name(BootStage(s)));
+                return;
+            }
+            if (s > 0 && us[i] < runs[i].us[s - 1]) {
+                bench::fail("boot %s: %s before %s", name, boot_stage_name(BootStage(s)),
+                            boot_stage_name(BootStage(s - 1)));
+            }
+        }
+        std::sort(us, us + boots);
+        const uint32_t median = us[boots / 2];
+        bench::report("  %-14s median %8.3f ms (+%7.3f)  worst %8.3f ms",
+                      boot_stage_name(BootStage(s)), median / 1e3,
+                      (median - std::min(median, prev_median)) / 1e3, us[boots - 1] / 1e3);
+        prev_median = median;
+    }
+    uint32_t worst = 0;
+    for (const Timeline &t : runs) {
+        const uint32_t us = t.us[size_t(BootStage::first_control)] - t.us[size_t(BootStage::main)];
+        worst = std::max(worst, us);
+    }
+    bench::report("  main -> first control: worst %.3f ms of %d boots (budget %.0f ms)",
+                  worst / 1e3, boots, first_control_budget_us / 1e3);
+    if (worst > first_control_budget_us) {
+        bench::fail("boot %s: first control %.3f ms after main, over the %.0f ms budget", name,
+                    worst / 1e3, first_control_budget_us / 1e3);
+    }
+}
+
+} // namespace
+
+BENCH_SUITE(boot) {
+    for (Arena *a = Arena::first(); a; a = a->next()) {
+        if (a->used()) {
+            bench::fail("boot: app_init() already ran in this process; run this suite first");
+            return;
+        }
+    }
+    unlink(flash_path);
+    bench::report("boot with an empty log, %d boots:", boots);
+    run("empty log");
+
+    const uint64_t payload = fill_log(28);
+    bench::report("boot with 28 days of minute history (%llu payload B), %d boots:",
+                  (unsigned long long)payload, boots);
+    run("filled log");
+
+    Timeline t = {};
+    const bool sent = boot_once(t, true);
+    bench::report("boot with telemetry: timeline %s, first control at %.3f ms",
+                  sent ? "sent as a record" : "NOT SENT",
+                  t.us[size_t(BootStage::first_control)] / 1e3);
+    if (!sent) bench::fail("boot: no boot record on telemetry, or it disagrees with the marks");
+    unlink(flash_path);
+}
@@ -0,0 +1,151 @@
+// Control-loop throughput: Thermostat::step against a first-order room model,
+// for both numeric backends, plus the fixed-point path's deviation from float
+// and its saturation at the ends of the Q16 range.
+#include <cmath>
+#include <limits>
+
+#include "bench.h"
+#include "thermostat.h"
+
+using namespace thermo;
+
+namespace {
+
+// Tiny room: heat input when the relay is on, exponential loss to outside.
+// Kept in float for both backends so the plant is identical.
+struct Room {
+    float temp_c = 15.0f;
+    float outside_c = 5.0f;
+
+    void advance(bool heat) {
+        temp_c += (heat ? 0.02f : 0.0f) - 0.001f * (temp_c - outside_c);
+    }
+};
+
+// Temperatures are pre-converted so the timed loop measures step() only.
+template <typename T>
+void run(ControlMode mode, uint32_t iterations) {
+    ThermostatConfig config;
+    config.mode = mode;
+
+    constexpr uint32_t trace_len = 4096;
+    static T trace[trace_len];
+    Room room;
+    {
+        BasicThermostat<float> shaper(config);
+        for (uint32_t i = 0; i < trace_len; i++) {
+            room.advance(shaper.step(room.temp_c));
+            trace[i] = Numeric<T>::from_float(room.temp_c);
+        }
+    }
+
+    BasicThermostat<T> thermostat(config);
+    uint32_t on_ticks = 0;
+    uint64_t t0 = bench::now_ns();
+    uint64_t c0 = bench::cycles();
+    for (uint32_t i = 0; i < iterations; i++) {
+        on_ticks += thermostat.step(trace[i & (trace_len - 1)]);
+    }
+    uint64_t c1 = bench::cycles();
+    uint64_t elapsed = bench::now_ns() - t0;
+    bench::keep(on_ticks);
+
+    bench::report("%-10s %-7s %10u iters  %7.2f cycles/step  %7.2f ns/step  %8.2f Msteps/s",
+                  mode == ControlMode::pid ? "pid" : "hysteresis", Numeric<T>::name,
+                  iterations, double(c1 - c0) / iterations, double(elapsed) / iterations,
+                  iterations * 1e3 / double(elapsed));
+}
+
+// Closed loop with each backend against the same plant, long enough to cover
+// many PID windows; reports how far the Q16 controller drifts from float.
+void accuracy(ControlMode mode, uint32_t ticks) {
+    ThermostatConfig config;
+    config.mode = mode;
+    BasicThermostat<float> ref(config);
+    BasicThermostat<Q16> fix(config);
+    Room room_ref, room_fix;
+
+    double max_duty_err = 0, max_temp_err = 0;
+    uint32_t relay_mismatch = 0;
+    for (uint32_t i = 0; i < ticks; i++) {
+        bool a = ref.step(room_ref.temp_c);
+        bool b = fix.step(Q16(room_fix.temp_c));
+        room_ref.advance(a);
+        room_fix.advance(b);
+        relay_mismatch += a != b;
+        max_duty_err = std::fmax(max_duty_err, std::fabs(ref.duty() - fix.duty().to_float()));
+        max_temp_err = std::fmax(max_temp_err, std::fabs(room_ref.temp_c - room_fix.temp_c));
+    }
+    bench::report("%-10s accuracy over %u ticks: max |duty err| %.5f  max |temp err| %.4f C  "
+                  "relay mismatches %u (%.3f%%)",
+                  mode == ControlMode::pid ? "pid" : "hysteresis", ticks, max_duty_err,
+                  max_temp_err, relay_mismatch, 100.0 * relay_mismatch / ticks);
+    if (max_temp_err > 0.25) {
+        bench::fail("q16 closed-loop temperature deviates %.3f C from float", max_temp_err);
+    }
+}
+
+// Out-of-range conversions and division by zero pin to the ends of the range
+// instead of wrapping or trapping.
+void saturation() {
+    const Q16 max = Q16::from_raw(INT32_MAX), min = Q16::from_raw(INT32_MIN);
+    struct Case {
+        const char *what;
+        Q16 got, want;
+    };
+    volatile int big = 40'000;  // not folded, so the runtime path is checked
+    volatile float inf = std::numeric_limits<float>::infinity();
+    volatile float nan = std::numeric_limits<float>::quiet_NaN();
+    const Case cases[] = {
+        {"int 40000", Q16(int(big)), max},
+        {"int -40000", Q16(-int(big)), min},
+        {"int -32768", Q16(-32768), min},
+        {"int 32767", Q16(32767), Q16::from_raw(32767 * Q16::one_raw)},
+        {"float 1e9", Q16(1e9f), max},
+        {"float -1e9", Q16(-1e9f), min},
+        {"float 32768", Q16(32768.0f), max},
+        {"float -32768", Q16(-32768.0f), min},
+        {"float inf", Q16(float(inf)), max},
+        {"float -inf", Q16(-float(inf)), min},
+        {"float nan", Q16(float(nan)), Q16(0)},
+        {"double 1e300", Q16(1e300), max},
+        {"double -1e300", Q16(-1e300), min},
+        {"double 32767.99999", Q16(32767.99999), Q16::from_raw(INT32_MAX)},
+        {"1 / 0", Q16(1) / Q16(0), max},
+        {"-1 / 0", Q16(-1) / Q16(0), min},
+        {"0 / 0", Q16(0) / Q16(0), Q16(0)},
+        {"ratio(5, 0)", Q16::ratio(5, 0), max},
+        {"ratio(-5, 0)", Q16::ratio(-5, 0), min},
+        {"30000 / 0.5", Q16(30000) / Q16(0.5f), max},
+        {"ratio(1 << 20, 1)", Q16::ratio(1 << 20, 1), max},
+        {"ratio(-3, 2)", Q16::ratio(-3, 2), Q16(-1.5f)},
+        {"-3 / 2", Q16(-3) / Q16(2), Q16(-1.5f)},
+        {"-(-32768)", -min, max},
+        {"-(-30000 * 2)", -(Q16(-30000) * Q16(2)), max},
+    };
+    uint32_t bad = 0;
+    for (const Case &c : cases) {
+        if (c.got == c.want) continue;
+        bench::fail("q16 %s: raw %ld, want %ld", c.what, long(c.got.raw()), long(c.want.raw()));
+        bad++;
+    }
+    if (min.round() != -32768 || max.round() != 32768) {
+        bench::fail("q16 round at the ends: %ld, %ld", long(min.round()), long(max.round()));
+        bad++;
+    }
+    bench::report("q16 saturation: %zu out-of-range conversions and divisions, %u wrong",
+                  sizeof(cases) / sizeof(cases[0]), bad);
+}
+
+} // namespace
+
+BENCH_SUITE(control_loop) {
+    saturation();
+    constexpr uint32_t iterations = 20'000'000;
+    run<float>(ControlMode::hysteresis, iterations);
+    run<Q16>(ControlMode::hysteresis, iterations);
+    run<float>(ControlMode::pid, iterations);
+    run<Q16>(ControlMode::pid, iterations);
+    accuracy(ControlMode::hysteresis, 1'000'000);
+    accuracy(ControlMode::pid, 1'000'000);
+}
@@ -0,0 +1,198 @@
+// Display renderer on the in-memory panel: a day of the status screen at one
+// frame a second, sent as full redraws and as dirty spans, with the bytes
+// and wire time per frame and the CPU cost of drawing. Checks that the panel
+// always ends up showing exactly the framebuffer, that a double-buffered
+// display can draw the next frame while the last is on the wire without it
+// showing, and that a from-scratch render matches after a long run.
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+
+#include "bench.h"
+#include "display.h"
+
+using namespace thermo;
+
+namespace {
+
+struct Screen {
+    int temp_tenths;
+    int set_tenths;
+    bool heat;
+    int probe_tenths[2];
+    int lo_tenths;
+    int hi_tenths;
+};
+
+void tenths(char *out, size_t size, int v) {
+    const int mag = v < 0 ? -v : v;
+    snprintf(out, size, "%s%d.%d", v < 0 ? "-" : "", mag / 10, mag % 10);
+}
+
+// The same layout as the firmware's display task.
+void draw(Display &d, const Screen &s) {
+    char value[16], hi[16], line[40];
+    tenths(value, sizeof(value), s.set_tenths);
+    snprintf(line, sizeof(line), "SET %-5s", value);
+    d.text(0, 0, line, font_small);
+    d.text(Framebuffer::width - 4 * font_small.advance(), 0, s.heat ? "HEAT" : "IDLE", font_small);
+    tenths(value, sizeof(value), s.temp_tenths);
+    snprintf(line, sizeof(line), "%5s", value);
+    d.text(19, 14, line, font_large);
+    int x = 0;
+    for (int i = 0; i < 2; i++) {
+        tenths(value, sizeof(value), s.probe_tenths[i]);
+        snprintf(line, sizeof(line), "P%d %-5s ", i, value);
+        x = d.text(x, 42, line, font_small);
+    }
+    tenths(value, sizeof(value), s.lo_tenths);
+    tenths(hi, sizeof(hi), s.hi_tenths);
+    snprintf(line, sizeof(line), "24H %s..%s", value, hi);
+    d.fill_rect(d.text(0, 56, line, font_small), 56, Framebuffer::width, 8, false);
+}
+
+// A day of a room drifting around the setpoint under hysteresis control,
+// sampled once a second; the probes lag behind the room.
+struct House {
+    uint32_t rng = 12345;
+    float temp = 19.8f;
+    bool heat = false;
+    Screen s = {};
+
+    float noise() {
+        rng = rng * 1664525u + 1013904223u;
+        return float(rng >> 8) / float(1u << 24) - 0.5f;
+    }
+    const Screen &step(uint32_t t) {
+        const float set = t < 6 * 3600 || t > 22 * 3600 ? 18.0f : 20.5f;
+        if (temp < set - 0.3f) heat = true;
+        if (temp > set + 0.3f) heat = false;
+        temp += (heat ? 0.0009f : -0.0004f) + 0.003f * noise();
+        s.temp_tenths = int(lroundf(temp * 10));
+        s.set_tenths = int(lroundf(set * 10));
+        s.heat = heat;
+        s.probe_tenths[0] = int(lroundf((temp - 1.2f + 0.3f * sinf(t / 5000.0f)) * 10));
+        s.probe_tenths[1] = int(lroundf((temp + 0.4f) * 10));
+        if (!t || s.temp_tenths < s.lo_tenths) s.lo_tenths = s.temp_tenths;
+        if (!t || s.temp_tenths > s.hi_tenths) s.hi_tenths = s.temp_tenths;
+        return s;
+    }
+};
+
+void drain(VirtualClock &clock, MemoryDisplayPort &port) {
+    while (port.busy()) clock.sleep_until(port.busy_until());
+}
+
+bool same(const Framebuffer &a, const Framebuffer &b) {
+    return memcmp(&a, &b, sizeof(Framebuffer)) == 0;
+}
+
+void run_day(const char *name, bool full_redraw, bool double_buffered) {
+    VirtualClock clock;
+    MemoryDisplayPort port(clock, 8'000'000);
+    static Framebuffer fb[2];
+    Display d(port, fb[0], double_buffered ? &fb[1] : nullptr);
+    House house;
+
+    constexpr uint32_t frames = 86400;
+    uint64_t cpu_ns = 0;
+    uint32_t mismatches = 0;
+    for (uint32_t t = 0; t < frames; t++) {
+        clock.sleep_until(uint64_t(t) * 1'000'000);
+        const Screen &s = house.step(t);
+        const uint64_t t0 = bench::now_ns();
+        if (full_redraw) d.invalidate();
+        draw(d, s);
+        d.present();
+        cpu_ns += bench::now_ns() - t0;
+        drain(clock, port);
+        if (!same(port.panel(), d.frame())) mismatches++;
+    }
+    const DisplayStats &st = d.stats();
+    bench::report("%s: %.1f bytes/frame on the wire (%.1f pixel bytes in %.2f spans), %.1f us/frame "
+                  "at 8 MHz, %u of %u frames unchanged",
+                  name, double(port.bytes()) / frames, double(st.data_bytes) / frames,
+                  st.frames ? double(st.spans) / st.frames : 0.0, double(port.busy_us()) / frames,
+                  st.unchanged, frames);
+    bench::report("  %.0f bytes per frame that changed; draw + present %.2f us CPU per frame",
+                  st.frames ? double(port.bytes()) / st.frames : 0.0, cpu_ns / 1e3 / frames);
+    if (mismatches) bench::fail("%s: panel differs from the framebuffer after %u frames", name,
+                                mismatches);
+}
+
+} // namespace
+
+BENCH_SUITE(display) {
+    run_day("full redraw", true, false);
+    run_day("dirty spans", false, false);
+    run_day("dirty spans, double-buffered", false, true);
+
+    // Worst ordinary change: every large digit at once.
+    {
+        VirtualClock clock;
+        MemoryDisplayPort port(clock, 8'000'000);
+        static Framebuffer fb;
+        Display d(port, fb);
+        Screen s = {188, 205, true, {180, 190}, 170, 215};
+        draw(d, s);
+        d.present();
+        drain(clock, port);
+        const uint64_t before = port.bytes();
+        s.temp_tenths = 199;
+        draw(d, s);
+        d.present();
+        drain(clock, port);
+        bench::report("18.8 -> 19.9: %llu bytes (full frame %zu)",
+                      (unsigned long long)(port.bytes() - before),
+                      Framebuffer::pages * (DisplayPort::command_bytes + Framebuffer::width));
+    }
+
+    // Drawing during the transfer. A 1 MHz bus makes a full frame ~8.6 ms.
+    // Single-buffered, drawing must wait for the wire; double-buffered it
+    // starts at once, and the frame on the wire must still arrive intact.
+    for (bool double_buffered : {false, true}) {
+        VirtualClock clock;
+        MemoryDisplayPort port(clock, 1'000'000);
+        static Framebuffer fb[2], shown, reference_fb;
+        Display d(port, fb[0], double_buffered ? &fb[1] : nullptr);
+        House house;
+        constexpr uint32_t frames = 2000;
+        uint64_t waited_us = 0;
+        uint32_t torn = 0;
+        int bar = 0;
+        for (uint32_t t = 0; t < frames; t++) {
+            const uint64_t w0 = clock.now_us();
+            while (!d.ready()) clock.sleep_until(port.busy_until());
+            waited_us += clock.now_us() - w0;
+            draw(d, house.step(t * 600));  // ten minutes a frame: lots of change
+            bar = int(t * 13 % 108);
+            d.fill_rect(0, 36, Framebuffer::width, 3, false);
+            d.fill_rect(bar, 36, 20, 3, true);
+            if (t) {
+                drain(clock, port);
+                if (!same(port.panel(), shown)) torn++;
+            }
+            d.present();
+            memcpy(&shown, &d.frame(), sizeof(shown));
+        }
+        drain(clock, port);
+
+        // Whatever the damage history, a fresh render of the last screen
+        // must match what the panel shows.
+        MemoryDisplayPort ref_port(clock, 1'000'000);
+        Display ref(ref_port, reference_fb);
+        draw(ref, house.s);
+        ref.fill_rect(bar, 36, 20, 3, true);
+        ref.present();
+        drain(clock, ref_port);
+        const bool fresh_ok = same(port.panel(), ref_port.panel());
+
+        bench::report("%s at 1 MHz: drawing waited %.0f us/frame for the bus; frames torn: %u of "
+                      "%u; matches a fresh render=%d",
+                      double_buffered ? "double-buffered" : "single-buffered",
+                      double(waited_us) / frames, torn, frames, fresh_ok);
+        if (torn || !fresh_ok) bench::fail("display contents wrong after %u frames", frames);
+        if (double_buffered && waited_us) bench::fail("double-buffered drawing waited for the bus");
+    }
+}
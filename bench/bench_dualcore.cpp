@@ -0,0 +1,107 @@
+// Core-split stress: the SPSC queue and the sensing core, each run as two
+// host threads standing in for the RP2040's cores.
+#include <thread>
+
+#include "bench.h"
+#include "sensing_core.h"
+#include "sensor.h"
+
+using namespace thermo;
+
+namespace {
+
+// Every field derives from seq, so a torn slot cannot pass the check.
+struct Record {
+    uint32_t seq;
+    uint32_t mixed;
+    uint32_t inverted;
+    uint32_t rotated;
+
+    static Record make(uint32_t seq) {
+        return {seq, seq * 2654435761u, ~seq, (seq << 13) | (seq >> 19)};
+    }
+    bool valid() const { return *this == make(seq); }
+    bool operator==(const Record &o) const {
+        return seq == o.seq && mixed == o.mixed && inverted == o.inverted && rotated == o.rotated;
+    }
+};
+
+void queue_stress(uint32_t count) {
+    static SpscQueue<Record, 32> queue;
+
+    uint64_t t0 = bench::now_ns();
+    std::thread producer([count] {
+        for (uint32_t seq = 0; seq < count; seq++) {
+            // Yield while full: the host may have fewer cores than threads.
+            while (!queue.push(Record::make(seq))) std::this_thread::yield();
+        }
+    });
+    uint32_t expected = 0, torn = 0, reordered = 0;
+    while (expected < count) {
+        Record r;
+        if (!queue.pop(r)) {
+            std::this_thread::yield();
+            continue;
+        }
+        torn += !r.valid();
+        reordered += r.seq != expected;
+        expected = r.seq + 1;
+    }
+    producer.join();
+    uint64_t elapsed = bench::now_ns() - t0;
+
+    bench::report("spsc queue: %u records  %.1f Mrecords/s  torn=%u lost/reordered=%u", count,
+                  count * 1e3 / double(elapsed), torn, reordered);
+    if (torn || reordered) bench::fail("spsc queue corrupted %u / lost %u records", torn, reordered);
+}
+
+// The real producer loop on an emulated core 1: every gap in the sequence
+// must be accounted for by the drop counter.
+void sensing_core_run(uint64_t duration_ms, bool slow_consumer) {
+    sensing_core_init();
+    sensor_host_set_celsius(21.0f);
+    sensing_core_start();
+
+    uint32_t received = 0, gaps = 0, next = 0;
+    uint64_t end = bench::now_ns() + duration_ms * 1'000'000;
+    while (bench::now_ns() < end) {
+        SensorReading r;
+        if (!sensing_core_pop(r)) {
+            std::this_thread::yield();
+            continue;
+        }
+        gaps += r.seq - next;
+        next = r.seq + 1;
+        received++;
+        if (slow_consumer) std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    sensing_core_stop();
+    SensorReading r;
+    while (sensing_core_pop(r)) {
+        gaps += r.seq - next;
+        next = r.seq + 1;
+        received++;
+    }
+    static uint32_t prior_drops;
+    uint32_t drops = sensing_core_drops() - prior_drops;
+    prior_drops = sensing_core_drops();
+    // Drops after the last delivered reading leave no gap behind them.
+    uint32_t produced = next + (drops - gaps);
+
+    bench::report("sensing core (%s consumer): %u readings in %llu ms  %.2f Mreadings/s  "
+                  "drops=%u gaps=%u",
+                  slow_consumer ? "slow" : "fast", received, (unsigned long long)duration_ms,
+                  received / (duration_ms * 1e3), drops, gaps);
+    if (gaps > drops || received + drops != produced) {
+        bench::fail("sensing core lost readings: received %u + drops %u != produced %u", received,
+                    drops, produced);
+    }
+}
+
+} // namespace
+
+BENCH_SUITE(dual_core) {
+    queue_stress(20'000'000);
+    sensing_core_run(300, false);
+    sensing_core_run(300, true);
+}
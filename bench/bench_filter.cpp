@@ -0,0 +1,190 @@
+// Block filter chain (decimate 16:1 -> IIR -> median) against a naive
+// per-sample implementation of the same filters; outputs must match exactly.
+#include <algorithm>
+#include <vector>
+
+#include "bench.h"
+#include "block_filter.h"
+
+using namespace thermo;
+
+namespace {
+
+constexpr unsigned decimation = 16;
+constexpr unsigned iir_shift = 2;
+constexpr size_t block = 256;
+
+// One sample in, at most one sample out; the shape a main-loop filter has.
+class NaiveFilter {
+public:
+    explicit NaiveFilter(unsigned taps) : taps_(taps) {}
+
+    bool push(uint16_t raw, uint16_t &out) {
+        acc_ += raw;
+        if (++phase_ < decimation) return false;
+        uint16_t x = uint16_t(acc_ >> 1);  // 16 samples -> counts x 8
+        acc_ = 0;
+        phase_ = 0;
+
+        if (!primed_) {
+            state_ = int32_t(x) << 8;
+            for (unsigned i = 0; i < taps_; i++) window_[i] = 0;
+        }
+        state_ += ((int32_t(x) << 8) - state_) >> iir_shift;
+        uint16_t y = uint16_t((state_ + 0x80) >> 8);
+
+        if (!primed_) {
+            for (unsigned i = 0; i < taps_; i++) window_[i] = y;
+            primed_ = true;
+        }
+        for (unsigned i = 0; i + 1 < taps_; i++) window_[i] = window_[i + 1];
+        window_[taps_ - 1] = y;
+        uint16_t sorted[5];
+        std::copy(window_, window_ + taps_, sorted);
+        std::sort(sorted, sorted + taps_);
+        out = sorted[taps_ / 2];
+        return true;
+    }
+
+private:
+    unsigned taps_;
+    uint32_t acc_ = 0;
+    unsigned phase_ = 0;
+    int32_t state_ = 0;
+    uint16_t window_[5];
+    bool primed_ = false;
+};
+
+std::vector<uint16_t> make_input(size_t count) {
+    std::vector<uint16_t> samples(count);
+    uint32_t lcg = 99;
+    for (size_t i = 0; i < count; i++) {
+        lcg = lcg * 1664525u + 1013904223u;
+        int drift = int((i >> 12) % 64);
+        int noise = int(lcg >> 28) - 8;
+        int spike = (lcg & 0x1ff) == 0 ? 1500 : 0;
+        samples[i] = uint16_t(std::min(4095, 900 + drift + noise + spike));
+    }
+    return samples;
+}
+
+void run(unsigned taps, const std::vector<uint16_t> &input) {
+    const size_t n = input.size();
+
+    std::vector<uint16_t> naive_out;
+    naive_out.reserve(n / decimation);
+    NaiveFilter naive(taps);
+    uint64_t t0 = bench::now_ns();
+    for (size_t i = 0; i < n; i++) {
+        uint16_t y;
+        if (naive.push(input[i], y)) naive_out.push_back(y);
+    }
+    uint64_t naive_ns = bench::now_ns() - t0;
+
+    std::vector<uint16_t> work(input);  // chain filters in place
+    std::vector<uint16_t> block_out;
+    block_out.reserve(n / decimation);
+    DecimateStage decimate(decimation);
+    IirStage iir(iir_shift);
+    MedianStage median(taps);
+    FilterChain chain;
+    chain.add(decimate).add(iir).add(median);
+    t0 = bench::now_ns();
+    for (size_t i = 0; i + block <= n; i += block) {
+        size_t produced = chain.process(work.data() + i, block);
+        block_out.insert(block_out.end(), work.data() + i, work.data() + i + produced);
+    }
+    uint64_t block_ns = bench::now_ns() - t0;
+
+    bench::report("median-%u  naive %7.1f Msamples/s   block %7.1f Msamples/s   speedup %.1fx",
+                  taps, n * 1e3 / naive_ns, n * 1e3 / block_ns, double(naive_ns) / block_ns);
+    if (block_out != naive_out) bench::fail("median-%u block chain output differs from naive", taps);
+}
+
+// Kernel-level comparison: scalar vs SWAR vs SIMD on the same data.
+template <typename Fn>
+double time_kernel(const std::vector<uint16_t> &input, Fn fn, std::vector<uint16_t> &result) {
+    std::vector<uint16_t> work(input);
+    std::vector<size_t> produced(input.size() / block);
+    uint64_t t0 = bench::now_ns();
+    for (size_t b = 0; b < produced.size(); b++) produced[b] = fn(work.data() + b * block, block);
+    uint64_t elapsed = bench::now_ns() - t0;
+    result.clear();
+    for (size_t b = 0; b < produced.size(); b++) {
+        result.insert(result.end(), work.begin() + b * block, work.begin() + b * block + produced[b]);
+    }
+    return input.size() * 1e3 / double(elapsed);
+}
+
+// The SWAR min and max, lane by lane, against std::min and std::max over
+// every pair of lanes the median stages can see, both lanes at once.
+void swar_lanes() {
+    using namespace filter_kernels;
+    uint32_t bad = 0, pairs = 0;
+    for (uint32_t a = 0; a < 0x8000; a += 37) {
+        for (uint32_t b = 0; b < 0x8000; b += 41) {
+            const uint32_t x = a | (b << 16), y = b | (((a + 0x4000) & 0x7fff) << 16);
+            const uint32_t lo = swar_min(x, y), hi = swar_max(x, y);
+            for (int lane = 0; lane < 2; lane++) {
+                const uint32_t xl = x >> (16 * lane) & 0xffff, yl = y >> (16 * lane) & 0xffff;
+                bad += (lo >> (16 * lane) & 0xffff) != std::min(xl, yl);
+                bad += (hi >> (16 * lane) & 0xffff) != std::max(xl, yl);
+                pairs++;
+            }
+        }
+    }
+    bench::report("swar min/max: %u lane pairs, %u wrong", pairs, bad);
+    if (bad) bench::fail("swar min/max: %u lanes disagree with std::min/std::max", bad);
+}
+
+void kernels(const std::vector<uint16_t> &raw) {
+    using namespace filter_kernels;
+    std::vector<uint16_t> scaled(raw.size()), ref, out;
+    for (size_t i = 0; i < raw.size(); i++) scaled[i] = uint16_t(raw[i] << filter_frac_bits);
+
+    struct {
+        const char *name;
+        size_t (*fn)(uint16_t *, size_t, unsigned);
+    } decimators[] = {
+        {"scalar", decimate_scalar},
+        {"swar", decimate_swar},
+#if THERMO_FILTER_SIMD
+        {"simd", decimate_simd},
+#endif
+    };
+    for (auto &d : decimators) {
+        double rate = time_kernel(raw, [&](uint16_t *p, size_t n) { return d.fn(p, n, decimation); },
+                                  d.fn == decimate_scalar ? ref : out);
+        bench::report("decimate/%u %-6s %8.1f Msamples/s", decimation, d.name, rate);
+        if (d.fn != decimate_scalar && out != ref) bench::fail("decimate %s != scalar", d.name);
+    }
+
+    for (unsigned taps : {3u, 5u}) {
+        struct {
+            const char *name;
+            void (*fn)(uint16_t *, size_t, unsigned);
+        } medians[] = {
+            {"scalar", median_scalar},
+            {"swar", median_swar},
+#if THERMO_FILTER_SIMD
+            {"simd", median_simd},
+#endif
+        };
+        for (auto &m : medians) {
+            double rate = time_kernel(scaled, [&](uint16_t *p, size_t n) { m.fn(p, n, taps); return n; },
+                                      m.fn == median_scalar ? ref : out);
+            bench::report("median-%u   %-6s %8.1f Msamples/s", taps, m.name, rate);
+            if (m.fn != median_scalar && out != ref) bench::fail("median-%u %s != scalar", taps, m.name);
+        }
+    }
+}
+
+} // namespace
+
+BENCH_SUITE(block_filter) {
+    std::vector<uint16_t> input = make_input(size_t(1) << 22);
+    run(3, input);
+    run(5, input);
+    swar_lanes();
+    kernels(input);
+}
@@ -0,0 +1,139 @@
+// Flash log over a memory-mapped file: a simulated year of minute samples
+// and twice-daily setpoint changes, then recovery by scanning, including
+// after a page torn by power loss.
+#include <cstring>
+#include <unistd.h>
+
+#include "bench.h"
+#include "flash_log.h"
+
+using namespace thermo;
+
+namespace {
+
+constexpr const char *flash_path = "/tmp/thermostat_bench_flash.bin";
+constexpr size_t region = THERMO_FLASH_LOG_BYTES;
+constexpr uint8_t setting_setpoint = 1;
+constexpr uint8_t record_sample = record_user;
+
+struct Scan {
+    uint32_t samples = 0;
+    uint32_t settings = 0;
+    uint32_t first_t = 0, last_t = 0;
+    uint32_t out_of_order = 0;
+};
+
+void scan_visitor(void *ctx, uint8_t type, const uint8_t *data, size_t len) {
+    Scan &s = *static_cast<Scan *>(ctx);
+    if (type == record_setting) {
+        s.settings++;
+    } else if (type == record_sample && len == 6) {
+        uint32_t t;
+        memcpy(&t, data, 4);
+        if (!s.samples) s.first_t = t;
+        if (s.samples && t <= s.last_t) s.out_of_order++;
+        s.last_t = t;
+        s.samples++;
+    }
+}
+
+void append_sample(FlashLog &log, uint32_t minute) {
+    uint8_t rec[6];
+    uint32_t t = minute * 60;
+    int16_t centi = int16_t(2000 + (minute % 1440 < 720 ? minute % 720 : 720 - minute % 720) / 4);
+    memcpy(rec, &t, 4);
+    memcpy(rec + 4, &centi, 2);
+    log.append(record_sample, rec, sizeof(rec));
+}
+
+} // namespace
+
+BENCH_SUITE(flash_log) {
+    unlink(flash_path);
+    FileFlash flash(flash_path, region);
+    if (!flash.ok()) {
+        bench::fail("cannot map %s", flash_path);
+        return;
+    }
+
+    // --- a year of history ---------------------------------------------------
+    FlashLog log(flash);
+    log.mount();
+    constexpr uint32_t minutes = 365 * 24 * 60;
+    uint32_t setting_changes = 0;
+    float setpoint = 20.0f;
+    uint64_t t0 = bench::now_ns();
+    for (uint32_t m = 0; m < minutes; m++) {
+        append_sample(log, m);
+        if (m % 720 == 0) {
+            setpoint = setpoint == 20.0f ? 17.5f : 20.0f;
+            log.write_setting(setting_setpoint, &setpoint, sizeof(setpoint));
+            setting_changes++;
+        }
+        if (m % 10 == 0) log.prepare();  // the idle-time maintenance task
+    }
+    log.flush();
+    uint64_t elapsed = bench::now_ns() - t0;
+
+    const FlashLogStats &st = log.stats();
+    uint32_t min_erase = UINT32_MAX, max_erase = 0;
+    for (size_t s = 0; s < region / FlashDevice::sector_size; s++) {
+        uint32_t e = flash.erase_count(s);
+        if (e < min_erase) min_erase = e;
+        if (e > max_erase) max_erase = e;
+    }
+    bench::report("1 simulated year: %u samples + %u setting changes in %.1f ms", minutes,
+                  setting_changes, elapsed / 1e6);
+    bench::report("  payload %llu B, programmed %llu B: write amplification %.2fx (%u pages)",
+                  (unsigned long long)st.payload_bytes, (unsigned long long)st.programmed_bytes,
+                  double(st.programmed_bytes) / st.payload_bytes, st.pages_programmed);
+    bench::report("  %u sector erases, per-sector erase count %u..%u (naive fixed settings "
+                  "sector: %u erases of one sector)",
+                  st.sectors_erased, min_erase, max_erase, setting_changes);
+    if (max_erase - min_erase > 1) bench::fail("uneven wear: %u..%u erases", min_erase, max_erase);
+
+    // --- recovery by scanning --------------------------------------------------
+    FlashLog recovered(flash);
+    t0 = bench::now_ns();
+    uint32_t pages = recovered.mount();
+    uint64_t mount_ns = bench::now_ns() - t0;
+    Scan scan;
+    t0 = bench::now_ns();
+    recovered.for_each(scan_visitor, &scan);
+    uint64_t scan_ns = bench::now_ns() - t0;
+    float restored = 0;
+    recovered.read_setting(setting_setpoint, &restored, sizeof(restored));
+    bench::report("  mount: %u valid pages in %.2f ms; full replay of %u samples (%.1f days) in "
+                  "%.2f ms; setpoint restored %.1f",
+                  pages, mount_ns / 1e6, scan.samples, (scan.last_t - scan.first_t) / 86400.0,
+                  scan_ns / 1e6, restored);
+    if (restored != setpoint) bench::fail("setpoint %.1f restored as %.1f", setpoint, restored);
+    if (scan.out_of_order) bench::fail("%u samples replayed out of order", scan.out_of_order);
+    if (scan.last_t != (minutes - 1) * 60) bench::fail("newest sample lost (last t=%u)", scan.last_t);
+    if (recovered.next_seq() != log.next_seq()) bench::fail("sequence not recovered");
+
+    // --- power loss mid-page ------------------------------------------------
+    for (uint32_t m = minutes; m < minutes + 200; m++) append_sample(recovered, m);
+    flash.fail_next_program_after(100);
+    for (uint32_t m = minutes + 200; m < minutes + 260; m++) append_sample(recovered, m);
+    // "Reboot": everything in RAM is gone, including the unflushed batch.
+    FlashLog rebooted(flash);
+    rebooted.mount();
+    uint32_t torn = rebooted.stats().torn_pages;
+    for (uint32_t m = minutes + 1000; m < minutes + 1100; m++) append_sample(rebooted, m);
+    rebooted.flush();
+    FlashLog again(flash);
+    again.mount();
+    Scan after;
+    again.for_each(scan_visitor, &after);
+    restored = 0;
+    again.read_setting(setting_setpoint, &restored, sizeof(restored));
+    bench::report("  power loss mid-page: %u torn page(s) skipped, newest sample t=%u, "
+                  "out of order=%u, setpoint %.1f",
+                  torn, after.last_t, after.out_of_order, restored);
+    if (torn != 1) bench::fail("expected one torn page, found %u", torn);
+    if (after.out_of_order || after.last_t != (minutes + 1099) * 60 || restored != setpoint) {
+        bench::fail("log not consistent after power loss");
+    }
+    unlink(flash_path);
+}
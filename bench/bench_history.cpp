@@ -0,0 +1,175 @@
+// Compressed temperature history: a year of minute samples with timing
+// jitter and outages, encoded into chunks. Reports bytes per sample against
+// the raw 6-byte record, decode rate and range-query cost, and checks both
+// against the raw samples.
+#include <cmath>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+#include "bench.h"
+#include "flash_log.h"
+#include "history.h"
+
+using namespace thermo;
+
+namespace {
+
+constexpr const char *flash_path = "/tmp/thermostat_bench_history.bin";
+
+struct Sample {
+    uint32_t t;
+    int16_t centi;
+};
+
+// Daily cycle plus a slow random walk, quantised like the sensor path
+// (centi-degrees). Mostly 60 s apart; one sample in 50 a second late or
+// early, and a 45-minute outage every ten days.
+std::vector<Sample> make_year() {
+    std::vector<Sample> out;
+    uint32_t rng = 12345;
+    auto next = [&rng] {
+        rng = rng * 1664525u + 1013904223u;
+        return rng >> 8;
+    };
+    float drift = 0;
+    uint32_t t = 1'700'000'000;
+    for (uint32_t m = 0; m < 365 * 24 * 60; m++) {
+        t += 60;
+        if (m % 14400 == 14399) {
+            t += 45 * 60;
+            continue;
+        }
+        uint32_t jitter = next() % 50;
+        uint32_t ts = t + (jitter == 0 ? 1 : 0) - (jitter == 1 ? 1 : 0);
+        drift += (int(next() % 201) - 100) * 0.0002f;
+        if (drift > 2) drift = 2;
+        if (drift < -2) drift = -2;
+        float c = 20.0f + 1.5f * std::sin(float(m % 1440) * 6.2831853f / 1440) + drift;
+        out.push_back({ts, int16_t(std::lround(c * 100))});
+    }
+    return out;
+}
+
+struct Chunk {
+    uint8_t bytes[HistoryChunkWriter::chunk_size];
+    size_t len;
+};
+
+HistorySummary brute_force(const std::vector<Sample> &samples, uint32_t t0, uint32_t t1) {
+    HistorySummary s;
+    for (const Sample &x : samples) {
+        if (x.t >= t0 && x.t <= t1) s.add(x.t, x.centi);
+    }
+    return s;
+}
+
+bool same(const HistorySummary &a, const HistorySummary &b) {
+    return a.count == b.count && a.min == b.min && a.max == b.max && a.sum == b.sum &&
+           a.t_first == b.t_first && a.t_last == b.t_last;
+}
+
+} // namespace
+
+BENCH_SUITE(history) {
+    const std::vector<Sample> samples = make_year();
+
+    // --- encode ----------------------------------------------------------------
+    std::vector<Chunk> chunks;
+    HistoryChunkWriter writer;
+    auto seal = [&] {
+        Chunk c;
+        memcpy(c.bytes, writer.data(), writer.size());
+        c.len = writer.size();
+        chunks.push_back(c);
+        writer.reset();
+    };
+    uint64_t t0 = bench::now_ns();
+    for (const Sample &s : samples) {
+        if (!writer.append(s.t, s.centi)) {
+            seal();
+            writer.append(s.t, s.centi);
+        }
+    }
+    if (!writer.empty()) seal();
+    uint64_t encode_ns = bench::now_ns() - t0;
+
+    size_t bytes = 0;
+    for (const Chunk &c : chunks) bytes += c.len;
+    bench::report("1 year, %zu samples -> %zu chunks, %zu B: %.2f B/sample (raw record 6 B, "
+                  "%.1fx smaller), encode %.1f Msamples/s",
+                  samples.size(), chunks.size(), bytes, double(bytes) / samples.size(),
+                  6.0 * samples.size() / bytes, samples.size() / (encode_ns / 1e3));
+
+    // --- decode, checked against the input ------------------------------------
+    size_t i = 0, mismatches = 0;
+    int64_t checksum = 0;
+    t0 = bench::now_ns();
+    for (const Chunk &c : chunks) {
+        HistoryChunkReader reader;
+        if (!reader.open(c.bytes, c.len)) {
+            mismatches++;
+            continue;
+        }
+        uint32_t t;
+        int16_t centi;
+        while (reader.next(t, centi)) {
+            checksum += centi;
+            if (i >= samples.size() || samples[i].t != t || samples[i].centi != centi) mismatches++;
+            i++;
+        }
+    }
+    uint64_t decode_ns = bench::now_ns() - t0;
+    bench::keep(checksum);
+    bench::report("  decode all: %.2f ms, %.1f Msamples/s", decode_ns / 1e6,
+                  i / (decode_ns / 1e3));
+    if (i != samples.size() || mismatches) {
+        bench::fail("round trip: %zu of %zu samples decoded, %zu mismatches", i, samples.size(),
+                    mismatches);
+    }
+
+    // --- range queries ---------------------------------------------------------
+    const uint32_t end = samples.back().t;
+    struct Range {
+        const char *name;
+        uint32_t seconds;
+    } ranges[] = {{"last 24 h", 86400}, {"last 7 days", 7 * 86400}, {"last 30 days", 30 * 86400},
+                  {"whole year", end - samples.front().t}};
+    for (const Range &r : ranges) {
+        uint32_t from = end - r.seconds;
+        t0 = bench::now_ns();
+        HistoryRangeQuery q(from, end);
+        for (const Chunk &c : chunks) q.add_chunk(c.bytes, c.len);
+        uint64_t query_ns = bench::now_ns() - t0;
+        HistorySummary expect = brute_force(samples, from, end);
+        bench::report("  %-12s min %.2f max %.2f mean %.2f over %u samples: %u chunks summarised, "
+                      "%u decoded, %.1f us",
+                      r.name, q.result().min / 100.0, q.result().max / 100.0, q.result().mean() / 100,
+                      q.result().count, q.chunks_summarised(), q.chunks_decoded(), query_ns / 1e3);
+        if (!same(q.result(), expect)) bench::fail("%s: query disagrees with brute force", r.name);
+        if (q.chunks_decoded() > 2) bench::fail("%s: decoded %u chunks", r.name, q.chunks_decoded());
+    }
+
+    // --- through the flash log -------------------------------------------------
+    unlink(flash_path);
+    {
+        FileFlash flash(flash_path, THERMO_FLASH_LOG_BYTES);
+        if (!flash.ok()) {
+            bench::fail("cannot map %s", flash_path);
+            return;
+        }
+        FlashLog log(flash);
+        log.mount();
+        HistoryStore store(log);
+        for (const Sample &s : samples) store.append(s.t, s.centi);
+        // The log keeps the newest data; its oldest sectors have been recycled.
+        uint32_t from = end - 7 * 86400;
+        HistorySummary got = store.query(from, end);
+        HistorySummary expect = brute_force(samples, from, end);
+        bench::report("  via flash log: %llu payload B for the year, last 7 days %u samples "
+                      "(includes the chunk still in RAM)",
+                      (unsigned long long)log.stats().payload_bytes, got.count);
+        if (!same(got, expect)) bench::fail("flash-backed query disagrees with brute force");
+    }
+    unlink(flash_path);
+}
@@ -0,0 +1,258 @@
+// HTTP server (http.h): requests per second over loopback for the gzipped
+// web UI, its 304 revalidation and the JSON status, with one and several
+// keep-alive clients and with a connection per request; every response is
+// checked byte for byte. Reports the server's RAM, and no heap call is
+// allowed while requests are served.
+#include <arpa/inet.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "bench.h"
+#include "http.h"
+#include "memory_config.h"
+#include "web_assets.h"
+
+using namespace thermo;
+
+static_assert(sizeof(HttpServer) <= THERMO_RAM_NETWORK, "HttpServer outgrew its arena");
+
+namespace {
+
+int status_json(void *, const HttpRequest &, JsonWriter &out) {
+    out.begin_object();
+    out.key("temp");
+    out.value_centi(2051);
+    out.key("setpoint");
+    out.value_centi(2050);
+    out.key("relay");
+    out.value(true);
+    out.key("mode");
+    out.value("pid");
+    out.key("uptime_s");
+    out.value(int32_t(86400));
+    out.end_object();
+    return 200;
+}
+
+constexpr char status_body[] =
+    "{\"temp\":20.51,\"setpoint\":20.50,\"relay\":true,\"mode\":\"pid\",\"uptime_s\":86400}";
+
+// The server, busy-polled on its own thread like the firmware's http task
+// without the sleep in between.
+class Server {
+public:
+    Server() : server_(transport_) {
+        server_.add_json("/api/status", status_json, nullptr);
+        server_.poll();  // listen, to learn the port
+        thread_ = std::thread([this] {
+            while (!stop_) server_.poll();
+        });
+    }
+    ~Server() { stop(); }
+    void stop() {
+        stop_ = true;
+        if (thread_.joinable()) thread_.join();
+    }
+    uint16_t port() const { return transport_.port(); }
+    // Read once stopped.
+    const HttpStats &stats() const { return server_.stats(); }
+
+private:
+    HttpSocketTransport transport_{"127.0.0.1", 0};
+    HttpServer server_;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+enum class Kind { asset, revalidate, json };
+
+// A blocking client that checks every response it reads.
+class Client {
+public:
+    ~Client() { disconnect(); }
+
+    bool connect(uint16_t port) {
+        disconnect();
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        const int one = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return ::connect(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+    }
+    void disconnect() {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+    // One request and its response; false if anything was off.
+    bool request(Kind kind, bool close) {
+        const WebAsset &a = *web_asset_find("/index.html", 11);
+        char req[256];
+        size_t len = 0;
+        auto put = [&](const char *s) {
+            const size_t n = strlen(s);
+            memcpy(req + len, s, n);
+            len += n;
+        };
+        put(kind == Kind::json ? "GET /api/status HTTP/1.1\r\n" : "GET / HTTP/1.1\r\n");
+        put("Host: thermostat\r\nAccept-Encoding: gzip, deflate\r\n");
+        if (kind == Kind::revalidate) {
+            put("If-None-Match: ");
+            put(a.etag);
+            put("\r\n");
+        }
+        put(close ? "Connection: close\r\n\r\n" : "\r\n");
+        if (::send(fd_, req, len, MSG_NOSIGNAL) != ssize_t(len)) return false;
+
+        // Header, then Content-Length bytes of body.
+        size_t have = 0, head = 0;
+        while (!head) {
+            const ssize_t n = ::recv(fd_, buf_ + have, sizeof(buf_) - have - 1, 0);
+            if (n <= 0) return false;
+            have += size_t(n);
+            buf_[have] = 0;
+            if (const char *end = strstr(buf_, "\r\n\r\n")) head = size_t(end - buf_) + 4;
+        }
+        const int status = atoi(buf_ + 9);
+        const char *cl = strstr(buf_, "Content-Length: ");
+        const size_t body = cl && size_t(cl - buf_) < head ? size_t(atol(cl + 16)) : 0;
+        while (have < head + body) {
+            const ssize_t n = ::recv(fd_, buf_ + have, sizeof(buf_) - have - 1, 0);
+            if (n <= 0) return false;
+            have += size_t(n);
+        }
+        if (have != head + body) return false;
+        const uint8_t *b = reinterpret_cast<const uint8_t *>(buf_ + head);
+        switch (kind) {
+        case Kind::asset:
+            return status == 200 && body == a.size && !memcmp(b, a.data, a.size) &&
+                   strstr(buf_, "Content-Encoding: gzip\r\n");
+        case Kind::revalidate:
+            return status == 304 && body == 0;
+        case Kind::json:
+            return status == 200 && body == sizeof(status_body) - 1 &&
+                   !memcmp(b, status_body, body);
+        }
+        return false;
+    }
+
+private:
+    int fd_ = -1;
+    char buf_[4096];
+};
+
+struct Run {
+    double per_s = 0;
+    uint64_t heap = 0;
+    uint32_t bad = 0;
+};
+
+// `clients` threads each make `requests` requests, on one connection or a
+// new one each time.
+Run load(Server &server, Kind kind, uint32_t clients, uint32_t requests, bool per_request) {
+    static Client pool[HttpServer::max_connections];
+    std::atomic<uint32_t> ready{0}, done{0}, bad{0};
+    std::atomic<bool> go{false}, release{false};
+    std::thread threads[HttpServer::max_connections];
+    for (uint32_t i = 0; i < clients; i++) {
+        threads[i] = std::thread([&, i] {
+            Client &c = pool[i];
+            if (!per_request && !c.connect(server.port())) bad++;
+            ready++;
+            while (!go) {}
+            for (uint32_t r = 0; r < requests; r++) {
+                if (per_request && !c.connect(server.port())) bad++;
+                if (!c.request(kind, per_request)) bad++;
+            }
+            c.disconnect();
+            done++;
+            // Thread teardown frees; keep it out of the count.
+            while (!release) {}
+        });
+    }
+    while (ready < clients) {}
+    Run r;
+    const uint64_t heap0 = bench::heap_calls();
+    const uint64_t t0 = bench::now_ns();
+    go = true;
+    while (done < clients) {}
+    const uint64_t t1 = bench::now_ns();
+    r.heap = bench::heap_calls() - heap0;
+    release = true;
+    for (uint32_t i = 0; i < clients; i++) threads[i].join();
+    r.per_s = double(clients) * requests / (double(t1 - t0) * 1e-9);
+    r.bad = bad;
+    return r;
+}
+
+} // namespace
+
+BENCH_SUITE(http) {
+    uint32_t packed = 0, raw = 0;
+    for (size_t i = 0; i < web_asset_count; i++) {
+        packed += web_assets[i].size;
+        raw += web_assets[i].raw_size;
+    }
+    bench::report("web UI: %zu assets, %u bytes gzipped in flash (%u raw), no RAM copy",
+                  web_asset_count, packed, raw);
+    bench::report("server: %zu bytes static for %zu connections (%zu B request line, %zu B "
+                  "response buffer each)",
+                  sizeof(HttpServer), HttpServer::max_connections, HttpServer::max_line,
+                  HttpServer::out_bytes);
+
+    struct Case {
+        const char *name;
+        Kind kind;
+        uint32_t clients;
+        uint32_t requests;
+        bool per_request;
+    };
+    const Case cases[] = {
+        {"index.html, gzipped      ", Kind::asset, 1, 20'000, false},
+        {"index.html, 304          ", Kind::revalidate, 1, 20'000, false},
+        {"/api/status JSON         ", Kind::json, 1, 20'000, false},
+        {"index.html, 4 clients    ", Kind::asset, 4, 10'000, false},
+        {"/api/status, 4 clients   ", Kind::json, 4, 10'000, false},
+        {"index.html, new conn each", Kind::asset, 1, 2'000, true},
+    };
+    Server server;
+    for (const Case &c : cases) {
+        const Run r = load(server, c.kind, c.clients, c.requests, c.per_request);
+        bench::report("%s: %8.0f requests/s, %llu heap calls%s", c.name, r.per_s,
+                      (unsigned long long)r.heap, r.bad ? ", BAD RESPONSES" : "");
+        if (r.bad || r.heap) bench::fail("http %s: %u bad responses", c.name, r.bad);
+    }
+
+    // Every slot held by an idle keep-alive client: a newcomer still gets in,
+    // in place of the one that has waited longest.
+    static Client idle[HttpServer::max_connections + 1];
+    uint32_t idle_bad = 0;
+    for (Client &c : idle) {
+        idle_bad += !c.connect(server.port()) || !c.request(Kind::json, false);
+    }
+    idle_bad += !idle[HttpServer::max_connections].request(Kind::revalidate, false);
+    bench::report("%zu idle keep-alive clients, then one more: %s", HttpServer::max_connections,
+                  idle_bad ? "LOCKED OUT" : "served");
+    if (idle_bad) bench::fail("http: %u requests failed with the pool held idle", idle_bad);
+    for (Client &c : idle) c.disconnect();
+
+    server.stop();
+    const HttpStats &s = server.stats();
+    bench::report("%u requests on %u connections (peak %u at once, %u idle evicted), %u not "
+                  "modified, %.1f MB of asset bodies sent by reference",
+                  s.requests, s.accepted, s.peak_connections, s.evicted, s.not_modified,
+                  double(s.body_bytes) / 1e6);
+    if (s.errors || s.refused || !s.evicted ||
+        s.peak_connections > HttpServer::max_connections) {
+        bench::fail("http: %u errors, %u refused", s.errors, s.refused);
+    }
+}
@@ -0,0 +1,78 @@
+// Benchmark runner: thermostat_bench [-o file] [suite...]
+#include <cstdarg>
+#include <cstring>
+
+#include "bench.h"
+
+namespace bench {
+
+static Suite *suites;
+static FILE *out_file;
+static bool failed;
+
+Suite *register_suite(Suite *suite) {
+    // Keep registration order stable regardless of static-init order within
+    // a file by appending at the tail.
+    Suite **tail = &suites;
+    while (*tail) tail = &(*tail)->next;
+    *tail = suite;
+    return suite;
+}
+
+static void vwrite(const char *prefix, const char *fmt, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    fputs(prefix, stdout);
+    vprintf(fmt, args);
+    fputc('\n', stdout);
+    if (out_file) {
+        fputs(prefix, out_file);
+        vfprintf(out_file, fmt, copy);
+        fputc('\n', out_file);
+    }
+    va_end(copy);
+}
+
+void report(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vwrite("", fmt, args);
+    va_end(args);
+}
+
+void fail(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vwrite("FAIL: ", fmt, args);
+    va_end(args);
+    failed = true;
+}
+
+} // namespace bench
+
+int main(int argc, char **argv) {
+    const char *out_path = "bench_output.txt";
+    int first_filter = 1;
+    if (argc > 2 && strcmp(argv[1], "-o") == 0) {
+        out_path = argv[2];
+        first_filter = 3;
+    }
+    bench::out_file = fopen(out_path, "w");
+    if (!bench::out_file) {
+        fprintf(stderr, "cannot open %s\n", out_path);
+        return 1;
+    }
+
+    for (bench::Suite *s = bench::suites; s; s = s->next) {
+        bool selected = first_filter >= argc;
+        for (int i = first_filter; i < argc && !selected; i++) {
+            selected = strstr(s->name, argv[i]) != nullptr;
+        }
+        if (!selected) continue;
+        bench::report("== %s", s->name);
+        s->fn();
+    }
+
+    fclose(bench::out_file);
+    return bench::failed ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+// Static memory model check: after the firmware's own init sequence, a
+// simulated day of operation must not allocate at all. malloc and friends
+// are interposed (glibc) to count every heap call in the process; operator
+// new goes through malloc, so it is counted too.
+#include <atomic>
+#include <unistd.h>
+
+#include "app.h"
+#include "arena.h"
+#include "bench.h"
+#include "flash_device.h"
+#include "flash_log.h"
+#include "mqtt.h"
+#include "power.h"
+#include "sensing_core.h"
+#include "sensor.h"
+#include "telemetry.h"
+
+extern "C" {
+void *__libc_malloc(size_t);
+void *__libc_calloc(size_t, size_t);
+void *__libc_realloc(void *, size_t);
+void __libc_free(void *);
+}
+
+static std::atomic<uint64_t> heap_call_count{0};
+
+uint64_t bench::heap_calls() {
+    return heap_call_count.load();
+}
+
+extern "C" void *malloc(size_t n) {
+    heap_call_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(n);
+}
+
+extern "C" void *calloc(size_t n, size_t size) {
+    heap_call_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *p, size_t n) {
+    heap_call_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(p, n);
+}
+
+extern "C" void free(void *p) {
+    if (p) heap_call_count.fetch_add(1, std::memory_order_relaxed);
+    __libc_free(p);
+}
+
+using namespace thermo;
+
+namespace {
+
+// Telemetry is built, queued and sent, into nowhere.
+struct DiscardSink final : TelemetrySink {
+    size_t write(const uint8_t *, size_t len) override { return len; }
+};
+
+// No broker ever answers: readings fill every MQTT buffer and then drop.
+struct NoBroker final : MqttTransport {
+    bool open() override { return false; }
+    void close() override {}
+    bool send(const uint8_t *, size_t) override { return false; }
+    void poll() override {}
+};
+
+} // namespace
+
+BENCH_SUITE(memory) {
+    VirtualClock clock;
+    static FileFlash flash("/tmp/thermostat_bench_memory_flash.bin", THERMO_FLASH_LOG_BYTES);
+    AppConfig config;
+    config.status_output = false;
+    config.flash = &flash;
+    static DiscardSink telemetry_sink;
+    config.telemetry = &telemetry_sink;
+    static NoBroker broker;
+    config.mqtt = &broker;
+    static PowerModel power(clock);
+    config.power = &power;
+
+    uint64_t before_init = bench::heap_calls();
+    Scheduler &scheduler = app_init(clock, config);
+    sensor_host_set_celsius(19.0f);
+    app_start();
+    uint64_t after_init = bench::heap_calls();
+
+    constexpr uint64_t day_us = 24ull * 3600 * 1'000'000;
+    size_t runs = 0;
+    while (clock.now_us() < day_us) runs += scheduler.run_once();
+    uint64_t after_run = bench::heap_calls();
+    sensing_core_stop();
+    unlink("/tmp/thermostat_bench_memory_flash.bin");
+
+    bench::report("heap calls: init %llu (host thread start), one simulated day %llu over %zu task runs",
+                  (unsigned long long)(after_init - before_init),
+                  (unsigned long long)(after_run - after_init), runs);
+    for (Arena *a = Arena::first(); a; a = a->next()) {
+        bench::report("  arena %-10s %5zu / %5zu bytes in %u allocations%s", a->name(), a->used(),
+                      a->capacity(), a->allocations(), a->sealed() ? ", sealed" : "");
+        if (!a->sealed()) bench::fail("arena %s not sealed after app_start()", a->name());
+    }
+    if (after_run != after_init) {
+        bench::fail("%llu heap calls after init", (unsigned long long)(after_run - after_init));
+    }
+
+    // Fixed-block pool churn: allocate and release in a steady pattern.
+    alignas(8) static uint8_t pool_storage[4096];
+    static Arena pool_arena("bench_pool", pool_storage, sizeof(pool_storage));
+    struct Buffer {
+        uint8_t bytes[60];
+    };
+    BlockPool<Buffer> pool;
+    pool.init(pool_arena, 32);
+    pool_arena.seal();
+    Buffer *held[32] = {};
+    uint64_t t0 = bench::now_ns();
+    constexpr uint32_t ops = 10'000'000;
+    for (uint32_t i = 0; i < ops; i++) {
+        Buffer *&slot = held[(i * 7) & 31];
+        if (slot) {
+            pool.release(slot);
+            slot = nullptr;
+        } else {
+            slot = pool.allocate();
+        }
+    }
+    uint64_t elapsed = bench::now_ns() - t0;
+    bench::report("block pool: %.2f ns per allocate/release, peak %zu of %zu blocks",
+                  double(elapsed) / ops, pool.peak(), pool.capacity());
+}
@@ -0,0 +1,124 @@
+// MPC mode (mpc.h): the compile-time horizon tables against libm, the cost
+// of one solve on each numeric backend (and what that means on the M0+),
+// and the Q16 controller's closed-loop drift from the float one on the
+// same house.
+#include <algorithm>
+#include <cmath>
+
+#include "bench.h"
+#include "house_model.h"
+#include "mpc.h"
+#include "thermostat.h"
+
+using namespace thermo;
+
+// The tables are constant-evaluated, not built at startup.
+static_assert(mpc::tables<Q16>.step[0][0].raw() == 0, "horizon tables must be constexpr");
+static_assert(mpc::tables<float>.step[mpc::tau_points - 1][mpc::horizon] > 0.0f,
+              "horizon tables must be constexpr");
+
+namespace {
+
+// A terrace-sized model, as autotune fits it (bench_autotune).
+constexpr float gain_c = 3.2f, tau_s = 74 * 60, dead_s = 6 * 60, move_s = 600;
+constexpr MpcWeights weights{0.05f, 0.1f};
+
+template <typename T>
+void solve_cost() {
+    static MpcController<T> c;
+    constexpr uint32_t models = 2000;
+    uint64_t t0 = bench::now_ns();
+    for (uint32_t i = 0; i < models; i++) {
+        c.set_model(gain_c + 0.001f * (i & 7), tau_s, dead_s, move_s, weights);
+    }
+    const double model_ns = double(bench::now_ns() - t0) / models;
+
+    constexpr uint32_t solves = 200'000;
+    uint32_t rng = 1;
+    T acc(0);
+    t0 = bench::now_ns();
+    const uint64_t c0 = bench::cycles();
+    for (uint32_t i = 0; i < solves; i++) {
+        rng = rng * 1664525u + 1013904223u;
+        const T temp = Numeric<T>::from_float(19.0f + float(rng >> 8) / float(1u << 24) * 2);
+        acc += c.update(temp, T(20));
+    }
+    const uint64_t c1 = bench::cycles();
+    const double ns = double(bench::now_ns() - t0) / solves;
+    bench::keep(acc);
+    bench::report("%-7s solve %7.1f ns (%6.0f cycles), new model %7.1f ns", Numeric<T>::name, ns,
+                  double(c1 - c0) / solves, model_ns);
+}
+
+struct Run {
+    double mean_c = 0;
+    double kwh = 0;
+};
+
+template <typename T>
+Run closed_loop(uint32_t days) {
+    ThermostatConfig config;
+    config.mode = ControlMode::mpc;
+    config.model_gain_c = gain_c;
+    config.model_tau_s = tau_s;
+    config.model_dead_s = dead_s;
+    BasicThermostat<T> t(config);
+    const sim::HouseParams house = {"terrace", 4.0e6, 2.5e5, 450, 160, 6000, 60, 2};
+    sim::House h(house, 18.0);
+    Run r;
+    const uint32_t seconds = days * 86400;
+    for (uint32_t s = 0; s < seconds; s++) {
+        // Setback at night.
+        if (s % 86400 == 0) t.set_setpoint(20.0f);
+        if (s % 86400 == 16 * 3600) t.set_setpoint(17.0f);
+        h.step(t.step(Numeric<T>::from_float(float(h.sensor()))));
+        r.mean_c += h.air_c() / seconds;
+    }
+    r.kwh = h.energy_kwh();
+    return r;
+}
+
+} // namespace
+
+BENCH_SUITE(mpc) {
+    // --- tables ------------------------------------------------------------------
+    double worst = 0;
+    int32_t worst_q16 = 0;
+    for (uint32_t k = 0; k < mpc::tau_points; k++) {
+        const double tau = mpc::tables<float>.tau[k];
+        for (uint32_t n = 0; n <= mpc::horizon; n++) {
+            const double exact = 1 - std::exp(-double(n) / tau);
+            worst = std::max(worst, std::fabs(mpc::tables<float>.step[k][n] - exact));
+            const int32_t q = mpc::tables<Q16>.step[k][n].raw() - Q16(exact).raw();
+            worst_q16 = std::max(worst_q16, q < 0 ? -q : q);
+        }
+    }
+    bench::report("horizon tables: %u time constants x %u moves, %zu bytes (Q16) in flash; "
+                  "worst error %.1e (float), %d LSB (Q16)",
+                  mpc::tau_points, mpc::horizon + 1, sizeof(mpc::HorizonTables<Q16>), worst,
+                  int(worst_q16));
+    if (worst > 1e-6 || worst_q16 > 1) bench::fail("horizon tables disagree with libm");
+
+    // --- one solve ---------------------------------------------------------------
+    solve_cost<float>();
+    solve_cost<Q16>();
+    // Multiplies per solve: the horizon loop (model step, error, one response
+    // and product per decided move), then the coordinate-descent sweeps.
+    constexpr uint32_t muls = 6 + mpc::horizon * (3 + 2 * mpc::moves) + mpc::moves + 1 +
+                              mpc::sweeps * mpc::moves * (mpc::moves + 1);
+    // A Q16 multiply on the M0+ is a 32x32->64 library call plus shift and
+    // saturation: about 40 cycles. Loads, adds and compares at least double it.
+    const double m0_us = muls * 40.0 * 2 / 125.0;
+    bench::report("M0+ estimate: %u Q16 multiplies per solve, ~%.0f us at 125 MHz, once per "
+                  "%.0f s move in a %.0f s control tick",
+                  muls, m0_us, move_s, ThermostatConfig{}.tick_s);
+
+    // --- Q16 against float in closed loop ----------------------------------------
+    const Run f = closed_loop<float>(4);
+    const Run q = closed_loop<Q16>(4);
+    bench::report("closed loop, 4 days: mean room %.3f C float vs %.3f C q16; %.2f vs %.2f kWh",
+                  f.mean_c, q.mean_c, f.kwh, q.kwh);
+    if (std::fabs(f.mean_c - q.mean_c) > 0.05 || std::fabs(f.kwh - q.kwh) > 0.02 * f.kwh) {
+        bench::fail("q16 mpc drifts from float");
+    }
+}
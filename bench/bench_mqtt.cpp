@@ -0,0 +1,372 @@
+// MQTT publisher (mqtt.h): the cost of serialising a reading, throughput
+// over a loopback TCP connection to a broker stand-in as the QoS 1 window
+// widens against a slow PUBACK, and redelivery with DUP when the broker
+// drops the connection mid-stream. No heap call is allowed while readings
+// flow.
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "bench.h"
+#include "memory_config.h"
+#include "mqtt.h"
+
+using namespace thermo;
+
+namespace {
+
+MqttReading reading(uint32_t i) {
+    return {i, int16_t(2000 + i % 100), -50, (i & 1) != 0};
+}
+
+// --- in-process broker ---------------------------------------------------------
+
+// Reports every packet sent and answers it at once, so only the client's own
+// work is timed.
+struct InstantBroker final : MqttTransport {
+    bool open() override { return connect_ = true; }
+    void close() override { count_ = 0; }
+    bool send(const uint8_t *data, size_t len) override {
+        if (count_ == max) return false;
+        queue_[count_++] = {data, len};
+        return true;
+    }
+    void poll() override {
+        if (connect_) {
+            connect_ = false;
+            client_->on_connected();
+        }
+        // Answer first: once reported sent, the bytes may be reused.
+        uint8_t replies[max * 4];
+        size_t n = 0, sent = 0;
+        for (size_t i = 0; i < count_; i++) {
+            const uint8_t *p = queue_[i].data;
+            sent += queue_[i].len;
+            if (p[0] >> 4 == 1) {
+                const uint8_t connack[] = {0x20, 2, 0, 0};
+                memcpy(replies + n, connack, 4);
+            } else {
+                const size_t header = p[1] & 0x80 ? 3 : 2;
+                const uint8_t *id = p + header + 2 + (p[header] << 8 | p[header + 1]);
+                const uint8_t puback[] = {0x40, 2, id[0], id[1]};
+                memcpy(replies + n, puback, 4);
+            }
+            n += 4;
+        }
+        count_ = 0;
+        if (sent) client_->on_sent(sent);
+        if (n) client_->on_receive(replies, n);
+    }
+
+private:
+    struct Packet {
+        const uint8_t *data;
+        size_t len;
+    };
+    static constexpr size_t max = 8;
+    Packet queue_[max];
+    size_t count_ = 0;
+    bool connect_ = false;
+};
+
+void serialise_cost() {
+    static SystemClock clock;
+    InstantBroker broker;
+    static MqttClient client(broker, clock);
+    while (!client.connected()) client.poll();
+    constexpr uint32_t n = 1'000'000;
+    const uint64_t heap0 = bench::heap_calls();
+    const uint64_t t0 = bench::now_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        client.publish(reading(i));
+        if (client.buffers_in_use() > 2) client.poll();
+    }
+    client.flush();
+    client.poll();
+    client.poll();
+    const double ns = double(bench::now_ns() - t0) / n;
+    const uint64_t heap = bench::heap_calls() - heap0;
+    const MqttStats &s = client.stats();
+    bench::report("serialise and frame: %.1f ns per reading, %.0f bytes per reading on the "
+                  "wire; %u buffers taken from the pool for %u PUBLISHes, %llu heap calls",
+                  ns, double(s.bytes) / n, s.buffer_allocs, s.publishes,
+                  (unsigned long long)heap);
+    if (heap || s.dropped || s.acked != s.publishes) bench::fail("mqtt serialisation is wrong");
+}
+
+// --- loopback broker -----------------------------------------------------------
+
+// A broker stand-in on its own thread: accepts CONNECT, PINGREQ and QoS 1
+// PUBLISH, holds every PUBACK back for ack_delay_us, and can drop the first
+// connection after a number of PUBLISHes to force redelivery. Static buffers
+// only, so its thread adds nothing to the heap count either.
+class Broker {
+public:
+    static constexpr uint32_t max_readings = 1 << 16;
+
+    Broker(uint32_t ack_delay_us, uint32_t drop_after)
+        : ack_delay_ns_(uint64_t(ack_delay_us) * 1000), drop_after_(drop_after) {
+        memset(seen_, 0, sizeof(seen_));
+        listen_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (bind(listen_, reinterpret_cast<sockaddr *>(&addr), len) != 0 ||
+            listen(listen_, 1) != 0 ||
+            getsockname(listen_, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+            bench::fail("loopback broker cannot listen");
+        }
+        port_ = ntohs(addr.sin_port);
+        thread_ = std::thread([this] { serve(); });
+    }
+    ~Broker() {
+        stop_ = true;
+        thread_.join();
+        ::close(listen_);
+    }
+
+    uint16_t port() const { return port_; }
+    // Read once the client is done.
+    uint32_t connects() const { return connects_; }
+    uint32_t publishes() const { return publishes_; }
+    uint32_t dups() const { return dups_; }
+    uint32_t unique() const { return unique_; }
+    const char *first_payload() const { return first_payload_; }
+
+private:
+    struct Ack {
+        uint8_t bytes[4];
+        uint64_t due_ns;
+    };
+
+    void serve() {
+        while (!stop_) {
+            pollfd p = {listen_, POLLIN, 0};
+            if (::poll(&p, 1, 1) <= 0) continue;
+            const int fd = accept(listen_, nullptr, nullptr);
+            if (fd < 0) continue;
+            const int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            connects_++;
+            session(fd);
+            ::close(fd);
+        }
+    }
+
+    void session(int fd) {
+        size_t have = 0;
+        acks_head_ = acks_count_ = 0;
+        while (!stop_) {
+            const uint64_t now = bench::now_ns();
+            while (acks_count_ && acks_[acks_head_].due_ns <= now) {
+                reply(fd, acks_[acks_head_].bytes);
+                acks_head_ = (acks_head_ + 1) % max_acks;
+                acks_count_--;
+            }
+            uint64_t wait_ns = 1'000'000;
+            if (acks_count_) wait_ns = std::min(wait_ns, acks_[acks_head_].due_ns - now);
+            pollfd p = {fd, POLLIN, 0};
+            const timespec ts = {0, long(wait_ns)};
+            if (ppoll(&p, 1, &ts, nullptr) <= 0) continue;
+            const ssize_t n = ::recv(fd, in_ + have, sizeof(in_) - have, 0);
+            if (n <= 0) return;
+            have += size_t(n);
+            size_t used = 0;
+            for (;;) {
+                const size_t len = packet(fd, in_ + used, have - used);
+                if (len == 0) break;
+                if (len == size_t(-1)) return;
+                used += len;
+            }
+            memmove(in_, in_ + used, have - used);
+            have -= used;
+        }
+    }
+
+    // Handles one whole packet; 0 if incomplete, -1 to drop the connection.
+    size_t packet(int fd, const uint8_t *p, size_t avail) {
+        size_t body = 0, header = 1;
+        for (uint32_t shift = 0;; shift += 7) {
+            if (header >= avail) return 0;
+            const uint8_t c = p[header++];
+            body |= size_t(c & 0x7f) << shift;
+            if (!(c & 0x80)) break;
+        }
+        if (header + body > avail) return 0;
+        const uint8_t *b = p + header;
+        switch (p[0] >> 4) {
+        case 1: {  // CONNECT
+            const uint8_t connack[] = {0x20, 2, 0, 0};
+            reply(fd, connack);
+            break;
+        }
+        case 3: {  // PUBLISH, QoS 1
+            publishes_++;
+            if (p[0] & 0x08) dups_++;
+            if (drop_after_ && publishes_ == drop_after_) return size_t(-1);
+            const size_t topic = size_t(b[0] << 8 | b[1]);
+            const uint8_t *id = b + 2 + topic;
+            const char *json = reinterpret_cast<const char *>(id + 2);
+            const size_t json_len = body - 4 - topic;
+            if (!first_payload_[0]) {
+                memcpy(first_payload_, json, std::min(json_len, sizeof(first_payload_) - 1));
+            }
+            count(json, json_len);
+            if (acks_count_ < max_acks) {
+                Ack &a = acks_[(acks_head_ + acks_count_++) % max_acks];
+                a = {{0x40, 2, id[0], id[1]}, bench::now_ns() + ack_delay_ns_};
+            }
+            break;
+        }
+        case 12: {  // PINGREQ
+            const uint8_t pingresp[] = {0xd0, 0};
+            reply(fd, pingresp);
+            break;
+        }
+        case 14:  // DISCONNECT
+            return size_t(-1);
+        default:
+            break;
+        }
+        return header + body;
+    }
+
+    // Marks every "t" in the batch seen.
+    void count(const char *json, size_t len) {
+        for (size_t i = 0; i + 4 < len; i++) {
+            if (memcmp(json + i, "\"t\":", 4)) continue;
+            uint32_t t = 0;
+            for (i += 4; i < len && json[i] >= '0' && json[i] <= '9'; i++) {
+                t = t * 10 + uint32_t(json[i] - '0');
+            }
+            if (t < max_readings && !seen_[t]) {
+                seen_[t] = true;
+                unique_++;
+            }
+        }
+    }
+
+    static void reply(int fd, const uint8_t *bytes) {
+        const size_t len = bytes[0] >> 4 == 13 ? 2 : 4;
+        if (::send(fd, bytes, len, MSG_NOSIGNAL) != ssize_t(len)) return;
+    }
+
+    static constexpr size_t max_acks = 64;
+
+    uint64_t ack_delay_ns_;
+    uint32_t drop_after_;
+    int listen_ = -1;
+    uint16_t port_ = 0;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+    std::atomic<uint32_t> connects_{0};
+    std::atomic<uint32_t> publishes_{0};
+    std::atomic<uint32_t> dups_{0};
+    std::atomic<uint32_t> unique_{0};
+    uint8_t in_[4096];
+    Ack acks_[max_acks];
+    size_t acks_head_ = 0;
+    size_t acks_count_ = 0;
+    char first_payload_[128] = {};
+    bool seen_[max_readings];
+};
+
+struct Run {
+    double readings_per_s = 0;
+    uint64_t heap = 0;
+    bool timed_out = false;
+    MqttStats stats;
+};
+
+// Publishes `readings` as fast as the buffers free up, then waits for the
+// last PUBACK.
+Run stream(Broker &broker, const MqttConfig &config, uint32_t readings) {
+    static SystemClock clock;
+    SocketTransport transport("127.0.0.1", broker.port());
+    MqttClient client(transport, clock, config);
+    Run r;
+    const uint64_t deadline = bench::now_ns() + 20'000'000'000ull;
+    while (!client.connected() && bench::now_ns() < deadline) client.poll();
+
+    const uint64_t heap0 = bench::heap_calls();
+    const uint64_t t0 = bench::now_ns();
+    for (uint32_t i = 0; i < readings && bench::now_ns() < deadline; i++) {
+        while (client.buffers_in_use() == MqttClient::buffers && bench::now_ns() < deadline) {
+            client.poll();
+        }
+        client.publish(reading(i));
+        client.poll();
+    }
+    client.flush();
+    while (client.buffers_in_use() && bench::now_ns() < deadline) client.poll();
+    const uint64_t t1 = bench::now_ns();
+    r.heap = bench::heap_calls() - heap0;
+    r.timed_out = t1 >= deadline;
+    r.readings_per_s = readings / (double(t1 - t0) * 1e-9);
+    r.stats = client.stats();
+    return r;
+}
+
+} // namespace
+
+BENCH_SUITE(mqtt) {
+    static_assert(sizeof(MqttClient) <= THERMO_RAM_NETWORK, "MqttClient outgrew its arena");
+    bench::report("client: %zu packet buffers of %zu bytes, %zu bytes in all",
+                  MqttClient::buffers, MqttClient::buffer_bytes, sizeof(MqttClient));
+
+    // --- serialisation -------------------------------------------------------------
+    serialise_cost();
+
+    // --- throughput against a slow PUBACK ------------------------------------------
+    constexpr uint32_t ack_delay_us = 500;
+    constexpr uint32_t readings = 10'000;
+    double single = 0;
+    for (uint32_t window : {1u, 2u, 4u}) {
+        Broker broker(ack_delay_us, 0);
+        MqttConfig config;
+        config.window = window;
+        const Run r = stream(broker, config, readings);
+        if (window == 1) single = r.readings_per_s;
+        bench::report("window %u, PUBACK after %u us: %7.0f readings/s (%4.1fx), %u PUBLISHes, "
+                      "peak %u buffers, %llu heap calls",
+                      window, ack_delay_us, r.readings_per_s, r.readings_per_s / single,
+                      r.stats.publishes, r.stats.peak_buffers, (unsigned long long)r.heap);
+        if (r.timed_out || r.heap || r.stats.dropped || broker.unique() != readings ||
+            r.stats.acked != r.stats.publishes) {
+            bench::fail("mqtt window %u lost readings or allocated", window);
+        }
+        if (window == 1) {
+            const char *expect = "[{\"t\":0,\"c\":20.00,\"sp\":-0.50,\"on\":0},"
+                                 "{\"t\":1,\"c\":20.01,\"sp\":-0.50,\"on\":1},";
+            if (strncmp(broker.first_payload(), expect, strlen(expect))) {
+                bench::fail("mqtt payload: %s", broker.first_payload());
+            }
+        }
+        if (window == 4 && r.readings_per_s < 2 * single) {
+            bench::fail("a wider mqtt window does not raise throughput");
+        }
+    }
+
+    // --- redelivery ----------------------------------------------------------------
+    {
+        Broker broker(ack_delay_us, 50);
+        MqttConfig config;
+        config.retry_us = 10'000;
+        const Run r = stream(broker, config, 2'000);
+        bench::report("broker drops the connection at the 50th PUBLISH: %u connects, %u resent "
+                      "with DUP, %u of %u readings delivered",
+                      broker.connects(), broker.dups(), broker.unique(), 2'000u);
+        if (r.timed_out || broker.unique() != 2'000 || !broker.dups() ||
+            broker.connects() != 2 || r.stats.resent != broker.dups()) {
+            bench::fail("mqtt does not redeliver after a reconnect");
+        }
+    }
+}
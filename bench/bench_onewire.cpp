@@ -0,0 +1,137 @@
+// DS18B20 probes on the simulated 1-Wire bus: enumeration, the parallel
+// convert + single-transfer read pipeline, and CRC rejection. Wire time comes
+// from the simulator's slot accounting; CPU time is what the host spends in
+// the driver, the part that remains on the device once DMA moves the bits.
+#include <cstring>
+#include <initializer_list>
+
+#include "bench.h"
+#include "crc.h"
+#include "ds18b20.h"
+#include "onewire.h"
+
+using namespace thermo;
+
+namespace {
+
+void make_rom(OneWireRom &rom, uint8_t family, uint32_t serial) {
+    rom[0] = family;
+    for (int i = 0; i < 6; i++) rom[1 + i] = uint8_t(serial >> (i * 5));
+    rom[7] = crc8_maxim(rom, 7);
+}
+
+float probe_celsius(size_t i) {
+    return 18.0f + 0.5f * float(i) + 0.0625f;
+}
+
+bool same_rom(const OneWireRom &a, const OneWireRom &b) {
+    return memcmp(a, b, sizeof(OneWireRom)) == 0;
+}
+
+// Search order follows the ROM codes, not the order devices were attached.
+size_t probe_for(const Ds18b20Array &probes, const OneWireRom &rom) {
+    for (size_t i = 0; i < probes.count(); i++) {
+        if (same_rom(probes.rom(i), rom)) return i;
+    }
+    return probes.count();
+}
+
+} // namespace
+
+BENCH_SUITE(onewire) {
+    for (size_t n : {1, 2, 4, 8}) {
+        OneWireBus bus;
+        bus.init(0);
+        OneWireRom roms[Ds18b20Array::max_probes];
+        for (size_t i = 0; i < n; i++) {
+            make_rom(roms[i], 0x28, 0x9e3779b9u * uint32_t(i + 1));
+            bus.host_add_ds18b20(roms[i], probe_celsius(i));
+        }
+        // A device of another family on the same bus is found but skipped.
+        OneWireRom other;
+        make_rom(other, 0x10, 0x12345);
+        bus.host_add_ds18b20(other, 99.0f);
+
+        Ds18b20Array probes(bus);
+        uint64_t wire0 = bus.host_bus_time_us();
+        uint64_t t0 = bench::now_ns();
+        size_t found = probes.enumerate();
+        uint64_t enum_ns = bench::now_ns() - t0;
+        uint64_t enum_wire = bus.host_bus_time_us() - wire0;
+        size_t matched = 0;
+        for (size_t j = 0; j < n; j++) matched += probe_for(probes, roms[j]) < found;
+        if (found != n || matched != n) {
+            bench::fail("%zu probes: enumerated %zu, %zu matching ROMs", n, found, matched);
+            continue;
+        }
+
+        // One cycle as the scheduler drives it: convert, a second later read,
+        // a second later collect.
+        wire0 = bus.host_bus_time_us();
+        probes.step();
+        uint64_t convert_wire = bus.host_bus_time_us() - wire0;
+        bus.host_advance_us(1'000'000);
+        wire0 = bus.host_bus_time_us();
+        probes.step();
+        uint64_t read_wire = bus.host_bus_time_us() - wire0;
+        bus.host_advance_us(1'000'000);
+        bool fresh = probes.step();
+        size_t correct = 0;
+        for (size_t j = 0; j < n; j++) {
+            size_t i = probe_for(probes, roms[j]);
+            correct += probes.valid(i) && probes.raw(i) == int16_t(probe_celsius(j) * 16);
+        }
+        if (!fresh || correct != n) bench::fail("%zu probes: %zu correct readings", n, correct);
+
+        // CPU cost of collecting a finished read: CRC + conversion per probe.
+        constexpr int reps = 2000;
+        uint64_t parse_ns = 0;
+        for (int r = 0; r < reps; r++) {
+            probes.start_read();
+            t0 = bench::now_ns();
+            probes.finish_read();
+            parse_ns += bench::now_ns() - t0;
+        }
+
+        bench::report("%zu probe(s): enumerate %.1f ms wire (%.0f us CPU on host); convert %llu "
+                      "us + read %.1f ms wire per cycle; collect %.0f ns CPU",
+                      n, enum_wire / 1e3, enum_ns / 1e3, (unsigned long long)convert_wire,
+                      read_wire / 1e3, double(parse_ns) / reps);
+        // Bit-banged and one probe at a time, the CPU would time every slot
+        // and wait out a conversion per probe.
+        bench::report("  vs sequential bit-bang: %.0f ms per cycle, %.1f ms of it with the CPU "
+                      "timing slots; here one %.0f ms conversion window, CPU free",
+                      n * (Ds18b20Array::conversion_us / 1e3) + (convert_wire * n + read_wire) / 1e3,
+                      (convert_wire * n + read_wire) / 1e3, Ds18b20Array::conversion_us / 1e3);
+    }
+
+    // --- a corrupted scratchpad is rejected, then recovers --------------------
+    OneWireBus bus;
+    OneWireRom roms[3];
+    for (size_t i = 0; i < 3; i++) {
+        make_rom(roms[i], 0x28, 1000 + uint32_t(i));
+        bus.host_add_ds18b20(roms[i], 21.0f);
+    }
+    Ds18b20Array probes(bus);
+    probes.enumerate();
+    const size_t p1 = probe_for(probes, roms[1]);
+    auto cycle = [&] {
+        probes.step();
+        bus.host_advance_us(1'000'000);
+        probes.step();
+        bus.host_advance_us(1'000'000);
+        probes.step();
+    };
+    cycle();
+    bus.host_set_celsius(1, 25.5f);
+    bus.host_corrupt_next_read(1);
+    cycle();
+    bool rejected = probes.count() == 3 && !probes.valid(p1) &&
+                    probes.valid((p1 + 1) % 3) && probes.valid((p1 + 2) % 3) &&
+                    probes.crc_errors() == 1 && probes.raw(p1) == 21 * 16;
+    cycle();
+    bool recovered = probes.valid(p1) && probes.raw(p1) == int16_t(25.5f * 16);
+    bench::report("corrupted scratchpad: rejected=%d (crc errors %u), recovered next cycle=%d",
+                  rejected, probes.crc_errors(), recovered);
+    if (!rejected || !recovered) bench::fail("CRC rejection/recovery failed");
+}
@@ -0,0 +1,271 @@
+// Power manager (power.h) on the host model: the firmware's task schedule
+// over simulated days, once for each deepest state allowed, scored by the
+// average current the model integrates. Checks that deeper policies never
+// cost more, that no wake comes back past its release, and that the control
+// task starts no later than when idling; that a board exiting slower than
+// the spec is learned after a few late wakes; and that no state below idle
+// is entered while a sensor bus transfer runs.
+#include <iterator>
+
+#include "bench.h"
+#include "power.h"
+#include "sensor_bus.h"
+
+using namespace thermo;
+
+namespace {
+
+struct Load {
+    VirtualClock *clock;
+    uint32_t cost_us;
+};
+
+void busy(void *ctx) {
+    Load &load = *static_cast<Load *>(ctx);
+    load.clock->advance(load.cost_us);
+}
+
+struct TaskSpec {
+    const char *name;
+    uint32_t period_us;
+    uint32_t phase_us;
+    uint32_t cost_us;
+};
+
+// Periods and phases as app_init() registers them; costs as measured by the
+// other suites, rounded up.
+constexpr TaskSpec mains_tasks[] = {
+    {"control", 1'000'000, 0, 120},     {"history", 60'000'000, 1'000'000, 4'000},
+    {"flash", 10'000'000, 2'000'000, 1'000}, {"probes", 1'000'000, 250'000, 200},
+    {"display", 1'000'000, 100'000, 600}, {"telemetry", 500'000, 300'000, 300},
+    {"mqtt", 50'000, 40'000, 40},       {"http", 20'000, 15'000, 30},
+};
+constexpr TaskSpec battery_tasks[] = {
+    {"control", 1'000'000, 0, 120},     {"history", 60'000'000, 1'000'000, 4'000},
+    {"flash", 10'000'000, 2'000'000, 1'000}, {"probes", 1'000'000, 250'000, 200},
+    {"display", 1'000'000, 100'000, 600},
+};
+// The same with the control tick, probes and display stretched to 10 s.
+constexpr TaskSpec slow_tick_tasks[] = {
+    {"control", 10'000'000, 0, 120},    {"history", 60'000'000, 1'000'000, 4'000},
+    {"flash", 10'000'000, 2'000'000, 1'000}, {"probes", 10'000'000, 250'000, 200},
+    {"display", 10'000'000, 100'000, 600},
+};
+
+struct Scenario {
+    const char *name;
+    const TaskSpec *tasks;
+    size_t count;
+    uint32_t days;
+    PowerState firmware;  // deepest state app_init() allows with this setup
+};
+
+struct Score {
+    double ma = 0;
+    uint64_t horizon_us = 0;
+    uint64_t run_us = 0;
+    uint64_t time_us[power_state_count] = {};
+    PowerStateStats stats[power_state_count];
+    uint32_t exit_estimate_us[power_state_count] = {};
+    uint32_t control_latency_us = 0;
+    uint32_t overruns = 0;
+};
+
+Score simulate(const Scenario &sc, PowerState deepest, uint32_t exit_percent = 100) {
+    VirtualClock clock;
+    PowerModel model(clock, true, exit_percent);
+    PowerManager power(clock, model);
+    power.set_deepest(deepest);
+    Scheduler scheduler(power);
+    Load loads[Scheduler::max_tasks];
+    int ids[Scheduler::max_tasks];
+    for (size_t i = 0; i < sc.count; i++) {
+        const TaskSpec &t = sc.tasks[i];
+        loads[i] = Load{&clock, t.cost_us};
+        ids[i] = scheduler.add_periodic(t.name, t.period_us, busy, &loads[i], t.phase_us);
+    }
+    const uint64_t horizon_us = uint64_t(sc.days) * 24 * 3600 * 1'000'000;
+    while (clock.now_us() < horizon_us) scheduler.run_once();
+    model.settle();
+
+    Score s;
+    s.ma = model.average_ma();
+    s.horizon_us = clock.now_us();
+    s.run_us = model.run_us();
+    for (size_t i = 0; i < power_state_count; i++) {
+        s.time_us[i] = model.time_us(PowerState(i));
+        s.stats[i] = power.stats(PowerState(i));
+        s.exit_estimate_us[i] = power.exit_estimate_us(PowerState(i));
+    }
+    s.control_latency_us = scheduler.stats(ids[0])->worst_latency_us;
+    for (size_t i = 0; i < sc.count; i++) s.overruns += scheduler.stats(ids[i])->overruns;
+    return s;
+}
+
+// An I2C sensor read once a second, long enough at 100 kHz (a few ms) that
+// the wait after it would otherwise start in the middle of the transfer.
+struct Sensor {
+    MockBusPort port;
+    BusQueue queue;
+    BusTransaction t;
+    uint8_t reg = 0;
+    uint8_t rx[32];
+    uint32_t reads = 0;
+
+    explicit Sensor(VirtualClock &clock) : port(clock, 100'000, true), queue(port, clock) {
+        port.add_device(0x48);
+        t.address = 0x48;
+        t.tx = &reg;
+        t.tx_len = 1;
+        t.rx = rx;
+        t.rx_len = sizeof(rx);
+    }
+};
+
+void sensor_task(void *ctx) {
+    Sensor &s = *static_cast<Sensor *>(ctx);
+    s.port.poll();
+    s.queue.dispatch();
+    s.reads += s.queue.submit(s.t);
+}
+
+// The check the firmware registers for a bus queue; polling the mock stands
+// in for its completion interrupt.
+bool sensor_busy(void *ctx) {
+    Sensor &s = *static_cast<Sensor *>(ctx);
+    s.port.poll();
+    return BusQueue::busy(&s.queue);
+}
+
+// The model, counting entries below idle made mid-transfer.
+class WatchedPort final : public PowerPort {
+public:
+    WatchedPort(PowerModel &model, VirtualClock &clock, const MockBusPort &bus)
+        : model_(model), clock_(clock), bus_(bus) {}
+    PowerState deepest() const override { return model_.deepest(); }
+    uint64_t wake_time(PowerState state, uint64_t t) const override {
+        return model_.wake_time(state, t);
+    }
+    void enter(PowerState state, uint64_t wake_at) override {
+        if (state != PowerState::idle && bus_.busy_until() > clock_.now_us()) mid_transfer++;
+        model_.enter(state, wake_at);
+    }
+
+    uint32_t mid_transfer = 0;
+
+private:
+    PowerModel &model_;
+    VirtualClock &clock_;
+    const MockBusPort &bus_;
+};
+
+struct BusScore {
+    uint32_t reads;
+    uint32_t completed;
+    uint32_t mid_transfer;
+    uint32_t busy_waits;
+    double ma;
+};
+
+BusScore simulate_bus(bool check) {
+    VirtualClock clock;
+    PowerModel model(clock);
+    Sensor sensor(clock);
+    WatchedPort watched(model, clock, sensor.port);
+    PowerManager power(clock, watched);
+    if (check) power.add_busy_check(sensor_busy, &sensor);
+    Scheduler scheduler(power);
+    Load control{&clock, 120};
+    scheduler.add_periodic("control", 1'000'000, busy, &control);
+    scheduler.add_periodic("sensor", 1'000'000, sensor_task, &sensor, 250'000);
+    const uint64_t horizon_us = uint64_t(3600) * 1'000'000;
+    while (clock.now_us() < horizon_us) scheduler.run_once();
+    model.settle();
+    return BusScore{sensor.reads, sensor.queue.stats().completed, watched.mid_transfer,
+                    power.busy_waits(), model.average_ma()};
+}
+
+} // namespace
+
+BENCH_SUITE(power) {
+    for (size_t i = 1; i < power_state_count; i++) {
+        const PowerState s = PowerState(i);
+        bench::report("%-8s enter %4u us, exit %5u us, %4.1f mA: pays off from %5u us",
+                      power_states[i].name, power_states[i].enter_us, power_states[i].exit_us,
+                      double(power_states[i].ma), power_target_residency_us(s));
+    }
+
+    const Scenario scenarios[] = {
+        {"mains: USB telemetry, MQTT, HTTP", mains_tasks, std::size(mains_tasks), 1,
+         PowerState::slow},
+        {"battery: 1 s tick", battery_tasks, std::size(battery_tasks), 3, PowerState::dormant},
+        {"battery: 10 s tick", slow_tick_tasks, std::size(slow_tick_tasks), 3,
+         PowerState::dormant},
+    };
+    for (const Scenario &sc : scenarios) {
+        bench::report("%s, %u simulated days (* the firmware's choice):", sc.name, sc.days);
+        Score prev;
+        for (size_t d = 0; d < power_state_count; d++) {
+            const uint64_t t0 = bench::now_ns();
+            const Score s = simulate(sc, PowerState(d));
+            const double wall = double(bench::now_ns() - t0) * 1e-9;
+            const double h = double(s.horizon_us);
+            bench::report("%c deepest %-8s %6.2f mA avg (%6.1f mAh/day)  run %5.2f%%  "
+                          "idle %5.1f%%  slow %5.1f%%  sleep %5.1f%%  dormant %5.1f%%  "
+                          "[%.2f s wall]",
+                          PowerState(d) == sc.firmware ? '*' : ' ', power_states[d].name, s.ma,
+                          s.ma * 24, 100.0 * s.run_us / h, 100.0 * s.time_us[0] / h,
+                          100.0 * s.time_us[1] / h, 100.0 * s.time_us[2] / h,
+                          100.0 * s.time_us[3] / h, wall);
+            uint32_t late = 0;
+            for (size_t i = 1; i <= d; i++) {
+                const PowerStateStats &st = s.stats[i];
+                late += st.late;
+                if (!st.entries) continue;
+                bench::report("    %-8s %9u entries, worst wake %5u us, %u late",
+                              power_states[i].name, st.entries, st.worst_wake_us, st.late);
+            }
+            if (late) bench::fail("power %s: %u wakes past the release", sc.name, late);
+            if (s.overruns) bench::fail("power %s: %u overruns", sc.name, s.overruns);
+            if (d > 0) {
+                if (s.ma > prev.ma) {
+                    bench::fail("power %s: %s costs %.3f mA, more than %s", sc.name,
+                                power_states[d].name, s.ma, power_states[d - 1].name);
+                }
+                // Deep states wake early, so control starts no later than
+                // with plain idle waits (whose wake is the alarm itself).
+                if (s.control_latency_us > prev.control_latency_us + power_states[0].exit_us) {
+                    bench::fail("power %s: control latency %u us, %u us when idling", sc.name,
+                                s.control_latency_us, prev.control_latency_us);
+                }
+            }
+            prev = s;
+        }
+    }
+
+    // A board whose exits take half as long again as the spec: the first
+    // wakes are late, then the policy wakes that much earlier.
+    const Score slow = simulate(scenarios[1], PowerState::sleep, 150);
+    const PowerStateStats &st = slow.stats[size_t(PowerState::sleep)];
+    const uint32_t learned = slow.exit_estimate_us[size_t(PowerState::sleep)];
+    bench::report("exits at 150%% of spec: %u of %u sleep wakes late, exit estimate %u -> %u us",
+                  st.late, st.entries, power_states[size_t(PowerState::sleep)].exit_us, learned);
+    if (st.late > 16 || learned <= power_states[size_t(PowerState::sleep)].exit_us) {
+        bench::fail("power: exit latency not learned (%u late, estimate %u us)", st.late, learned);
+    }
+
+    // Slow, sleep and dormant run clk_sys from the crystal, which would
+    // stretch a transfer's timing; the busy check keeps those waits at idle.
+    const BusScore open = simulate_bus(false), vetoed = simulate_bus(true);
+    bench::report("1 s sensor reads at 100 kHz, an hour: unchecked %u of %u waits below idle "
+                  "mid-transfer (%.3f mA); checked %u (%u idle polls, %.3f mA)",
+                  open.mid_transfer, open.reads, open.ma, vetoed.mid_transfer, vetoed.busy_waits,
+                  vetoed.ma);
+    if (vetoed.mid_transfer || !vetoed.busy_waits) {
+        bench::fail("power: %u waits below idle during a bus transfer", vetoed.mid_transfer);
+    }
+    if (!open.mid_transfer) bench::fail("power: the unchecked run never slept mid-transfer");
+    if (vetoed.completed + 1 < vetoed.reads) {
+        bench::fail("power: %u of %u sensor reads completed", vetoed.completed, vetoed.reads);
+    }
+}
@@ -0,0 +1,106 @@
+// Sampling profiler on the host (setitimer/SIGPROF): a workload that spends
+// three quarters of its CPU time in one function and a quarter in another
+// must come out of the histogram in that ratio. Also the cost of recording
+// a sample, which is what the device's timer interrupt adds per sample.
+#include <sys/resource.h>
+
+#include <cmath>
+
+#include "bench.h"
+#include "profiler.h"
+
+using namespace thermo;
+
+namespace {
+
+uint64_t cpu_us() {
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return uint64_t(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1'000'000 +
+           uint64_t(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+}
+
+// Not constant, so the compiler cannot specialise the functions below into
+// clones at other addresses.
+volatile uint32_t unit = 100'000;
+
+// Two loops of the same kind, so a unit of work costs the same in each.
+__attribute__((noinline)) uint32_t work_a(uint32_t x, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) x = x * 1664525u + 1013904223u + (x >> 7);
+    return x;
+}
+
+__attribute__((noinline)) uint32_t work_b(uint32_t x, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) x = x * 22695477u + 1u + (x >> 9);
+    return x;
+}
+
+// Which of the two functions a bucket belongs to: the nearest entry point
+// below it, if the bucket is within the function's few dozen bytes.
+int owner(uintptr_t bucket) {
+    const uintptr_t a = reinterpret_cast<uintptr_t>(&work_a);
+    const uintptr_t b = reinterpret_cast<uintptr_t>(&work_b);
+    const uintptr_t span = 128;
+    const uintptr_t slack = uintptr_t(1) << ProfileHistogram::bucket_shift;
+    if (bucket + slack > a && bucket < a + span && (b < a || bucket < b)) return 0;
+    if (bucket + slack > b && bucket < b + span && (a < b || bucket < a)) return 1;
+    return -1;
+}
+
+} // namespace
+
+BENCH_SUITE(profiler) {
+    // --- cost of one sample ------------------------------------------------------
+    {
+        static ProfileHistogram h;
+        constexpr uint32_t n = 4'000'000;
+        uint32_t rng = 1;
+        const uint64_t t0 = bench::now_ns();
+        for (uint32_t i = 0; i < n; i++) {
+            // 300 distinct 16-byte buckets of "code".
+            rng = rng * 1664525u + 1013904223u;
+            h.add(0x10000000u + (rng >> 16) % 300 * 16 + (rng >> 8 & 15));
+        }
+        const double ns = double(bench::now_ns() - t0) / n;
+        size_t used = 0;
+        for (size_t i = 0; i < ProfileHistogram::buckets; i++) used += h.slot(i).key != 0;
+        bench::report("histogram add: %.1f ns per sample; %zu of %zu buckets used, %.2f%% of "
+                      "samples unbucketed",
+                      ns, used, ProfileHistogram::buckets, 100.0 * h.unbucketed() / h.samples());
+    }
+
+    // --- a known split --------------------------------------------------------------
+    profile.clear();
+    constexpr uint32_t rate_hz = 1000;
+    if (!profiler_start(rate_hz)) {
+        bench::fail("profiler_start failed");
+        return;
+    }
+    const uint64_t cpu0 = cpu_us();
+    uint32_t x = 1;
+    while (cpu_us() - cpu0 < 1'500'000) {
+        x = work_a(x, 3 * unit);
+        x = work_b(x, unit);
+    }
+    profiler_stop();
+    const double cpu_s = (cpu_us() - cpu0) / 1e6;
+    bench::keep(x);
+
+    uint32_t in[2] = {};
+    for (size_t i = 0; i < ProfileHistogram::buckets; i++) {
+        const ProfileHistogram::Bucket &b = profile.slot(i);
+        const int f = b.key ? owner(ProfileHistogram::address(b)) : -1;
+        if (f >= 0) in[f] += b.count;
+    }
+    const uint32_t samples = profile.samples();
+    const double share_a = in[0] + in[1] ? double(in[0]) / (in[0] + in[1]) : 0;
+    bench::report("SIGPROF at %u Hz: %u samples in %.2f s CPU (%.0f/s); work_a %u, work_b %u, "
+                  "elsewhere %u",
+                  rate_hz, samples, cpu_s, samples / cpu_s, in[0], in[1],
+                  samples - in[0] - in[1]);
+    bench::report("  work_a share %.1f%% (expected 75%%)", 100 * share_a);
+    if (samples < 50 || std::fabs(share_a - 0.75) > 0.1 || in[0] + in[1] < samples * 0.8) {
+        bench::fail("profile does not match the workload");
+    }
+    profile.clear();
+}
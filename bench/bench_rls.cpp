@@ -0,0 +1,174 @@
+// Online model identification (rls.h): how fast the estimate converges on a
+// room whose true model is known, how fast it follows a change, what one
+// update costs, and a year in a simulated house with the Q16 estimator
+// checked against float for drift and the covariance for windup.
+#include <algorithm>
+#include <cmath>
+
+#include "bench.h"
+#include "house_model.h"
+#include "rls.h"
+#include "simulator.h"
+#include "thermostat.h"
+
+using namespace thermo;
+
+namespace {
+
+constexpr uint32_t period_ticks = 300;
+constexpr float forget = 0.995f;
+
+// A first-order room: full heat settles gain_c above base_c.
+struct Plant {
+    double gain_c;
+    double tau_s;
+    double base_c;
+};
+
+struct Settle {
+    double first_h = 0;   // from a cold start to within 5% for good
+    double change_h = 0;  // the same after the plant changes
+    double gain_err = 0;  // at the end, relative
+    double tau_err = 0;
+    uint32_t restarts = 0;
+};
+
+bool near(double estimate, double truth) {
+    return std::fabs(estimate - truth) <= 0.05 * truth;
+}
+
+// Hysteresis control with a night setback, so there is always some
+// excitation; the plant switches from p0 to p1 at change_h.
+template <typename T>
+Settle settle(const Plant &p0, const Plant &p1, uint32_t change_h, uint32_t hours) {
+    RlsEstimator<T> rls;
+    rls.configure(period_ticks, 1.0f, forget, 0);
+    const uint32_t change_s = change_h * 3600;
+    double y = p0.base_c;
+    bool heat = false;
+    uint32_t rng = 1;
+    uint32_t bad_before = 0, bad_after = change_s;
+    Settle out;
+    for (uint32_t s = 0; s < hours * 3600; s++) {
+        const Plant &p = s < change_s ? p0 : p1;
+        const double setpoint = (s / 3600) % 24 < 7 ? 17.0 : 20.0;
+        if (y < setpoint - 0.3) heat = true;
+        if (y > setpoint + 0.3) heat = false;
+        y += (p.base_c + (heat ? p.gain_c : 0.0) - y) / p.tau_s;
+        rng = rng * 1664525u + 1013904223u;
+        const double noise = 0.02 * (double(rng >> 8) / double(1u << 24) - 0.5);
+        if (!rls.sample(Numeric<T>::from_float(float(y + noise)), heat)) continue;
+        const RoomEstimate e = rls.estimate();
+        if (!(e.valid && near(e.gain_c, p.gain_c) && near(e.tau_s, p.tau_s))) {
+            (s < change_s ? bad_before : bad_after) = s;
+        }
+        out.gain_err = std::fabs(e.gain_c - p.gain_c) / p.gain_c;
+        out.tau_err = std::fabs(e.tau_s - p.tau_s) / p.tau_s;
+    }
+    out.first_h = bad_before / 3600.0;
+    out.change_h = (bad_after - change_s) / 3600.0;
+    out.restarts = rls.restarts();
+    return out;
+}
+
+template <typename T>
+void update_cost() {
+    // A one-tick block makes every sample an update.
+    static RlsEstimator<T> rls;
+    rls.configure(1, 1.0f, forget, 0);
+    constexpr uint32_t n = 1'000'000;
+    uint32_t rng = 1;
+    const uint64_t t0 = bench::now_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        rng = rng * 1664525u + 1013904223u;
+        const T temp = Numeric<T>::from_float(19.0f + float(rng >> 8) / float(1u << 24));
+        rls.sample(temp, rng >> 31);
+    }
+    const double ns = double(bench::now_ns() - t0) / n;
+    bench::keep(rls.theta()[0]);
+    bench::report("%-7s update %6.1f ns", Numeric<T>::name, ns);
+}
+
+} // namespace
+
+BENCH_SUITE(rls) {
+    // --- convergence on a known room ----------------------------------------------
+    const Plant before = {9.0, 4 * 3600.0, 14.0};
+    const Plant after = {12.0, 5 * 3600.0, 9.0};  // colder, and the gain and lag up
+    for (int backend = 0; backend < 2; backend++) {
+        const Settle s = backend ? settle<Q16>(before, after, 96, 192)
+                                 : settle<float>(before, after, 96, 192);
+        bench::report("%-7s within 5%% after %4.1f h from cold, %4.1f h after a change; "
+                      "final error gain %.1f%%, tau %.1f%%",
+                      backend ? Numeric<Q16>::name : Numeric<float>::name, s.first_h,
+                      s.change_h, s.gain_err * 100, s.tau_err * 100);
+        if (s.first_h > 24 || s.change_h > 72 || s.gain_err > 0.03 || s.tau_err > 0.03 ||
+            s.restarts) {
+            bench::fail("rls does not converge on a first-order room");
+        }
+    }
+
+    // --- one update ----------------------------------------------------------------
+    update_cost<float>();
+    update_cost<Q16>();
+    // g = P phi (9), the error (3), the gain vector (3), theta (3), the
+    // covariance (6 + 6) and recentring (7), plus one division.
+    constexpr uint32_t muls = 9 + 3 + 3 + 3 + 12 + 7;
+    bench::report("M0+ estimate: %u Q16 multiplies and a division, ~%.0f us per %u-tick "
+                  "block",
+                  muls, (muls * 40.0 * 2 + 200) / 125.0, period_ticks);
+
+    // --- a year in a simulated house -----------------------------------------------
+    // MPC with online identification and no autotune: PID until the estimate
+    // is valid, then MPC on it. A float estimator sees the same samples.
+    ThermostatConfig config;
+    config.mode = ControlMode::mpc;
+    config.model_adapt = true;
+    BasicThermostat<Q16> t(config);
+    RlsEstimator<float> reference;
+    reference.configure(config.rls_period_ticks, config.tick_s, config.rls_forget,
+                        config.model_dead_s);
+    const sim::HouseParams &hp = sim::reference_houses[1];
+    const sim::Schedule sched;
+    sim::House house(hp, sched.night_c);
+    sim::Outdoor outdoor(sim::reference_climates[1], 0, 1);
+    uint32_t blocks = 0, valid = 0;
+    float gain_lo = 1e9f, gain_hi = 0, tau_lo = 1e9f, tau_hi = 0, trace_hi = 0;
+    float drift = 0;
+    for (uint32_t minute = 0; minute < 365 * 24 * 60; minute++) {
+        house.set_outside(outdoor.next_minute());
+        const uint32_t of_day = minute % (24 * 60);
+        const bool awake = of_day >= sched.wake_h * 60u && of_day < sched.sleep_h * 60u;
+        t.set_setpoint(awake ? sched.day_c : sched.night_c);
+        for (uint32_t sec = 0; sec < 60; sec++) {
+            const float temp = float(house.sensor());
+            const bool heat = t.step(Q16(temp));
+            house.step(heat);
+            if (!reference.sample(temp, heat)) continue;
+            blocks++;
+            const RoomEstimate q = t.estimator().estimate();
+            const RoomEstimate f = reference.estimate();
+            trace_hi = std::max(trace_hi, t.estimator().trace().to_float());
+            if (!q.valid) continue;
+            valid++;
+            gain_lo = std::min(gain_lo, q.gain_c);
+            gain_hi = std::max(gain_hi, q.gain_c);
+            tau_lo = std::min(tau_lo, q.tau_s);
+            tau_hi = std::max(tau_hi, q.tau_s);
+            if (f.valid) drift = std::max(drift, std::fabs(q.gain_c - f.gain_c) / f.gain_c);
+        }
+    }
+    const RlsEstimator<Q16> &est = t.estimator();
+    bench::report("a year in the %s, %s: %u updates, valid %.0f%% of the time; "
+                  "gain %.1f..%.1f C, tau %.0f..%.0f min",
+                  hp.name, sim::reference_climates[1].name, est.updates(),
+                  100.0 * valid / std::max(blocks, 1u), gain_lo, gain_hi, tau_lo / 60,
+                  tau_hi / 60);
+    bench::report("  q16 gain within %.1f%% of float; covariance trace at most %.1f (cap %d); "
+                  "%u restarts",
+                  double(drift) * 100, trace_hi, int(RlsEstimator<Q16>::trace_cap), est.restarts());
+    const float trace_limit = RlsEstimator<Q16>::trace_cap / forget;
+    if (est.restarts() || !(trace_hi <= trace_limit) || drift > 0.1 || valid < blocks / 2) {
+        bench::fail("rls is not numerically stable over a year");
+    }
+}
@@ -0,0 +1,199 @@
+// Rollup index: a year of minute samples, then window queries of every size
+// answered from the rollup rings, from chunk headers (HistoryRangeQuery) and
+// by scanning raw samples. Every rollup answer is checked against a scan of
+// the span it reports covering, and a rebuild from the flash history is
+// checked against the incrementally built index.
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+#include "bench.h"
+#include "flash_log.h"
+#include "history.h"
+#include "rollup.h"
+
+using namespace thermo;
+
+namespace {
+
+constexpr const char *flash_path = "/tmp/thermostat_bench_rollup.bin";
+
+struct Sample {
+    uint32_t t;
+    int16_t centi;
+};
+
+std::vector<Sample> make_year() {
+    std::vector<Sample> out;
+    uint32_t rng = 777;
+    float drift = 0;
+    uint32_t t = 1'700'000'000;
+    for (uint32_t m = 0; m < 365 * 24 * 60; m++) {
+        t += 60;
+        if (m % 20000 == 19999) t += 3 * 3600;  // an outage now and then
+        rng = rng * 1664525u + 1013904223u;
+        drift += (int((rng >> 8) % 201) - 100) * 0.0002f;
+        drift = std::min(2.0f, std::max(-2.0f, drift));
+        float c = 20.0f + 1.5f * std::sin(float(m % 1440) * 6.2831853f / 1440) + drift;
+        out.push_back({t + (rng >> 28 == 0 ? 1 : 0), int16_t(std::lround(c * 100))});
+    }
+    return out;
+}
+
+HistorySummary scan(const std::vector<Sample> &v, uint32_t t0, uint32_t t1) {
+    auto it = std::lower_bound(v.begin(), v.end(), t0,
+                               [](const Sample &s, uint32_t t) { return s.t < t; });
+    HistorySummary s;
+    for (; it != v.end() && it->t <= t1; ++it) s.add(it->t, it->centi);
+    return s;
+}
+
+bool same_values(const HistorySummary &a, const HistorySummary &b) {
+    return a.count == b.count && (!a.count || (a.min == b.min && a.max == b.max && a.sum == b.sum));
+}
+
+// Resolution the index promises for a window edge: the left edge needs its
+// own time in a ring, the right edge the start of its enclosing bucket.
+bool retained(uint32_t end, uint32_t t, uint32_t width, uint32_t slots) {
+    return t / width + slots > end / width;
+}
+
+uint32_t left_resolution(uint32_t end, uint32_t a) {
+    if (retained(end, a, 60, RollupIndex::minute_slots)) return 60;
+    if (retained(end, a, 3600, RollupIndex::hour_slots)) return 3600;
+    return 86400;
+}
+
+uint32_t right_resolution(uint32_t end, uint32_t b) {
+    if (retained(end, uint32_t((uint64_t(b) + 1) / 3600 * 3600), 60, RollupIndex::minute_slots)) {
+        return 60;
+    }
+    if (retained(end, uint32_t((uint64_t(b) + 1) / 86400 * 86400), 3600, RollupIndex::hour_slots)) {
+        return 3600;
+    }
+    return 86400;
+}
+
+} // namespace
+
+BENCH_SUITE(rollup) {
+    const std::vector<Sample> samples = make_year();
+    static RollupIndex index;  // 26 KiB: keep it off the stack
+    index.clear();
+
+    uint64_t t0 = bench::now_ns();
+    for (const Sample &s : samples) index.add(s.t, s.centi);
+    uint64_t add_ns = bench::now_ns() - t0;
+    bench::report("%zu samples added in %.1f ms (%.1f ns/sample), index %zu B", samples.size(),
+                  add_ns / 1e6, double(add_ns) / samples.size(), sizeof(RollupIndex));
+
+    std::vector<std::vector<uint8_t>> chunks;
+    HistoryChunkWriter writer;
+    for (const Sample &s : samples) {
+        if (!writer.append(s.t, s.centi)) {
+            chunks.emplace_back(writer.data(), writer.data() + writer.size());
+            writer.reset();
+            writer.append(s.t, s.centi);
+        }
+    }
+    chunks.emplace_back(writer.data(), writer.data() + writer.size());
+
+    // --- latency by window size ------------------------------------------------
+    const uint32_t end = samples.back().t;
+    struct Window {
+        const char *name;
+        uint32_t seconds;
+    } windows[] = {{"1 hour", 3600},         {"24 hours", 86400},       {"7 days", 7 * 86400},
+                   {"30 days", 30 * 86400}, {"365 days", 365 * 86400}};
+    for (const Window &w : windows) {
+        const uint32_t from = end - w.seconds + 1;
+        constexpr int reps = 200;
+        uint32_t buckets = 0;
+        HistorySummary r;
+        t0 = bench::now_ns();
+        for (int i = 0; i < reps; i++) {
+            r = index.query(from, end, &buckets);
+            bench::keep(r.sum);
+        }
+        double rollup_ns = double(bench::now_ns() - t0) / reps;
+
+        t0 = bench::now_ns();
+        HistoryRangeQuery q(from, end);
+        for (const auto &c : chunks) q.add_chunk(c.data(), c.size());
+        double chunk_ns = double(bench::now_ns() - t0);
+        bench::keep(q.result().sum);
+
+        t0 = bench::now_ns();
+        HistorySummary raw;
+        for (const Sample &s : samples) {
+            if (s.t >= from && s.t <= end) raw.add(s.t, s.centi);
+        }
+        double scan_ns = double(bench::now_ns() - t0);
+        bench::keep(raw.sum);
+
+        bench::report("  %-9s rollup %7.0f ns (%3u buckets) | chunk headers %8.0f ns | raw scan "
+                      "%9.0f ns | %6u samples, mean %.2f",
+                      w.name, rollup_ns, buckets, chunk_ns, scan_ns, r.count, r.mean() / 100);
+        if (!same_values(r, scan(samples, r.t_first, r.t_last))) {
+            bench::fail("%s: rollup disagrees with a scan of its span", w.name);
+        }
+    }
+
+    // --- random windows: exact over the reported span, widened no further
+    //     than the resolution promised at the window's age -------------------
+    uint32_t rng = 99, checked = 0, bad = 0;
+    for (int i = 0; i < 20000; i++) {
+        rng = rng * 1664525u + 1013904223u;
+        uint32_t age = (rng >> 4) % (380 * 86400);
+        rng = rng * 1664525u + 1013904223u;
+        uint32_t len = 1 + (rng >> 4) % (age + 1);
+        uint32_t a = end - age, b = std::min(end, a + len);
+        HistorySummary r = index.query(a, b);
+        if (!r.count) continue;
+        checked++;
+        // Outages leave empty buckets, so the span only has to reach the
+        // first and last samples actually inside the window.
+        HistorySummary inside = scan(samples, a, b);
+        bool ok = same_values(r, scan(samples, r.t_first, r.t_last)) &&
+                  r.t_first + left_resolution(end, a) > a &&
+                  r.t_last < b + right_resolution(end, b) &&
+                  (!inside.count || (r.t_first <= inside.t_first && r.t_last >= inside.t_last));
+        if (!ok && bad++ < 3) {
+            bench::report("  bad window [%u, %u]: got [%u, %u] n=%u", a, b, r.t_first, r.t_last,
+                          r.count);
+        }
+    }
+    bench::report("  %u random windows checked against raw scans, %u wrong", checked, bad);
+    if (bad) bench::fail("%u random windows wrong", bad);
+
+    // --- rebuild from the flash history ----------------------------------------
+    unlink(flash_path);
+    {
+        FileFlash flash(flash_path, THERMO_FLASH_LOG_BYTES);
+        if (!flash.ok()) {
+            bench::fail("cannot map %s", flash_path);
+            return;
+        }
+        FlashLog log(flash);
+        log.mount();
+        HistoryStore store(log);
+        for (const Sample &s : samples) store.append(s.t, s.centi);
+        static RollupIndex rebuilt;
+        t0 = bench::now_ns();
+        uint32_t decoded = rebuilt.rebuild(store);
+        uint64_t rebuild_ns = bench::now_ns() - t0;
+        // The log only retains the newest ~9 months; compare within that.
+        uint32_t mismatches = 0;
+        for (uint32_t days = 1; days <= 200; days++) {
+            uint32_t from = end - days * 86400 + 1;
+            if (!same_values(rebuilt.query(from, end), index.query(from, end))) mismatches++;
+        }
+        bench::report("  rebuild from flash: %.2f ms, %u of %zu chunks decoded, %u/200 windows "
+                      "differ from the incremental index",
+                      rebuild_ns / 1e6, decoded, chunks.size(), mismatches);
+        if (mismatches || rebuilt.newest() != end) bench::fail("rebuilt index differs");
+    }
+    unlink(flash_path);
+}
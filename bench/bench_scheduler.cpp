@@ -0,0 +1,162 @@
+// Scheduler on a virtual clock: a week of firmware schedule, with task costs
+// modelled by advancing the clock, run as fast as the host allows; then how
+// a periodic task resumes after a stall, and idling with every task held.
+#include "bench.h"
+#include "scheduler.h"
+
+using namespace thermo;
+
+namespace {
+
+struct Load {
+    VirtualClock *clock;
+    uint32_t cost_us;
+};
+
+void busy(void *ctx) {
+    Load &load = *static_cast<Load *>(ctx);
+    load.clock->advance(load.cost_us);
+}
+
+struct Rearm {
+    Scheduler *scheduler;
+    Load load;
+    uint32_t fired;
+    int id;            // the pending one-shot
+    int prev;          // the one before, finished
+    uint32_t credited; // runs its stats showed
+};
+
+// One-shot that re-arms itself with a varying delay, like a retry timer.
+// Each run counts the runs credited to the previous one-shot, which has
+// finished by now and whose slot no task has taken since.
+void rearm(void *ctx) {
+    Rearm &r = *static_cast<Rearm *>(ctx);
+    busy(&r.load);
+    r.fired++;
+    if (const TaskStats *s = r.scheduler->stats(r.prev)) r.credited += s->runs;
+    r.prev = r.id;
+    r.id = r.scheduler->add_oneshot("retry", 45'000'000 + (r.fired % 7) * 1'000'000, rearm, ctx);
+}
+
+// A 10 ms task whose first run stalls for 35 ms.
+struct Stall {
+    VirtualClock *clock;
+    uint64_t at[4];
+    uint32_t runs;
+};
+
+void stall(void *ctx) {
+    Stall &s = *static_cast<Stall *>(ctx);
+    if (s.runs < 4) s.at[s.runs] = s.clock->now_us();
+    s.clock->advance(s.runs++ ? 1'000 : 35'000);
+}
+
+// After the stall the releases at 10, 20 and 30 ms are gone and the task
+// picks up at 40 ms, on time, instead of running late straight away.
+void catch_up() {
+    VirtualClock clock;
+    Scheduler scheduler(clock);
+    Stall s{&clock, {}, 0};
+    const int id = scheduler.add_periodic("stall", 10'000, stall, &s);
+    while (s.runs < 4) scheduler.run_once();
+    const TaskStats &st = *scheduler.stats(id);
+    bench::report("  stalled 35 ms in a 10 ms period: next runs at %llu, %llu ms, %u skipped, "
+                  "%u overruns",
+                  (unsigned long long)(s.at[1] / 1000), (unsigned long long)(s.at[2] / 1000),
+                  st.skipped, st.overruns);
+    if (s.at[1] != 40'000 || s.at[2] != 50'000 || st.skipped != 3 || st.overruns != 1) {
+        bench::fail("scheduler: after a stall, ran at %llu us with %u skipped, %u overruns",
+                    (unsigned long long)s.at[1], st.skipped, st.overruns);
+    }
+}
+
+// Every task held at `never`: run_once() must sleep, not spin.
+void parked() {
+    VirtualClock clock;
+    Scheduler scheduler(clock);
+    Load load{&clock, 10};
+    const int id = scheduler.add_periodic("held", 1'000, busy, &load);
+    scheduler.reschedule(id, Scheduler::never);
+    constexpr int calls = 10;
+    for (int i = 0; i < calls; i++) scheduler.run_once();
+    bench::report("  every task held: %d run_once() calls idled %.1f ms", calls,
+                  scheduler.idle_us() / 1e3);
+    if (scheduler.stats(id)->runs || clock.now_us() != uint64_t(calls) * Scheduler::max_idle_us) {
+        bench::fail("scheduler: held task ran %u times, %llu us passed in %d idle calls",
+                    scheduler.stats(id)->runs, (unsigned long long)clock.now_us(), calls);
+    }
+}
+
+} // namespace
+
+BENCH_SUITE(scheduler) {
+    VirtualClock clock;
+    Scheduler scheduler(clock);
+
+    Load control{&clock, 80};
+    Load sensor{&clock, 15};
+    Load display{&clock, 30'000};  // slow full-screen refresh over SPI
+    Load history{&clock, 4'000};
+    Rearm retry{&scheduler, {&clock, 500}, 0, Scheduler::invalid_task, Scheduler::invalid_task, 0};
+
+    int ids[] = {
+        scheduler.add_periodic("control", 1'000'000, busy, &control, 0, 50'000),
+        scheduler.add_periodic("sensor", 100'000, busy, &sensor, 10'000),
+        scheduler.add_periodic("display", 250'000, busy, &display, 20'000),
+        scheduler.add_periodic("history", 60'000'000, busy, &history, 30'000),
+    };
+    const int first_retry = scheduler.add_oneshot("retry", 5'000'000, rearm, &retry);
+    retry.id = first_retry;
+
+    constexpr uint64_t days = 7;
+    constexpr uint64_t horizon_us = days * 24 * 3600 * 1'000'000ull;
+    uint64_t wakeups = 0;
+    uint64_t t0 = bench::now_ns();
+    while (clock.now_us() < horizon_us) {
+        scheduler.run_once();
+        wakeups++;
+    }
+    uint64_t elapsed = bench::now_ns() - t0;
+
+    bench::report("%llu simulated days in %.3f s wall (%.0fx real time), %llu wake-ups, idle %.2f%%",
+                  (unsigned long long)days, elapsed / 1e9, horizon_us * 1e3 / double(elapsed),
+                  (unsigned long long)wakeups, 100.0 * scheduler.idle_us() / clock.now_us());
+    for (int id : ids) {
+        const TaskStats &s = *scheduler.stats(id);
+        bench::report("  %-8s runs=%-8u worst latency=%6u us  worst run=%6u us  overruns=%u skipped=%u",
+                      scheduler.name(id), s.runs, s.worst_latency_us, s.worst_run_us, s.overruns,
+                      s.skipped);
+    }
+    // Every run is credited to the one-shot that ran, none to the one it
+    // armed, which has not run yet.
+    retry.credited += scheduler.stats(retry.prev)->runs;
+    const uint32_t pending_runs = scheduler.stats(retry.id)->runs;
+    bench::report("  retry one-shot re-armed itself %u times, %u runs credited", retry.fired,
+                  retry.credited);
+    if (retry.credited != retry.fired || pending_runs) {
+        bench::fail("retry fired %u times, %u runs credited, %u to the pending one-shot",
+                    retry.fired, retry.credited, pending_runs);
+    }
+    // The 30 ms display refresh may delay the relay decision by at most its
+    // own run time; that must stay inside the control deadline.
+    const TaskStats &c = *scheduler.stats(ids[0]);
+    if (c.overruns || c.worst_latency_us > display.cost_us) {
+        bench::fail("control task latency %u us, %u overruns", c.worst_latency_us, c.overruns);
+    }
+    if (c.runs != days * 24 * 3600) bench::fail("control ran %u times, expected %llu", c.runs,
+                                                (unsigned long long)(days * 24 * 3600));
+
+    // The first retry's id is long out of date; cancelling it must leave the
+    // one-shot now in its slot (or any other) alone.
+    scheduler.cancel(first_retry);
+    const uint32_t fired = retry.fired;
+    const uint64_t until = clock.now_us() + 60'000'000;
+    while (clock.now_us() < until) scheduler.run_once();
+    if (scheduler.stats(first_retry) || retry.fired == fired) {
+        bench::fail("cancel of a stale id stopped the retry one-shot");
+    }
+
+    catch_up();
+    parked();
+}
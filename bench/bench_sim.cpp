@@ -0,0 +1,170 @@
+// Closed-loop house simulator (sim/simulator.h): how much simulated time one
+// core gets through, and a parameter sweep run serially and on every core,
+// which must agree exactly. Sanity checks on the model: a narrower
+// hysteresis band cycles the burner more, and doors open about as often as
+// the occupancy says. Then the controllers against each other: hysteresis,
+// autotuned PID and MPC over two winter months in every reference house.
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "simulator.h"
+
+using namespace sim;
+using thermo::ControlMode;
+
+namespace {
+
+const HouseParams &terrace = reference_houses[1];
+const Climate &continental = reference_climates[1];
+
+Scenario scenario(ControlMode mode, float band_c, uint32_t days, uint32_t seed) {
+    Scenario s;
+    s.label = "bench";
+    s.house = terrace;
+    s.climate = continental;
+    s.control.mode = mode;
+    s.control.hysteresis_c = band_c;
+    s.days = days;
+    s.seed = seed;
+    return s;
+}
+
+bool same(const Metrics &a, const Metrics &b) {
+    return a.kwh == b.kwh && a.cycles == b.cycles && a.cold_dh == b.cold_dh &&
+           a.hot_dh == b.hot_dh && a.rms_c == b.rms_c && a.doors == b.doors &&
+           a.seconds == b.seconds;
+}
+
+} // namespace
+
+BENCH_SUITE(house_sim) {
+    // --- one core ----------------------------------------------------------------
+    {
+        const Scenario s = scenario(ControlMode::pid, 0.5f, 365, 1);
+        const uint64_t t0 = bench::now_ns();
+        const Metrics m = simulate(s);
+        const double wall_s = (bench::now_ns() - t0) / 1e9;
+        bench::report("one year, PID, continental terrace: %.2f s wall, %.1f ns per simulated "
+                      "second, %.0f years per minute per core",
+                      wall_s, wall_s * 1e9 / m.seconds, 60 / wall_s);
+        bench::report("  %.0f kWh, %.1f burner starts/day, %.1f cold Ch, %.1f hot Ch, rms %.2f C, "
+                      "%u doors",
+                      m.kwh, m.cycles / 365.0, m.cold_dh, m.hot_dh, m.rms_c, m.doors);
+        if (60 / wall_s < 10) bench::fail("simulator manages under 10 years per minute");
+        const double expected_doors = s.occupancy.doors_per_day * 365;
+        if (std::fabs(m.doors - expected_doors) > 0.1 * expected_doors) {
+            bench::fail("%u door openings, expected about %.0f", m.doors, expected_doors);
+        }
+    }
+
+    // --- a sweep, serial and parallel ----------------------------------------------
+    std::vector<Scenario> grid;
+    for (float band : {0.25f, 0.5f, 1.0f}) {
+        for (uint32_t seed = 1; seed <= 4; seed++) {
+            grid.push_back(scenario(ControlMode::hysteresis, band, 60, seed));
+        }
+    }
+    for (uint32_t seed = 1; seed <= 4; seed++) {
+        grid.push_back(scenario(ControlMode::pid, 0.5f, 60, seed));
+    }
+    std::vector<Metrics> serial(grid.size()), parallel(grid.size());
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t t0 = bench::now_ns();
+    sweep(grid.data(), serial.data(), grid.size(), 1);
+    const double serial_s = (bench::now_ns() - t0) / 1e9;
+    t0 = bench::now_ns();
+    sweep(grid.data(), parallel.data(), grid.size());
+    const double parallel_s = (bench::now_ns() - t0) / 1e9;
+    const double years = grid.size() * 60 / 365.0;
+    bench::report("sweep of %zu scenarios (%.1f years): %.2f s on 1 thread, %.2f s on %u "
+                  "(%.1fx, %.0f years per minute)",
+                  grid.size(), years, serial_s, parallel_s, cores, serial_s / parallel_s,
+                  years / parallel_s * 60);
+    for (size_t i = 0; i < grid.size(); i++) {
+        if (!same(serial[i], parallel[i])) {
+            bench::fail("scenario %zu differs between the serial and parallel sweep", i);
+        }
+    }
+
+    // Burner starts per day and comfort for each band, averaged over seeds.
+    double starts[4] = {}, cold[4] = {}, kwh[4] = {};
+    for (size_t i = 0; i < grid.size(); i++) {
+        starts[i / 4] += serial[i].cycles / 60.0 / 4;
+        cold[i / 4] += serial[i].cold_dh / 4;
+        kwh[i / 4] += serial[i].kwh / 4;
+    }
+    const char *labels[] = {"hyst 0.25", "hyst 0.5", "hyst 1.0", "pid"};
+    for (int k = 0; k < 4; k++) {
+        bench::report("  %-9s %5.1f starts/day, %6.1f cold Ch, %5.0f kWh in 60 winter days",
+                      labels[k], starts[k], cold[k], kwh[k]);
+    }
+    if (!(starts[0] > starts[1] && starts[1] > starts[2])) {
+        bench::fail("narrower hysteresis bands should cycle the burner more");
+    }
+
+    // --- controllers compared ------------------------------------------------------
+    struct Contender {
+        const char *label;
+        ControlMode mode;
+        bool autotune;
+        bool adapt;  // MPC refits its model online
+    };
+    const Contender contenders[] = {
+        {"hysteresis", ControlMode::hysteresis, false, false},
+        {"pid tuned", ControlMode::pid, true, false},
+        {"mpc", ControlMode::mpc, true, false},
+        {"mpc adapt", ControlMode::mpc, true, true},
+    };
+    constexpr size_t n_houses = reference_house_count;
+    std::vector<Scenario> field;
+    for (const Contender &c : contenders) {
+        for (const HouseParams &h : reference_houses) {
+            Scenario s = scenario(c.mode, 0.5f, 60, 1);
+            s.label = c.label;
+            s.house = h;
+            s.autotune = c.autotune;
+            s.control.model_adapt = c.adapt;
+            field.push_back(s);
+        }
+    }
+    std::vector<Metrics> out(field.size());
+    sweep(field.data(), out.data(), field.size());
+    bench::report("two continental winter months, %zu houses:", n_houses);
+    Metrics total[std::size(contenders)] = {};
+    for (size_t k = 0; k < std::size(contenders); k++) {
+        for (size_t i = 0; i < n_houses; i++) {
+            const Metrics &m = out[k * n_houses + i];
+            Metrics &t = total[k];
+            t.kwh += m.kwh;
+            t.cycles += m.cycles;
+            t.cold_dh += m.cold_dh;
+            t.hot_dh += m.hot_dh;
+            t.rms_c += m.rms_c / n_houses;
+            t.worst_cold_c = std::max(t.worst_cold_c, m.worst_cold_c);
+            if (m.tune == thermo::AutotuneState::failed) {
+                bench::fail("%s: autotune failed in the %s", contenders[k].label,
+                            reference_houses[i].name);
+            }
+        }
+        const Metrics &t = total[k];
+        bench::report("  %-10s %6.0f kWh, %6.1f starts/day, %6.1f cold Ch, %5.1f hot Ch, "
+                      "rms %.2f C",
+                      contenders[k].label, t.kwh, t.cycles / 60.0 / n_houses, t.cold_dh,
+                      t.hot_dh, t.rms_c);
+    }
+    const Metrics &hyst = total[0], &pid = total[1];
+    for (size_t k = 2; k < std::size(contenders); k++) {
+        const Metrics &mpc = total[k];
+        if (!(mpc.rms_c < hyst.rms_c && mpc.cold_dh < hyst.cold_dh)) {
+            bench::fail("%s is no more comfortable than hysteresis", contenders[k].label);
+        }
+        if (mpc.kwh > hyst.kwh * 1.05 || mpc.kwh > pid.kwh) {
+            bench::fail("%s uses more than 5%% over hysteresis, or more than pid",
+                        contenders[k].label);
+        }
+    }
+}
@@ -0,0 +1,311 @@
+// Binary telemetry: encoding cost against the printf status line it
+// replaces, then end to end through a pseudo-terminal with a decoder thread
+// standing in for the host. First flat out with the producer respecting
+// backpressure, then with the reader stalled: the producer must never
+// block, and every record must be either delivered or counted as dropped,
+// with the decoder's sequence gaps matching the device's drop count.
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "bench.h"
+#include "telemetry.h"
+
+using namespace thermo;
+
+namespace {
+
+struct Status {
+    uint32_t t_ms;
+    int16_t temp;
+    int16_t setpoint;
+    uint8_t relay;
+    uint16_t drops;
+};
+
+void encode(uint8_t *r, const Status &s) {
+    for (int i = 0; i < 4; i++) r[i] = uint8_t(s.t_ms >> (8 * i));
+    r[4] = uint8_t(s.temp);
+    r[5] = uint8_t(s.temp >> 8);
+    r[6] = uint8_t(s.setpoint);
+    r[7] = uint8_t(s.setpoint >> 8);
+    r[8] = s.relay;
+    r[9] = uint8_t(s.drops);
+    r[10] = uint8_t(s.drops >> 8);
+}
+
+Status status_at(uint32_t i) {
+    return {i, int16_t(2000 + int(i % 97)), 2050, uint8_t(i & 1), 0};
+}
+
+bool send(Telemetry &tm, uint32_t i) {
+    uint8_t r[11];
+    encode(r, status_at(i));
+    return tm.record(telemetry::record_status, r, sizeof(r));
+}
+
+struct MemorySink final : TelemetrySink {
+    uint8_t buf[1 << 16];
+    size_t len = 0;
+    size_t write(const uint8_t *data, size_t n) override {
+        if (n > sizeof(buf) - len) n = sizeof(buf) - len;
+        for (size_t i = 0; i < n; i++) buf[len + i] = data[i];
+        len += n;
+        return n;
+    }
+};
+
+struct Received {
+    std::atomic<uint32_t> records{0};
+    uint32_t next_t = 0;
+    uint32_t out_of_order = 0;
+    uint32_t bad_payload = 0;
+};
+
+void on_record(void *ctx, const TelemetryDecoder::Frame &, uint8_t type, const uint8_t *p,
+               size_t len) {
+    Received &r = *static_cast<Received *>(ctx);
+    uint8_t expect[11];
+    const uint32_t t = uint32_t(p[0] | p[1] << 8 | p[2] << 16) | uint32_t(p[3]) << 24;
+    encode(expect, status_at(t));
+    if (type != telemetry::record_status || len != 11 ||
+        !std::equal(expect, expect + 11, p)) {
+        r.bad_payload++;
+    }
+    if (t < r.next_t) r.out_of_order++;
+    r.next_t = t + 1;
+    r.records.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t thread_cpu_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return uint64_t(ts.tv_sec) * 1'000'000'000 + uint64_t(ts.tv_nsec);
+}
+
+// Host side of the loopback: reads the pty like a serial port.
+struct Reader {
+    int fd;
+    Received received;
+    TelemetryDecoder decoder{on_record, &received};
+    std::atomic<bool> paused{false};
+    std::atomic<bool> done{false};
+    std::thread thread;
+
+    explicit Reader(int fd_) : fd(fd_) {
+        thread = std::thread([this] { run(); });
+    }
+    void run() {
+        uint8_t buf[4096];
+        while (!done.load()) {
+            if (paused.load()) {
+                usleep(1000);
+                continue;
+            }
+            pollfd p{fd, POLLIN, 0};
+            if (poll(&p, 1, 5) <= 0) continue;
+            const ssize_t n = read(fd, buf, sizeof(buf));
+            if (n > 0) decoder.feed(buf, size_t(n));
+        }
+    }
+    /// Wait until `count` records have arrived (or a few seconds passed).
+    void wait_for(uint32_t count) {
+        const uint64_t t0 = bench::now_ns();
+        while (received.records.load(std::memory_order_acquire) < count &&
+               bench::now_ns() - t0 < 5'000'000'000ull) {
+            sched_yield();
+        }
+    }
+    void stop() {
+        done = true;
+        thread.join();
+    }
+};
+
+bool open_pty(int &master, int &slave) {
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master)) return false;
+    slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if (slave < 0) return false;
+    termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+void drain(Telemetry &tm) {
+    tm.flush();
+    while (tm.queued()) {
+        tm.pump();
+        sched_yield();
+    }
+    tm.pump();
+}
+
+void loopback_flat_out(int master, int slave) {
+    VirtualClock clock;
+    FdSink sink(master);
+    Telemetry tm(sink, clock);
+    Reader reader(slave);
+
+    constexpr uint32_t n = 300'000;
+    const uint64_t wall0 = bench::now_ns();
+    const uint64_t cpu0 = thread_cpu_ns();
+    uint64_t yield_ns = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        send(tm, i);
+        tm.pump();
+        // Respect backpressure here: this run measures throughput, not drops.
+        while (tm.queued() == Telemetry::queue_packets) {
+            const uint64_t y0 = thread_cpu_ns();
+            sched_yield();
+            tm.pump();
+            yield_ns += thread_cpu_ns() - y0;
+        }
+    }
+    drain(tm);
+    reader.wait_for(n);
+    const double wall_s = (bench::now_ns() - wall0) / 1e9;
+    const uint64_t cpu_ns = thread_cpu_ns() - cpu0 - yield_ns;
+    reader.stop();
+
+    const TelemetryStats &st = tm.stats();
+    const Received &r = reader.received;
+    bench::report("pty loopback: %u records in %.2f s = %.0f records/s (%.2f MB/s), %.1f records "
+                  "per frame, producer CPU %.0f ns/record",
+                  n, wall_s, n / wall_s, st.bytes / wall_s / 1e6, double(st.records) / st.frames,
+                  double(cpu_ns) / n);
+    if (r.records != n || r.out_of_order || r.bad_payload || reader.decoder.bad_frames() ||
+        reader.decoder.lost_frames() || st.dropped_records) {
+        bench::fail("loopback: %u of %u records, %u out of order, %u bad payloads, %u bad frames, "
+                    "%u lost frames, %u dropped",
+                    r.records.load(), n, r.out_of_order, r.bad_payload,
+                    reader.decoder.bad_frames(), reader.decoder.lost_frames(),
+                    st.dropped_records);
+    }
+}
+
+void loopback_stalled_reader(int master, int slave) {
+    VirtualClock clock;
+    FdSink sink(master);
+    Telemetry tm(sink, clock);
+    Reader reader(slave);
+
+    // The host stops reading while the device keeps producing, then
+    // recovers.
+    reader.paused = true;
+    constexpr uint32_t stalled = 50'000, resumed = 20'000;
+    uint64_t worst_ns = 0;
+    uint32_t i = 0;
+    for (; i < stalled; i++) {
+        const uint64_t t0 = bench::now_ns();
+        send(tm, i);
+        tm.pump();
+        const uint64_t dt = bench::now_ns() - t0;
+        if (dt > worst_ns) worst_ns = dt;
+    }
+    const uint32_t dropped_while_stalled = tm.stats().dropped_records;
+    reader.paused = false;
+    for (; i < stalled + resumed; i++) {
+        send(tm, i);
+        tm.pump();
+        while (tm.queued() == Telemetry::queue_packets) {
+            sched_yield();
+            tm.pump();
+        }
+    }
+    drain(tm);
+    const TelemetryStats &st = tm.stats();
+    reader.wait_for(i - st.dropped_records);
+    reader.stop();
+
+    const Received &r = reader.received;
+    const TelemetryDecoder &d = reader.decoder;
+    bench::report("stalled reader: %u records produced, %u dropped (%u frames) while stalled; "
+                  "worst record+pump %.1f us; decoder saw %u lost frames, device count %u",
+                  i, dropped_while_stalled, st.dropped_frames, worst_ns / 1e3, d.lost_frames(),
+                  d.device_dropped());
+    if (r.records + st.dropped_records != i || d.lost_frames() != st.dropped_frames ||
+        d.device_dropped() != uint16_t(st.dropped_records) || r.out_of_order || r.bad_payload ||
+        d.bad_frames() || !dropped_while_stalled) {
+        bench::fail("stall: %u received + %u dropped != %u, or lost %u != %u frames", r.records.load(),
+                    st.dropped_records, i, d.lost_frames(), st.dropped_frames);
+    }
+}
+
+} // namespace
+
+BENCH_SUITE(telemetry) {
+    // --- encoding cost ----------------------------------------------------------
+    {
+        VirtualClock clock;
+        static MemorySink sink;
+        Telemetry tm(sink, clock);
+        constexpr uint32_t n = 4000;  // about 60 KB of frames: fits the sink
+        uint64_t t0 = bench::now_ns();
+        for (uint32_t i = 0; i < n; i++) {
+            send(tm, i);
+            tm.pump();
+        }
+        tm.flush();
+        tm.pump();
+        const uint64_t binary_ns = bench::now_ns() - t0;
+
+        char line[96];
+        size_t text_bytes = 0;
+        t0 = bench::now_ns();
+        for (uint32_t i = 0; i < n; i++) {
+            const Status s = status_at(i);
+            text_bytes += size_t(snprintf(line, sizeof(line),
+                                          "temp=%.2f set=%.2f relay=%d drops=%u\n",
+                                          s.temp / 100.0, s.setpoint / 100.0, s.relay,
+                                          unsigned(s.drops)));
+            bench::keep(line[0]);
+        }
+        const uint64_t text_ns = bench::now_ns() - t0;
+
+        Received r;
+        TelemetryDecoder decoder(on_record, &r);
+        decoder.feed(sink.buf, sink.len);
+        bench::report("binary: %.0f ns and %.1f bytes per status record (%.1f per frame); "
+                      "printf line: %.0f ns and %.1f bytes",
+                      double(binary_ns) / n, double(sink.len) / n,
+                      double(tm.stats().records) / tm.stats().frames, double(text_ns) / n,
+                      double(text_bytes) / n);
+        if (r.records != n || r.bad_payload || decoder.bad_frames()) {
+            bench::fail("in-memory round trip: %u of %u records", r.records.load(), n);
+        }
+
+        // Garbage between frames costs at most the frame it lands in.
+        Received r2;
+        TelemetryDecoder resync(on_record, &r2);
+        const uint8_t noise[] = {0x13, 0x37, 0x00, 0x42};
+        resync.feed(sink.buf + 10, 40);  // joined mid-frame
+        resync.feed(noise, sizeof(noise));
+        resync.feed(sink.buf + 50, sink.len - 50);
+        bench::report("resync after joining mid-stream and line noise: %u of %u records, %u bad "
+                      "frames",
+                      r2.records.load(), n, resync.bad_frames());
+        if (r2.records < n - 12 || r2.bad_payload) bench::fail("decoder did not resynchronise");
+    }
+
+    int master, slave;
+    if (!open_pty(master, slave)) {
+        bench::report("no pseudo-terminal available; loopback skipped");
+        return;
+    }
+    loopback_flat_out(master, slave);
+    loopback_stalled_reader(master, slave);
+    close(slave);
+    close(master);
+}
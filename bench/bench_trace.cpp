@@ -0,0 +1,186 @@
+// Event tracing: what a trace point costs with tracing compiled in, and that
+// it costs nothing when compiled out (the default build). Then a reader
+// draining a ring while its writer runs flat out, which must account for
+// every event as either read intact and in order or lost, and a crash
+// snapshot written to the flash log and read back.
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "bench.h"
+#include "flash_log.h"
+#include "trace.h"
+
+using namespace thermo;
+
+namespace {
+
+constexpr const char *flash_path = "/tmp/thermostat_bench_trace_flash.bin";
+
+// Fastest of a few runs of `n` iterations, in ns per iteration.
+template <typename Fn>
+double best_ns(uint32_t n, Fn fn) {
+    uint64_t best = UINT64_MAX;
+    for (int run = 0; run < 5; run++) {
+        const uint64_t t0 = bench::now_ns();
+        fn(n);
+        best = std::min(best, bench::now_ns() - t0);
+    }
+    return double(best) / n;
+}
+
+__attribute__((noinline)) void plain_loop(uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) bench::keep(i);
+}
+
+// The same loop with the trace points a task body carries.
+__attribute__((noinline)) void traced_loop(uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        TRACE_SCOPE(task_control);
+        TRACE_COUNTER(temp, i);
+        bench::keep(i);
+    }
+}
+
+struct Dump {
+    uint32_t events[Tracer::cores] = {};
+    uint32_t lost = 0;
+    uint32_t out_of_order = 0;
+    int32_t last_arg[Tracer::cores] = {-1, -1};
+};
+
+void on_dump_record(void *ctx, uint8_t type, const uint8_t *p, size_t len) {
+    if (type != trace::record_trace_dump || len < trace::block_header || p[0] >= Tracer::cores) {
+        return;
+    }
+    Dump &d = *static_cast<Dump *>(ctx);
+    const size_t core = p[0];
+    d.lost += uint32_t(p[1] | p[2] << 8);
+    for (const uint8_t *e = p + trace::block_header; e + trace::event_size <= p + len;
+         e += trace::event_size) {
+        const int32_t arg = e[6] | e[7] << 8;
+        if (d.last_arg[core] >= 0 && arg != d.last_arg[core] + 1) d.out_of_order++;
+        d.last_arg[core] = arg;
+        d.events[core]++;
+    }
+}
+
+} // namespace
+
+BENCH_SUITE(trace) {
+    // --- cost per event ----------------------------------------------------------
+    static Tracer t;
+    t.reset();
+    constexpr uint32_t n = 2'000'000;
+    const double record_ns = best_ns(n, [](uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            t.record(TraceId::reading, TraceKind::instant, uint16_t(i));
+        }
+    });
+    const double stamp_ns = best_ns(n, [](uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) bench::keep(time_us_32());
+    });
+    bench::report("enabled: %.1f ns per event, of which %.1f ns reading the timer", record_ns,
+                  stamp_ns);
+
+    const double plain = best_ns(n, plain_loop);
+    const double traced = best_ns(n, traced_loop);
+    bench::report("task body with 3 trace points: %.2f ns vs %.2f ns without (THERMO_TRACE=%d)",
+                  traced, plain, THERMO_TRACE);
+    if (!THERMO_TRACE && traced - plain > 0.5) {
+        bench::fail("compiled-out trace points cost %.2f ns", traced - plain);
+    }
+
+    // --- concurrent drain ------------------------------------------------------
+    // The writer stands in for core 1. It yields every 1000 events, as the
+    // emulated cores may share a CPU, so the reader is regularly lapped.
+    {
+        t.reset();
+        constexpr uint32_t events = 1'000'000;
+        std::atomic<bool> done{false};
+        std::thread writer([&] {
+            trace_set_core(1);
+            for (uint32_t i = 0; i < events; i++) {
+                t.record(TraceId::reading, TraceKind::instant, uint16_t(i));
+                if (i % 1000 == 999) sched_yield();
+            }
+            done = true;
+        });
+        uint32_t cursor = 0, lost = 0, received = 0, bad = 0;
+        uint32_t next = 0;  // expected sequence number, mod 2^16 in the event
+        TraceEvent buf[32];
+        uint32_t last_time = 0;
+        for (;;) {
+            const bool finished = done.load();
+            const uint32_t lost_before = lost;
+            const size_t got = t.ring(1).read(cursor, buf, 32, lost);
+            next += lost - lost_before;
+            for (size_t i = 0; i < got; i++, next++) {
+                const bool backwards = int32_t(buf[i].time_us - last_time) < 0;
+                if (buf[i].arg != uint16_t(next) || backwards) bad++;
+                last_time = buf[i].time_us;
+            }
+            received += uint32_t(got);
+            if (finished && !got) break;
+            if (!got) sched_yield();
+        }
+        writer.join();
+        bench::report("concurrent drain: %u events read intact, %u lost to overwrites, %u "
+                      "wrong (ring of %zu)",
+                      received, lost, bad, TraceRing::capacity);
+        if (received + lost != events || bad) {
+            bench::fail("drain: %u read + %u lost != %u, %u out of sequence", received, lost,
+                        events, bad);
+        }
+    }
+
+    // --- crash snapshot through the flash log ----------------------------------
+    {
+        t.reset();
+        constexpr uint32_t core0_events = 1000, core1_events = 10;
+        for (uint32_t i = 0; i < core0_events; i++) {
+            t.record(TraceId::reading, TraceKind::instant, uint16_t(i));
+        }
+        trace_set_core(1);
+        for (uint32_t i = 0; i < core1_events; i++) {
+            t.record(TraceId::relay, TraceKind::instant, uint16_t(i));
+        }
+        trace_set_core(0);
+        t.freeze(true);
+        t.record(TraceId::fault, TraceKind::instant, 0);  // dropped: frozen
+        const bool faulted = t.faulted();
+
+        unlink(flash_path);
+        FileFlash flash(flash_path, 16 * FlashDevice::sector_size);
+        if (!flash.ok()) {
+            bench::fail("cannot map %s", flash_path);
+            return;
+        }
+        {
+            FlashLog log(flash);
+            log.mount();
+            const uint64_t t0 = bench::now_ns();
+            if (!trace_dump(t, log)) bench::fail("trace_dump failed");
+            const uint64_t dump_ns = bench::now_ns() - t0;
+            bench::report("crash snapshot: %zu events in %u pages, %.0f us to write",
+                          TraceRing::capacity - 1 + core1_events, log.stats().pages_programmed,
+                          dump_ns / 1e3);
+        }
+        FlashLog reread(flash);
+        reread.mount();
+        Dump d;
+        reread.for_each(on_dump_record, &d);
+        t.reset();
+        bench::report("  read back: core 0 %u events (last %d), core 1 %u events; cleared=%d",
+                      d.events[0], d.last_arg[0], d.events[1], !t.faulted());
+        if (!faulted || d.events[0] != TraceRing::capacity - 1 ||
+            d.last_arg[0] != int32_t(core0_events - 1) || d.events[1] != core1_events || d.lost ||
+            d.out_of_order || t.faulted()) {
+            bench::fail("crash snapshot did not round-trip");
+        }
+        unlink(flash_path);
+    }
+}
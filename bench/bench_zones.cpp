@@ -0,0 +1,252 @@
+// Multi-zone controller (zones.h): per-tick cost from 1 to 256 zones for
+// both numeric backends, against the same zones as one BasicThermostat each;
+// a closed-loop check that unstaggered zones switch exactly as those
+// thermostats do; and a day of sixteen zones on shared equipment, with and
+// without staggered windows, scored by how many zones each item of
+// equipment serves at once.
+#include <algorithm>
+
+#include "bench.h"
+#include "thermostat.h"
+#include "zones.h"
+
+using namespace thermo;
+
+namespace {
+
+constexpr uint32_t max_bench_zones = 256;
+
+// First-order room per zone, in float for both backends so the plant is
+// identical; rooms differ in how fast they heat and lose heat.
+struct Rooms {
+    float temp_c[max_bench_zones];
+    float gain[max_bench_zones];
+    float loss[max_bench_zones];
+
+    explicit Rooms(uint32_t n) {
+        for (uint32_t i = 0; i < n; i++) {
+            temp_c[i] = 15.0f + float(i % 7) * 0.5f;
+            gain[i] = 0.02f + 0.004f * float(i % 5);
+            loss[i] = 0.0008f + 0.0001f * float(i % 3);
+        }
+    }
+    void advance(uint32_t i, bool heat) {
+        temp_c[i] += (heat ? gain[i] : 0.0f) - loss[i] * (temp_c[i] - 5.0f);
+    }
+};
+
+ZoneConfig zone_config(uint32_t i) {
+    ZoneConfig z;
+    z.setpoint_c = 19.0f + float(i % 4) * 0.5f;
+    z.mode = i % 4 == 3 ? ControlMode::hysteresis : ControlMode::pid;
+    z.group = uint8_t(i % 8);
+    return z;
+}
+
+ThermostatConfig thermostat_config(uint32_t i) {
+    const ZoneConfig z = zone_config(i);
+    ThermostatConfig c;
+    c.mode = z.mode;
+    c.setpoint_c = z.setpoint_c;
+    c.hysteresis_c = z.hysteresis_c;
+    c.kp = z.kp;
+    c.ki = z.ki;
+    c.kd = 0.0f;
+    return c;
+}
+
+// A zone's temperature trace, pre-converted so the timed loops measure the
+// controllers only.
+constexpr uint32_t trace_len = 1024;
+
+template <typename T>
+struct Traces {
+    T temp[trace_len][max_bench_zones];
+
+    Traces() {
+        Rooms rooms(max_bench_zones);
+        static BasicZoneController<float, max_bench_zones> shaper;
+        for (uint32_t i = 0; i < max_bench_zones; i++) shaper.add_zone(zone_config(i));
+        for (uint32_t t = 0; t < trace_len; t++) {
+            for (uint32_t i = 0; i < max_bench_zones; i++) {
+                shaper.temperatures()[i] = rooms.temp_c[i];
+                temp[t][i] = Numeric<T>::from_float(rooms.temp_c[i]);
+            }
+            shaper.step();
+            for (uint32_t i = 0; i < max_bench_zones; i++) rooms.advance(i, shaper.zone_on(i));
+        }
+    }
+};
+
+struct Cost {
+    double soa_ns;     // per tick
+    double object_ns;  // per tick
+};
+
+template <typename T>
+Cost measure(const Traces<T> &traces, uint32_t zones) {
+    const uint32_t ticks = std::max<uint32_t>(4'000, (1u << 21) / zones);
+    Cost cost;
+
+    static BasicZoneController<T, max_bench_zones> bank_storage;
+    bank_storage = BasicZoneController<T, max_bench_zones>();
+    BasicZoneController<T, max_bench_zones> *bank = &bank_storage;
+    for (uint32_t i = 0; i < zones; i++) bank->add_zone(zone_config(i));
+    uint32_t on = 0;
+    uint64_t t0 = bench::now_ns();
+    for (uint32_t t = 0; t < ticks; t++) {
+        const T *row = traces.temp[t % trace_len];
+        T *temp = bank->temperatures();
+        for (uint32_t i = 0; i < zones; i++) temp[i] = row[i];
+        bank->step();
+        on += bank->zone_calls()[0];
+    }
+    cost.soa_ns = double(bench::now_ns() - t0) / ticks;
+    bench::keep(on);
+
+    static BasicThermostat<T> objects[max_bench_zones];
+    for (uint32_t i = 0; i < zones; i++) objects[i] = BasicThermostat<T>(thermostat_config(i));
+    on = 0;
+    t0 = bench::now_ns();
+    for (uint32_t t = 0; t < ticks; t++) {
+        const T *row = traces.temp[t % trace_len];
+        for (uint32_t i = 0; i < zones; i++) on += objects[i].step(row[i]);
+    }
+    cost.object_ns = double(bench::now_ns() - t0) / ticks;
+    bench::keep(on);
+    return cost;
+}
+
+template <typename T>
+void scaling() {
+    static Traces<T> traces;
+    bench::report("%s: per-tick cost, SoA bank vs one BasicThermostat per zone", Numeric<T>::name);
+    double per_zone_16 = 0, per_zone_256 = 0;
+    for (uint32_t zones = 1; zones <= max_bench_zones; zones *= 2) {
+        const Cost c = measure(traces, zones);
+        bench::report("  %3u zones  bank %9.1f ns/tick (%6.2f ns/zone)  objects %9.1f ns/tick "
+                      "(%6.2f ns/zone)  %5.2fx",
+                      zones, c.soa_ns, c.soa_ns / zones, c.object_ns, c.object_ns / zones,
+                      c.object_ns / c.soa_ns);
+        if (zones == 16) per_zone_16 = c.soa_ns / zones;
+        if (zones == max_bench_zones) per_zone_256 = c.soa_ns / zones;
+    }
+    // The pass is linear in zones: per-zone cost must not grow with the bank.
+    if (per_zone_256 > 2 * per_zone_16) {
+        bench::fail("zones %s: %.2f ns/zone at 256 zones, %.2f at 16", Numeric<T>::name,
+                    per_zone_256, per_zone_16);
+    }
+}
+
+// Unstaggered, the bank switches every zone as its own thermostat would.
+template <typename T>
+void equivalence(uint32_t zones, uint32_t ticks) {
+    ZoneBankConfig config;
+    config.stagger = false;
+    static BasicZoneController<T, max_bench_zones> bank_storage;
+    bank_storage = BasicZoneController<T, max_bench_zones>(config);
+    BasicZoneController<T, max_bench_zones> *bank = &bank_storage;
+    static BasicThermostat<T> objects[max_bench_zones];
+    for (uint32_t i = 0; i < zones; i++) {
+        bank->add_zone(zone_config(i));
+        objects[i] = BasicThermostat<T>(thermostat_config(i));
+    }
+    Rooms rooms(zones);
+    uint32_t mismatches = 0;
+    for (uint32_t t = 0; t < ticks; t++) {
+        for (uint32_t i = 0; i < zones; i++) {
+            bank->temperatures()[i] = Numeric<T>::from_float(rooms.temp_c[i]);
+        }
+        bank->step();
+        for (uint32_t i = 0; i < zones; i++) {
+            const bool on = objects[i].step(Numeric<T>::from_float(rooms.temp_c[i]));
+            mismatches += on != bank->zone_on(i);
+            rooms.advance(i, on);
+        }
+    }
+    bench::report("%s: %u zones x %u ticks against BasicThermostat: %u relay mismatches",
+                  Numeric<T>::name, zones, ticks, mismatches);
+    if (mismatches) bench::fail("zones %s: %u mismatches", Numeric<T>::name, mismatches);
+}
+
+struct Sharing {
+    uint32_t peak[2];    // zones at once, once warmed up
+    double mean[2];      // zones at once, over ticks the equipment runs
+    uint32_t starts[2];  // equipment off -> on
+    uint32_t bad_outputs;
+};
+
+// Sixteen zones in four groups, groups 0-1 on equipment 0 and 2-3 on
+// equipment 1, for a day with a night setback on group 1. The first two
+// hours, with every room heating flat out, are left out of the peak.
+Sharing share(bool stagger) {
+    ZoneBankConfig config;
+    config.stagger = stagger;
+    ZoneController bank(config);
+    for (uint32_t i = 0; i < zone_limit; i++) {
+        ZoneConfig z = zone_config(i);
+        z.mode = ControlMode::pid;
+        z.group = uint8_t(i / 4);
+        bank.add_zone(z);
+    }
+    bank.set_group_equipment(2, 1);
+    bank.set_group_equipment(3, 1);
+    Rooms rooms(zone_limit);
+    Sharing s = {};
+    uint64_t sum[2] = {}, running[2] = {};
+    bool was_on[2] = {};
+    for (uint32_t t = 0; t < 24 * 3600; t++) {
+        if (t == 8 * 3600) bank.set_group_setpoint(1, 17.0f);
+        if (t == 16 * 3600) bank.set_group_setpoint(1, 20.0f);
+        for (uint32_t i = 0; i < zone_limit; i++) {
+            bank.temperatures()[i] = Numeric<real_t>::from_float(rooms.temp_c[i]);
+        }
+        bank.step();
+        uint32_t expect[2] = {};
+        for (uint32_t i = 0; i < zone_limit; i++) {
+            const bool on = bank.zone_on(i);
+            expect[i / 8] += on;
+            s.bad_outputs += on != bool(bank.zone_calls()[0] >> i & 1);
+            rooms.advance(i, on);
+        }
+        for (uint8_t e = 0; e < 2; e++) {
+            const uint32_t d = bank.equipment_demand(e);
+            s.bad_outputs += d != expect[e] || bank.equipment_on(e) != (d > 0);
+            if (t >= 2 * 3600) s.peak[e] = std::max(s.peak[e], d);
+            s.starts[e] += d > 0 && !was_on[e];
+            was_on[e] = d > 0;
+            sum[e] += d;
+            running[e] += d > 0;
+        }
+    }
+    for (int e = 0; e < 2; e++) s.mean[e] = running[e] ? double(sum[e]) / running[e] : 0;
+    return s;
+}
+
+} // namespace
+
+BENCH_SUITE(zones) {
+    bench::report("state: %zu B for a %u-zone bank (%.1f B/zone), %zu B per BasicThermostat",
+                  sizeof(ZoneController), zone_limit, double(sizeof(ZoneController)) / zone_limit,
+                  sizeof(Thermostat));
+    scaling<Q16>();
+    scaling<float>();
+    equivalence<Q16>(64, 20'000);
+    equivalence<float>(64, 20'000);
+
+    const Sharing flat = share(false), staggered = share(true);
+    for (int e = 0; e < 2; e++) {
+        bench::report("equipment %d, 8 zones: aligned windows peak %u zones, mean %.2f, "
+                      "%4u starts; staggered peak %u, mean %.2f, %4u starts",
+                      e, flat.peak[e], flat.mean[e], flat.starts[e], staggered.peak[e],
+                      staggered.mean[e], staggered.starts[e]);
+        if (staggered.peak[e] > flat.peak[e] || staggered.starts[e] > flat.starts[e]) {
+            bench::fail("zones: staggering made equipment %d worse (peak %u, %u starts)", e,
+                        staggered.peak[e], staggered.starts[e]);
+        }
+    }
+    if (flat.bad_outputs || staggered.bad_outputs) {
+        bench::fail("zones: %u call bitmap or equipment outputs disagree with the zones",
+                    flat.bad_outputs + staggered.bad_outputs);
+    }
+}
@@ -5,7 +5,15 @@ set -e
 if [ ! -d "pico-sdk" ]; then
 	git clone https://github.com/raspberrypi/pico-sdk.git
 fi
+# Wi-Fi and TCP/IP for Pico W builds with THERMO_MQTT.
+git -C pico-sdk submodule update --init lib/lwip lib/cyw43-driver
 export PICO_SDK_PATH=$(pwd)/pico-sdk
 if [ ! -f "pico_sdk_import.cmake" ]; then
 	cp pico-sdk/external/pico_sdk_import.cmake .
 fi
+
+# Device build:  cmake -S . -B build && cmake --build build
+# Pico W, MQTT:  cmake -S . -B build-w -DPICO_BOARD=pico_w -DTHERMO_MQTT=ON \
+#                  -DTHERMO_WIFI_SSID=... -DTHERMO_WIFI_PASSWORD=... -DTHERMO_MQTT_BROKER=...
+# Host build:    cmake -S . -B build-host -DPICO_PLATFORM=host && cmake --build build-host
+#                ./build-host/bench/thermostat_bench   (writes bench_output.txt)
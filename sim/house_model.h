@@ -0,0 +1,104 @@
+// Lumped-capacitance house for closed-loop simulation: a furnace heating the
+// emitters (radiators and their water), which warm the room air; the air
+// exchanges heat with the building fabric and both lose heat to the outside.
+// The controller sees the air temperature through a dead time (sensor
+// placement, mixing) plus a little noise.
+//
+//   q_f follows P_heat (relay on) or 0 (off) with time constant tau_f
+//   C_em dT_em/dt = q_f - UA_em (T_em - T_air)
+//   C_air dT_air/dt = UA_em (T_em - T_air) - UA_wall (T_air - T_wall)
+//                     - (UA_loss + UA_door) (T_air - T_out) + Q_gains
+//   C_wall dT_wall/dt = UA_wall (T_air - T_wall) - UA_wall_out (T_wall - T_out)
+//
+// Fuel is counted while the relay is on, plus a fixed amount per burner
+// start (pre-purge, ignition, warming the flue), so short cycles cost
+// energy. With c_wall = 0 the fabric node is left out and the house is the
+// two-node model the autotune bench was calibrated on.
+#pragma once
+
+#include <cstdint>
+
+namespace sim {
+
+struct HouseParams {
+    const char *name;
+    double c_air;    // J/K: air, furnishings and the fabric that follows the air
+    double c_em;     // J/K: emitters
+    double ua_em;    // W/K: emitter to air
+    double ua_loss;  // W/K: air to outside (windows, ventilation)
+    double power;    // W when the relay is on
+    uint32_t dead_s; // sensor dead time
+    double outside_c;  // until set_outside()
+    double c_wall = 0;       // J/K: walls, floors, ceilings; 0 leaves them out
+    double ua_wall = 0;      // W/K: air to inner wall surface
+    double ua_wall_out = 0;  // W/K: through the walls to outside
+    double furnace_tau_s = 0;  // heat exchanger lag
+    double start_loss_s = 0;   // fuel lost per burner start, in seconds at full power
+    double door_ua = 0;      // W/K added while an outside door is open
+};
+
+class House {
+public:
+    static constexpr uint32_t max_dead_s = 600;
+
+    explicit House(const HouseParams &p, double start_c = 16.0, uint32_t seed = 1)
+        : p_(p), outside_(p.outside_c), start_(start_c), air_(start_c), em_(start_c),
+          wall_(start_c), rng_(seed) {
+        ramp_ = p.furnace_tau_s > 1 ? 1.0 / p.furnace_tau_s : 1.0;
+    }
+
+    void set_outside(double c) { outside_ = c; }
+    void set_door(bool open) { door_ = open; }
+    /// People, appliances and sun, in watts.
+    void set_gains(double w) { gains_ = w; }
+
+    /// Advance one second with the heat on or off.
+    void step(bool heat) {
+        furnace_ += ((heat ? p_.power : 0.0) - furnace_) * ramp_;
+        const double q_em = p_.ua_em * (em_ - air_);
+        const double loss = (p_.ua_loss + (door_ ? p_.door_ua : 0.0)) * (air_ - outside_);
+        double q_wall = 0;
+        if (p_.c_wall > 0) {
+            q_wall = p_.ua_wall * (air_ - wall_);
+            wall_ += (q_wall - p_.ua_wall_out * (wall_ - outside_)) / p_.c_wall;
+        }
+        em_ += (furnace_ - q_em) / p_.c_em;
+        air_ += (q_em - q_wall - loss + gains_) / p_.c_air;
+        delay_[t_ % (max_dead_s + 1)] = air_;
+        t_++;
+        energy_j_ += heat ? p_.power * (burning_ ? 1.0 : 1.0 + p_.start_loss_s) : 0.0;
+        burning_ = heat;
+    }
+
+    /// What the thermostat's sensor reads now.
+    double sensor() {
+        const uint32_t dead = p_.dead_s < max_dead_s ? p_.dead_s : max_dead_s;
+        const double seen = t_ > dead ? delay_[(t_ - 1 - dead) % (max_dead_s + 1)] : start_;
+        rng_ = rng_ * 1664525u + 1013904223u;
+        return seen + 0.02 * (double(rng_ >> 8) / double(1u << 24) - 0.5);
+    }
+
+    double air_c() const { return air_; }
+    double wall_c() const { return wall_; }
+    double energy_kwh() const { return energy_j_ / 3.6e6; }
+    uint32_t seconds() const { return t_; }
+
+private:
+    HouseParams p_;
+    double outside_;
+    double start_;
+    double air_;
+    double em_;
+    double wall_;
+    double furnace_ = 0;
+    double ramp_;
+    double gains_ = 0;
+    bool door_ = false;
+    bool burning_ = false;
+    double delay_[max_dead_s + 1] = {};
+    uint32_t t_ = 0;
+    uint32_t rng_;
+    double energy_j_ = 0;
+};
+
+} // namespace sim
@@ -0,0 +1,198 @@
+#include "simulator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace sim {
+
+using thermo::AutotuneState;
+using thermo::ControlMode;
+using thermo::real_t;
+using thermo::Thermostat;
+using thermo::ThermostatConfig;
+
+static constexpr double two_pi = 6.283185307179586;
+static constexpr uint32_t minutes_per_day = 24 * 60;
+// The heating counts as in use if the burner ran this recently.
+static constexpr uint64_t heating_window_min = 6 * 60;
+
+const HouseParams reference_houses[reference_house_count] = {
+    // name  c_air c_em ua_em loss power dead out | c_wall ua_wall ua_wall_out tau start door
+    {"flat", 1.5e6, 1.0e5, 400, 35, 4000, 30, 0, 2.0e7, 400, 45, 30, 10, 60},
+    {"terrace", 3.0e6, 2.5e5, 450, 60, 7000, 60, 0, 4.0e7, 600, 80, 45, 15, 80},
+    {"detached", 4.0e6, 3.0e5, 500, 90, 10000, 60, 0, 6.0e7, 800, 130, 60, 20, 100},
+    {"heavy, underfloor", 4.0e6, 1.5e6, 300, 50, 7000, 120, 0, 1.2e8, 900, 70, 60, 20, 80},
+    {"drafty, old", 3.0e6, 2.0e5, 500, 180, 12000, 45, 0, 5.0e7, 700, 120, 45, 15, 120},
+};
+
+const Climate reference_climates[reference_climate_count] = {
+    // name          mean seasonal diurnal front days
+    {"maritime", 10.5, 6.5, 3.0, 2.5, 3.0},
+    {"continental", 8.0, 11.0, 5.0, 4.0, 4.0},
+};
+
+static uint64_t xorshift(uint64_t &s) {
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return s;
+}
+
+static double uniform(uint64_t &s) {
+    return double(xorshift(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static uint64_t mix_seed(uint32_t seed, uint64_t stream) {
+    uint64_t s = (uint64_t(seed) << 32 | stream) * 0x9e3779b97f4a7c15ull;
+    return s ? s : 1;
+}
+
+Outdoor::Outdoor(const Climate &c, uint32_t start_day, uint32_t seed)
+    : c_(c), minute_(uint64_t(start_day) * minutes_per_day), rng_(mix_seed(seed, 1)) {
+    const double steps = std::max(c.front_days, 0.01) * minutes_per_day;
+    keep_ = std::exp(-1.0 / steps);
+    drive_ = c.front_c * std::sqrt(1 - keep_ * keep_);
+    front_ = c.front_c * gauss();
+}
+
+double Outdoor::gauss() {
+    // Box-Muller; one of the pair is enough at one draw per minute.
+    const double u = 1.0 - uniform(rng_);
+    return std::sqrt(-2.0 * std::log(u)) * std::cos(two_pi * uniform(rng_));
+}
+
+double Outdoor::next_minute() {
+    const double day = double(minute_ % (365 * minutes_per_day)) / minutes_per_day;
+    const double hour = double(minute_ % minutes_per_day) / 60;
+    minute_++;
+    front_ = front_ * keep_ + drive_ * gauss();
+    return c_.mean_c - c_.seasonal_c * std::cos(two_pi * (day - 15) / 365) -
+           c_.diurnal_c * std::cos(two_pi * (hour - 4) / 24) + front_;
+}
+
+/// Relay-feedback tuning on a winter day at the day setpoint, as an
+/// installer would run it. Returns the controller config to use: PID gains
+/// and, for MPC, the room model.
+static ThermostatConfig tune(const Scenario &s, Metrics &m) {
+    ThermostatConfig config = s.control;
+    Thermostat tuner(config);
+    tuner.set_setpoint(s.schedule.day_c);
+    tuner.start_autotune();
+    House house(s.house, s.schedule.night_c, s.seed);
+    house.set_outside(s.climate.mean_c - s.climate.seasonal_c);
+    const uint32_t limit = uint32_t(config.autotune_max_s) + 1;
+    for (uint32_t i = 0; i < limit && tuner.autotune_state() == AutotuneState::running; i++) {
+        house.step(tuner.step(real_t(float(house.sensor()))));
+    }
+    m.tune = tuner.autotune_state();
+    if (m.tune == AutotuneState::done) {
+        const ThermostatConfig &tuned = tuner.config();
+        if (config.mode != ControlMode::mpc) config.mode = ControlMode::pid;
+        config.kp = tuned.kp;
+        config.ki = tuned.ki;
+        config.kd = tuned.kd;
+        config.model_gain_c = tuned.model_gain_c;
+        config.model_tau_s = tuned.model_tau_s;
+        config.model_dead_s = tuned.model_dead_s;
+    }
+    return config;
+}
+
+Metrics simulate(const Scenario &s) {
+    Metrics m;
+    const ThermostatConfig config = s.autotune ? tune(s, m) : s.control;
+    if (config.mode == ControlMode::pid) {
+        m.kp = config.kp;
+        m.ki = config.ki;
+    }
+    Thermostat t(config);
+    House house(s.house, s.schedule.night_c, s.seed);
+    Outdoor outdoor(s.climate, s.start_day, s.seed);
+    uint64_t rng = mix_seed(s.seed, 2);
+
+    const Schedule &sched = s.schedule;
+    const Occupancy &occ = s.occupancy;
+    const uint32_t tick = std::max(1u, uint32_t(std::lround(config.tick_s)));
+    const uint32_t wake = sched.wake_h * 60u, sleep = sched.sleep_h * 60u;
+    const double door_p = sleep > wake ? occ.doors_per_day / (sleep - wake) : 0;
+    const uint32_t door_span =
+        occ.door_max_s > occ.door_min_s ? occ.door_max_s - occ.door_min_s : 0;
+
+    float setpoint = sched.night_c;
+    t.set_setpoint(setpoint);
+    bool relay = false;
+    uint32_t door_left = 0, tick_pos = 0;
+    uint64_t on_s = 0, counted_s = 0;
+    uint64_t last_on = ~uint64_t(0) / 2;  // "never": far from any minute
+    double sum_sq = 0, cold = 0, hot = 0, worst = 0;
+    for (uint64_t minute = 0; minute < uint64_t(s.days) * minutes_per_day; minute++) {
+        const double out = outdoor.next_minute();
+        house.set_outside(out);
+        const uint32_t of_day = uint32_t(minute % minutes_per_day);
+        const bool awake = of_day >= wake && of_day < sleep;
+        const float want = awake ? sched.day_c : sched.night_c;
+        if (want != setpoint) t.set_setpoint(setpoint = want);
+        house.set_gains(awake ? occ.gains_w : 0.0);
+        if (awake && !door_left && uniform(rng) < door_p) {
+            door_left = occ.door_min_s;
+            if (door_span) door_left += uint32_t(xorshift(rng) % (door_span + 1));
+            m.doors++;
+        }
+        const bool counted = awake && (of_day - wake) * 60u >= sched.grace_s;
+        // Above the band and the RMS only count against the controller while
+        // it is heating: on a warm afternoon no heating control can help.
+        const bool heating = minute - last_on < heating_window_min;
+
+        for (uint32_t sec = 0; sec < 60; sec++) {
+            house.set_door(door_left > 0);
+            door_left -= door_left > 0;
+            if (tick_pos++ == 0) {
+                const bool r = t.step(real_t(float(house.sensor())));
+                m.cycles += r && !relay;
+                relay = r;
+                if (relay) last_on = minute;
+            }
+            if (tick_pos == tick) tick_pos = 0;
+            house.step(relay);
+            on_s += relay;
+            if (counted) {
+                const double err = house.air_c() - sched.day_c;
+                cold += std::max(0.0, -sched.cold_margin_c - err);
+                worst = std::min(worst, err);
+                if (heating) {
+                    hot += std::max(0.0, err - sched.hot_margin_c);
+                    sum_sq += err * err;
+                    counted_s++;
+                }
+            }
+        }
+    }
+    m.kwh = house.energy_kwh();
+    m.heat_h = on_s / 3600.0;
+    m.cold_dh = cold / 3600;
+    m.hot_dh = hot / 3600;
+    m.rms_c = counted_s ? std::sqrt(sum_sq / counted_s) : 0;
+    m.worst_cold_c = -worst;
+    m.seconds = house.seconds();
+    return m;
+}
+
+void sweep(const Scenario *scenarios, Metrics *out, size_t n, unsigned threads) {
+    if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = unsigned(std::min<size_t>(threads, n));
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;) {
+            out[i] = simulate(scenarios[i]);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; i++) pool.emplace_back(worker);
+    worker();
+    for (std::thread &th : pool) th.join();
+}
+
+} // namespace sim
@@ -0,0 +1,107 @@
+// Faster-than-real-time closed-loop simulation: the firmware's Thermostat,
+// built for the host, controlling a house_model.h house through a year of
+// weather, a day/night setpoint schedule and people opening the door. One
+// simulated second is one control tick and one model step, so a core runs
+// a year in a couple of seconds and a sweep of configurations runs on all
+// cores at once.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "house_model.h"
+#include "thermostat.h"
+
+namespace sim {
+
+/// Outdoor temperature: a seasonal sinusoid coldest in mid-January, a daily
+/// swing coldest before dawn, and weather fronts as a slowly wandering
+/// Gauss-Markov term.
+struct Climate {
+    const char *name;
+    double mean_c;      // annual mean
+    double seasonal_c;  // half the summer-winter swing
+    double diurnal_c;   // half the day-night swing
+    double front_c;     // standard deviation of the weather term
+    double front_days;  // its correlation time
+};
+
+class Outdoor {
+public:
+    Outdoor(const Climate &c, uint32_t start_day, uint32_t seed);
+
+    /// Temperature over the next minute; the first call covers the start day's
+    /// midnight.
+    double next_minute();
+
+private:
+    double gauss();
+
+    Climate c_;
+    uint64_t minute_;
+    double front_ = 0;
+    double keep_;   // AR(1) coefficient per minute
+    double drive_;  // innovation scale per minute
+    uint64_t rng_;
+};
+
+struct Schedule {
+    float day_c = 20.5f;
+    float night_c = 17.0f;
+    uint8_t wake_h = 6;   // day setpoint from here...
+    uint8_t sleep_h = 22; // ...to here
+    uint32_t grace_s = 3600;     // morning warm-up not counted against comfort
+    double cold_margin_c = 0.5;  // comfortable from day_c - this...
+    double hot_margin_c = 1.0;   // ...to day_c + this
+};
+
+struct Occupancy {
+    double doors_per_day = 8;  // outside door openings while awake
+    uint32_t door_min_s = 20;
+    uint32_t door_max_s = 240;
+    double gains_w = 300;      // while awake
+};
+
+struct Scenario {
+    const char *label = "";  // controller, for reports
+    HouseParams house = {};
+    Climate climate = {};
+    thermo::ThermostatConfig control;
+    bool autotune = false;  // tune on a winter day first, then run with the result
+    Schedule schedule;
+    Occupancy occupancy;
+    uint32_t days = 365;
+    uint32_t start_day = 0;  // day of the year, 0 = 1 January
+    uint32_t seed = 1;
+};
+
+struct Metrics {
+    double kwh = 0;           // fuel burned
+    double heat_h = 0;        // relay on time
+    uint32_t cycles = 0;      // relay switch-ons
+    double cold_dh = 0;       // awake degree-hours below the comfort band
+    double hot_dh = 0;        // ...and above it, with the heating in use
+    double rms_c = 0;         // awake deviation from the day setpoint, heating
+    double worst_cold_c = 0;  // deepest awake dip below the setpoint
+    uint32_t doors = 0;
+    thermo::AutotuneState tune = thermo::AutotuneState::off;
+    float kp = 0, ki = 0;     // gains the run used
+    uint64_t seconds = 0;     // simulated
+};
+
+/// The houses and climates tools/house_sim sweeps, also used by the
+/// benchmarks: from a small well-insulated flat to a drafty old house, and
+/// a mild maritime against a continental climate.
+constexpr size_t reference_house_count = 5;
+constexpr size_t reference_climate_count = 2;
+extern const HouseParams reference_houses[reference_house_count];
+extern const Climate reference_climates[reference_climate_count];
+
+/// Runs one scenario to completion. Deterministic for a given scenario.
+Metrics simulate(const Scenario &s);
+
+/// Runs `n` scenarios on `threads` worker threads (0: one per core). Each
+/// scenario is independent, so the results do not depend on the thread count.
+void sweep(const Scenario *scenarios, Metrics *out, size_t n, unsigned threads = 0);
+
+} // namespace sim
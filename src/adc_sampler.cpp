@@ -0,0 +1,162 @@
+#include "adc_sampler.h"
+
+#include <cstring>
+
+#include "memory_config.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#endif
+
+namespace thermo {
+
+#if PICO_ON_DEVICE
+
+// The DMA completion IRQ is shared, so only one sampler may run at a time.
+static AdcSampler *active_sampler;
+
+void AdcSampler::start(const AdcSamplerConfig &config) {
+    channels_ = __builtin_popcount(config.input_mask & 0x1f);
+    completed_ = 0;
+    read_ = 0;
+    overruns_ = 0;
+
+    adc_init();
+    for (unsigned input = 0; input < 4; input++) {
+        if (config.input_mask & (1u << input)) adc_gpio_init(26 + input);
+    }
+    if (config.input_mask & (1u << 4)) adc_set_temp_sensor_enabled(true);
+    adc_select_input(__builtin_ctz(config.input_mask));
+    adc_set_round_robin(channels_ > 1 ? config.input_mask & 0x1f : 0);
+    // FIFO on, DREQ at one sample, no error bit, keep full 12 bits.
+    adc_fifo_setup(true, true, 1, false, false);
+    // One conversion takes 96 ADC clocks (48 MHz); the divider adds idle time.
+    // adc_set_clkdiv() truncates a divider past its 16-bit integer field
+    // instead of failing, which would sample at some unrelated rate.
+    float rate = config.sample_rate_hz;
+    rate = rate < min_sample_rate_hz ? min_sample_rate_hz : rate;
+    rate = rate > max_sample_rate_hz ? max_sample_rate_hz : rate;
+    const float div = 48'000'000.0f / rate - 1.0f;
+    adc_set_clkdiv(div < 96.0f ? 0.0f : div);
+
+    for (int i = 0; i < 2; i++) dma_chan_[i] = dma_claim_unused_channel(true);
+    for (int i = 0; i < 2; i++) {
+        dma_channel_config c = dma_channel_get_default_config(dma_chan_[i]);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+        channel_config_set_read_increment(&c, false);
+        channel_config_set_write_increment(&c, true);
+        channel_config_set_dreq(&c, DREQ_ADC);
+        channel_config_set_chain_to(&c, dma_chan_[i ^ 1]);
+        dma_channel_configure(dma_chan_[i], &c, ring_[i], &adc_hw->fifo, block_samples, false);
+    }
+
+    active_sampler = this;
+    uint32_t mask = (1u << dma_chan_[0]) | (1u << dma_chan_[1]);
+    dma_hw->ints0 = mask;
+    dma_set_irq0_channel_mask_enabled(mask, true);
+    irq_set_exclusive_handler(DMA_IRQ_0, dma_irq_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    running_ = true;
+    dma_channel_start(dma_chan_[0]);
+    adc_run(true);
+}
+
+void AdcSampler::stop() {
+    if (!running_) return;
+    adc_run(false);
+    irq_set_enabled(DMA_IRQ_0, false);
+    for (int i = 0; i < 2; i++) {
+        dma_channel_set_irq0_enabled(dma_chan_[i], false);
+        dma_channel_abort(dma_chan_[i]);
+        dma_channel_unclaim(dma_chan_[i]);
+        dma_chan_[i] = -1;
+    }
+    adc_fifo_drain();
+    active_sampler = nullptr;
+    running_ = false;
+}
+
+void THERMO_HOT(AdcSampler::dma_irq_handler)() {
+    AdcSampler *s = active_sampler;
+    for (int i = 0; i < 2; i++) {
+        if (dma_channel_get_irq0_status(s->dma_chan_[i])) {
+            dma_channel_acknowledge_irq0(s->dma_chan_[i]);
+            // The other channel is already filling the next block; arm this
+            // one for the block after that, to be triggered by the chain.
+            uint32_t next = (s->completed_ + 2) % block_count;
+            dma_channel_set_write_addr(s->dma_chan_[i], s->ring_[next], false);
+            dma_channel_set_trans_count(s->dma_chan_[i], block_samples, false);
+            s->on_block_done();
+        }
+    }
+}
+
+#else
+
+void AdcSampler::start(const AdcSamplerConfig &config) {
+    channels_ = __builtin_popcount(config.input_mask & 0x1f);
+    completed_ = 0;
+    read_ = 0;
+    overruns_ = 0;
+    replay_pos_ = 0;
+    running_ = true;
+}
+
+void AdcSampler::stop() {
+    running_ = false;
+}
+
+void AdcSampler::host_replay(const uint16_t *samples, size_t count) {
+    replay_ = samples;
+    replay_len_ = count;
+    replay_pos_ = 0;
+}
+
+void AdcSampler::host_complete_block() {
+    if (!running_ || !replay_len_) return;
+    uint16_t *dst = ring_[completed_ % block_count];
+    size_t filled = 0;
+    while (filled < block_samples) {
+        size_t n = replay_len_ - replay_pos_;
+        if (n > block_samples - filled) n = block_samples - filled;
+        memcpy(dst + filled, replay_ + replay_pos_, n * sizeof(uint16_t));
+        filled += n;
+        replay_pos_ = (replay_pos_ + n) % replay_len_;
+    }
+    on_block_done();
+}
+
+#endif
+
+void THERMO_HOT(AdcSampler::on_block_done)() {
+    completed_ = completed_ + 1;
+}
+
+bool THERMO_HOT(AdcSampler::acquire)(AdcBlock &block) {
+#if !PICO_ON_DEVICE
+    // With no hardware behind it, the host model keeps one block ahead of
+    // the consumer, as a free-running DMA would.
+    if (read_ == completed_) host_complete_block();
+#endif
+    uint32_t done = completed_;
+    if (read_ == done) return false;
+    // Slots for blocks `done` and `done + 1` are being written or armed, so
+    // anything older than done - (block_count - 2) has been recycled.
+    if (done - read_ > block_count - 2) {
+        uint32_t oldest = done - (block_count - 2);
+        overruns_ += oldest - read_;
+        read_ = oldest;
+    }
+    block.samples = ring_[read_ % block_count];
+    block.seq = read_;
+    return true;
+}
+
+void THERMO_HOT(AdcSampler::release)() {
+    read_++;
+}
+
+} // namespace thermo
@@ -0,0 +1,79 @@
+// Free-running ADC capture into a ring of blocks, filled by two chained DMA
+// channels so the CPU only sees complete blocks.
+//
+// The ADC runs continuously (round-robin across the enabled inputs) and paces
+// its FIFO into DMA. Channel A fills even blocks and channel B odd blocks;
+// each chains to the other, and the completion IRQ re-points the channel that
+// just finished two blocks ahead. The consumer therefore has block_count - 2
+// blocks of slack before the producer laps it.
+//
+// On the host build there is no ADC; blocks are filled from a recorded sample
+// stream handed to host_replay(), so consumers can be exercised and timed.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace thermo {
+
+struct AdcSamplerConfig {
+    uint32_t input_mask = 1u << 4;   // ADC inputs sampled round-robin; 4 = temp sensor
+    float sample_rate_hz = 1000.0f;  // aggregate conversions per second
+};
+
+struct AdcBlock {
+    uint16_t *samples;  // block_samples 12-bit readings, inputs interleaved;
+                        // the consumer may filter them in place until release()
+    uint32_t seq;       // running block number
+};
+
+class AdcSampler {
+public:
+    static constexpr size_t block_samples = 256;
+    static constexpr size_t block_count = 8;
+    /// The ADC clock is 48 MHz, a conversion takes 96 of its cycles, and the
+    /// divider's integer part is 16 bits wide: slower or faster rates cannot
+    /// be set, and start() clamps to these.
+    static constexpr float min_sample_rate_hz = 48'000'000.0f / 65'536.0f;  // ~732 Hz
+    static constexpr float max_sample_rate_hz = 48'000'000.0f / 96.0f;
+
+    void start(const AdcSamplerConfig &config = {});
+    void stop();
+
+    /// Oldest completed block not yet released; false if none is ready.
+    /// Skips (and counts) blocks the producer has already overwritten.
+    bool acquire(AdcBlock &block);
+    /// Hand the block returned by the last acquire() back to the producer.
+    void release();
+
+    uint32_t completed() const { return completed_; }
+    uint32_t overruns() const { return overruns_; }
+    unsigned channel_count() const { return channels_; }
+
+#if !PICO_ON_DEVICE
+    /// Host build only: source for simulated conversions, replayed in a loop.
+    void host_replay(const uint16_t *samples, size_t count);
+    /// Host build only: simulate one DMA block completion.
+    void host_complete_block();
+#endif
+
+private:
+    void on_block_done();
+#if PICO_ON_DEVICE
+    static void dma_irq_handler();
+    int dma_chan_[2] = {-1, -1};
+#else
+    const uint16_t *replay_ = nullptr;
+    size_t replay_len_ = 0;
+    size_t replay_pos_ = 0;
+#endif
+
+    alignas(4) uint16_t ring_[block_count][block_samples];
+    volatile uint32_t completed_ = 0;  // written by the IRQ only
+    uint32_t read_ = 0;                // owned by the consumer
+    uint32_t overruns_ = 0;
+    unsigned channels_ = 1;
+    bool running_ = false;
+};
+
+} // namespace thermo
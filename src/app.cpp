@@ -0,0 +1,618 @@
+#include "app.h"
+
+#include <cstdio>
+
+#include "arena.h"
+#include "boot.h"
+#include "display.h"
+#include "ds18b20.h"
+#include "flash_log.h"
+#include "history.h"
+#include "profiler.h"
+#include "relay.h"
+#include "rollup.h"
+#include "sensing_core.h"
+#include "http.h"
+#include "mqtt.h"
+#include "power.h"
+#include "telemetry.h"
+#include "thermostat.h"
+#include "trace.h"
+
+namespace thermo {
+
+THERMO_ARENA(control, THERMO_RAM_CONTROL);
+THERMO_ARENA(storage, THERMO_RAM_STORAGE);
+THERMO_ARENA(bus, THERMO_RAM_BUS);
+THERMO_ARENA(history, THERMO_RAM_HISTORY);
+THERMO_ARENA(display, THERMO_RAM_DISPLAY);
+THERMO_ARENA(telemetry, THERMO_RAM_TELEMETRY);
+THERMO_ARENA(network, THERMO_RAM_NETWORK);
+
+#ifndef THERMO_ONEWIRE_GPIO
+#define THERMO_ONEWIRE_GPIO 16
+#endif
+
+// SSD1306 panel on spi1 (override the pins all together). Set
+// THERMO_DISPLAY_DOUBLE_BUFFER to 0 to save a framebuffer (1 KB) at the cost
+// of drawing only between transfers.
+#ifndef THERMO_DISPLAY_SPI
+#define THERMO_DISPLAY_SPI 1
+#define THERMO_DISPLAY_SCK_GPIO 10
+#define THERMO_DISPLAY_MOSI_GPIO 11
+#define THERMO_DISPLAY_DC_GPIO 12
+#define THERMO_DISPLAY_CS_GPIO 13
+#define THERMO_DISPLAY_RESET_GPIO 14
+#endif
+#ifndef THERMO_DISPLAY_BAUD
+#define THERMO_DISPLAY_BAUD 8'000'000
+#endif
+#ifndef THERMO_DISPLAY_DOUBLE_BUFFER
+#define THERMO_DISPLAY_DOUBLE_BUFFER 1
+#endif
+
+namespace {
+
+enum : uint8_t {
+    setting_setpoint = 1,
+    setting_pid_gains = 2,  // kp, ki, kd floats from autotuning
+    setting_room_model = 3, // gain, tau, dead time floats from autotuning
+};
+
+struct App {
+    Clock *clock;
+    FlashLog *log;
+    HistoryStore *history;
+    RollupIndex *rollup;
+    Ds18b20Array *probes = nullptr;  // external 1-Wire probes, if any answered at boot
+    Display *display;
+    Telemetry *telemetry = nullptr;
+    MqttClient *mqtt = nullptr;
+    HttpServer *http = nullptr;
+    uint32_t history_base_s = 0;  // history time at boot
+    Thermostat thermostat;
+    real_t temp_c = real_t(20);
+    bool relay_on = false;
+    bool mpc = false;  // switch to MPC when autotune learns a room model
+    Scheduler *scheduler;
+    int control_id = Scheduler::invalid_task;
+    int history_index_id = Scheduler::invalid_task;
+    bool history_ready = false;  // rollup rebuilt and history_base_s set
+    uint32_t tick_us;
+    bool boot_reported = false;  // the boot timeline has gone out
+#if THERMO_TRACE
+    uint32_t trace_cursor[Tracer::cores] = {};
+#endif
+#if THERMO_PROFILE
+    bool profile_sending = false;  // a dump is going out over telemetry
+    size_t profile_pos = 0;        // next histogram slot to send
+    uint32_t profile_id = 0;       // t_ms of the dump
+#endif
+};
+
+uint32_t now_ms(const App &app) {
+    return uint32_t(app.clock->now_us() / 1000);
+}
+
+void put16(uint8_t *p, int v) {
+    p[0] = uint8_t(v);
+    p[1] = uint8_t(v >> 8);
+}
+
+void put32(uint8_t *p, uint32_t v) {
+    put16(p, int(v & 0xffff));
+    put16(p + 2, int(v >> 16));
+}
+
+// See telemetry.h for the record layouts.
+void send_status(App &app) {
+    uint8_t r[11];
+    put32(r, now_ms(app));
+    put16(r + 4, Numeric<real_t>::round(app.temp_c * 100));
+    put16(r + 6, Numeric<float>::round(app.thermostat.config().setpoint_c * 100));
+    r[8] = app.relay_on;
+    put16(r + 9, int(sensing_core_drops()));
+    app.telemetry->record(telemetry::record_status, r, sizeof(r));
+}
+
+void send_probes(App &app) {
+    const uint32_t t = now_ms(app);
+    for (size_t i = 0; i < app.probes->count(); i++) {
+        uint8_t r[8];
+        put32(r, t);
+        r[4] = uint8_t(i);
+        r[5] = app.probes->valid(i);
+        put16(r + 6, app.probes->raw(i));
+        app.telemetry->record(telemetry::record_probe, r, sizeof(r));
+    }
+}
+
+void send_boot(App &app) {
+    constexpr size_t stages = size_t(BootStage::count);
+    static_assert(1 + 4 * stages <= telemetry::max_payload, "boot record outgrew a frame");
+    uint8_t r[1 + 4 * stages];
+    r[0] = uint8_t(stages);
+    for (size_t i = 0; i < stages; i++) put32(r + 1 + 4 * i, boot_time_us(BootStage(i)));
+    app.telemetry->record(telemetry::record_boot, r, sizeof(r));
+}
+
+void publish_reading(App &app) {
+    const MqttReading r = {now_ms(app), int16_t(Numeric<real_t>::round(app.temp_c * 100)),
+                           int16_t(Numeric<float>::round(app.thermostat.config().setpoint_c * 100)),
+                           app.relay_on};
+    app.mqtt->publish(r);
+}
+
+void THERMO_HOT(control_task)(void *ctx) {
+    TRACE_SCOPE(task_control);
+    App &app = *static_cast<App *>(ctx);
+    // Drain everything core 1 produced since the last tick; the newest
+    // reading wins.
+    SensorReading reading;
+    while (sensing_core_pop(reading)) app.temp_c = reading.temp_c;
+    TRACE_COUNTER(temp, Numeric<real_t>::round(app.temp_c * 100));
+    const bool tuning = app.thermostat.autotune_state() == AutotuneState::running;
+    app.relay_on = app.thermostat.step(app.temp_c);
+    relay_set(app.relay_on);
+    boot_mark(BootStage::first_control);
+    if (tuning && app.thermostat.autotune_state() == AutotuneState::done) {
+        const ThermostatConfig &c = app.thermostat.config();
+        const float gains[3] = {c.kp, c.ki, c.kd};
+        app.log->write_setting(setting_pid_gains, gains, sizeof(gains));
+        const float model[3] = {c.model_gain_c, c.model_tau_s, c.model_dead_s};
+        app.log->write_setting(setting_room_model, model, sizeof(model));
+        // Hours of tuning: onto flash now, not when the page next fills.
+        app.log->flush();
+        if (app.mpc) app.thermostat.set_mode(ControlMode::mpc);
+    }
+    if (app.telemetry) send_status(app);
+    if (app.mqtt) publish_reading(app);
+    // The first decision is out: now the history index, which scans the
+    // whole log.
+    if (!app.history_ready) app.scheduler->reschedule(app.history_index_id, app.clock->now_us());
+}
+
+// Control starts with the first reading instead of deciding on the 20 C
+// placeholder: until it arrives, look every 100 us, then release the control
+// task, registered first but held, which runs at once and every tick after.
+void control_start_task(void *ctx) {
+    App &app = *static_cast<App *>(ctx);
+    SensorReading reading;
+    if (!sensing_core_pop(reading)) {
+        app.scheduler->add_oneshot("start", 100, control_start_task, ctx);
+        return;
+    }
+    app.temp_c = reading.temp_c;
+    app.scheduler->reschedule(app.control_id, app.clock->now_us());
+}
+
+// Rebuilds the rollup from flash, held until the first control decision
+// so that the scan is not on its path. Until it is done the rollup is
+// empty and no minute samples are taken.
+void history_index_task(void *ctx) {
+    App &app = *static_cast<App *>(ctx);
+    app.rollup->rebuild(*app.history);
+    // History time carries on from the newest stored sample, so it keeps
+    // increasing across reboots.
+    if (!app.rollup->empty()) app.history_base_s = app.rollup->newest() + 60;
+    app.history_ready = true;
+    boot_mark(BootStage::history_index);
+    if (app.telemetry) {
+        send_boot(app);
+        app.boot_reported = true;
+    }
+}
+
+uint32_t history_now(const App &app) {
+    return app.history_base_s + uint32_t(app.clock->now_us() / 1'000'000);
+}
+
+// One sample a minute, in centi-degrees, into the compressed history and the
+// rollup. A chunk (a few hours of samples) is written to flash when it fills.
+void history_task(void *ctx) {
+    TRACE_SCOPE(task_history);
+    App &app = *static_cast<App *>(ctx);
+    if (!app.history_ready) return;
+    uint32_t t = history_now(app);
+    int16_t centi = int16_t(Numeric<real_t>::round(app.temp_c * 100));
+    app.history->append(t, centi);
+    app.rollup->add(t, centi);
+}
+
+// Lowest priority: erase the next sector before the log needs it, so the
+// multi-millisecond erase happens here and not inside a history append.
+void flash_maintenance_task(void *ctx) {
+    TRACE_SCOPE(task_flash);
+    static_cast<App *>(ctx)->log->prepare();
+}
+
+// Once a second, alternately start a conversion on every probe and collect
+// the results over DMA; the wait in between costs the CPU nothing.
+void probe_task(void *ctx) {
+    TRACE_SCOPE(task_probes);
+    App &app = *static_cast<App *>(ctx);
+    if (app.probes->step() && app.telemetry) send_probes(app);
+}
+
+#if THERMO_TRACE
+// New trace events, one block per record, while at least half the packet
+// queue is free: tracing loses its own events before it crowds out status
+// records. Each record fills a frame of its own.
+void send_trace(App &app) {
+    uint8_t block[telemetry::max_payload];
+    for (size_t core = 0; core < Tracer::cores; core++) {
+        while (app.telemetry->queued() < Telemetry::queue_packets / 2) {
+            const size_t len =
+                trace_read_block(tracer, core, app.trace_cursor[core], block, sizeof(block));
+            if (len == trace::block_header) break;
+            app.telemetry->record(telemetry::record_trace, block, len);
+            app.telemetry->flush();
+        }
+    }
+}
+#endif
+
+// Moves finished packets to USB as fast as the host takes them, and closes a
+// batch once its oldest record is a second old: at one status record a
+// second plus the probes, packets go out mostly full.
+void telemetry_task(void *ctx) {
+    TRACE_SCOPE(task_telemetry);
+    App &app = *static_cast<App *>(ctx);
+#if THERMO_TRACE
+    send_trace(app);
+#endif
+    app.telemetry->pump();
+}
+
+void mqtt_task(void *ctx) {
+    TRACE_SCOPE(task_mqtt);
+    static_cast<App *>(ctx)->mqtt->poll();
+}
+
+const char *mode_name(ControlMode mode) {
+    switch (mode) {
+    case ControlMode::hysteresis: return "hysteresis";
+    case ControlMode::pid: return "pid";
+    case ControlMode::mpc: return "mpc";
+    }
+    return "?";
+}
+
+// GET /api/status, for the configuration page.
+int status_json(void *ctx, const HttpRequest &request, JsonWriter &out) {
+    App &app = *static_cast<App *>(ctx);
+    if (request.method != HttpMethod::get && request.method != HttpMethod::head) return 405;
+    const ThermostatConfig &c = app.thermostat.config();
+    out.begin_object();
+    out.key("temp");
+    out.value_centi(Numeric<real_t>::round(app.temp_c * 100));
+    out.key("setpoint");
+    out.value_centi(Numeric<float>::round(c.setpoint_c * 100));
+    out.key("relay");
+    out.value(app.relay_on);
+    out.key("mode");
+    out.value(mode_name(c.mode));
+    out.key("uptime_s");
+    out.value(int32_t(app.clock->now_us() / 1'000'000));
+    out.key("drops");
+    out.value(int32_t(sensing_core_drops()));
+    out.end_object();
+    return 200;
+}
+
+// POST /api/setpoint?c=21.5 sets and stores the setpoint; GET reads it.
+int setpoint_json(void *ctx, const HttpRequest &request, JsonWriter &out) {
+    App &app = *static_cast<App *>(ctx);
+    if (request.method == HttpMethod::post) {
+        int32_t centi;
+        if (!request.param_centi("c", &centi) || centi < 500 || centi > 3000) {
+            out.begin_object();
+            out.key("error");
+            out.value("c must be 5.00 .. 30.00");
+            out.end_object();
+            return 400;
+        }
+        const float setpoint = float(centi) / 100;
+        app.thermostat.set_setpoint(setpoint);
+        // write_setting only stages the record: program it now, so the
+        // setpoint survives a power cut right after the reply.
+        app.log->write_setting(setting_setpoint, &setpoint, sizeof(setpoint));
+        app.log->flush();
+    } else if (request.method != HttpMethod::get && request.method != HttpMethod::head) {
+        return 405;
+    }
+    out.begin_object();
+    out.key("setpoint");
+    out.value_centi(Numeric<float>::round(app.thermostat.config().setpoint_c * 100));
+    out.end_object();
+    return 200;
+}
+
+void http_task(void *ctx) {
+    TRACE_SCOPE(task_http);
+    static_cast<App *>(ctx)->http->poll();
+}
+
+#if THERMO_PROFILE
+// Sends the histogram, five buckets a record, while the packet queue is at
+// least half free; sampling stays stopped until the last bucket is out.
+void send_profile(App &app) {
+    while (app.telemetry->queued() < Telemetry::queue_packets / 2) {
+        const bool first = app.profile_pos == 0;
+        uint8_t r[8 + 5 * 8];
+        put32(r, app.profile_id);
+        put32(r + 4, profile.samples());
+        size_t len = 8;
+        for (; app.profile_pos < ProfileHistogram::buckets && len < sizeof(r); app.profile_pos++) {
+            const ProfileHistogram::Bucket &b = profile.slot(app.profile_pos);
+            if (!b.key) continue;
+            put32(r + len, uint32_t(ProfileHistogram::address(b)));
+            put32(r + len + 4, b.count);
+            len += 8;
+        }
+        // An empty histogram still sends one record, so the dump shows up.
+        if (len > 8 || first) {
+            app.telemetry->record(telemetry::record_profile, r, len);
+        }
+        if (app.profile_pos == ProfileHistogram::buckets) {
+            app.profile_sending = false;
+            profile.clear();
+            profiler_start(THERMO_PROFILE_HZ);
+            return;
+        }
+    }
+}
+
+// A 'p' on the USB serial port (SIGUSR1 on the host) asks for the profile
+// collected since the last one. It goes out as telemetry records when there
+// is a telemetry stream, otherwise as text for tools/profile_report.py.
+void profile_task(void *ctx) {
+    App &app = *static_cast<App *>(ctx);
+#if PICO_ON_DEVICE
+    if (getchar_timeout_us(0) == 'p') profiler_request_dump();
+#endif
+    if (app.profile_sending) {
+        send_profile(app);
+        return;
+    }
+    if (!profiler_take_dump_request()) return;
+    profiler_stop();
+    if (app.telemetry) {
+        app.profile_sending = true;
+        app.profile_pos = 0;
+        app.profile_id = now_ms(app);
+        send_profile(app);
+        return;
+    }
+    profile_write(profile, stdout);
+    profile.clear();
+    profiler_start(THERMO_PROFILE_HZ);
+}
+#endif
+
+// "-12.3" from tenths, without floating-point printf.
+void format_tenths(char *out, size_t size, int tenths) {
+    const int mag = tenths < 0 ? -tenths : tenths;
+    snprintf(out, size, "%s%d.%d", tenths < 0 ? "-" : "", mag / 10, mag % 10);
+}
+
+int centi_to_tenths(int centi) {
+    return (centi + (centi < 0 ? -5 : 5)) / 10;
+}
+
+// Redraws every field each time; only the pixels that changed go to the
+// panel, so an unchanged screen costs no bus time at all.
+void display_task(void *ctx) {
+    TRACE_SCOPE(task_display);
+    App &app = *static_cast<App *>(ctx);
+    Display &d = *app.display;
+    if (!d.ready()) return;
+    char value[16];
+    char line[40];
+
+    format_tenths(value, sizeof(value),
+                  Numeric<float>::round(app.thermostat.config().setpoint_c * 10));
+    snprintf(line, sizeof(line), "SET %-5s", value);
+    d.text(0, 0, line, font_small);
+    d.text(Framebuffer::width - 4 * font_small.advance(), 0, app.relay_on ? "HEAT" : "IDLE",
+           font_small);
+
+    format_tenths(value, sizeof(value), Numeric<real_t>::round(app.temp_c * 10));
+    snprintf(line, sizeof(line), "%5s", value);
+    d.text(19, 14, line, font_large);
+
+    // The first two probes: "P0 20.1  P1 --"
+    int x = 0;
+    for (size_t i = 0; app.probes && i < app.probes->count() && i < 2; i++) {
+        if (app.probes->valid(i)) {
+            format_tenths(value, sizeof(value), (app.probes->raw(i) * 10 + 8) >> 4);
+        } else {
+            snprintf(value, sizeof(value), "--");
+        }
+        snprintf(line, sizeof(line), "P%u %-5s ", unsigned(i), value);
+        x = d.text(x, 42, line, font_small);
+    }
+
+    const uint32_t now = history_now(app);
+    const HistorySummary day = app.rollup->query(now > 86400 ? now - 86400 : 0, now);
+    if (day.count) {
+        char hi[16];
+        format_tenths(value, sizeof(value), centi_to_tenths(day.min));
+        format_tenths(hi, sizeof(hi), centi_to_tenths(day.max));
+        snprintf(line, sizeof(line), "24H %s..%s", value, hi);
+    } else {
+        snprintf(line, sizeof(line), "24H --");
+    }
+    // The line's length varies: blank whatever the previous one left over.
+    d.fill_rect(d.text(0, 56, line, font_small), 56, Framebuffer::width, 8, false);
+
+    d.present();
+}
+
+void status_task(void *ctx) {
+    TRACE_SCOPE(task_status);
+    App &app = *static_cast<App *>(ctx);
+    uint32_t now = history_now(app);
+    HistorySummary day = app.rollup->query(now > 86400 ? now - 86400 : 0, now);
+    printf("temp=%.2f set=%.2f relay=%d drops=%u 24h=%.2f..%.2f",
+           Numeric<real_t>::to_float(app.temp_c), app.thermostat.config().setpoint_c,
+           app.relay_on, unsigned(sensing_core_drops()), day.min / 100.0, day.max / 100.0);
+    for (size_t i = 0; app.probes && i < app.probes->count(); i++) {
+        if (app.probes->valid(i)) printf(" probe%u=%.2f", unsigned(i), app.probes->raw(i) / 16.0);
+    }
+    printf("\n");
+    if (!app.boot_reported && boot_time_us(BootStage::history_index)) {
+        boot_print();
+        app.boot_reported = true;
+    }
+}
+
+// Busy checks for the power manager: no clock switch mid-transfer.
+bool onewire_busy(void *ctx) {
+    return static_cast<const OneWireBus *>(ctx)->busy();
+}
+
+bool panel_busy(void *ctx) {
+    return static_cast<DisplayPort *>(ctx)->busy();
+}
+
+} // namespace
+
+Scheduler &app_init(Clock &clock, const AppConfig &config) {
+#if THERMO_TRACE
+    const bool crashed = trace_init();
+#endif
+    relay_init();
+    sensing_core_init();
+
+    FlashDevice *flash = config.flash;
+    if (!flash) {
+#if PICO_ON_DEVICE
+        flash = storage_arena.create<PicoFlash>(PICO_FLASH_SIZE_BYTES - THERMO_FLASH_LOG_BYTES,
+                                                THERMO_FLASH_LOG_BYTES);
+#else
+        static FileFlash host_flash("thermostat_flash.bin", THERMO_FLASH_LOG_BYTES);
+        flash = &host_flash;
+#endif
+    }
+    FlashLog *log = storage_arena.create<FlashLog>(*flash);
+    log->mount();
+    boot_mark(BootStage::flash_mount);
+#if THERMO_TRACE
+    // The last run ended in a fault: keep its trace before recording anew.
+    if (crashed) trace_dump(tracer, *log);
+    trace_start();
+#endif
+
+    App *app = control_arena.create<App>();
+    app->clock = &clock;
+    app->log = log;
+    app->history = storage_arena.create<HistoryStore>(*log);
+    app->rollup = history_arena.create<RollupIndex>();
+    float setpoint;
+    if (log->read_setting(setting_setpoint, &setpoint, sizeof(setpoint)) == sizeof(setpoint)) {
+        app->thermostat.set_setpoint(setpoint);
+    }
+    app->mpc = config.mpc;
+    float gains[3];
+    float model[3];
+    if (log->read_setting(setting_pid_gains, gains, sizeof(gains)) == sizeof(gains)) {
+        app->thermostat.set_gains(gains[0], gains[1], gains[2]);
+        app->thermostat.set_mode(ControlMode::pid);
+        if (log->read_setting(setting_room_model, model, sizeof(model)) == sizeof(model)) {
+            app->thermostat.set_model(model[0], model[1], model[2]);
+            if (config.mpc) app->thermostat.set_mode(ControlMode::mpc);
+        }
+    } else if (config.autotune) {
+        // Until it settles (a few oscillations, hours in a slow house) the
+        // tuner runs the relay itself; the gains are stored when it is done.
+        app->thermostat.start_autotune();
+    }
+    boot_mark(BootStage::settings);
+
+    OneWireBus *onewire = bus_arena.create<OneWireBus>();
+    onewire->init(THERMO_ONEWIRE_GPIO);
+    Ds18b20Array *probes = bus_arena.create<Ds18b20Array>(*onewire);
+    if (probes->enumerate()) app->probes = probes;
+    boot_mark(BootStage::probes);
+
+#if PICO_ON_DEVICE
+    Ssd1306Port *panel = display_arena.create<Ssd1306Port>();
+    panel->init(THERMO_DISPLAY_SPI, THERMO_DISPLAY_SCK_GPIO, THERMO_DISPLAY_MOSI_GPIO,
+                THERMO_DISPLAY_CS_GPIO, THERMO_DISPLAY_DC_GPIO, THERMO_DISPLAY_RESET_GPIO,
+                THERMO_DISPLAY_BAUD);
+#else
+    static MemoryDisplayPort host_panel(clock, THERMO_DISPLAY_BAUD);
+    MemoryDisplayPort *panel = &host_panel;
+#endif
+    Framebuffer *first = display_arena.create<Framebuffer>();
+    Framebuffer *second = nullptr;
+    if (THERMO_DISPLAY_DOUBLE_BUFFER) second = display_arena.create<Framebuffer>();
+    app->display = display_arena.create<Display>(*panel, *first, second);
+    boot_mark(BootStage::display);
+
+    if (config.telemetry) {
+        app->telemetry = telemetry_arena.create<Telemetry>(*config.telemetry, clock, 1'000'000);
+    }
+
+    if (config.mqtt) {
+        const MqttConfig mqtt = config.mqtt_config ? *config.mqtt_config : MqttConfig{};
+        app->mqtt = network_arena.create<MqttClient>(*config.mqtt, clock, mqtt);
+    }
+    if (config.http) {
+        app->http = network_arena.create<HttpServer>(*config.http);
+        app->http->add_json("/api/status", status_json, app);
+        app->http->add_json("/api/setpoint", setpoint_json, app);
+    }
+
+    Clock *waits = &clock;
+    if (config.power) {
+        PowerManager *power = control_arena.create<PowerManager>(clock, *config.power);
+        // USB and the Wi-Fi chip need their clocks between tasks: with
+        // either in use, only clk_sys slows down.
+        const bool usb = config.status_output || config.telemetry;
+        if (usb || config.mqtt || config.http) power->set_deepest(PowerState::slow);
+        // A sensor bus driver, when one lands, adds its queue here too:
+        // power->add_busy_check(BusQueue::busy, queue).
+        power->add_busy_check(onewire_busy, onewire);
+        power->add_busy_check(panel_busy, panel);
+        waits = power;
+    }
+    Scheduler *scheduler = control_arena.create<Scheduler>(*waits);
+    app->scheduler = scheduler;
+    app->tick_us = uint32_t(app->thermostat.config().tick_s * 1e6f);
+    // Registration order is the tie-break priority: control first, held
+    // until its starter sees the first reading.
+    app->control_id = scheduler->add_periodic("control", app->tick_us, control_task, app);
+    scheduler->reschedule(app->control_id, Scheduler::never);
+    scheduler->add_oneshot("start", 0, control_start_task, app);
+    app->history_index_id = scheduler->add_oneshot("history index", 0, history_index_task, app);
+    scheduler->reschedule(app->history_index_id, Scheduler::never);
+    if (config.status_output) {
+        scheduler->add_periodic("status", 5'000'000, status_task, app, 500'000);
+    }
+    scheduler->add_periodic("history", 60'000'000, history_task, app, 1'000'000);
+    scheduler->add_periodic("flash", 10'000'000, flash_maintenance_task, app, 2'000'000);
+    if (app->probes) scheduler->add_periodic("probes", 1'000'000, probe_task, app, 250'000);
+    scheduler->add_periodic("display", 1'000'000, display_task, app, 100'000);
+    if (app->telemetry) {
+        scheduler->add_periodic("telemetry", 500'000, telemetry_task, app, 300'000);
+    }
+    if (app->mqtt) scheduler->add_periodic("mqtt", 50'000, mqtt_task, app, 40'000);
+    if (app->http) scheduler->add_periodic("http", 20'000, http_task, app, 15'000);
+#if THERMO_PROFILE
+    scheduler->add_periodic("profile", 200'000, profile_task, app, 150'000);
+#endif
+    boot_mark(BootStage::scheduler);
+    return *scheduler;
+}
+
+void app_start() {
+    sensing_core_start();
+    arena_seal_all();
+#if THERMO_PROFILE
+    profiler_start(THERMO_PROFILE_HZ);
+#endif
+}
+
+} // namespace thermo
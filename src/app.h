@@ -0,0 +1,36 @@
+// Firmware composition: allocates every subsystem from its arena and
+// registers the core 0 tasks. Shared by main() and the host benchmarks so
+// both run exactly the same init sequence.
+#pragma once
+
+#include "scheduler.h"
+
+namespace thermo {
+
+class FlashDevice;
+class HttpTransport;
+class MqttTransport;
+class PowerPort;
+class TelemetrySink;
+struct MqttConfig;
+
+struct AppConfig {
+    bool status_output = true;          // periodic status line on stdio
+    FlashDevice *flash = nullptr;       // log storage; null for the platform default
+    TelemetrySink *telemetry = nullptr; // binary telemetry stream; null for none
+    MqttTransport *mqtt = nullptr;      // readings to the building system; null for none
+    const MqttConfig *mqtt_config = nullptr;  // topic, batching; null for the defaults
+    HttpTransport *http = nullptr;      // configuration page; null for none
+    PowerPort *power = nullptr;         // low-power waits between tasks; null to idle
+    bool autotune = false;              // tune PID at boot unless tuned gains are stored
+    bool mpc = false;                   // control by MPC once autotune has a room model
+};
+
+/// Bring up every subsystem and register the core 0 tasks. Does not start
+/// core 1 and does not seal the arenas; see app_start().
+Scheduler &app_init(Clock &clock, const AppConfig &config = {});
+
+/// Launch core 1 and seal the arenas: from here on nothing allocates.
+void app_start();
+
+} // namespace thermo
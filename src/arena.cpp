@@ -0,0 +1,35 @@
+#include "arena.h"
+
+#include "pico/stdlib.h"
+
+namespace thermo {
+
+static Arena *arena_list;
+
+Arena::Arena(const char *name, uint8_t *base, size_t capacity)
+    : name_(name), base_(base), capacity_(capacity), next_(arena_list) {
+    arena_list = this;
+}
+
+Arena *Arena::first() {
+    return arena_list;
+}
+
+void *Arena::allocate(size_t bytes, size_t align) {
+    if (sealed_) panic("arena %s: allocation of %u bytes after init", name_, unsigned(bytes));
+    uintptr_t start = (reinterpret_cast<uintptr_t>(base_) + used_ + align - 1) & ~uintptr_t(align - 1);
+    size_t end = start - reinterpret_cast<uintptr_t>(base_) + bytes;
+    if (end > capacity_) {
+        panic("arena %s: %u bytes needed, %u of %u used", name_, unsigned(bytes), unsigned(used_),
+              unsigned(capacity_));
+    }
+    used_ = end;
+    allocations_++;
+    return reinterpret_cast<void *>(start);
+}
+
+void arena_seal_all() {
+    for (Arena *a = arena_list; a; a = a->next()) a->seal();
+}
+
+} // namespace thermo
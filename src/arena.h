@@ -0,0 +1,124 @@
+// Static memory model: every subsystem draws its storage at init time from a
+// statically sized arena, and nothing allocates once the system is running.
+//
+// THERMO_ARENA(name, bytes) reserves zero-initialised storage in its own
+// linker input section (.bss.ram_<name>) so tools/ram_report.py can attribute
+// RAM per subsystem from the link map. Arenas register themselves in a list;
+// arena_seal_all() marks the end of init, after which any allocation panics.
+//
+// BlockPool hands out fixed-size blocks from arena storage with an O(1) free
+// list, for things that come and go at run time (buffers, records).
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include "memory_config.h"
+
+namespace thermo {
+
+class Arena {
+public:
+    Arena(const char *name, uint8_t *base, size_t capacity);
+
+    /// Aligned bump allocation. Panics if the arena is sealed or too small:
+    /// both are configuration errors that must show up on the first boot.
+    void *allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+
+    template <typename T, typename... Args>
+    T *create(Args &&...args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    T *create_array(size_t count) {
+        T *p = static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+        for (size_t i = 0; i < count; i++) new (p + i) T();
+        return p;
+    }
+
+    void seal() { sealed_ = true; }
+    bool sealed() const { return sealed_; }
+    const char *name() const { return name_; }
+    size_t used() const { return used_; }
+    size_t capacity() const { return capacity_; }
+    uint32_t allocations() const { return allocations_; }
+    Arena *next() const { return next_; }
+
+    static Arena *first();
+
+private:
+    const char *name_;
+    uint8_t *base_;
+    size_t capacity_;
+    size_t used_ = 0;
+    uint32_t allocations_ = 0;
+    bool sealed_ = false;
+    Arena *next_;
+};
+
+/// End of init: seal every registered arena.
+void arena_seal_all();
+
+#define THERMO_ARENA(name, bytes)                                                  \
+    alignas(8) static uint8_t arena_storage_##name[(bytes)]                        \
+        __attribute__((section(".bss.ram_" #name)));                               \
+    static ::thermo::Arena name##_arena(#name, arena_storage_##name, (bytes))
+
+template <typename T>
+class BlockPool {
+public:
+    /// Carve `count` blocks out of `arena`. Call once, during init.
+    void init(Arena &arena, size_t count) {
+        blocks_ = static_cast<Block *>(arena.allocate(sizeof(Block) * count, alignof(Block)));
+        capacity_ = count;
+        free_ = nullptr;
+        for (size_t i = count; i-- > 0;) {
+            blocks_[i].next = free_;
+            free_ = &blocks_[i];
+        }
+        in_use_ = 0;
+        peak_ = 0;
+    }
+
+    /// Uninitialised storage for one T, or nullptr when the pool is empty.
+    T *allocate() {
+        Block *b = free_;
+        if (!b) {
+            exhausted_++;
+            return nullptr;
+        }
+        free_ = b->next;
+        if (++in_use_ > peak_) peak_ = in_use_;
+        return reinterpret_cast<T *>(b->storage);
+    }
+
+    void release(T *item) {
+        Block *b = reinterpret_cast<Block *>(item);
+        b->next = free_;
+        free_ = b;
+        in_use_--;
+    }
+
+    size_t capacity() const { return capacity_; }
+    size_t in_use() const { return in_use_; }
+    size_t peak() const { return peak_; }
+    uint32_t exhausted() const { return exhausted_; }
+
+private:
+    union Block {
+        Block *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    Block *blocks_ = nullptr;
+    Block *free_ = nullptr;
+    size_t capacity_ = 0;
+    size_t in_use_ = 0;
+    size_t peak_ = 0;
+    uint32_t exhausted_ = 0;
+};
+
+} // namespace thermo
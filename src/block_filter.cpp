@@ -0,0 +1,299 @@
+#include "block_filter.h"
+
+#include <cstring>
+
+#include "memory_config.h"
+
+#if THERMO_FILTER_SIMD
+#include <emmintrin.h>
+#endif
+
+namespace thermo {
+
+namespace filter_kernels {
+
+static constexpr unsigned log2_factor(unsigned factor) {
+    return factor >= 16 ? 4 : factor >= 8 ? 3 : factor >= 4 ? 2 : factor >= 2 ? 1 : 0;
+}
+
+// Scales a sum of 2^k raw samples to counts x 8.
+static inline uint32_t scale_sum(uint32_t sum, unsigned k) {
+    return k <= filter_frac_bits ? sum << (filter_frac_bits - k) : sum >> (k - filter_frac_bits);
+}
+
+static inline uint16_t min16(uint16_t a, uint16_t b) { return a < b ? a : b; }
+static inline uint16_t max16(uint16_t a, uint16_t b) { return a < b ? b : a; }
+
+static inline uint16_t med3(uint16_t a, uint16_t b, uint16_t c) {
+    return max16(min16(a, b), min16(max16(a, b), c));
+}
+
+// Median of five as two pairwise min/max reductions and a median of three.
+static inline uint16_t med5(uint16_t a, uint16_t b, uint16_t c, uint16_t d, uint16_t e) {
+    uint16_t f = max16(min16(a, b), min16(c, d));
+    uint16_t g = min16(max16(a, b), max16(c, d));
+    return med3(e, f, g);
+}
+
+static inline uint16_t median_at(const uint16_t *x, size_t i, unsigned taps) {
+    return taps == 5 ? med5(x[i - 4], x[i - 3], x[i - 2], x[i - 1], x[i])
+                     : med3(x[i - 2], x[i - 1], x[i]);
+}
+
+size_t decimate_scalar(uint16_t *data, size_t n, unsigned factor) {
+    unsigned k = log2_factor(factor);
+    size_t out = n >> k;
+    for (size_t o = 0; o < out; o++) {
+        uint32_t sum = 0;
+        for (size_t j = 0; j < (size_t(1) << k); j++) sum += data[(o << k) + j];
+        data[o] = uint16_t(scale_sum(sum, k));
+    }
+    return out;
+}
+
+void median_scalar(uint16_t *data, size_t n, unsigned taps) {
+    for (size_t i = n; i-- > taps - 1;) data[i] = median_at(data, i, taps);
+}
+
+// --- SWAR: two 16-bit lanes per 32-bit word -------------------------------
+
+static inline uint32_t swar_med3(uint32_t a, uint32_t b, uint32_t c) {
+    return swar_max(swar_min(a, b), swar_min(swar_max(a, b), c));
+}
+
+static inline uint32_t swar_med5(uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e) {
+    uint32_t f = swar_max(swar_min(a, b), swar_min(c, d));
+    uint32_t g = swar_min(swar_max(a, b), swar_max(c, d));
+    return swar_med3(e, f, g);
+}
+
+static inline bool word_aligned(const void *p) {
+    return (reinterpret_cast<uintptr_t>(p) & 3) == 0;
+}
+
+size_t THERMO_HOT(decimate_swar)(uint16_t *data, size_t n, unsigned factor) {
+    if (!word_aligned(data)) return decimate_scalar(data, n, factor);
+    unsigned k = log2_factor(factor);
+    const uint32_t *words = reinterpret_cast<const uint32_t *>(data);
+    if (k == 0) {
+        // 12-bit lanes shifted by 3 stay inside their 16 bits.
+        uint32_t *w = reinterpret_cast<uint32_t *>(data);
+        for (size_t i = 0; i < n / 2; i++) w[i] <<= filter_frac_bits;
+        if (n & 1) data[n - 1] <<= filter_frac_bits;
+        return n;
+    }
+    size_t out = n >> k;
+    size_t words_per_out = size_t(1) << (k - 1);
+    for (size_t o = 0; o < out; o++) {
+        // Up to 8 words: each lane sums at most 8 12-bit samples (< 2^15).
+        uint32_t acc = 0;
+        const uint32_t *w = words + o * words_per_out;
+        for (size_t j = 0; j < words_per_out; j++) acc += w[j];
+        data[o] = uint16_t(scale_sum((acc & 0xffffu) + (acc >> 16), k));
+    }
+    return out;
+}
+
+void THERMO_HOT(median_swar)(uint16_t *data, size_t n, unsigned taps) {
+    if (!word_aligned(data) || n < taps + 1) {
+        median_scalar(data, n, taps);
+        return;
+    }
+    // Output pairs (i, i + 1) start at even i, so every lane window is built
+    // from aligned word loads plus a shift to form the odd-offset words.
+    // Work from the end so each pair still sees unfiltered history.
+    const size_t first = taps - 1;  // 2 or 4, even
+    size_t end = n;
+    if ((n - first) & 1) {
+        data[n - 1] = median_at(data, n - 1, taps);
+        end = n - 1;
+    }
+    uint32_t *w = reinterpret_cast<uint32_t *>(data);
+    for (size_t i = end - 2;; i -= 2) {
+        uint32_t c = w[i / 2];
+        uint32_t b = w[i / 2 - 1];
+        uint32_t bc = (b >> 16) | (c << 16);
+        if (taps == 5) {
+            uint32_t a = w[i / 2 - 2];
+            uint32_t ab = (a >> 16) | (b << 16);
+            w[i / 2] = swar_med5(a, ab, b, bc, c);
+        } else {
+            w[i / 2] = swar_med3(b, bc, c);
+        }
+        if (i == first) break;
+    }
+}
+
+// --- SSE2: eight 16-bit lanes ---------------------------------------------
+
+#if THERMO_FILTER_SIMD
+
+// Eight outputs per iteration from 8 << K inputs. K is a template parameter
+// so the reduction tree is fully unrolled.
+template <unsigned K>
+static size_t decimate_simd_k(uint16_t *data, size_t n) {
+    const __m128i ones = _mm_set1_epi16(1);
+    constexpr size_t per_chunk = size_t(8) << K;
+    const size_t chunks = n / per_chunk;
+
+    for (size_t c = 0; c < chunks; c++) {
+        __m128i v[size_t(1) << K];
+        const uint16_t *src = data + c * per_chunk;
+        for (size_t j = 0; j < (size_t(1) << K); j++) {
+            v[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 8 * j));
+        }
+        // Each level sums adjacent pairs: madd against ones widens to 32
+        // bits, packs narrows back. Inputs stay below 2^15 until the last
+        // level of a 16:1 decimation, which is pre-shifted before packing.
+        size_t count = size_t(1) << K;
+        for (unsigned level = 1; level <= K; level++) {
+            count /= 2;
+            for (size_t j = 0; j < count; j++) {
+                __m128i lo = _mm_madd_epi16(v[2 * j], ones);
+                __m128i hi = _mm_madd_epi16(v[2 * j + 1], ones);
+                if (level == 4) {
+                    lo = _mm_srli_epi32(lo, 4 - filter_frac_bits);
+                    hi = _mm_srli_epi32(hi, 4 - filter_frac_bits);
+                }
+                v[j] = _mm_packs_epi32(lo, hi);
+            }
+        }
+        __m128i out = K < filter_frac_bits ? _mm_slli_epi16(v[0], filter_frac_bits - K) : v[0];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + 8 * c), out);
+    }
+
+    // Tail: fewer than 8 outputs left.
+    size_t done_in = chunks * per_chunk;
+    size_t done_out = chunks * 8;
+    size_t rest = decimate_scalar(data + done_in, n - done_in, 1u << K);
+    memmove(data + done_out, data + done_in, rest * sizeof(uint16_t));
+    return done_out + rest;
+}
+
+size_t decimate_simd(uint16_t *data, size_t n, unsigned factor) {
+    switch (log2_factor(factor)) {
+    case 0: return decimate_simd_k<0>(data, n);
+    case 1: return decimate_simd_k<1>(data, n);
+    case 2: return decimate_simd_k<2>(data, n);
+    case 3: return decimate_simd_k<3>(data, n);
+    default: return decimate_simd_k<4>(data, n);
+    }
+}
+
+static inline __m128i load8(const uint16_t *p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+void median_simd(uint16_t *data, size_t n, unsigned taps) {
+    const size_t first = taps - 1;
+    if (n < first + 8) {
+        median_scalar(data, n, taps);
+        return;
+    }
+    // Vectors cover [i, i + 8) from the top down; whatever is left between
+    // `first` and the lowest vector is finished in scalar, also top down.
+    size_t i = n - 8;
+    for (;;) {
+        __m128i e = load8(data + i), d = load8(data + i - 1), c = load8(data + i - 2);
+        __m128i r;
+        if (taps == 5) {
+            __m128i b = load8(data + i - 3), a = load8(data + i - 4);
+            __m128i f = _mm_max_epi16(_mm_min_epi16(a, b), _mm_min_epi16(c, d));
+            __m128i g = _mm_min_epi16(_mm_max_epi16(a, b), _mm_max_epi16(c, d));
+            r = _mm_max_epi16(_mm_min_epi16(e, f), _mm_min_epi16(_mm_max_epi16(e, f), g));
+        } else {
+            r = _mm_max_epi16(_mm_min_epi16(c, d), _mm_min_epi16(_mm_max_epi16(c, d), e));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), r);
+        if (i < first + 8) break;
+        i -= 8;
+    }
+    for (size_t j = i; j-- > first;) data[j] = median_at(data, j, taps);
+}
+
+size_t decimate(uint16_t *data, size_t n, unsigned factor) {
+    return decimate_simd(data, n, factor);
+}
+
+void median(uint16_t *data, size_t n, unsigned taps) {
+    median_simd(data, n, taps);
+}
+
+#else
+
+size_t THERMO_HOT(decimate)(uint16_t *data, size_t n, unsigned factor) {
+    return decimate_swar(data, n, factor);
+}
+
+void THERMO_HOT(median)(uint16_t *data, size_t n, unsigned taps) {
+    median_swar(data, n, taps);
+}
+
+#endif
+
+} // namespace filter_kernels
+
+size_t THERMO_HOT(DecimateStage::process)(uint16_t *data, size_t n) {
+    return filter_kernels::decimate(data, n, factor_);
+}
+
+size_t THERMO_HOT(IirStage::process)(uint16_t *data, size_t n) {
+    if (n && !primed_) {
+        state_ = int32_t(data[0]) << 8;
+        primed_ = true;
+    }
+    int32_t s = state_;
+    for (size_t i = 0; i < n; i++) {
+        s += ((int32_t(data[i]) << 8) - s) >> shift_;
+        data[i] = uint16_t((s + 0x80) >> 8);
+    }
+    state_ = s;
+    return n;
+}
+
+size_t THERMO_HOT(MedianStage::process)(uint16_t *data, size_t n) {
+    const size_t hist = taps_ - 1;
+    if (!n) return 0;
+    if (!primed_) {
+        for (size_t j = 0; j < hist; j++) history_[j] = data[0];
+        primed_ = true;
+    }
+    if (n < hist) {
+        // Too short to carry its own history: filter through a window.
+        uint16_t window[8];
+        memcpy(window, history_, hist * sizeof(uint16_t));
+        memcpy(window + hist, data, n * sizeof(uint16_t));
+        for (size_t i = 0; i < n; i++) data[i] = filter_kernels::median_at(window, hist + i, taps_);
+        memcpy(history_, window + n, hist * sizeof(uint16_t));
+        return n;
+    }
+
+    // The first `hist` outputs need the previous block's tail; compute them
+    // before the kernel overwrites anything, then save this block's tail.
+    uint16_t head[4];
+    uint16_t window[8];
+    memcpy(window, history_, hist * sizeof(uint16_t));
+    memcpy(window + hist, data, hist * sizeof(uint16_t));
+    for (size_t i = 0; i < hist; i++) head[i] = filter_kernels::median_at(window, hist + i, taps_);
+    memcpy(history_, data + n - hist, hist * sizeof(uint16_t));
+
+    filter_kernels::median(data, n, taps_);
+    memcpy(data, head, hist * sizeof(uint16_t));
+    return n;
+}
+
+FilterChain &FilterChain::add(FilterStage &stage) {
+    if (count_ < max_stages) stages_[count_++] = &stage;
+    return *this;
+}
+
+size_t THERMO_HOT(FilterChain::process)(uint16_t *data, size_t n) {
+    for (size_t i = 0; i < count_; i++) n = stages_[i]->process(data, n);
+    return n;
+}
+
+void FilterChain::reset() {
+    for (size_t i = 0; i < count_; i++) stages_[i]->reset();
+}
+
+} // namespace thermo
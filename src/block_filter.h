@@ -0,0 +1,127 @@
+// Block filter stages for ADC data: oversampling decimation, first-order IIR
+// and a median-of-N spike rejector, composable into a FilterChain.
+//
+// All stages work in place on 16-bit samples in "counts x 8" (12-bit ADC
+// reading with three fractional bits), which keeps every value below 0x8000.
+// That headroom is what lets the kernels treat two samples as one 32-bit word
+// on the Cortex-M0+ (SWAR: lanes never carry into each other, and a lane's
+// top bit can be borrowed for comparisons), and use signed 16-bit SIMD
+// min/max on the host.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace thermo {
+
+/// Samples are raw counts << filter_frac_bits after the decimation stage.
+constexpr unsigned filter_frac_bits = 3;
+
+class FilterStage {
+public:
+    /// Filter n samples in place; returns the number of output samples.
+    virtual size_t process(uint16_t *data, size_t n) = 0;
+    virtual void reset() {}
+
+protected:
+    // Stages are never deleted through the base; a non-virtual destructor
+    // keeps operator delete out of the firmware image.
+    ~FilterStage() = default;
+};
+
+/// Sums every `factor` raw 12-bit samples into one counts x 8 sample.
+/// factor must be 1, 2, 4, 8 or 16 and divide the block length.
+class DecimateStage final : public FilterStage {
+public:
+    explicit DecimateStage(unsigned factor) : factor_(factor) {}
+    size_t process(uint16_t *data, size_t n) override;
+
+private:
+    unsigned factor_;
+};
+
+/// y += (x - y) / 2^shift, with eight extra bits of state precision.
+class IirStage final : public FilterStage {
+public:
+    explicit IirStage(unsigned shift) : shift_(shift) {}
+    size_t process(uint16_t *data, size_t n) override;
+    void reset() override { primed_ = false; }
+
+private:
+    unsigned shift_;
+    int32_t state_ = 0;
+    bool primed_ = false;
+};
+
+/// Causal median over the last 3 or 5 samples; history spans block edges.
+class MedianStage final : public FilterStage {
+public:
+    explicit MedianStage(unsigned taps) : taps_(taps == 5 ? 5 : 3) {}
+    size_t process(uint16_t *data, size_t n) override;
+    void reset() override { primed_ = false; }
+
+private:
+    unsigned taps_;
+    uint16_t history_[4] = {};
+    bool primed_ = false;
+};
+
+/// Runs stages in the order they were added.
+class FilterChain {
+public:
+    static constexpr size_t max_stages = 4;
+
+    FilterChain &add(FilterStage &stage);
+    size_t process(uint16_t *data, size_t n);
+    void reset();
+
+private:
+    FilterStage *stages_[max_stages] = {};
+    size_t count_ = 0;
+};
+
+/// Raw kernels, one per implementation, so benchmarks can compare them. The
+/// unsuffixed versions pick the fastest available for the build.
+namespace filter_kernels {
+
+size_t decimate_scalar(uint16_t *data, size_t n, unsigned factor);
+size_t decimate_swar(uint16_t *data, size_t n, unsigned factor);
+// out[i] = median(in[i - taps + 1 .. i]) for i >= taps - 1, in place.
+void median_scalar(uint16_t *data, size_t n, unsigned taps);
+void median_swar(uint16_t *data, size_t n, unsigned taps);
+
+#if defined(__SSE2__)
+#define THERMO_FILTER_SIMD 1
+size_t decimate_simd(uint16_t *data, size_t n, unsigned factor);
+void median_simd(uint16_t *data, size_t n, unsigned taps);
+#else
+#define THERMO_FILTER_SIMD 0
+#endif
+
+size_t decimate(uint16_t *data, size_t n, unsigned factor);
+void median(uint16_t *data, size_t n, unsigned taps);
+
+// SWAR lane operations: two samples per 32-bit word, each below 0x8000.
+constexpr uint32_t lane_top = 0x80008000u;
+
+/// 0xffff in each lane where a >= b. Setting the top bit first means the
+/// subtraction can never borrow across lanes, and the bit survives exactly
+/// when a - b >= 0.
+inline uint32_t swar_ge(uint32_t a, uint32_t b) {
+    uint32_t ge = (((a | lane_top) - b) & lane_top) >> 15;
+    return ge * 0xffffu;
+}
+
+/// Lane-wise minimum: b where a >= b, else a.
+inline uint32_t swar_min(uint32_t a, uint32_t b) {
+    return a ^ ((a ^ b) & swar_ge(a, b));
+}
+
+/// Lane-wise maximum: a where a >= b, else b.
+inline uint32_t swar_max(uint32_t a, uint32_t b) {
+    return b ^ ((a ^ b) & swar_ge(a, b));
+}
+
+} // namespace filter_kernels
+
+} // namespace thermo
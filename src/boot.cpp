@@ -0,0 +1,59 @@
+#include "boot.h"
+
+#include <atomic>
+#include <cstdio>
+
+#include "pico/stdlib.h"
+
+namespace thermo {
+
+static std::atomic<uint32_t> marks[size_t(BootStage::count)];
+
+#if PICO_ON_DEVICE
+static constexpr uint64_t origin_us = 0;  // the timer starts at reset
+#else
+static uint64_t origin_us = time_us_64();
+#endif
+
+void boot_mark(BootStage stage) {
+    std::atomic<uint32_t> &m = marks[size_t(stage)];
+    if (m.load(std::memory_order_relaxed)) return;
+    // 0 means "not yet", so a stage done within the first microsecond is 1.
+    const uint32_t t = uint32_t(time_us_64() - origin_us);
+    m.store(t ? t : 1, std::memory_order_relaxed);
+}
+
+uint32_t boot_time_us(BootStage stage) {
+    return marks[size_t(stage)].load(std::memory_order_relaxed);
+}
+
+const char *boot_stage_name(BootStage stage) {
+    static const char *const names[] = {
+#define THERMO_BOOT_NAME(name) #name,
+        THERMO_BOOT_STAGES(THERMO_BOOT_NAME)
+#undef THERMO_BOOT_NAME
+    };
+    return size_t(stage) < size_t(BootStage::count) ? names[size_t(stage)] : nullptr;
+}
+
+void boot_print() {
+    uint32_t prev = 0;
+    for (size_t i = 0; i < size_t(BootStage::count); i++) {
+        const uint32_t t = boot_time_us(BootStage(i));
+        if (!t) continue;
+        printf("boot %-14s %9.3f ms  +%.3f\n", boot_stage_name(BootStage(i)), t / 1e3,
+               int32_t(t - prev) / 1e3);
+        prev = t;
+    }
+}
+
+#if !PICO_ON_DEVICE
+
+void boot_restart() {
+    origin_us = time_us_64();
+    for (std::atomic<uint32_t> &m : marks) m.store(0, std::memory_order_relaxed);
+}
+
+#endif
+
+} // namespace thermo
@@ -0,0 +1,59 @@
+// Boot timeline: when each init stage was done, in microseconds from
+// power-on, up to the first control decision on a real reading and the
+// history index rebuilt behind it.
+//
+// On the device the timer starts counting at reset, so time_us_32() already
+// runs from power-on: the first mark, at main(), includes the bootrom, boot2
+// and the runtime's own init. The host has no reset; its timeline starts
+// with the process, or again at boot_restart().
+//
+// A mark is one 32-bit store and only the first one for a stage counts, so
+// marks can stay in the control task and be set from either core. Once the
+// last stage is done, the timeline goes out as a telemetry record or,
+// without telemetry, after the next status line; bench_boot checks it on
+// the host.
+#pragma once
+
+#include <cstdint>
+
+namespace thermo {
+
+// Every stage, in the order they complete.
+#define THERMO_BOOT_STAGES(X) \
+    X(main)                   \
+    X(stdio)                  \
+    X(network)                \
+    X(flash_mount)            \
+    X(settings)               \
+    X(probes)                 \
+    X(display)                \
+    X(scheduler)              \
+    X(core1)                  \
+    X(first_reading)          \
+    X(first_control)          \
+    X(history_index)
+
+enum class BootStage : uint8_t {
+#define THERMO_BOOT_ENUM(name) name,
+    THERMO_BOOT_STAGES(THERMO_BOOT_ENUM)
+#undef THERMO_BOOT_ENUM
+    count
+};
+
+/// Record that `stage` is done, unless it already was.
+void boot_mark(BootStage stage);
+
+/// Microseconds from power-on to `stage`, or 0 if it has not been reached.
+uint32_t boot_time_us(BootStage stage);
+
+const char *boot_stage_name(BootStage stage);
+
+/// The stages reached so far, one line each, on stdio.
+void boot_print();
+
+#if !PICO_ON_DEVICE
+/// Host build only: forget every mark and count from now, as at power-on.
+void boot_restart();
+#endif
+
+} // namespace thermo
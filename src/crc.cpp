@@ -0,0 +1,46 @@
+#include "crc.h"
+
+namespace thermo {
+
+uint16_t crc16_ccitt(const void *data, size_t len, uint16_t crc) {
+    static constexpr uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+        0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+    };
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < len; i++) {
+        crc = uint16_t((crc << 4) ^ table[(crc >> 12) ^ (p[i] >> 4)]);
+        crc = uint16_t((crc << 4) ^ table[(crc >> 12) ^ (p[i] & 0x0f)]);
+    }
+    return crc;
+}
+
+uint8_t crc8_maxim(const void *data, size_t len, uint8_t crc) {
+    static constexpr uint8_t table[16] = {
+        0x00, 0x9d, 0x23, 0xbe, 0x46, 0xdb, 0x65, 0xf8,
+        0x8c, 0x11, 0xaf, 0x32, 0xca, 0x57, 0xe9, 0x74,
+    };
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < len; i++) {
+        crc = uint8_t((crc >> 4) ^ table[(crc ^ p[i]) & 0x0f]);
+        crc = uint8_t((crc >> 4) ^ table[(crc ^ (p[i] >> 4)) & 0x0f]);
+    }
+    return crc;
+}
+
+uint32_t crc32(const void *data, size_t len, uint32_t crc) {
+    static constexpr uint32_t table[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4,
+        0x4db26158, 0x5005713c, 0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+        0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc >> 4) ^ table[(crc ^ p[i]) & 0x0f];
+        crc = (crc >> 4) ^ table[(crc ^ (p[i] >> 4)) & 0x0f];
+    }
+    return ~crc;
+}
+
+} // namespace thermo
@@ -0,0 +1,23 @@
+// CRCs for on-flash and on-wire integrity checks. All use a 16-entry
+// nibble table: 16 to 64 bytes of flash each, and fast enough on the M0+ for
+// page-sized buffers.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace thermo {
+
+/// CRC-16/CCITT-FALSE (poly 0x1021, init 0xffff). Pass a previous result as
+/// `crc` to continue over several buffers.
+uint16_t crc16_ccitt(const void *data, size_t len, uint16_t crc = 0xffff);
+
+/// CRC-8/MAXIM (Dallas 1-Wire: poly 0x31 reflected, init 0). A ROM code or
+/// scratchpad including its trailing CRC byte checks to 0.
+uint8_t crc8_maxim(const void *data, size_t len, uint8_t crc = 0);
+
+/// CRC-32 (IEEE 802.3, reflected, as used by zlib). Chain by passing the
+/// previous result.
+uint32_t crc32(const void *data, size_t len, uint32_t crc = 0);
+
+} // namespace thermo
@@ -0,0 +1,245 @@
+#include "display.h"
+
+#include <cstring>
+
+#if PICO_ON_DEVICE
+#include <initializer_list>
+
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/spi.h"
+#include "pico/stdlib.h"
+#endif
+
+namespace thermo {
+
+Display::Display(DisplayPort &port, Framebuffer &first, Framebuffer *second)
+    : port_(port), front_(&first), back_(second ? second : &first) {
+    memset(front_, 0, sizeof(Framebuffer));
+    memset(back_, 0, sizeof(Framebuffer));
+    // The panel powers up with random contents.
+    invalidate();
+}
+
+void Display::invalidate() {
+    for (int p = 0; p < Framebuffer::pages; p++) {
+        dirty_x0_[p] = 0;
+        dirty_x1_[p] = Framebuffer::width;
+    }
+}
+
+void Display::write(int page, int x, uint8_t mask, uint8_t bits) {
+    uint8_t &b = back_->px[page][x];
+    const uint8_t v = uint8_t((b & ~mask) | (bits & mask));
+    if (v == b) return;
+    b = v;
+    if (dirty_x0_[page] == dirty_x1_[page]) {
+        dirty_x0_[page] = uint8_t(x);
+        dirty_x1_[page] = uint8_t(x + 1);
+    } else if (x < dirty_x0_[page]) {
+        dirty_x0_[page] = uint8_t(x);
+    } else if (x >= dirty_x1_[page]) {
+        dirty_x1_[page] = uint8_t(x + 1);
+    }
+}
+
+// Rows [y, y + h) of column x take the low h bits of `bits`; h <= 32.
+void Display::write_column(int x, int y, int h, uint32_t bits) {
+    if (x < 0 || x >= Framebuffer::width) return;
+    if (y < 0) {
+        if (-y >= h) return;
+        bits >>= -y;
+        h += y;
+        y = 0;
+    }
+    const int shift = y & 7;
+    uint64_t mask = ((uint64_t(1) << h) - 1) << shift;
+    uint64_t v = (uint64_t(bits) << shift) & mask;
+    for (int page = y >> 3; mask && page < Framebuffer::pages; page++, mask >>= 8, v >>= 8) {
+        if (uint8_t(mask)) write(page, x, uint8_t(mask), uint8_t(v));
+    }
+}
+
+void Display::fill_rect(int x, int y, int w, int h, bool on) {
+    for (int row = y; row < y + h; row += 32) {
+        const int rows = y + h - row < 32 ? y + h - row : 32;
+        for (int col = x; col < x + w; col++) write_column(col, row, rows, on ? ~0u : 0u);
+    }
+}
+
+int Display::text(int x, int y, const char *s, const Font &font) {
+    for (; *s && x < Framebuffer::width; s++) {
+        const uint32_t *columns = font.glyph(*s);
+        for (int i = 0; i < font.width; i++) write_column(x + i, y, font.height, columns[i]);
+        for (int i = font.width; i < font.advance(); i++) write_column(x + i, y, font.height, 0);
+        x += font.advance();
+    }
+    return x;
+}
+
+bool Display::present() {
+    if (port_.busy()) {
+        stats_.deferred++;
+        return false;
+    }
+    size_t n = 0;
+    for (int p = 0; p < Framebuffer::pages; p++) {
+        if (dirty_x0_[p] == dirty_x1_[p]) continue;
+        sent_[n++] = {uint8_t(p), dirty_x0_[p], dirty_x1_[p]};
+        stats_.data_bytes += dirty_x1_[p] - dirty_x0_[p];
+        dirty_x0_[p] = dirty_x1_[p] = 0;
+    }
+    if (!n) {
+        stats_.unchanged++;
+        return true;
+    }
+    if (back_ != front_) {
+        // The old front is one frame behind, and only where this frame
+        // changed: copy those spans to make it the next drawing buffer.
+        Framebuffer *drawn = back_;
+        back_ = front_;
+        front_ = drawn;
+        for (size_t i = 0; i < n; i++) {
+            const DisplaySpan &s = sent_[i];
+            memcpy(&back_->px[s.page][s.x0], &front_->px[s.page][s.x0], s.x1 - s.x0);
+        }
+    }
+    stats_.frames++;
+    stats_.spans += uint32_t(n);
+    port_.start(*front_, sent_, n);
+    return true;
+}
+
+#if PICO_ON_DEVICE
+
+// --- SSD1306 on SPI ------------------------------------------------------------
+
+static Ssd1306Port *display_port;
+
+static spi_inst_t *display_spi(unsigned index) {
+    return index ? spi1 : spi0;
+}
+
+void Ssd1306Port::init(unsigned index, unsigned sck, unsigned mosi, unsigned cs, unsigned dc,
+                       unsigned reset, uint32_t baud) {
+    index_ = index;
+    cs_ = cs;
+    dc_ = dc;
+    spi_inst_t *spi = display_spi(index);
+    spi_init(spi, baud);
+    gpio_set_function(sck, GPIO_FUNC_SPI);
+    gpio_set_function(mosi, GPIO_FUNC_SPI);
+    for (unsigned pin : {cs, dc, reset}) {
+        gpio_init(pin);
+        gpio_set_dir(pin, GPIO_OUT);
+        gpio_put(pin, true);
+    }
+    gpio_put(reset, false);
+    sleep_us(10);
+    gpio_put(reset, true);
+    sleep_us(10);
+
+    // 128x64, internal charge pump, horizontal addressing (the column and
+    // page window set before each span then wraps within the span).
+    static const uint8_t setup[] = {
+        0xae, 0xd5, 0x80, 0xa8, 0x3f, 0xd3, 0x00, 0x40, 0x8d, 0x14, 0x20, 0x00, 0xa1,
+        0xc8, 0xda, 0x12, 0x81, 0xcf, 0xd9, 0xf1, 0xdb, 0x40, 0xa4, 0xa6, 0xaf,
+    };
+    gpio_put(cs, false);
+    gpio_put(dc, false);
+    spi_write_blocking(spi, setup, sizeof(setup));
+    gpio_put(cs, true);
+
+    chan_ = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(chan_);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, spi_get_dreq(spi, true));
+    dma_channel_configure(chan_, &c, &spi_get_hw(spi)->dr, nullptr, 0, false);
+
+    // Shares DMA_IRQ_1 with the sensor bus ports.
+    display_port = this;
+    dma_channel_set_irq1_enabled(chan_, true);
+    irq_add_shared_handler(DMA_IRQ_1, dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+}
+
+void Ssd1306Port::start(const Framebuffer &fb, const DisplaySpan *spans, size_t count) {
+    fb_ = &fb;
+    spans_ = spans;
+    count_ = count;
+    next_ = 0;
+    busy_ = true;
+    gpio_put(cs_, false);
+    start_span();
+}
+
+// The six command bytes go out by hand (a few microseconds), since D/C must
+// change around them; the span's pixels then go by DMA.
+void Ssd1306Port::start_span() {
+    spi_inst_t *spi = display_spi(index_);
+    const DisplaySpan &s = spans_[next_++];
+    const uint8_t window[command_bytes] = {0x21, s.x0, uint8_t(s.x1 - 1), 0x22, s.page, s.page};
+    gpio_put(dc_, false);
+    spi_write_blocking(spi, window, sizeof(window));
+    gpio_put(dc_, true);
+    dma_channel_transfer_from_buffer_now(chan_, &fb_->px[s.page][s.x0], s.x1 - s.x0);
+}
+
+void Ssd1306Port::on_dma_done() {
+    // DMA is done once the last byte is in the FIFO; let it drain before
+    // touching D/C or CS.
+    spi_inst_t *spi = display_spi(index_);
+    while (spi_is_busy(spi)) tight_loop_contents();
+    if (next_ < count_) {
+        start_span();
+        return;
+    }
+    gpio_put(cs_, true);
+    busy_ = false;
+}
+
+void Ssd1306Port::dma_irq_handler() {
+    Ssd1306Port *p = display_port;
+    if (p && dma_channel_get_irq1_status(p->chan_)) {
+        dma_channel_acknowledge_irq1(p->chan_);
+        p->on_dma_done();
+    }
+}
+
+#else
+
+// --- host panel ------------------------------------------------------------------
+
+MemoryDisplayPort::MemoryDisplayPort(Clock &clock, uint32_t bit_rate_hz)
+    : clock_(clock), bit_rate_hz_(bit_rate_hz) {}
+
+void MemoryDisplayPort::start(const Framebuffer &fb, const DisplaySpan *spans, size_t count) {
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < count; i++) bytes += command_bytes + spans[i].x1 - spans[i].x0;
+    const uint64_t us = (bytes * 8 * 1'000'000 + bit_rate_hz_ - 1) / bit_rate_hz_;
+    fb_ = &fb;
+    spans_ = spans;
+    count_ = count;
+    done_at_ = clock_.now_us() + us;
+    bytes_ += bytes;
+    busy_us_ += us;
+    transfers_++;
+}
+
+bool MemoryDisplayPort::busy() {
+    if (!fb_) return false;
+    if (clock_.now_us() < done_at_) return true;
+    for (size_t i = 0; i < count_; i++) {
+        const DisplaySpan &s = spans_[i];
+        memcpy(&panel_.px[s.page][s.x0], &fb_->px[s.page][s.x0], s.x1 - s.x0);
+    }
+    fb_ = nullptr;
+    return false;
+}
+
+#endif
+
+} // namespace thermo
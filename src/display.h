@@ -0,0 +1,167 @@
+// Framebuffer display with damage tracking, for a 128x64 monochrome
+// SSD1306-class panel on SPI.
+//
+// The framebuffer uses the controller's own memory layout (8 pages of 128
+// bytes, each byte a vertical strip of 8 pixels), so any run of columns
+// within a page can go to the panel straight from RAM. Drawing compares
+// every byte it writes and widens the page's dirty span only where the
+// contents really change: redrawing an unchanged "21.37" costs nothing on
+// the wire, and a changed last digit sends a few dozen bytes, not 1 KB.
+//
+// present() hands the dirty spans to a DisplayPort, which moves them with
+// DMA while the caller gets on with other work. With a second framebuffer
+// the display is double-buffered: present() swaps the two and copies the
+// spans just sent into the new drawing buffer, so the next frame can be
+// drawn while this one is still on the wire. Single-buffered, drawing must
+// wait until ready().
+//
+// Ports: Ssd1306Port over pico-sdk hardware_spi on the device;
+// MemoryDisplayPort on the host, an in-memory panel that takes simulated
+// wire time and counts the bytes sent.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "font.h"
+#include "scheduler.h"
+
+namespace thermo {
+
+struct Framebuffer {
+    static constexpr int width = 128;
+    static constexpr int height = 64;
+    static constexpr int pages = height / 8;
+
+    uint8_t px[pages][width];  // bit 0 is the top row of the page
+};
+
+/// Columns [x0, x1) of one page.
+struct DisplaySpan {
+    uint8_t page;
+    uint8_t x0;
+    uint8_t x1;
+};
+
+/// Sends spans of a framebuffer to the panel.
+class DisplayPort {
+public:
+    /// Controller commands in front of each span (column and page window).
+    static constexpr size_t command_bytes = 6;
+
+    /// Start sending `count` spans of `fb`. Both must stay unchanged until
+    /// busy() returns false.
+    virtual void start(const Framebuffer &fb, const DisplaySpan *spans, size_t count) = 0;
+    virtual bool busy() = 0;
+
+protected:
+    ~DisplayPort() = default;
+};
+
+struct DisplayStats {
+    uint32_t frames = 0;     // presents that sent something
+    uint32_t unchanged = 0;  // presents with nothing to send
+    uint32_t deferred = 0;   // presents refused while the port was busy
+    uint32_t spans = 0;
+    uint64_t data_bytes = 0;
+};
+
+class Display {
+public:
+    /// Double-buffered if `second` is given.
+    Display(DisplayPort &port, Framebuffer &first, Framebuffer *second = nullptr);
+
+    /// Whether drawing may start. Always true when double-buffered.
+    bool ready() { return back_ != front_ || !port_.busy(); }
+
+    void fill_rect(int x, int y, int w, int h, bool on);
+    void clear() { fill_rect(0, 0, Framebuffer::width, Framebuffer::height, false); }
+    /// Opaque text: each glyph cell, spacing included, is fully repainted.
+    /// Returns the x just past the last cell.
+    int text(int x, int y, const char *s, const Font &font);
+    /// Send the whole screen with the next present(), e.g. after a panel
+    /// reset.
+    void invalidate();
+
+    /// Start sending what changed since the last present. False, keeping
+    /// the damage for next time, if the previous frame is still on the wire.
+    bool present();
+
+    /// The buffer being drawn into.
+    const Framebuffer &frame() const { return *back_; }
+    const DisplayStats &stats() const { return stats_; }
+
+private:
+    void write_column(int x, int y, int h, uint32_t bits);
+    void write(int page, int x, uint8_t mask, uint8_t bits);
+
+    DisplayPort &port_;
+    Framebuffer *front_;  // last presented
+    Framebuffer *back_;   // being drawn; == front_ when single-buffered
+    uint8_t dirty_x0_[Framebuffer::pages];
+    uint8_t dirty_x1_[Framebuffer::pages] = {};  // x0 == x1: clean
+    DisplaySpan sent_[Framebuffer::pages];
+    DisplayStats stats_;
+};
+
+#if PICO_ON_DEVICE
+
+class Ssd1306Port final : public DisplayPort {
+public:
+    /// `index` selects spi0 or spi1. Resets and configures the panel.
+    void init(unsigned index, unsigned sck, unsigned mosi, unsigned cs, unsigned dc,
+              unsigned reset, uint32_t baud);
+    void start(const Framebuffer &fb, const DisplaySpan *spans, size_t count) override;
+    bool busy() override { return busy_; }
+
+private:
+    static void dma_irq_handler();
+    void start_span();
+    void on_dma_done();
+
+    unsigned index_ = 0;
+    unsigned cs_ = 0;
+    unsigned dc_ = 0;
+    int chan_ = -1;
+    const Framebuffer *fb_ = nullptr;
+    const DisplaySpan *spans_ = nullptr;
+    size_t count_ = 0;
+    size_t next_ = 0;
+    volatile bool busy_ = false;
+};
+
+#else
+
+/// Host panel: display RAM in memory. A transfer takes its wire time at
+/// `bit_rate_hz` on `clock` and lands in panel() when it completes, so a
+/// buffer modified while still on the wire shows up as a wrong picture.
+class MemoryDisplayPort final : public DisplayPort {
+public:
+    MemoryDisplayPort(Clock &clock, uint32_t bit_rate_hz);
+
+    void start(const Framebuffer &fb, const DisplaySpan *spans, size_t count) override;
+    bool busy() override;
+    /// When the running transfer will finish (0 if idle).
+    uint64_t busy_until() const { return fb_ ? done_at_ : 0; }
+
+    const Framebuffer &panel() const { return panel_; }
+    uint64_t bytes() const { return bytes_; }
+    uint64_t busy_us() const { return busy_us_; }
+    uint32_t transfers() const { return transfers_; }
+
+private:
+    Clock &clock_;
+    uint32_t bit_rate_hz_;
+    Framebuffer panel_ = {};
+    const Framebuffer *fb_ = nullptr;
+    const DisplaySpan *spans_ = nullptr;
+    size_t count_ = 0;
+    uint64_t done_at_ = 0;
+    uint64_t bytes_ = 0;
+    uint64_t busy_us_ = 0;
+    uint32_t transfers_ = 0;
+};
+
+#endif
+
+} // namespace thermo
@@ -0,0 +1,83 @@
+#include "ds18b20.h"
+
+#include "crc.h"
+
+namespace thermo {
+
+using namespace onewire;
+
+namespace {
+
+constexpr uint8_t family_ds18b20 = 0x28;
+constexpr uint8_t cmd_convert_t = 0x44;
+constexpr uint8_t cmd_read_scratchpad = 0xbe;
+
+} // namespace
+
+size_t Ds18b20Array::enumerate() {
+    count_ = bus_.search(roms_, max_probes, family_ds18b20);
+
+    convert_ops_[0] = reset_op();
+    convert_ops_[1] = byte_op(cmd_skip_rom);
+    convert_ops_[2] = byte_op(cmd_convert_t);
+    for (size_t p = 0; p < count_; p++) {
+        uint32_t *op = read_ops_ + p * ops_per_probe;
+        *op++ = reset_op();
+        *op++ = byte_op(cmd_match_rom);
+        for (size_t b = 0; b < 8; b++) *op++ = byte_op(roms_[p][b]);
+        *op++ = byte_op(cmd_read_scratchpad);
+        for (size_t b = 0; b < 9; b++) *op++ = read_byte_op();
+    }
+    valid_ = 0;
+    reading_ = converting_ = false;
+    return count_;
+}
+
+bool Ds18b20Array::start_conversion() {
+    if (!count_ || !bus_.start(convert_ops_, results_, 3)) return false;
+    converting_ = true;
+    return true;
+}
+
+bool Ds18b20Array::start_read() {
+    if (!count_ || !bus_.start(read_ops_, results_, count_ * ops_per_probe)) return false;
+    reading_ = true;
+    converting_ = false;
+    return true;
+}
+
+bool Ds18b20Array::finish_read() {
+    if (!reading_ || bus_.busy()) return false;
+    reading_ = false;
+    reads_++;
+    for (size_t p = 0; p < count_; p++) {
+        const uint8_t *r = results_ + p * ops_per_probe;
+        const uint8_t *pad = r + pad_offset;
+        if (!presence(r[0])) {
+            missing_++;
+            valid_ &= ~(1u << p);
+        } else if (crc8_maxim(pad, 9) != 0 || (pad[4] & 0x1f) != 0x1f) {
+            // A probe that dropped off mid-read gives all 1s (bad CRC); a
+            // line held low gives all 0s, whose CRC passes but whose
+            // configuration byte lacks its always-set low bits.
+            crc_errors_++;
+            valid_ &= ~(1u << p);
+        } else {
+            raw_[p] = int16_t(pad[0] | pad[1] << 8);
+            valid_ |= 1u << p;
+        }
+    }
+    return true;
+}
+
+bool Ds18b20Array::step() {
+    if (converting_) {
+        start_read();
+        return false;
+    }
+    bool fresh = finish_read();
+    start_conversion();
+    return fresh;
+}
+
+} // namespace thermo
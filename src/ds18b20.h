@@ -0,0 +1,76 @@
+// DS18B20 temperature probes sharing one 1-Wire bus.
+//
+// Every probe converts at once (Skip ROM + Convert T), and a single DMA
+// transfer later reads all the scratchpads back (Match ROM + Read
+// Scratchpad per probe, back to back). Both operation lists are encoded once
+// by enumerate(), so a read cycle costs the CPU two DMA kicks plus a CRC
+// check and a conversion per probe. Probes must be externally powered:
+// parasite power needs a strong pull-up during conversion, which the bus
+// master does not drive.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "fixed.h"
+#include "onewire.h"
+
+namespace thermo {
+
+class Ds18b20Array {
+public:
+    static constexpr size_t max_probes = 8;
+    /// Conversion time at the power-up default 12-bit resolution.
+    static constexpr uint32_t conversion_us = 750'000;
+
+    explicit Ds18b20Array(OneWireBus &bus) : bus_(bus) {}
+
+    /// Search the bus (blocking, init only) and prepare the operation lists.
+    /// Devices of other families are left alone. Returns the probe count.
+    size_t enumerate();
+
+    /// Start a conversion on every probe. Readings are ready conversion_us
+    /// later. False if the bus is busy.
+    bool start_conversion();
+    /// Start reading every scratchpad in one transfer. False if busy.
+    bool start_read();
+    /// Once the read transfer has finished, check and convert the results.
+    /// False while it is still running.
+    bool finish_read();
+
+    /// Call once per conversion period: alternately starts a conversion and
+    /// collects it. Returns true when fresh readings were stored.
+    bool step();
+
+    size_t count() const { return count_; }
+    const OneWireRom &rom(size_t i) const { return roms_[i]; }
+    /// Whether the probe's last read passed its CRC and presence checks.
+    bool valid(size_t i) const { return valid_ & (1u << i); }
+    /// Last good reading, in 1/16 degrees.
+    int16_t raw(size_t i) const { return raw_[i]; }
+    real_t celsius(size_t i) const { return Numeric<real_t>::ratio(raw_[i], 16); }
+
+    uint32_t reads() const { return reads_; }
+    uint32_t crc_errors() const { return crc_errors_; }
+    uint32_t missing() const { return missing_; }
+
+private:
+    static constexpr size_t ops_per_probe = 20;  // reset, match, rom[8], read, pad[9]
+    static constexpr size_t pad_offset = 11;
+
+    OneWireBus &bus_;
+    OneWireRom roms_[max_probes];
+    uint32_t convert_ops_[3];
+    uint32_t read_ops_[max_probes * ops_per_probe];
+    uint8_t results_[max_probes * ops_per_probe];
+    int16_t raw_[max_probes] = {};
+    size_t count_ = 0;
+    uint32_t valid_ = 0;
+    bool reading_ = false;
+    bool converting_ = false;
+    uint32_t reads_ = 0;
+    uint32_t crc_errors_ = 0;
+    uint32_t missing_ = 0;
+};
+
+} // namespace thermo
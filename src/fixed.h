@@ -0,0 +1,129 @@
+// Q16.16 fixed-point arithmetic and the build-time numeric backend selection.
+//
+// The RP2040's Cortex-M0+ has no FPU, so every float operation in the control
+// path is a soft-float call. Q16 keeps temperatures, setpoints and gains in a
+// 32-bit integer with 16 fractional bits (resolution ~15 micro-degrees, range
+// +/-32768). Conversions in and all arithmetic saturate at the ends of that
+// range, products and quotients through a 64-bit intermediate; a division by
+// zero gives the end of the range on the dividend's side (0 for 0 / 0).
+#pragma once
+
+#include <cstdint>
+
+namespace thermo {
+
+class Q16 {
+public:
+    static constexpr int frac_bits = 16;
+    static constexpr int32_t one_raw = int32_t(1) << frac_bits;
+
+    constexpr Q16() = default;
+    constexpr Q16(int v) : raw_(saturate(int64_t(v) * one_raw)) {}
+    /// NaN converts to 0.
+    constexpr Q16(float v) : raw_(saturate_scaled(v * one_raw + (v < 0 ? -0.5f : 0.5f))) {}
+    constexpr Q16(double v) : raw_(saturate_scaled(v * one_raw + (v < 0 ? -0.5 : 0.5))) {}
+
+    static constexpr Q16 from_raw(int32_t raw) {
+        Q16 q;
+        q.raw_ = raw;
+        return q;
+    }
+    /// n / d computed in fixed point, without going through float.
+    static constexpr Q16 ratio(int32_t n, int32_t d) { return from_raw(quotient(n, d)); }
+
+    constexpr int32_t raw() const { return raw_; }
+    constexpr float to_float() const { return float(raw_) / one_raw; }
+    /// Round to nearest integer, halves away from zero.
+    /// The magnitude is unsigned, so neither end of the range overflows.
+    constexpr int32_t round() const {
+        const uint32_t mag = raw_ >= 0 ? uint32_t(raw_) : 0u - uint32_t(raw_);
+        const int32_t r = int32_t((mag + uint32_t(one_raw / 2)) >> frac_bits);
+        return raw_ >= 0 ? r : -r;
+    }
+
+    constexpr Q16 operator-() const { return from_raw(saturate(-int64_t(raw_))); }
+    constexpr Q16 operator+(Q16 o) const { return from_raw(saturate(int64_t(raw_) + o.raw_)); }
+    constexpr Q16 operator-(Q16 o) const { return from_raw(saturate(int64_t(raw_) - o.raw_)); }
+    constexpr Q16 operator*(Q16 o) const {
+        int64_t p = int64_t(raw_) * o.raw_;
+        return from_raw(saturate((p + (int64_t(1) << (frac_bits - 1))) >> frac_bits));
+    }
+    constexpr Q16 operator/(Q16 o) const { return from_raw(quotient(raw_, o.raw_)); }
+    /// Scaling by an integer avoids the 64-bit product.
+    constexpr Q16 operator*(int32_t k) const { return from_raw(saturate(int64_t(raw_) * k)); }
+
+    constexpr Q16 &operator+=(Q16 o) { return *this = *this + o; }
+    constexpr Q16 &operator-=(Q16 o) { return *this = *this - o; }
+    constexpr Q16 &operator*=(Q16 o) { return *this = *this * o; }
+
+    constexpr bool operator<(Q16 o) const { return raw_ < o.raw_; }
+    constexpr bool operator>(Q16 o) const { return raw_ > o.raw_; }
+    constexpr bool operator<=(Q16 o) const { return raw_ <= o.raw_; }
+    constexpr bool operator>=(Q16 o) const { return raw_ >= o.raw_; }
+    constexpr bool operator==(Q16 o) const { return raw_ == o.raw_; }
+    constexpr bool operator!=(Q16 o) const { return raw_ != o.raw_; }
+
+private:
+    static constexpr int32_t saturate(int64_t v) {
+        return v > INT32_MAX ? INT32_MAX : (v < INT32_MIN ? INT32_MIN : int32_t(v));
+    }
+    // A float or double already scaled by one_raw and offset for rounding.
+    // The limits are powers of two, exact in either type; the conversion
+    // truncates, so anything strictly between them fits.
+    template <typename F>
+    static constexpr int32_t saturate_scaled(F v) {
+        return v >= F(2147483648.0) ? INT32_MAX
+               : v > F(-2147483648.0) ? int32_t(v)
+               : v < F(0)             ? INT32_MIN
+                                      : 0;  // NaN
+    }
+    // n / d in Q16 for raw n and d, saturating; d == 0 picks n's side.
+    static constexpr int32_t quotient(int32_t n, int32_t d) {
+        if (d == 0) return n > 0 ? INT32_MAX : (n < 0 ? INT32_MIN : 0);
+        return saturate(int64_t(n) * one_raw / d);
+    }
+
+    int32_t raw_ = 0;
+};
+
+/// Uniform access to the operations the control code needs from either
+/// backend, so templates never touch float-only or Q16-only API directly.
+template <typename T>
+struct Numeric;
+
+template <>
+struct Numeric<float> {
+    static constexpr const char *name = "float";
+    static constexpr float from_float(float v) { return v; }
+    static constexpr float to_float(float v) { return v; }
+    static constexpr float ratio(int32_t n, int32_t d) { return float(n) / float(d); }
+    static constexpr int32_t round(float v) { return int32_t(v < 0 ? v - 0.5f : v + 0.5f); }
+};
+
+template <>
+struct Numeric<Q16> {
+    static constexpr const char *name = "q16.16";
+    static constexpr Q16 from_float(float v) { return Q16(v); }
+    static constexpr float to_float(Q16 v) { return v.to_float(); }
+    static constexpr Q16 ratio(int32_t n, int32_t d) { return Q16::ratio(n, d); }
+    static constexpr int32_t round(Q16 v) { return v.round(); }
+};
+
+template <typename T>
+constexpr T clamp(T v, T lo, T hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// Backend used by the firmware's control path; see THERMO_NUMERIC in
+// src/CMakeLists.txt. Both backends are always available to templates.
+#ifndef THERMO_FIXED_POINT
+#define THERMO_FIXED_POINT 1
+#endif
+
+#if THERMO_FIXED_POINT
+using real_t = Q16;
+#else
+using real_t = float;
+#endif
+
+} // namespace thermo
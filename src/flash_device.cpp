@@ -0,0 +1,106 @@
+#include "flash_device.h"
+
+#include <cstring>
+
+#if PICO_ON_DEVICE
+#include "hardware/flash.h"
+#include "pico/flash.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace thermo {
+
+#if PICO_ON_DEVICE
+
+namespace {
+
+struct FlashOp {
+    uint32_t offset;
+    const uint8_t *data;
+    size_t len;
+};
+
+// Both run with the other core parked and interrupts off; they and
+// everything they call live in RAM.
+void __not_in_flash_func(do_program)(void *param) {
+    const FlashOp *op = static_cast<const FlashOp *>(param);
+    flash_range_program(op->offset, op->data, op->len);
+}
+
+void __not_in_flash_func(do_erase)(void *param) {
+    const FlashOp *op = static_cast<const FlashOp *>(param);
+    flash_range_erase(op->offset, op->len);
+}
+
+} // namespace
+
+void PicoFlash::read(uint32_t offset, void *dst, size_t len) {
+    memcpy(dst, reinterpret_cast<const void *>(XIP_BASE + base_ + offset), len);
+}
+
+bool PicoFlash::program(uint32_t offset, const void *src, size_t len) {
+    FlashOp op{base_ + offset, static_cast<const uint8_t *>(src), len};
+    return flash_safe_execute(do_program, &op, UINT32_MAX) == PICO_OK;
+}
+
+bool PicoFlash::erase(uint32_t offset, size_t len) {
+    FlashOp op{base_ + offset, nullptr, len};
+    return flash_safe_execute(do_erase, &op, UINT32_MAX) == PICO_OK;
+}
+
+#else
+
+FileFlash::FileFlash(const char *path, size_t size) : size_(size) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return;
+    struct stat st;
+    bool fresh = fstat(fd, &st) != 0 || size_t(st.st_size) != size;
+    if (fresh && ftruncate(fd, off_t(size)) != 0) {
+        close(fd);
+        return;
+    }
+    void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) return;
+    mem_ = static_cast<uint8_t *>(mem);
+    if (fresh) memset(mem_, 0xff, size);
+}
+
+FileFlash::~FileFlash() {
+    if (mem_) munmap(mem_, size_);
+}
+
+void FileFlash::read(uint32_t offset, void *dst, size_t len) {
+    memcpy(dst, mem_ + offset, len);
+}
+
+bool FileFlash::program(uint32_t offset, const void *src, size_t len) {
+    if ((offset | len) % page_size || offset + len > size_) return false;
+    size_t n = len < fail_after_ ? len : fail_after_;
+    const uint8_t *s = static_cast<const uint8_t *>(src);
+    for (size_t i = 0; i < n; i++) mem_[offset + i] &= s[i];  // NOR: 1 -> 0 only
+    bytes_programmed_ += n;
+    if (n < len) {
+        fail_after_ = SIZE_MAX;
+        return false;
+    }
+    return true;
+}
+
+bool FileFlash::erase(uint32_t offset, size_t len) {
+    if ((offset | len) % sector_size || offset + len > size_) return false;
+    memset(mem_ + offset, 0xff, len);
+    for (size_t s = offset / sector_size; s < (offset + len) / sector_size; s++) {
+        if (s < max_sectors) erase_counts_[s]++;
+        sectors_erased_++;
+    }
+    return true;
+}
+
+#endif
+
+} // namespace thermo
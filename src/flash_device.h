@@ -0,0 +1,89 @@
+// Raw NOR flash access for the storage layer.
+//
+// PicoFlash drives a region of the RP2040's QSPI flash through
+// hardware_flash. Program and erase run via flash_safe_execute(), which
+// parks the other core and disables interrupts for the duration, because
+// nothing may execute from XIP while the flash is busy. Reads go straight
+// through the XIP window.
+//
+// FileFlash (host) backs the region with a memory-mapped file and keeps NOR
+// semantics: erase sets bytes to 0xff and program can only clear bits. It
+// counts programmed bytes and erases per sector, and can cut a program short
+// to simulate power loss.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace thermo {
+
+class FlashDevice {
+public:
+    static constexpr size_t page_size = 256;     // program granule
+    static constexpr size_t sector_size = 4096;  // erase granule
+
+    virtual size_t size() const = 0;
+    virtual void read(uint32_t offset, void *dst, size_t len) = 0;
+    /// offset and len must be multiples of page_size.
+    virtual bool program(uint32_t offset, const void *src, size_t len) = 0;
+    /// offset and len must be multiples of sector_size.
+    virtual bool erase(uint32_t offset, size_t len) = 0;
+
+protected:
+    ~FlashDevice() = default;
+};
+
+#if PICO_ON_DEVICE
+
+class PicoFlash final : public FlashDevice {
+public:
+    /// region_offset is relative to the start of flash, not XIP_BASE.
+    PicoFlash(uint32_t region_offset, size_t region_size)
+        : base_(region_offset), size_(region_size) {}
+
+    size_t size() const override { return size_; }
+    void read(uint32_t offset, void *dst, size_t len) override;
+    bool program(uint32_t offset, const void *src, size_t len) override;
+    bool erase(uint32_t offset, size_t len) override;
+
+private:
+    uint32_t base_;
+    size_t size_;
+};
+
+#else
+
+class FileFlash final : public FlashDevice {
+public:
+    static constexpr size_t max_sectors = 4096;
+
+    /// Maps `path`, creating it erased if missing or the wrong size.
+    FileFlash(const char *path, size_t size);
+    ~FileFlash();
+
+    bool ok() const { return mem_ != nullptr; }
+    size_t size() const override { return size_; }
+    void read(uint32_t offset, void *dst, size_t len) override;
+    bool program(uint32_t offset, const void *src, size_t len) override;
+    bool erase(uint32_t offset, size_t len) override;
+
+    /// The next program() writes only `bytes` bytes and fails, as if power
+    /// was lost mid-page.
+    void fail_next_program_after(size_t bytes) { fail_after_ = bytes; }
+
+    uint64_t bytes_programmed() const { return bytes_programmed_; }
+    uint64_t sectors_erased() const { return sectors_erased_; }
+    uint32_t erase_count(size_t sector) const { return sector < max_sectors ? erase_counts_[sector] : 0; }
+
+private:
+    uint8_t *mem_ = nullptr;
+    size_t size_;
+    size_t fail_after_ = SIZE_MAX;
+    uint64_t bytes_programmed_ = 0;
+    uint64_t sectors_erased_ = 0;
+    uint32_t erase_counts_[max_sectors] = {};
+};
+
+#endif
+
+} // namespace thermo
@@ -0,0 +1,239 @@
+#include "flash_log.h"
+
+#include <cstring>
+
+#include "crc.h"
+#include "trace.h"
+
+namespace thermo {
+
+// Page layout: seq (u32) | payload length (u16) | crc16 (u16) | records.
+// Records: type (u8) | length (u8) | payload. An erased page reads as
+// seq 0xffffffff, which is never issued.
+static constexpr uint32_t erased_seq = 0xffffffffu;
+
+static uint16_t page_crc(const uint8_t *page, uint16_t len) {
+    uint16_t crc = crc16_ccitt(page, 6);
+    return crc16_ccitt(page + FlashLog::page_header_size, len, crc);
+}
+
+FlashLog::FlashLog(FlashDevice &flash)
+    : flash_(flash), pages_(uint32_t(flash.size() / page_size)) {
+    memset(page_, 0xff, sizeof(page_));
+}
+
+bool FlashLog::read_page(uint32_t page, uint8_t *buf, uint32_t &seq, uint16_t &len) {
+    flash_.read(page * page_size, buf, page_size);
+    memcpy(&seq, buf, 4);
+    memcpy(&len, buf + 4, 2);
+    uint16_t crc;
+    memcpy(&crc, buf + 6, 2);
+    if (seq == erased_seq || len > page_size - page_header_size) return false;
+    return page_crc(buf, len) == crc;
+}
+
+uint32_t FlashLog::mount() {
+    uint8_t buf[page_size];
+    const uint32_t sectors = pages_ / pages_per_sector;
+
+    // Pages within a sector are written in order, so the first page of each
+    // sector is enough to find the newest sector.
+    uint32_t newest_seq = 0, newest_sector = 0;
+    bool any = false;
+    for (uint32_t s = 0; s < sectors; s++) {
+        uint32_t seq;
+        uint16_t len;
+        if (read_page(s * pages_per_sector, buf, seq, len) && (!any || seq > newest_seq)) {
+            newest_seq = seq;
+            newest_sector = s;
+            any = true;
+        }
+    }
+
+    if (!any) {
+        // Blank (or unreadable) region: start from page 0; the first append
+        // erases sector 0 anyway.
+        head_page_ = 0;
+        next_seq_ = 1;
+    } else {
+        // The write frontier is after the last non-blank page of the newest
+        // sector; a torn page counts as used since it cannot be reprogrammed.
+        uint32_t first = newest_sector * pages_per_sector;
+        uint32_t last = first;
+        for (uint32_t i = 0; i < pages_per_sector; i++) {
+            uint32_t seq;
+            uint16_t len;
+            if (read_page(first + i, buf, seq, len)) {
+                if (seq > newest_seq) newest_seq = seq;
+                last = first + i;
+            } else if (seq != erased_seq) {
+                last = first + i;
+            }
+        }
+        head_page_ = (last + 1) % pages_;
+        next_seq_ = newest_seq + 1;
+    }
+    erased_sector_ = -1;
+    fill_ = page_header_size;
+
+    // Rebuild the settings cache; later values overwrite earlier ones. The
+    // same pass reads every page, so it counts them too.
+    for (Setting &s : settings_) s.used = false;
+    uint32_t valid = 0;
+    walk(
+        [](void *ctx, uint8_t type, const uint8_t *data, size_t len) {
+            if (type == record_setting && len >= 1) {
+                static_cast<FlashLog *>(ctx)->cache_setting(data[0], data + 1, len - 1);
+            }
+        },
+        this, valid, stats_.torn_pages);
+    return valid;
+}
+
+void FlashLog::for_each(Visitor fn, void *ctx) {
+    uint32_t valid, torn;
+    walk(fn, ctx, valid, torn);
+}
+
+void FlashLog::walk(Visitor fn, void *ctx, uint32_t &valid, uint32_t &torn) {
+    uint8_t buf[page_size];
+    const uint32_t sectors = pages_ / pages_per_sector;
+    // Sectors are reused in ring order. If the head is mid-sector, that
+    // sector holds the newest pages and the next one the oldest; if it is at
+    // a sector boundary, the head sector itself is the oldest (not yet
+    // recycled). Pages that do not continue the sequence (leftovers of an
+    // interrupted erase) are skipped.
+    uint32_t start = head_page_ / pages_per_sector;
+    if (head_page_ % pages_per_sector != 0) start = (start + 1) % sectors;
+    uint32_t last_seq = 0;
+    valid = torn = 0;
+    for (uint32_t i = 0; i < sectors; i++) {
+        uint32_t s = (start + i) % sectors;
+        for (uint32_t p = 0; p < pages_per_sector; p++) {
+            uint32_t seq;
+            uint16_t len;
+            if (!read_page(s * pages_per_sector + p, buf, seq, len)) {
+                torn += seq != erased_seq;
+                continue;
+            }
+            valid++;
+            if (seq <= last_seq) continue;
+            last_seq = seq;
+            size_t pos = page_header_size;
+            size_t end = page_header_size + len;
+            while (pos + record_header_size <= end) {
+                uint8_t type = buf[pos], rlen = buf[pos + 1];
+                if (pos + record_header_size + rlen > end) break;
+                fn(ctx, type, buf + pos + record_header_size, rlen);
+                pos += record_header_size + rlen;
+            }
+        }
+    }
+}
+
+void FlashLog::buffer_record(uint8_t type, const void *data, size_t len) {
+    page_[fill_] = type;
+    page_[fill_ + 1] = uint8_t(len);
+    memcpy(page_ + fill_ + record_header_size, data, len);
+    fill_ += record_header_size + len;
+}
+
+// First page of a sector: lead with every live setting, so they survive the
+// sector that held their last copy being recycled.
+void FlashLog::emit_settings() {
+    for (const Setting &s : settings_) {
+        if (!s.used) continue;
+        uint8_t rec[1 + max_setting_size];
+        rec[0] = s.key;
+        memcpy(rec + 1, s.data, s.len);
+        buffer_record(record_setting, rec, 1 + s.len);
+    }
+}
+
+bool FlashLog::append(uint8_t type, const void *data, size_t len) {
+    if (len > max_record_size) return false;
+    if (fill_ + record_header_size + len > page_size && !program_page()) return false;
+    if (fill_ == page_header_size && head_page_ % pages_per_sector == 0) emit_settings();
+    if (fill_ + record_header_size + len > page_size && !program_page()) return false;
+    buffer_record(type, data, len);
+    stats_.payload_bytes += len;
+    return true;
+}
+
+bool FlashLog::flush() {
+    return fill_ == page_header_size || program_page();
+}
+
+bool FlashLog::prepare() {
+    uint32_t sector = head_page_ / pages_per_sector;
+    if (head_page_ % pages_per_sector != 0 || erased_sector_ == int32_t(sector)) return true;
+    TRACE_BEGIN(flash_erase);
+    const bool erased = flash_.erase(sector * FlashDevice::sector_size, FlashDevice::sector_size);
+    TRACE_END(flash_erase);
+    if (!erased) return false;
+    stats_.sectors_erased++;
+    erased_sector_ = int32_t(sector);
+    return true;
+}
+
+bool FlashLog::program_page() {
+    if (!prepare()) return false;
+
+    uint16_t len = uint16_t(fill_ - page_header_size);
+    memcpy(page_, &next_seq_, 4);
+    memcpy(page_ + 4, &len, 2);
+    uint16_t crc = page_crc(page_, len);
+    memcpy(page_ + 6, &crc, 2);
+
+    TRACE_BEGIN(flash_program);
+    bool ok = flash_.program(head_page_ * page_size, page_, page_size);
+    TRACE_END(flash_program);
+    stats_.pages_programmed++;
+    stats_.programmed_bytes += page_size;
+    // Whether or not it worked, this page is spent: move on so a retry goes
+    // to fresh flash.
+    next_seq_++;
+    head_page_ = (head_page_ + 1) % pages_;
+    erased_sector_ = head_page_ % pages_per_sector == 0 ? -1 : erased_sector_;
+    fill_ = page_header_size;
+    memset(page_, 0xff, sizeof(page_));
+    if (!ok) stats_.program_failures++;
+    return ok;
+}
+
+void FlashLog::cache_setting(uint8_t key, const uint8_t *data, size_t len) {
+    if (len > max_setting_size) return;
+    Setting *slot = nullptr;
+    for (Setting &s : settings_) {
+        if (s.used && s.key == key) {
+            slot = &s;
+            break;
+        }
+        if (!s.used && !slot) slot = &s;
+    }
+    if (!slot) return;
+    slot->key = key;
+    slot->len = uint8_t(len);
+    slot->used = true;
+    memcpy(slot->data, data, len);
+}
+
+bool FlashLog::write_setting(uint8_t key, const void *data, size_t len) {
+    if (len > max_setting_size) return false;
+    cache_setting(key, static_cast<const uint8_t *>(data), len);
+    uint8_t rec[1 + max_setting_size];
+    rec[0] = key;
+    memcpy(rec + 1, data, len);
+    return append(record_setting, rec, 1 + len);
+}
+
+int FlashLog::read_setting(uint8_t key, void *data, size_t len) const {
+    for (const Setting &s : settings_) {
+        if (!s.used || s.key != key) continue;
+        memcpy(data, s.data, len < s.len ? len : s.len);
+        return s.len;
+    }
+    return -1;
+}
+
+} // namespace thermo
@@ -0,0 +1,106 @@
+// Append-only, wear-levelled record log on a flash region.
+//
+// The region is a ring of 4 KB sectors of 256-byte pages. Records are
+// batched in a RAM page buffer and programmed a whole page at a time; each
+// page carries a global sequence number and a CRC, so a page torn by power
+// loss is recognised and skipped. Sectors are erased in ring order just
+// before reuse, which spreads erases evenly and makes the oldest sector the
+// one that is recycled. prepare() can do that erase ahead of time from an
+// idle task, so append() never stalls the cores on an erase.
+//
+// Settings are sticky records: the latest value of every key is re-emitted
+// at the start of each sector, so recycling old sectors never loses them.
+// mount() rebuilds the write position and the settings cache by scanning.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "flash_device.h"
+
+namespace thermo {
+
+// Flash reserved for the log at the top of the device's flash.
+#ifndef THERMO_FLASH_LOG_BYTES
+#define THERMO_FLASH_LOG_BYTES (512 * 1024)
+#endif
+
+/// Record types. Values below 0x10 are reserved for the log itself.
+enum : uint8_t {
+    record_setting = 0x01,
+    record_user = 0x10,
+};
+
+struct FlashLogStats {
+    uint64_t payload_bytes = 0;    // bytes handed to append(), excluding headers
+    uint64_t programmed_bytes = 0;
+    uint32_t pages_programmed = 0;
+    uint32_t sectors_erased = 0;
+    uint32_t program_failures = 0;
+    uint32_t torn_pages = 0;       // found by the last mount()
+};
+
+class FlashLog {
+public:
+    static constexpr size_t page_size = FlashDevice::page_size;
+    static constexpr size_t pages_per_sector = FlashDevice::sector_size / page_size;
+    static constexpr size_t page_header_size = 8;
+    static constexpr size_t record_header_size = 2;
+    static constexpr size_t max_record_size = page_size - page_header_size - record_header_size;
+    static constexpr size_t max_settings = 6;
+    static constexpr size_t max_setting_size = 32;
+
+    explicit FlashLog(FlashDevice &flash);
+
+    /// Scan the region. Returns the number of valid pages found (0 for a
+    /// blank region, which is fine to write to).
+    uint32_t mount();
+
+    /// Queue a record; the page is programmed when full. False if the record
+    /// is too large or the page could not be written.
+    bool append(uint8_t type, const void *data, size_t len);
+    /// Program the partial page now (costs the rest of the page).
+    bool flush();
+    /// Erase the next sector ahead of need. Cheap no-op if already done.
+    bool prepare();
+
+    bool write_setting(uint8_t key, const void *data, size_t len);
+    /// Copies up to `len` bytes of the latest value; returns its size, or -1.
+    int read_setting(uint8_t key, void *data, size_t len) const;
+
+    using Visitor = void (*)(void *ctx, uint8_t type, const uint8_t *data, size_t len);
+    /// Every record on flash, oldest first (unflushed records excluded).
+    void for_each(Visitor fn, void *ctx);
+
+    const FlashLogStats &stats() const { return stats_; }
+    uint32_t page_count() const { return pages_; }
+    uint32_t next_seq() const { return next_seq_; }
+
+private:
+    struct Setting {
+        uint8_t key;
+        uint8_t len;
+        bool used;
+        uint8_t data[max_setting_size];
+    };
+
+    bool read_page(uint32_t page, uint8_t *buf, uint32_t &seq, uint16_t &len);
+    /// for_each(), also counting the valid and torn pages it read.
+    void walk(Visitor fn, void *ctx, uint32_t &valid, uint32_t &torn);
+    bool program_page();
+    void buffer_record(uint8_t type, const void *data, size_t len);
+    void emit_settings();
+    void cache_setting(uint8_t key, const uint8_t *data, size_t len);
+
+    FlashDevice &flash_;
+    uint32_t pages_;
+    uint32_t head_page_ = 0;  // next page to program
+    uint32_t next_seq_ = 1;
+    int32_t erased_sector_ = -1;  // sector known to be erased ahead of head
+    uint8_t page_[page_size];
+    size_t fill_ = page_header_size;
+    Setting settings_[max_settings] = {};
+    FlashLogStats stats_;
+};
+
+} // namespace thermo
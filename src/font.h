@@ -0,0 +1,129 @@
+// Bitmap fonts for the display, built at compile time.
+//
+// Glyphs are written below as 5x7 row pictures, which is easy to read and
+// edit. build_atlas<Scale>() turns them into column bitmaps in the panel's
+// native orientation (one word per pixel column, bit 0 at the top), scaled
+// up by pixel doubling, so the renderer only shifts and masks columns and
+// no font conversion runs on the device. The atlases are constexpr and end
+// up in flash.
+//
+// Covers space to '_' (ASCII 32-95); lowercase is drawn as uppercase and
+// anything else as a blank cell.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace thermo {
+
+struct Font {
+    uint8_t width;            // glyph cell, pixels
+    uint8_t height;
+    uint8_t spacing;          // blank columns after each glyph
+    const uint32_t *columns;  // glyph_count * width column bitmaps
+
+    static constexpr char first_char = 32;
+    static constexpr size_t glyph_count = 64;
+
+    /// Column bitmaps of `c`, `width` of them.
+    const uint32_t *glyph(char c) const {
+        if (c >= 'a' && c <= 'z') c = char(c - 'a' + 'A');
+        if (c < first_char || c >= first_char + char(glyph_count)) c = ' ';
+        return columns + size_t(c - first_char) * width;
+    }
+    int advance() const { return width + spacing; }
+};
+
+namespace font_detail {
+
+struct GlyphSource {
+    char c;
+    const char *rows;  // 7 rows of 5, '#' = pixel on
+};
+
+constexpr GlyphSource glyphs[] = {
+    {'%', "##..." "##..#" "...#." "..#.." ".#..." "#..##" "...##"},
+    {'+', "....." "..#.." "..#.." "#####" "..#.." "..#.." "....."},
+    {'-', "....." "....." "....." ".###." "....." "....." "....."},
+    {'.', "....." "....." "....." "....." "....." ".##.." ".##.."},
+    {'/', "....." "....#" "...#." "..#.." ".#..." "#...." "....."},
+    {'0', ".###." "#...#" "#..##" "#.#.#" "##..#" "#...#" ".###."},
+    {'1', "..#.." ".##.." "..#.." "..#.." "..#.." "..#.." ".###."},
+    {'2', ".###." "#...#" "....#" "...#." "..#.." ".#..." "#####"},
+    {'3', "#####" "...#." "..#.." "...#." "....#" "#...#" ".###."},
+    {'4', "...#." "..##." ".#.#." "#..#." "#####" "...#." "...#."},
+    {'5', "#####" "#...." "####." "....#" "....#" "#...#" ".###."},
+    {'6', "..##." ".#..." "#...." "####." "#...#" "#...#" ".###."},
+    {'7', "#####" "....#" "...#." "..#.." ".#..." ".#..." ".#..."},
+    {'8', ".###." "#...#" "#...#" ".###." "#...#" "#...#" ".###."},
+    {'9', ".###." "#...#" "#...#" ".####" "....#" "...#." ".##.."},
+    {':', "....." ".##.." ".##.." "....." ".##.." ".##.." "....."},
+    {'A', ".###." "#...#" "#...#" "#####" "#...#" "#...#" "#...#"},
+    {'B', "####." "#...#" "#...#" "####." "#...#" "#...#" "####."},
+    {'C', ".###." "#...#" "#...." "#...." "#...." "#...#" ".###."},
+    {'D', "####." "#...#" "#...#" "#...#" "#...#" "#...#" "####."},
+    {'E', "#####" "#...." "#...." "####." "#...." "#...." "#####"},
+    {'F', "#####" "#...." "#...." "####." "#...." "#...." "#...."},
+    {'G', ".###." "#...#" "#...." "#.###" "#...#" "#...#" ".####"},
+    {'H', "#...#" "#...#" "#...#" "#####" "#...#" "#...#" "#...#"},
+    {'I', ".###." "..#.." "..#.." "..#.." "..#.." "..#.." ".###."},
+    {'J', "..###" "...#." "...#." "...#." "...#." "#..#." ".##.."},
+    {'K', "#...#" "#..#." "#.#.." "##..." "#.#.." "#..#." "#...#"},
+    {'L', "#...." "#...." "#...." "#...." "#...." "#...." "#####"},
+    {'M', "#...#" "##.##" "#.#.#" "#.#.#" "#...#" "#...#" "#...#"},
+    {'N', "#...#" "#...#" "##..#" "#.#.#" "#..##" "#...#" "#...#"},
+    {'O', ".###." "#...#" "#...#" "#...#" "#...#" "#...#" ".###."},
+    {'P', "####." "#...#" "#...#" "####." "#...." "#...." "#...."},
+    {'Q', ".###." "#...#" "#...#" "#...#" "#.#.#" "#..#." ".##.#"},
+    {'R', "####." "#...#" "#...#" "####." "#.#.." "#..#." "#...#"},
+    {'S', ".####" "#...." "#...." ".###." "....#" "....#" "####."},
+    {'T', "#####" "..#.." "..#.." "..#.." "..#.." "..#.." "..#.."},
+    {'U', "#...#" "#...#" "#...#" "#...#" "#...#" "#...#" ".###."},
+    {'V', "#...#" "#...#" "#...#" "#...#" "#...#" ".#.#." "..#.."},
+    {'W', "#...#" "#...#" "#...#" "#.#.#" "#.#.#" "#.#.#" ".#.#."},
+    {'X', "#...#" "#...#" ".#.#." "..#.." ".#.#." "#...#" "#...#"},
+    {'Y', "#...#" "#...#" ".#.#." "..#.." "..#.." "..#.." "..#.."},
+    {'Z', "#####" "....#" "...#." "..#.." ".#..." "#...." "#####"},
+};
+
+constexpr int source_width = 5;
+constexpr int source_height = 7;
+
+template <int Scale>
+struct Atlas {
+    static constexpr int width = source_width * Scale;
+    static constexpr int height = source_height * Scale;
+    static_assert(height <= 32, "columns are 32-bit words");
+    uint32_t columns[Font::glyph_count * width];
+};
+
+template <int Scale>
+constexpr Atlas<Scale> build_atlas() {
+    Atlas<Scale> atlas{};
+    for (const GlyphSource &g : glyphs) {
+        uint32_t *out = atlas.columns + size_t(g.c - Font::first_char) * Atlas<Scale>::width;
+        for (int x = 0; x < Atlas<Scale>::width; x++) {
+            uint32_t bits = 0;
+            for (int y = 0; y < Atlas<Scale>::height; y++) {
+                if (g.rows[(y / Scale) * source_width + x / Scale] == '#') bits |= 1u << y;
+            }
+            out[x] = bits;
+        }
+    }
+    return atlas;
+}
+
+inline constexpr Atlas<1> atlas_small = build_atlas<1>();
+inline constexpr Atlas<3> atlas_large = build_atlas<3>();
+
+// The middle column of '1' is solid: proof the table is built by the compiler.
+static_assert(atlas_small.columns[('1' - Font::first_char) * 5 + 2] == 0x7f, "font atlas");
+
+} // namespace font_detail
+
+/// 5x7 text, 6 pixels per character.
+inline constexpr Font font_small{5, 7, 1, font_detail::atlas_small.columns};
+/// 15x21 (5x7 tripled), for the room temperature.
+inline constexpr Font font_large{15, 21, 3, font_detail::atlas_large.columns};
+
+} // namespace thermo
@@ -0,0 +1,241 @@
+#include "history.h"
+
+#include <cstring>
+
+#include "flash_log.h"
+
+namespace thermo {
+
+static_assert(HistoryChunkWriter::chunk_size <= FlashLog::max_record_size,
+              "a history chunk must fit one flash log record");
+
+// --- summary -----------------------------------------------------------------
+
+void HistorySummary::add(uint32_t t, int16_t centi) {
+    if (!count) {
+        t_first = t;
+        min = max = centi;
+    }
+    t_last = t;
+    if (centi < min) min = centi;
+    if (centi > max) max = centi;
+    sum += centi;
+    count++;
+}
+
+void HistorySummary::merge(const HistorySummary &o) {
+    if (!o.count) return;
+    if (!count) {
+        *this = o;
+        return;
+    }
+    if (o.t_first < t_first) t_first = o.t_first;
+    if (o.t_last > t_last) t_last = o.t_last;
+    if (o.min < min) min = o.min;
+    if (o.max > max) max = o.max;
+    sum += o.sum;
+    count += o.count;
+}
+
+// --- encoding ------------------------------------------------------------------
+
+static inline uint32_t zigzag(int32_t v) {
+    return (uint32_t(v) << 1) ^ uint32_t(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v) {
+    return int32_t(v >> 1) ^ -int32_t(v & 1);
+}
+
+static inline size_t put_varint(uint8_t *p, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = uint8_t(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = uint8_t(v);
+    return n;
+}
+
+static inline bool get_varint(const uint8_t *p, size_t len, size_t &pos, uint32_t &v) {
+    v = 0;
+    for (unsigned shift = 0; shift < 35 && pos < len; shift += 7) {
+        uint8_t b = p[pos++];
+        v |= uint32_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// Header: t_first u32 | t_last u32 | count u16 | min i16 | max i16 | pad u16
+//         | sum i32 | first sample i16 | payload length u16
+static void write_header(uint8_t *p, const HistorySummary &s, int16_t first, uint16_t len) {
+    uint16_t count = uint16_t(s.count);
+    int32_t sum = int32_t(s.sum);
+    memcpy(p + 0, &s.t_first, 4);
+    memcpy(p + 4, &s.t_last, 4);
+    memcpy(p + 8, &count, 2);
+    memcpy(p + 10, &s.min, 2);
+    memcpy(p + 12, &s.max, 2);
+    memset(p + 14, 0, 2);
+    memcpy(p + 16, &sum, 4);
+    memcpy(p + 20, &first, 2);
+    memcpy(p + 22, &len, 2);
+}
+
+static bool read_header(const uint8_t *p, size_t len, HistorySummary &s, int16_t &first,
+                        uint16_t &payload) {
+    if (len < HistoryChunkWriter::header_size) return false;
+    uint16_t count;
+    int32_t sum;
+    memcpy(&s.t_first, p + 0, 4);
+    memcpy(&s.t_last, p + 4, 4);
+    memcpy(&count, p + 8, 2);
+    memcpy(&s.min, p + 10, 2);
+    memcpy(&s.max, p + 12, 2);
+    memcpy(&sum, p + 16, 4);
+    s.count = count;
+    s.sum = sum;
+    memcpy(&first, p + 20, 2);
+    memcpy(&payload, p + 22, 2);
+    return s.count > 0 && HistoryChunkWriter::header_size + payload <= len;
+}
+
+void HistoryChunkWriter::reset() {
+    summary_ = HistorySummary();
+    len_ = header_size;
+    prev_dt_ = 0;
+}
+
+bool HistoryChunkWriter::append(uint32_t t, int16_t centi) {
+    if (summary_.count == 0) {
+        summary_.add(t, centi);
+        first_centi_ = centi;
+        prev_t_ = t;
+        prev_centi_ = centi;
+        return true;
+    }
+    if (summary_.count == UINT16_MAX || t < prev_t_) return false;
+
+    int32_t dt = int32_t(t - prev_t_);
+    int32_t dod = dt - prev_dt_;
+    uint32_t head = zigzag(int32_t(centi) - prev_centi_) << 1 | (dod != 0);
+    // Worst case: 3-byte head (17 bits) + 5-byte dod.
+    uint8_t tmp[8];
+    size_t n = put_varint(tmp, head);
+    if (dod) n += put_varint(tmp + n, zigzag(dod));
+    if (len_ + n > chunk_size) return false;
+
+    memcpy(buf_ + len_, tmp, n);
+    len_ += n;
+    summary_.add(t, centi);
+    prev_t_ = t;
+    prev_dt_ = dt;
+    prev_centi_ = centi;
+    return true;
+}
+
+const uint8_t *HistoryChunkWriter::data() {
+    write_header(buf_, summary_, first_centi_, uint16_t(len_ - header_size));
+    return buf_;
+}
+
+// --- decoding ------------------------------------------------------------------
+
+bool HistoryChunkReader::open(const uint8_t *data, size_t len) {
+    int16_t first;
+    uint16_t payload;
+    if (!read_header(data, len, summary_, first, payload)) return false;
+    data_ = data;
+    len_ = HistoryChunkWriter::header_size + payload;
+    pos_ = HistoryChunkWriter::header_size;
+    index_ = 0;
+    t_ = summary_.t_first;
+    dt_ = 0;
+    centi_ = first;
+    return true;
+}
+
+bool HistoryChunkReader::next(uint32_t &t, int16_t &centi) {
+    if (!data_ || index_ >= summary_.count) return false;
+    if (index_ > 0) {
+        uint32_t head;
+        if (!get_varint(data_, len_, pos_, head)) return false;
+        if (head & 1) {
+            uint32_t dod;
+            if (!get_varint(data_, len_, pos_, dod)) return false;
+            dt_ += unzigzag(dod);
+        }
+        t_ += uint32_t(dt_);
+        centi_ = int16_t(centi_ + unzigzag(head >> 1));
+    }
+    index_++;
+    t = t_;
+    centi = centi_;
+    return true;
+}
+
+// --- range queries -------------------------------------------------------------
+
+void HistoryRangeQuery::add_chunk(const uint8_t *data, size_t len) {
+    HistoryChunkReader reader;
+    if (!reader.open(data, len)) return;
+    const HistorySummary &s = reader.summary();
+    if (s.t_last < t0_ || s.t_first > t1_) return;
+    if (s.t_first >= t0_ && s.t_last <= t1_) {
+        result_.merge(s);
+        summarised_++;
+        return;
+    }
+    decoded_++;
+    uint32_t t;
+    int16_t centi;
+    while (reader.next(t, centi)) {
+        if (t > t1_) break;
+        if (t >= t0_) result_.add(t, centi);
+    }
+}
+
+// --- store -----------------------------------------------------------------------
+
+void HistoryStore::append(uint32_t t, int16_t centi) {
+    if (current_.append(t, centi)) return;
+    flush();
+    current_.append(t, centi);
+}
+
+void HistoryStore::flush() {
+    if (current_.empty()) return;
+    // A chunk all but fills a log page, so programming the page straight
+    // away costs a few bytes and makes the chunk durable (and visible to
+    // query()) now rather than when the next record arrives.
+    log_.append(record_type, current_.data(), current_.size());
+    log_.flush();
+    current_.reset();
+}
+
+HistorySummary HistoryStore::query(uint32_t t0, uint32_t t1) {
+    HistoryRangeQuery q(t0, t1);
+    for_each_chunk(
+        [](void *ctx, const uint8_t *data, size_t len) {
+            static_cast<HistoryRangeQuery *>(ctx)->add_chunk(data, len);
+        },
+        &q);
+    return q.result();
+}
+
+void HistoryStore::for_each_chunk(ChunkVisitor fn, void *ctx) {
+    struct Filter {
+        ChunkVisitor fn;
+        void *ctx;
+    } filter{fn, ctx};
+    log_.for_each(
+        [](void *p, uint8_t type, const uint8_t *data, size_t len) {
+            const Filter &f = *static_cast<const Filter *>(p);
+            if (type == record_type) f.fn(f.ctx, data, len);
+        },
+        &filter);
+    if (!current_.empty()) fn(ctx, current_.data(), current_.size());
+}
+
+} // namespace thermo
@@ -0,0 +1,127 @@
+// Compressed temperature history.
+//
+// Samples (timestamp in seconds, temperature in centi-degrees) are packed
+// into self-contained chunks of at most chunk_size bytes. Each chunk starts
+// with a summary header (time range, count, min, max, sum) followed by the
+// first sample in full and then one entry per further sample:
+//
+//   varint( zigzag(temperature delta) << 1 | (timestamp delta-of-delta != 0) )
+//   [ varint( zigzag(delta-of-delta) ) ]    only when the flag bit is set
+//
+// At a fixed sample interval with slowly changing readings that is one byte
+// per sample. Range queries use the headers of chunks that lie entirely
+// inside the range and decode only the (at most two) chunks on its edges.
+//
+// HistoryStore fills a chunk in RAM and appends it to the flash log as one
+// record (one page) when full.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace thermo {
+
+class FlashLog;
+
+/// Count, extremes and sum of a run of samples. Wide enough to summarise
+/// years of minute samples; a chunk header stores the narrow form.
+struct HistorySummary {
+    uint32_t t_first = 0;
+    uint32_t t_last = 0;
+    uint32_t count = 0;
+    int16_t min = 0;
+    int16_t max = 0;
+    int64_t sum = 0;
+
+    void add(uint32_t t, int16_t centi);
+    void merge(const HistorySummary &o);
+    float mean() const { return count ? float(double(sum) / count) : 0.0f; }
+};
+
+class HistoryChunkWriter {
+public:
+    // Fits one flash log record.
+    static constexpr size_t chunk_size = 240;
+    static constexpr size_t header_size = 24;
+
+    HistoryChunkWriter() { reset(); }
+
+    void reset();
+    /// False if the sample does not fit; seal the chunk and start another.
+    bool append(uint32_t t, int16_t centi);
+
+    bool empty() const { return summary_.count == 0; }
+    const HistorySummary &summary() const { return summary_; }
+    /// Header plus encoded samples, ready to store.
+    const uint8_t *data();
+    size_t size() const { return len_; }
+
+private:
+    HistorySummary summary_;
+    uint32_t prev_t_ = 0;
+    int32_t prev_dt_ = 0;
+    int16_t prev_centi_ = 0;
+    int16_t first_centi_ = 0;
+    size_t len_ = header_size;
+    uint8_t buf_[chunk_size];
+};
+
+class HistoryChunkReader {
+public:
+    /// False if `data` is not a well-formed chunk.
+    bool open(const uint8_t *data, size_t len);
+    const HistorySummary &summary() const { return summary_; }
+    /// Next sample, oldest first; false at the end.
+    bool next(uint32_t &t, int16_t &centi);
+
+private:
+    HistorySummary summary_;
+    const uint8_t *data_ = nullptr;
+    size_t len_ = 0;
+    size_t pos_ = 0;
+    uint16_t index_ = 0;
+    uint32_t t_ = 0;
+    int32_t dt_ = 0;
+    int16_t centi_ = 0;
+};
+
+/// Summary of [t0, t1] over a set of chunks: whole chunks by header, edge
+/// chunks by decoding. Feed every chunk, in any order.
+class HistoryRangeQuery {
+public:
+    HistoryRangeQuery(uint32_t t0, uint32_t t1) : t0_(t0), t1_(t1) {}
+
+    void add_chunk(const uint8_t *data, size_t len);
+    const HistorySummary &result() const { return result_; }
+    uint32_t chunks_decoded() const { return decoded_; }
+    uint32_t chunks_summarised() const { return summarised_; }
+
+private:
+    uint32_t t0_, t1_;
+    HistorySummary result_;
+    uint32_t decoded_ = 0;
+    uint32_t summarised_ = 0;
+};
+
+class HistoryStore {
+public:
+    static constexpr uint8_t record_type = 0x11;  // flash log record type of a chunk
+
+    explicit HistoryStore(FlashLog &log) : log_(log) {}
+
+    void append(uint32_t t, int16_t centi);
+    /// Write the partial chunk now (e.g. before a planned shutdown).
+    void flush();
+    /// min/max/mean over [t0, t1] from flash plus the chunk still in RAM.
+    HistorySummary query(uint32_t t0, uint32_t t1);
+
+    using ChunkVisitor = void (*)(void *ctx, const uint8_t *data, size_t len);
+    /// Every chunk on flash, oldest first, then the one still in RAM.
+    void for_each_chunk(ChunkVisitor fn, void *ctx);
+
+private:
+    FlashLog &log_;
+    HistoryChunkWriter current_;
+};
+
+} // namespace thermo
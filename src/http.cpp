@@ -0,0 +1,667 @@
+#include "http.h"
+
+#include <cstring>
+
+#if !PICO_ON_DEVICE
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace thermo {
+
+namespace {
+
+const char *reason(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 414: return "URI Too Long";
+    default: return "Internal Server Error";
+    }
+}
+
+// Error bodies, sent by reference like the assets.
+const char *error_body(int status) {
+    switch (status) {
+    case 400: return "{\"error\":\"bad request\"}";
+    case 404: return "{\"error\":\"not found\"}";
+    case 405: return "{\"error\":\"method not allowed\"}";
+    case 414: return "{\"error\":\"uri too long\"}";
+    default: return "{\"error\":\"internal\"}";
+    }
+}
+
+char lower(char c) {
+    return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+}
+
+bool equal_nocase(const char *a, size_t len, const char *b) {
+    for (size_t i = 0; i < len; i++) {
+        if (!b[i] || lower(a[i]) != b[i]) return false;
+    }
+    return !b[len];
+}
+
+// Whether `needle` (lower case) occurs in a[0, len), ignoring case.
+bool contains_nocase(const char *a, size_t len, const char *needle) {
+    const size_t n = strlen(needle);
+    for (size_t i = 0; i + n <= len; i++) {
+        if (equal_nocase(a + i, n, needle)) return true;
+    }
+    return false;
+}
+
+bool contains(const char *a, size_t len, const char *needle) {
+    const size_t n = strlen(needle);
+    for (size_t i = 0; i + n <= len; i++) {
+        if (!memcmp(a + i, needle, n)) return true;
+    }
+    return false;
+}
+
+// Appends into [p, end); the caller sizes the buffer for the worst case.
+struct Text {
+    char *p;
+    char *end;
+    bool overflow = false;
+
+    void put(const char *s) {
+        while (*s) put(*s++);
+    }
+    void put(char c) {
+        if (p < end) {
+            *p++ = c;
+        } else {
+            overflow = true;
+        }
+    }
+    void put_u32(uint32_t v) {
+        char digits[10];
+        size_t n = 0;
+        do {
+            digits[n++] = char('0' + v % 10);
+            v /= 10;
+        } while (v);
+        while (n) put(digits[--n]);
+    }
+};
+
+} // namespace
+
+const WebAsset *web_asset_find(const char *path, size_t len) {
+    for (size_t i = 0; i < web_asset_count; i++) {
+        const WebAsset &a = web_assets[i];
+        if (!strncmp(a.path, path, len) && !a.path[len]) return &a;
+    }
+    return nullptr;
+}
+
+// --- JSON ----------------------------------------------------------------------
+
+void JsonWriter::put(char c) {
+    if (len_ < cap_) {
+        buf_[len_++] = c;
+    } else {
+        overflow_ = true;
+    }
+}
+
+void JsonWriter::put(const char *s) {
+    while (*s) put(*s++);
+}
+
+void JsonWriter::begin_object() {
+    put('{');
+    first_ = true;
+}
+
+void JsonWriter::end_object() {
+    put('}');
+    first_ = false;
+}
+
+void JsonWriter::key(const char *name) {
+    if (!first_) put(',');
+    first_ = false;
+    put('"');
+    put(name);
+    put("\":");
+}
+
+void JsonWriter::value(int32_t v) {
+    Text t{buf_ + len_, buf_ + cap_};
+    if (v < 0) t.put('-');
+    t.put_u32(v < 0 ? 0u - uint32_t(v) : uint32_t(v));
+    len_ = size_t(t.p - buf_);
+    overflow_ |= t.overflow;
+}
+
+void JsonWriter::value_centi(int32_t v) {
+    Text t{buf_ + len_, buf_ + cap_};
+    if (v < 0) t.put('-');
+    const uint32_t a = v < 0 ? 0u - uint32_t(v) : uint32_t(v);
+    t.put_u32(a / 100);
+    t.put('.');
+    t.put(char('0' + a / 10 % 10));
+    t.put(char('0' + a % 10));
+    len_ = size_t(t.p - buf_);
+    overflow_ |= t.overflow;
+}
+
+void JsonWriter::value(bool v) {
+    put(v ? "true" : "false");
+}
+
+void JsonWriter::value(const char *s) {
+    put('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') put('\\');
+        if (uint8_t(*s) >= 0x20) put(*s);
+    }
+    put('"');
+}
+
+// --- requests ------------------------------------------------------------------
+
+bool HttpRequest::param(const char *name, const char **value, size_t *len) const {
+    const size_t n = strlen(name);
+    size_t i = 0;
+    while (i < query_len) {
+        size_t end = i;
+        while (end < query_len && query[end] != '&') end++;
+        if (end - i > n && query[i + n] == '=' && !memcmp(query + i, name, n)) {
+            *value = query + i + n + 1;
+            *len = end - i - n - 1;
+            return true;
+        }
+        i = end + 1;
+    }
+    return false;
+}
+
+bool HttpRequest::param_centi(const char *name, int32_t *centi) const {
+    const char *v;
+    size_t len;
+    if (!param(name, &v, &len) || !len) return false;
+    size_t i = 0;
+    const bool negative = v[0] == '-';
+    if (negative) i++;
+    int32_t whole = 0, frac = 0, places = 0;
+    bool digits = false, point = false;
+    for (; i < len; i++) {
+        if (v[i] == '.' && !point) {
+            point = true;
+        } else if (v[i] >= '0' && v[i] <= '9') {
+            digits = true;
+            if (!point) {
+                if (whole > 100'000) return false;
+                whole = whole * 10 + (v[i] - '0');
+            } else if (places < 2) {
+                frac = frac * 10 + (v[i] - '0');
+                places++;
+            }
+        } else {
+            return false;
+        }
+    }
+    if (!digits) return false;
+    if (places == 1) frac *= 10;
+    *centi = (negative ? -1 : 1) * (whole * 100 + frac);
+    return true;
+}
+
+// --- server --------------------------------------------------------------------
+
+HttpServer::HttpServer(HttpTransport &transport) : transport_(transport) {
+    transport_.attach(this);
+}
+
+bool HttpServer::add_json(const char *path, HttpJsonHandler fn, void *ctx) {
+    if (route_count_ == max_routes) return false;
+    routes_[route_count_++] = {path, fn, ctx};
+    return true;
+}
+
+size_t HttpServer::connections() const {
+    size_t n = 0;
+    for (const Connection &c : conns_) n += c.state != State::closed;
+    return n;
+}
+
+void HttpServer::poll() {
+    if (!listening_) listening_ = transport_.listen();
+    transport_.poll();
+    for (uint8_t i = 0; i < max_connections; i++) {
+        if (conns_[i].state == State::respond) pump(i);
+    }
+}
+
+void HttpServer::reset(Connection &c) {
+    c.state = State::request;
+    c.method = HttpMethod::other;
+    c.keep_alive = false;
+    c.overlong = false;
+    c.not_modified = false;
+    c.status = 0;
+    c.asset = nullptr;
+    c.route = nullptr;
+    c.body_left = 0;
+    c.line_len = 0;
+    c.query_len = 0;
+    c.out_start = c.out_len = 0;
+    c.body = nullptr;
+    c.body_len = 0;
+    c.queued = c.reported = 0;
+    c.waiting_since = seq_++;
+}
+
+int HttpServer::on_accept() {
+    int slot = -1;
+    for (uint8_t i = 0; i < max_connections && slot < 0; i++) {
+        if (conns_[i].state == State::closed) slot = i;
+    }
+    if (slot < 0) {
+        // Full: a keep-alive connection between requests, with nothing in
+        // flight, makes way, the one waiting longest first.
+        for (uint8_t i = 0; i < max_connections; i++) {
+            const Connection &c = conns_[i];
+            if (c.state != State::request || c.line_len || c.overlong) continue;
+            if (slot < 0 || c.waiting_since - conns_[slot].waiting_since > UINT32_MAX / 2) {
+                slot = i;
+            }
+        }
+        if (slot < 0) {
+            stats_.refused++;
+            return -1;
+        }
+        transport_.close(uint8_t(slot));
+        stats_.evicted++;
+    }
+    reset(conns_[slot]);
+    stats_.accepted++;
+    const uint32_t n = uint32_t(connections());
+    if (n > stats_.peak_connections) stats_.peak_connections = n;
+    return slot;
+}
+
+void HttpServer::on_closed(uint8_t conn) {
+    conns_[conn].state = State::closed;
+}
+
+size_t HttpServer::on_receive(uint8_t conn, const uint8_t *data, size_t len) {
+    Connection &c = conns_[conn];
+    size_t used = 0;
+    while (used < len) {
+        if (c.state == State::body) {
+            const size_t n = len - used < c.body_left ? len - used : c.body_left;
+            used += n;
+            c.body_left -= uint32_t(n);
+            if (!c.body_left) respond(conn);
+            continue;
+        }
+        if (c.state != State::request && c.state != State::headers) break;
+        const char ch = char(data[used++]);
+        if (ch == '\n') {
+            line_done(conn);
+        } else if (ch != '\r') {
+            if (c.line_len < max_line - 1) {
+                c.line[c.line_len++] = ch;
+            } else {
+                c.overlong = true;
+            }
+        }
+    }
+    return used;
+}
+
+void HttpServer::line_done(uint8_t conn) {
+    Connection &c = conns_[conn];
+    c.line[c.line_len] = 0;
+    if (c.state == State::request) {
+        // Blank lines before a request are allowed.
+        if (c.line_len || c.overlong) {
+            request_line(c);
+            c.state = State::headers;
+        }
+    } else if (c.line_len || c.overlong) {
+        header_line(c);
+    } else if (c.body_left) {
+        c.state = State::body;
+    } else {
+        respond(conn);
+    }
+    c.line_len = 0;
+    c.overlong = false;
+}
+
+void HttpServer::request_line(Connection &c) {
+    if (c.overlong) {
+        c.status = 414;
+        return;
+    }
+    // METHOD SP target SP HTTP/1.x
+    const char *line = c.line;
+    const char *sp1 = strchr(line, ' ');
+    const char *sp2 = sp1 ? strchr(sp1 + 1, ' ') : nullptr;
+    if (!sp2 || strncmp(sp2 + 1, "HTTP/1.", 7)) {
+        c.status = 400;
+        return;
+    }
+    const size_t method_len = size_t(sp1 - line);
+    if (method_len == 3 && !memcmp(line, "GET", 3)) {
+        c.method = HttpMethod::get;
+    } else if (method_len == 4 && !memcmp(line, "HEAD", 4)) {
+        c.method = HttpMethod::head;
+    } else if (method_len == 4 && !memcmp(line, "POST", 4)) {
+        c.method = HttpMethod::post;
+    }
+    c.keep_alive = sp2[8] == '1';  // 1.1 keeps the connection by default
+
+    const char *path = sp1 + 1;
+    const char *q = static_cast<const char *>(memchr(path, '?', size_t(sp2 - path)));
+    const size_t path_len = size_t((q ? q : sp2) - path);
+    if (q) {
+        const size_t n = size_t(sp2 - q - 1);
+        if (n >= max_query) {
+            c.status = 414;
+            return;
+        }
+        memcpy(c.query, q + 1, n);
+        c.query_len = uint8_t(n);
+    }
+
+    for (size_t i = 0; i < route_count_; i++) {
+        if (!strncmp(routes_[i].path, path, path_len) && !routes_[i].path[path_len]) {
+            c.route = &routes_[i];
+            if (c.method == HttpMethod::other) c.status = 405;
+            return;
+        }
+    }
+    c.asset = path_len == 1 ? web_asset_find("/index.html", 11)
+                            : web_asset_find(path, path_len);
+    if (!c.asset) {
+        c.status = 404;
+    } else if (c.method != HttpMethod::get && c.method != HttpMethod::head) {
+        c.status = 405;
+    }
+}
+
+void HttpServer::header_line(Connection &c) {
+    if (c.overlong) return;
+    const char *colon = strchr(c.line, ':');
+    if (!colon) return;
+    const size_t name_len = size_t(colon - c.line);
+    const char *value = colon + 1;
+    while (*value == ' ' || *value == '\t') value++;
+    const size_t value_len = strlen(value);
+
+    if (equal_nocase(c.line, name_len, "if-none-match")) {
+        c.not_modified = c.asset && (contains(value, value_len, c.asset->etag) ||
+                                     (value_len == 1 && value[0] == '*'));
+    } else if (equal_nocase(c.line, name_len, "connection")) {
+        if (contains_nocase(value, value_len, "close")) c.keep_alive = false;
+        if (contains_nocase(value, value_len, "keep-alive")) c.keep_alive = true;
+    } else if (equal_nocase(c.line, name_len, "content-length")) {
+        uint32_t n = 0;
+        for (const char *p = value; *p >= '0' && *p <= '9' && n < 100'000'000; p++) {
+            n = n * 10 + uint32_t(*p - '0');
+        }
+        c.body_left = n;
+    }
+}
+
+size_t HttpServer::render_head(Connection &c, int status, const char *type, size_t length,
+                               const char *extra) {
+    Text t{reinterpret_cast<char *>(c.out), reinterpret_cast<char *>(c.out) + out_bytes};
+    t.put("HTTP/1.1 ");
+    t.put_u32(uint32_t(status));
+    t.put(' ');
+    t.put(reason(status));
+    t.put("\r\n");
+    if (type) {
+        t.put("Content-Type: ");
+        t.put(type);
+        t.put("\r\n");
+    }
+    if (status != 304) {
+        t.put("Content-Length: ");
+        t.put_u32(uint32_t(length));
+        t.put("\r\n");
+    }
+    if (extra) t.put(extra);
+    t.put(c.keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+    return size_t(t.p - reinterpret_cast<char *>(c.out));
+}
+
+void HttpServer::respond(uint8_t conn) {
+    Connection &c = conns_[conn];
+    c.state = State::respond;
+    stats_.requests++;
+    const bool head_only = c.method == HttpMethod::head;
+    if (!c.status && c.route) {
+        respond_json(c);
+    } else if (!c.status) {
+        const WebAsset &a = *c.asset;
+        // Revalidated on every load, so a new image shows at once; unchanged
+        // assets cost a header each way.
+        char extra[96];
+        Text t{extra, extra + sizeof(extra) - 1};
+        if (!c.not_modified) t.put("Content-Encoding: gzip\r\n");
+        t.put("ETag: ");
+        t.put(a.etag);
+        t.put("\r\nCache-Control: no-cache\r\n");
+        *t.p = 0;
+        if (c.not_modified) {
+            stats_.not_modified++;
+            c.out_len = uint16_t(render_head(c, 304, nullptr, 0, extra));
+        } else {
+            c.out_len = uint16_t(render_head(c, 200, a.type, a.size, extra));
+            if (!head_only) {
+                c.body = a.data;
+                c.body_len = a.size;
+            }
+        }
+    } else {
+        // The request may not have been read to its end.
+        if (c.status == 400 || c.status == 414) c.keep_alive = false;
+        stats_.errors++;
+        const char *body = error_body(c.status);
+        const size_t len = strlen(body);
+        c.out_len = uint16_t(render_head(c, c.status, "application/json", len, nullptr));
+        if (!head_only) {
+            c.body = reinterpret_cast<const uint8_t *>(body);
+            c.body_len = uint32_t(len);
+        }
+    }
+    pump(conn);
+}
+
+void HttpServer::respond_json(Connection &c) {
+    char *body = reinterpret_cast<char *>(c.out + head_room);
+    JsonWriter w(body, out_bytes - head_room);
+    const HttpRequest request{c.method, c.query, c.query_len};
+    int status = c.route->fn(c.route->ctx, request, w);
+    if (w.overflow()) {
+        status = 500;
+        w = JsonWriter(body, out_bytes - head_room);
+        w.begin_object();
+        w.key("error");
+        w.value("response too long");
+        w.end_object();
+    }
+    if (status >= 400) stats_.errors++;
+    // Header first in the buffer, then moved up against the body.
+    const size_t head = render_head(c, status, "application/json", w.size(),
+                                    "Cache-Control: no-store\r\n");
+    c.out_start = uint16_t(head_room - head);
+    memmove(c.out + c.out_start, c.out, head);
+    c.out_len = uint16_t(head + (c.method == HttpMethod::head ? 0 : w.size()));
+}
+
+void HttpServer::pump(uint8_t conn) {
+    Connection &c = conns_[conn];
+    const uint32_t total = c.out_len + c.body_len;
+    while (c.queued < total) {
+        const size_t room = transport_.room(conn);
+        if (!room) break;
+        const uint8_t *p;
+        size_t n;
+        if (c.queued < c.out_len) {
+            p = c.out + c.out_start + c.queued;
+            n = c.out_len - c.queued;
+        } else {
+            p = c.body + (c.queued - c.out_len);
+            n = total - c.queued;
+        }
+        if (n > room) n = room;
+        if (!transport_.send(conn, p, n)) break;
+        c.queued += uint32_t(n);
+    }
+}
+
+void HttpServer::on_sent(uint8_t conn, size_t len) {
+    Connection &c = conns_[conn];
+    if (c.state != State::respond) return;
+    c.reported += uint32_t(len);
+    if (c.reported < c.out_len + c.body_len) {
+        pump(conn);
+        return;
+    }
+    stats_.body_bytes += c.body_len;
+    if (c.keep_alive) {
+        reset(c);  // the transport offers the next request on its next poll
+    } else {
+        transport_.close(conn);
+        c.state = State::closed;
+    }
+}
+
+#if !PICO_ON_DEVICE
+
+// --- host socket transport -----------------------------------------------------
+
+HttpSocketTransport::~HttpSocketTransport() {
+    for (Slot &s : slots_) {
+        if (s.fd >= 0) ::close(s.fd);
+    }
+    if (listen_ >= 0) ::close(listen_);
+}
+
+bool HttpSocketTransport::listen() {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port_);
+    if (inet_pton(AF_INET, address_, &addr.sin_addr) != 1) return false;
+    listen_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_ < 0) return false;
+    const int one = 1;
+    setsockopt(listen_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    socklen_t len = sizeof(addr);
+    if (bind(listen_, reinterpret_cast<const sockaddr *>(&addr), len) != 0 ||
+        ::listen(listen_, 16) != 0 ||
+        getsockname(listen_, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+        ::close(listen_);
+        listen_ = -1;
+        return false;
+    }
+    fcntl(listen_, F_SETFL, fcntl(listen_, F_GETFL) | O_NONBLOCK);
+    port_ = ntohs(addr.sin_port);
+    return true;
+}
+
+size_t HttpSocketTransport::room(uint8_t conn) {
+    const Slot &s = slots_[conn];
+    return s.fd >= 0 && s.count < max_pending ? 64 * 1024 : 0;
+}
+
+bool HttpSocketTransport::send(uint8_t conn, const uint8_t *data, size_t len) {
+    Slot &s = slots_[conn];
+    if (s.fd < 0 || s.count == max_pending) return false;
+    s.pending[(s.head + s.count) % max_pending] = {data, len};
+    s.count++;
+    return true;
+}
+
+void HttpSocketTransport::close(uint8_t conn) {
+    Slot &s = slots_[conn];
+    if (s.fd >= 0) ::close(s.fd);
+    s = Slot{};
+}
+
+void HttpSocketTransport::drop(uint8_t conn) {
+    close(conn);
+    server_->on_closed(conn);
+}
+
+// Writes what the socket takes and reports it; false if the connection went.
+bool HttpSocketTransport::flush(uint8_t conn) {
+    Slot &s = slots_[conn];
+    size_t sent = 0;
+    while (s.count) {
+        const Pending &p = s.pending[s.head];
+        const ssize_t n = ::send(s.fd, p.data + s.offset, p.len - s.offset, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            drop(conn);
+            return false;
+        }
+        sent += size_t(n);
+        s.offset += size_t(n);
+        if (s.offset < p.len) break;
+        s.offset = 0;
+        s.head = (s.head + 1) % max_pending;
+        s.count--;
+    }
+    if (sent) server_->on_sent(conn, sent);
+    return s.fd >= 0;
+}
+
+void HttpSocketTransport::poll() {
+    if (listen_ < 0) return;
+    for (;;) {
+        const int fd = accept(listen_, nullptr, nullptr);
+        if (fd < 0) break;
+        const int slot = server_->on_accept();
+        if (slot < 0) {
+            ::close(fd);
+            continue;
+        }
+        const int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        slots_[slot] = Slot{};
+        slots_[slot].fd = fd;
+    }
+
+    uint8_t buf[512];
+    for (uint8_t conn = 0; conn < HttpServer::max_connections; conn++) {
+        Slot &s = slots_[conn];
+        if (s.fd < 0 || !flush(conn)) continue;
+        const ssize_t n = ::recv(s.fd, buf, sizeof(buf), MSG_PEEK);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            drop(conn);
+            continue;
+        }
+        if (n < 0) continue;
+        const size_t used = server_->on_receive(conn, buf, size_t(n));
+        if (used) {
+            if (::recv(s.fd, buf, used, 0) < 0) {
+                drop(conn);
+                continue;
+            }
+            flush(conn);  // the response, at once
+        }
+    }
+}
+
+#endif
+
+} // namespace thermo
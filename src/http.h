@@ -0,0 +1,290 @@
+// HTTP/1.1 server for the installer's configuration page.
+//
+// Two kinds of response:
+//
+//  - The web UI (web_assets.h): gzipped at build time with an ETag. The body
+//    goes to the transport straight from the const array (XIP flash on the
+//    device) in pieces as the send buffer frees up; only the header is
+//    rendered. A request whose If-None-Match carries the ETag gets 304.
+//  - JSON endpoints registered with add_json(): the handler renders into the
+//    connection's fixed output buffer through a JsonWriter, and the header is
+//    written right-aligned in front of it once the length is known.
+//
+// Connections come from a fixed pool of max_connections and stay open
+// between requests (HTTP/1.1 keep-alive) unless the client says otherwise.
+// When the pool is full, a new connection takes the slot of the one that
+// has waited longest between requests; the lwIP transport also aborts
+// connections that stay silent for idle_polls polls.
+// One request per connection is handled at a time: while its response is
+// going out the connection takes no input, and the transport keeps what
+// arrived until it does. A header or request line longer than max_line is
+// ignored or refused, and only the few headers that matter are read.
+//
+// As with MqttTransport, bytes are sent by reference and must not change
+// until the transport reports them sent; everything runs from poll().
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "web_assets.h"
+
+struct tcp_pcb;  // lwIP
+struct pbuf;
+
+namespace thermo {
+
+class HttpServer;
+
+/// Accepts connections and moves bytes for HttpServer; connections are
+/// named by the server's slot numbers.
+class HttpTransport {
+public:
+    /// Start listening. False to be retried later (no network yet).
+    virtual bool listen() = 0;
+    /// Bytes send() would take on `conn` right now.
+    virtual size_t room(uint8_t conn) = 0;
+    /// Queue bytes without copying them: they must stay untouched until
+    /// on_sent() has reported them.
+    virtual bool send(uint8_t conn, const uint8_t *data, size_t len) = 0;
+    /// Close the connection; the server only does so once everything it
+    /// queued has been reported sent. No callback.
+    virtual void close(uint8_t conn) = 0;
+    /// Accept, send, and offer input to connections that take it.
+    virtual void poll() = 0;
+
+    void attach(HttpServer *server) { server_ = server; }
+
+protected:
+    ~HttpTransport() = default;
+    HttpServer *server_ = nullptr;
+};
+
+/// JSON into a fixed buffer; anything that does not fit marks it overflowed.
+class JsonWriter {
+public:
+    JsonWriter(char *buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+    void begin_object();
+    void end_object();
+    /// Starts a member; follow with one value.
+    void key(const char *name);
+    void value(int32_t v);
+    /// Hundredths as a decimal with two places: 2051 -> 20.51.
+    void value_centi(int32_t v);
+    void value(bool v);
+    void value(const char *s);
+
+    size_t size() const { return len_; }
+    bool overflow() const { return overflow_; }
+
+private:
+    void put(char c);
+    void put(const char *s);
+
+    char *buf_;
+    size_t cap_;
+    size_t len_ = 0;
+    bool overflow_ = false;
+    bool first_ = true;  // no member yet in the current object (no nesting past one)
+};
+
+enum class HttpMethod : uint8_t { get, head, post, other };
+
+struct HttpRequest {
+    HttpMethod method;
+    const char *query;  // after '?', not terminated
+    size_t query_len;
+
+    /// The value of query parameter `name` (not terminated), if present.
+    bool param(const char *name, const char **value, size_t *len) const;
+    /// A decimal parameter ("21.5") in hundredths.
+    bool param_centi(const char *name, int32_t *centi) const;
+};
+
+/// Renders the body of a JSON endpoint; returns the HTTP status.
+using HttpJsonHandler = int (*)(void *ctx, const HttpRequest &request, JsonWriter &out);
+
+struct HttpStats {
+    uint32_t accepted = 0;
+    uint32_t refused = 0;    // no free connection slot
+    uint32_t evicted = 0;    // idle keep-alive connections closed for a new one
+    uint32_t requests = 0;
+    uint32_t not_modified = 0;
+    uint32_t errors = 0;     // 4xx
+    uint32_t peak_connections = 0;
+    uint64_t body_bytes = 0; // sent by reference from assets
+};
+
+class HttpServer {
+public:
+    static constexpr size_t max_connections = 4;
+    static constexpr size_t max_routes = 4;
+    static constexpr size_t max_line = 128;
+    static constexpr size_t max_query = 48;
+    static constexpr size_t out_bytes = 512;
+    static constexpr size_t head_room = 192;  // header in front of a JSON body
+
+    explicit HttpServer(HttpTransport &transport);
+
+    /// Serve `path` (exact match) from a handler. False when the table is full.
+    bool add_json(const char *path, HttpJsonHandler fn, void *ctx);
+
+    void poll();
+
+    size_t connections() const;
+    const HttpStats &stats() const { return stats_; }
+
+    // Transport callbacks. on_accept() returns the new connection's slot,
+    // closing an idle keep-alive connection through the transport if it
+    // must, or -1 to refuse it; on_receive() returns how much it consumed.
+    int on_accept();
+    size_t on_receive(uint8_t conn, const uint8_t *data, size_t len);
+    void on_sent(uint8_t conn, size_t len);
+    void on_closed(uint8_t conn);
+
+private:
+    enum class State : uint8_t { closed, request, headers, body, respond };
+
+    struct Route {
+        const char *path;
+        HttpJsonHandler fn;
+        void *ctx;
+    };
+
+    struct Connection {
+        State state = State::closed;
+        HttpMethod method = HttpMethod::other;
+        bool keep_alive = false;
+        bool overlong = false;      // current line did not fit
+        bool not_modified = false;  // If-None-Match has the asset's ETag
+        int16_t status = 0;         // decided before the headers are read, or 0
+        const WebAsset *asset = nullptr;
+        const Route *route = nullptr;
+        uint32_t body_left = 0;     // request body to skip
+        uint16_t line_len = 0;
+        uint8_t query_len = 0;
+        char line[max_line];
+        char query[max_query];
+        // Response: out_len bytes from out (header, and a JSON body), then
+        // body_len bytes by reference.
+        uint16_t out_start = 0;
+        uint16_t out_len = 0;
+        const uint8_t *body = nullptr;
+        uint32_t body_len = 0;
+        uint32_t queued = 0;        // handed to the transport
+        uint32_t reported = 0;      // reported sent by it
+        uint32_t waiting_since = 0; // seq_ when it last became ready for a request
+        uint8_t out[out_bytes];
+    };
+
+    void reset(Connection &c);
+    void line_done(uint8_t conn);
+    void request_line(Connection &c);
+    void header_line(Connection &c);
+    void respond(uint8_t conn);
+    void respond_json(Connection &c);
+    size_t render_head(Connection &c, int status, const char *type, size_t length,
+                       const char *extra);
+    void pump(uint8_t conn);
+
+    HttpTransport &transport_;
+    bool listening_ = false;
+    Route routes_[max_routes];
+    size_t route_count_ = 0;
+    Connection conns_[max_connections];
+    uint32_t seq_ = 0;
+    HttpStats stats_;
+};
+
+#if PICO_ON_DEVICE
+
+#if THERMO_HTTP
+/// lwIP raw TCP (pico_cyw43_arch_lwip_poll): asset bodies are written
+/// without TCP_WRITE_FLAG_COPY, so lwIP sends them from flash.
+class HttpLwipTransport final : public HttpTransport {
+public:
+    /// lwIP polls each connection every poll_interval coarse timer ticks
+    /// (500 ms); one silent for idle_polls polls in a row is aborted.
+    static constexpr uint8_t poll_interval = 4;
+    static constexpr uint8_t idle_polls = 5;
+
+    explicit HttpLwipTransport(uint16_t port) : port_(port) {}
+    bool listen() override;
+    size_t room(uint8_t conn) override;
+    bool send(uint8_t conn, const uint8_t *data, size_t len) override;
+    void close(uint8_t conn) override;
+    void poll() override;
+
+private:
+    struct Slot {
+        HttpLwipTransport *self;
+        uint8_t conn;
+        tcp_pcb *pcb;
+        pbuf *held;    // received, not yet taken by the server
+        bool fin;      // the client closed; close once our data is acked
+        uint8_t idle;  // polls with nothing received or acked
+    };
+
+    // lwIP callbacks (err_t is int8_t).
+    static int8_t on_accept(void *arg, tcp_pcb *pcb, int8_t err);
+    static int8_t on_sent(void *arg, tcp_pcb *pcb, uint16_t len);
+    static int8_t on_recv(void *arg, tcp_pcb *pcb, pbuf *p, int8_t err);
+    static void on_error(void *arg, int8_t err);
+    static int8_t on_poll(void *arg, tcp_pcb *pcb);
+    void release(Slot &s, bool abort);
+    void feed(Slot &s);
+    void drop(Slot &s, bool abort = false);
+
+    uint16_t port_;
+    tcp_pcb *listen_ = nullptr;
+    bool aborted_ = false;  // a pcb was aborted inside a callback
+    Slot slots_[HttpServer::max_connections] = {};
+};
+#endif
+
+#else
+
+/// Non-blocking sockets. Input stays in the kernel until the server takes
+/// it (read with MSG_PEEK); output is sent from the caller's memory.
+class HttpSocketTransport final : public HttpTransport {
+public:
+    /// address: dotted IPv4 to bind; port 0 picks a free one (see port()).
+    HttpSocketTransport(const char *address, uint16_t port) : address_(address), port_(port) {}
+    ~HttpSocketTransport();
+    bool listen() override;
+    size_t room(uint8_t conn) override;
+    bool send(uint8_t conn, const uint8_t *data, size_t len) override;
+    void close(uint8_t conn) override;
+    void poll() override;
+
+    uint16_t port() const { return port_; }
+
+private:
+    struct Pending {
+        const uint8_t *data;
+        size_t len;
+    };
+    static constexpr size_t max_pending = 4;
+
+    struct Slot {
+        int fd = -1;
+        bool closing = false;
+        Pending pending[max_pending];
+        size_t head = 0;
+        size_t count = 0;
+        size_t offset = 0;
+    };
+
+    void drop(uint8_t conn);
+    bool flush(uint8_t conn);
+
+    const char *address_;
+    uint16_t port_;
+    int listen_ = -1;
+    Slot slots_[HttpServer::max_connections];
+};
+
+#endif
+
+} // namespace thermo
@@ -0,0 +1,173 @@
+// lwIP raw-API transport for the HTTP server on the Pico W (poll mode: the
+// callbacks run from cyw43_arch_poll() in the http task). Built with
+// THERMO_HTTP only.
+#include "http.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+#include "pico/cyw43_arch.h"
+
+namespace thermo {
+
+bool HttpLwipTransport::listen() {
+    tcp_pcb *pcb = tcp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!pcb) return false;
+    if (tcp_bind(pcb, IP_ANY_TYPE, port_) != ERR_OK) {
+        tcp_abort(pcb);
+        return false;
+    }
+    listen_ = tcp_listen_with_backlog(pcb, HttpServer::max_connections);
+    if (!listen_) {
+        tcp_abort(pcb);
+        return false;
+    }
+    tcp_arg(listen_, this);
+    tcp_accept(listen_, on_accept);
+    return true;
+}
+
+size_t HttpLwipTransport::room(uint8_t conn) {
+    tcp_pcb *pcb = slots_[conn].pcb;
+    // Each write by reference takes pbufs and segments from fixed pools;
+    // leave a few so the write does not fail half way.
+    if (!pcb || tcp_sndqueuelen(pcb) + 4 >= TCP_SND_QUEUELEN) return 0;
+    return tcp_sndbuf(pcb);
+}
+
+bool HttpLwipTransport::send(uint8_t conn, const uint8_t *data, size_t len) {
+    tcp_pcb *pcb = slots_[conn].pcb;
+    if (!pcb) return false;
+    // No TCP_WRITE_FLAG_COPY: the segments reference the bytes where they
+    // are, so asset bodies stream from flash through the XIP cache. This
+    // holds only while lwipopts.h leaves LWIP_NETIF_TX_SINGLE_PBUF off.
+    if (tcp_write(pcb, data, u16_t(len), 0) != ERR_OK) return false;
+    tcp_output(pcb);
+    return true;
+}
+
+// Detaches the slot from its pcb and ends the connection: gracefully, which
+// is safe only once everything queued has been acked (a graceful close
+// references no buffer of ours), or with a reset.
+void HttpLwipTransport::release(Slot &s, bool abort) {
+    if (!s.pcb) return;
+    tcp_arg(s.pcb, nullptr);
+    tcp_recv(s.pcb, nullptr);
+    tcp_sent(s.pcb, nullptr);
+    tcp_err(s.pcb, nullptr);
+    tcp_poll(s.pcb, nullptr, 0);
+    if (abort || tcp_close(s.pcb) != ERR_OK) {
+        tcp_abort(s.pcb);
+        aborted_ = true;
+    }
+    if (s.held) pbuf_free(s.held);
+    s.pcb = nullptr;
+    s.held = nullptr;
+}
+
+void HttpLwipTransport::close(uint8_t conn) {
+    release(slots_[conn], false);
+}
+
+void HttpLwipTransport::drop(Slot &s, bool abort) {
+    release(s, abort);
+    server_->on_closed(s.conn);
+}
+
+// Offers held input until the server stops taking it.
+void HttpLwipTransport::feed(Slot &s) {
+    while (s.held && s.pcb) {
+        tcp_pcb *pcb = s.pcb;
+        const size_t n = server_->on_receive(
+            s.conn, static_cast<const uint8_t *>(s.held->payload), s.held->len);
+        if (!n) break;
+        tcp_recved(pcb, u16_t(n));
+        if (!s.held) break;  // closed meanwhile
+        s.held = pbuf_free_header(s.held, u16_t(n));
+    }
+}
+
+void HttpLwipTransport::poll() {
+    cyw43_arch_poll();
+    for (Slot &s : slots_) {
+        if (s.held) feed(s);
+    }
+}
+
+err_t HttpLwipTransport::on_accept(void *arg, tcp_pcb *pcb, err_t err) {
+    auto *self = static_cast<HttpLwipTransport *>(arg);
+    if (err != ERR_OK || !pcb) return ERR_VAL;
+    const int conn = self->server_->on_accept();
+    if (conn < 0) {
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+    Slot &s = self->slots_[conn];
+    s = {self, uint8_t(conn), pcb, nullptr, false, 0};
+    tcp_arg(pcb, &s);
+    tcp_nagle_disable(pcb);
+    tcp_recv(pcb, on_recv);
+    tcp_sent(pcb, on_sent);
+    tcp_err(pcb, on_error);
+    tcp_poll(pcb, on_poll, poll_interval);
+    return ERR_OK;
+}
+
+err_t HttpLwipTransport::on_sent(void *arg, tcp_pcb *, u16_t len) {
+    Slot *s = static_cast<Slot *>(arg);
+    if (!s) return ERR_OK;
+    HttpLwipTransport *self = s->self;
+    self->aborted_ = false;
+    s->idle = 0;
+    self->server_->on_sent(s->conn, len);  // may close
+    // The client has gone: close once the last of the answer is acked.
+    if (s->pcb && s->fin && !tcp_sndqueuelen(s->pcb)) self->drop(*s);
+    return self->aborted_ ? ERR_ABRT : ERR_OK;
+}
+
+err_t HttpLwipTransport::on_recv(void *arg, tcp_pcb *, pbuf *p, err_t) {
+    Slot *s = static_cast<Slot *>(arg);
+    if (!s) {
+        if (p) pbuf_free(p);
+        return ERR_OK;
+    }
+    HttpLwipTransport *self = s->self;
+    self->aborted_ = false;
+    s->idle = 0;
+    if (!p) {
+        // The client closed. Anything still queued references our buffers
+        // and must be acked before the slot is reused; on_sent closes then.
+        s->fin = true;
+        if (!tcp_sndqueuelen(s->pcb)) self->drop(*s);
+    } else {
+        // Kept until the server takes it, which it does not while answering.
+        if (s->held) {
+            pbuf_cat(s->held, p);
+        } else {
+            s->held = p;
+        }
+        self->feed(*s);
+    }
+    return self->aborted_ ? ERR_ABRT : ERR_OK;
+}
+
+// Every poll_interval coarse ticks. A connection that has received nothing
+// and had nothing acked for idle_polls polls (a keep-alive client that went
+// away, or one stalled with data in flight) is reset to free its slot.
+err_t HttpLwipTransport::on_poll(void *arg, tcp_pcb *) {
+    Slot *s = static_cast<Slot *>(arg);
+    if (!s || ++s->idle < idle_polls) return ERR_OK;
+    s->self->drop(*s, true);
+    return ERR_ABRT;
+}
+
+void HttpLwipTransport::on_error(void *arg, err_t) {
+    // lwIP has already freed the pcb.
+    Slot *s = static_cast<Slot *>(arg);
+    if (!s) return;
+    s->pcb = nullptr;
+    if (s->held) pbuf_free(s->held);
+    s->held = nullptr;
+    s->self->server_->on_closed(s->conn);
+}
+
+} // namespace thermo
@@ -0,0 +1,47 @@
+// lwIP configuration for Pico W builds with THERMO_MQTT: raw API only, no
+// OS (pico_cyw43_arch_lwip_poll), and lwIP's own static heap so the no-heap
+// link check still holds.
+#pragma once
+
+#define NO_SYS 1
+#define LWIP_SOCKET 0
+#define LWIP_NETCONN 0
+#define MEM_LIBC_MALLOC 0
+#define MEM_ALIGNMENT 4
+#define MEM_SIZE 4000
+
+// The publisher writes by reference: one PBUF_REF pbuf per PUBLISH plus its
+// TCP header, at most MqttClient::buffers of them queued at once.
+#define MEMP_NUM_PBUF 16
+#define MEMP_NUM_TCP_SEG 32
+#define MEMP_NUM_ARP_QUEUE 10
+#define PBUF_POOL_SIZE 24
+
+#define LWIP_ARP 1
+#define LWIP_ETHERNET 1
+#define LWIP_ICMP 1
+#define LWIP_RAW 1
+#define LWIP_IPV4 1
+#define LWIP_TCP 1
+#define LWIP_UDP 1
+#define LWIP_DNS 1
+#define LWIP_DHCP 1
+#define DHCP_DOES_ARP_CHECK 0
+#define LWIP_DHCP_DOES_ACD_CHECK 0
+#define LWIP_TCP_KEEPALIVE 1
+
+#define TCP_MSS 1460
+#define TCP_WND (4 * TCP_MSS)
+#define TCP_SND_BUF (4 * TCP_MSS)
+#define TCP_SND_QUEUELEN ((4 * (TCP_SND_BUF) + (TCP_MSS - 1)) / (TCP_MSS))
+
+#define LWIP_NETIF_STATUS_CALLBACK 1
+#define LWIP_NETIF_LINK_CALLBACK 1
+#define LWIP_NETIF_HOSTNAME 1
+// LWIP_NETIF_TX_SINGLE_PBUF stays off: with it tcp_write() forces
+// TCP_WRITE_FLAG_COPY, copying every PUBLISH and asset into the lwIP heap.
+// The cyw43 netif gathers pbuf chains into its own frame buffer anyway.
+#define LWIP_CHKSUM_ALGORITHM 3
+
+#define LWIP_STATS 0
+#define LWIP_DEBUG 0
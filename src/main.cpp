@@ -0,0 +1,73 @@
+// Thermostat firmware entry point.
+#include "pico/stdlib.h"
+
+#include "app.h"
+#include "boot.h"
+#include "http.h"
+#include "mqtt.h"
+#include "power.h"
+#include "telemetry.h"
+
+#if PICO_ON_DEVICE && (THERMO_MQTT || THERMO_HTTP)
+#include "pico/cyw43_arch.h"
+#endif
+
+using namespace thermo;
+
+// GPIO (20 or 22) with a 32.768 kHz clock for the RTC, which lets the chip
+// go dormant between ticks; -1 if the board has none.
+#ifndef THERMO_RTC_CLOCK_GPIO
+#define THERMO_RTC_CLOCK_GPIO -1
+#endif
+
+int main() {
+    boot_mark(BootStage::main);
+    stdio_init_all();
+    boot_mark(BootStage::stdio);
+
+    static SystemClock clock;
+    AppConfig config;
+#if PICO_ON_DEVICE
+    // A fresh install tunes its PID gains to the house on first boot.
+    config.autotune = true;
+    // Wait between tasks in the deepest state that fits (see power.h).
+    static Rp2040PowerPort power(THERMO_RTC_CLOCK_GPIO);
+    config.power = &power;
+#endif
+#if PICO_ON_DEVICE && THERMO_LOW_POWER
+    // Battery installs: nothing on USB, so the waits may stop the clocks.
+    config.status_output = false;
+#elif PICO_ON_DEVICE && THERMO_TELEMETRY
+    // Binary telemetry takes the USB serial port over from the status line;
+    // read it with telemetry_decode from the host build.
+    static UsbCdcSink usb;
+    config.telemetry = &usb;
+    config.status_output = false;
+#endif
+#if PICO_ON_DEVICE && (THERMO_MQTT || THERMO_HTTP)
+    // Join the network in the background; the publisher keeps trying the
+    // broker, and the server keeps trying to listen, until the link is up.
+    if (cyw43_arch_init() == 0) {
+        cyw43_arch_enable_sta_mode();
+        cyw43_arch_wifi_connect_async(THERMO_WIFI_SSID, THERMO_WIFI_PASSWORD,
+                                      CYW43_AUTH_WPA2_AES_PSK);
+#if THERMO_MQTT
+        static LwipTransport broker(THERMO_MQTT_BROKER, 1883);
+        config.mqtt = &broker;
+#endif
+#if THERMO_HTTP
+        static HttpLwipTransport web(80);
+        config.http = &web;
+#endif
+    }
+#elif !PICO_ON_DEVICE
+    // The configuration page, for working on the web UI.
+    static HttpSocketTransport web("127.0.0.1", 8080);
+    config.http = &web;
+#endif
+    // Ports and the network link set up (joining happens later, on its own).
+    boot_mark(BootStage::network);
+    Scheduler &scheduler = app_init(clock, config);
+    app_start();
+    scheduler.run();
+}
@@ -0,0 +1,69 @@
+// Compile-time RAM budget for each subsystem's arena, in bytes. Override any
+// of these with -D to resize a subsystem; the link map report
+// (tools/ram_report.py) shows what each one actually reserves. Also where
+// the hot code lives.
+#pragma once
+
+// ADC block ring, filter stages and sensor state (core 1).
+#ifndef THERMO_RAM_SENSOR
+#define THERMO_RAM_SENSOR (5 * 1024)
+#endif
+
+// Core 1 -> core 0 reading queue.
+#ifndef THERMO_RAM_CORELINK
+#define THERMO_RAM_CORELINK 1024
+#endif
+
+// Scheduler task table, power manager, controller and application state
+// (core 0).
+#ifndef THERMO_RAM_CONTROL
+#define THERMO_RAM_CONTROL (2 * 1024 + 256)
+#endif
+
+// Flash log page buffer and settings cache, history chunk being filled.
+#ifndef THERMO_RAM_STORAGE
+#define THERMO_RAM_STORAGE 1536
+#endif
+
+// Peripheral buses: 1-Wire master and probe operation lists.
+#ifndef THERMO_RAM_BUS
+#define THERMO_RAM_BUS (2 * 1024)
+#endif
+
+// History rollup rings: a day of minutes, two weeks of hours, 400 days.
+#ifndef THERMO_RAM_HISTORY
+#define THERMO_RAM_HISTORY (26 * 1024)
+#endif
+
+// Display framebuffers (two when double-buffered) and renderer state.
+#ifndef THERMO_RAM_DISPLAY
+#define THERMO_RAM_DISPLAY (2 * 1024 + 256)
+#endif
+
+// Telemetry packet queue and the frame being filled.
+#ifndef THERMO_RAM_TELEMETRY
+#define THERMO_RAM_TELEMETRY 1536
+#endif
+
+// MQTT packet buffers the transport sends from, and the client's state;
+// HTTP connections, each with its request line and response buffer.
+#ifndef THERMO_RAM_NETWORK
+#define THERMO_RAM_NETWORK (7 * 1024)
+#endif
+
+// Hot paths (sampler interrupt, filter chain, sensing loop, control step,
+// scheduler dispatch) are defined as THERMO_HOT(name) in place of name. Built
+// with THERMO_LAYOUT=hot_in_ram they run from SRAM, copied there with .data at
+// boot and clear of XIP cache misses, at the cost of their size in RAM ("code
+// in RAM" in the report).
+#ifndef THERMO_HOT_IN_RAM
+#define THERMO_HOT_IN_RAM 0
+#endif
+
+// As the SDK's __not_in_flash_func, but variadic, for names with template
+// arguments.
+#if THERMO_HOT_IN_RAM && PICO_ON_DEVICE
+#define THERMO_HOT(...) __attribute__((section(".time_critical." #__VA_ARGS__))) __VA_ARGS__
+#else
+#define THERMO_HOT(...) __VA_ARGS__
+#endif
@@ -0,0 +1,123 @@
+#include "mpc.h"
+
+#include "memory_config.h"
+
+namespace thermo {
+
+using mpc::tables;
+
+template <typename T>
+void MpcController<T>::reset() {
+    rise_ = T(0);
+    baseline_ = T(0);
+    primed_ = false;
+    for (T &d : past_) d = T(0);
+    for (T &u : plan_) u = T(0);
+}
+
+// Runs when a model is learned or loaded, so the conversions are done in
+// float; the QP itself is formed in the backend type from the table.
+template <typename T>
+void MpcController<T>::set_model(float gain_c, float tau_s, float dead_s, float move_s,
+                                 const MpcWeights &weights) {
+    // A refined model keeps the input history and the baseline estimate, and
+    // the heat-induced rise in degrees; a first one starts clean.
+    const bool had_model = has_model_;
+    const T old_gain = gain_;
+    if (!had_model) reset();
+    has_model_ = gain_c > 0 && tau_s > 0 && move_s > 0;
+    if (!has_model_) return;
+
+    // Nearest grid point on a log scale: the midpoint between two points is
+    // at the geometric mean.
+    const float tau = tau_s / move_s;
+    const float midpoint = 1.0954451f;  // sqrt(tau_ratio)
+    uint32_t row = 0;
+    while (row + 1 < mpc::tau_points && tau > tables<T>.tau[row] * midpoint) row++;
+    row_ = uint8_t(row);
+    const float dead = dead_s / move_s + 0.5f;
+    dead_ = uint8_t(dead < mpc::max_dead ? uint32_t(dead) : mpc::max_dead);
+    a_ = T(1) - tables<T>.step[row][1];
+    gain_ = Numeric<T>::from_float(gain_c);
+    inv_gain_ = Numeric<T>::from_float(scale / gain_c);
+    if (had_model) rise_ = rise_ * old_gain * inv_gain_ * Numeric<T>::ratio(1, scale);
+    const float norm = float(scale * scale) / (gain_c * gain_c);
+    energy_ = Numeric<T>::from_float(weights.energy * norm);
+    move_ = Numeric<T>::from_float(weights.move * norm);
+
+    // Tracking term R'R over the horizon, plus the move-suppression term
+    // D'D, where D takes successive differences of the plan.
+    for (uint32_t j = 0; j < mpc::moves; j++) {
+        for (uint32_t l = j; l < mpc::moves; l++) {
+            T h(0);
+            for (uint32_t i = 1; i <= mpc::horizon; i++) h += response(i, j) * response(i, l);
+            if (l == j) h += move_ * (j + 1 < mpc::moves ? 2 : 1);
+            if (l == j + 1) h -= move_;
+            hessian_[j][l] = hessian_[l][j] = h;
+        }
+        const T diag = hessian_[j][j];
+        inv_diag_[j] = diag > T(0) ? T(1) / diag : T(0);
+    }
+}
+
+template <typename T>
+float MpcController<T>::tau_moves() const {
+    return tables<T>.tau[row_];
+}
+
+template <typename T>
+T THERMO_HOT(MpcController<T>::response)(uint32_t i, uint32_t j) const {
+    const int32_t n = int32_t(i) - int32_t(j) - int32_t(dead_);
+    if (n < 1) return T(0);
+    const T *step = tables<T>.step[row_];
+    // Each move is a pulse except the last, which is held to the horizon.
+    const T r = j + 1 < mpc::moves ? step[n] - step[n - 1] : step[n];
+    return r * scale;
+}
+
+template <typename T>
+T THERMO_HOT(MpcController<T>::update)(T temp_c, T setpoint) {
+    const T zero(0), one(1);
+    // Advance the model by the move just finished: the duty that reached the
+    // room then was applied `dead_` moves before it.
+    rise_ = a_ * rise_ + (one - a_) * past_[dead_];
+    const T observed = temp_c - rise_ * gain_;
+    baseline_ = primed_ ? baseline_ + (observed - baseline_) * Numeric<T>::ratio(1, 4) : observed;
+    primed_ = true;
+
+    // Free response: the duties already in the dead-time pipeline, then
+    // nothing. The errors it leaves give the QP's linear term.
+    const T target = (setpoint - baseline_) * inv_gain_;
+    T grad[mpc::moves] = {};
+    T rise = rise_;
+    for (uint32_t i = 1; i <= mpc::horizon; i++) {
+        const T input = i <= dead_ ? past_[dead_ - i] : zero;
+        rise = a_ * rise + (one - a_) * input;
+        const T error = target - rise * scale;
+        for (uint32_t j = 0; j < mpc::moves; j++) grad[j] -= response(i, j) * error;
+    }
+    for (uint32_t j = 0; j + 1 < mpc::moves; j++) grad[j] += energy_ * Numeric<T>::ratio(1, 2);
+    grad[mpc::moves - 1] +=
+        energy_ * Numeric<T>::ratio(int32_t(mpc::horizon - mpc::moves + 1), 2);
+    grad[0] -= move_ * past_[0];
+
+    // Warm start from the last plan moved on by one, then projected
+    // coordinate descent on the box 0 <= duty <= 1.
+    for (uint32_t j = 0; j + 1 < mpc::moves; j++) plan_[j] = plan_[j + 1];
+    for (uint32_t s = 0; s < mpc::sweeps; s++) {
+        for (uint32_t j = 0; j < mpc::moves; j++) {
+            T g = grad[j];
+            for (uint32_t l = 0; l < mpc::moves; l++) g += hessian_[j][l] * plan_[l];
+            plan_[j] = clamp(plan_[j] - g * inv_diag_[j], zero, one);
+        }
+    }
+
+    for (uint32_t k = mpc::max_dead; k > 0; k--) past_[k] = past_[k - 1];
+    past_[0] = plan_[0];
+    return plan_[0];
+}
+
+template class MpcController<float>;
+template class MpcController<Q16>;
+
+} // namespace thermo
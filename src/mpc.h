@@ -0,0 +1,135 @@
+// Model-predictive relay control over a first-order-plus-dead-time (FOPDT)
+// room model: full heat would raise the room `gain` degrees above where it
+// settles unheated, with time constant tau, after a dead time theta.
+//
+// Once per move (the relay's time-proportioning window) the controller
+// predicts the room over the next `horizon` moves and picks the duty of the
+// next `moves` moves, the last held to the end of the horizon, minimising
+//
+//   sum_i (setpoint - y_i)^2 + w_energy sum_j duty_j + w_move sum_j (duty_j - duty_j-1)^2
+//
+// subject to 0 <= duty <= 1, and applies the first. The baseline the model
+// rises above (outside temperature, gains) is not modelled: it is estimated
+// each move as the measurement minus the model's heat-induced rise, which
+// also absorbs model error, so the room settles on the setpoint.
+//
+// Prediction needs the model's step response over the horizon. With time in
+// moves that depends only on tau / move period, so it is tabulated at
+// compile time on a geometric grid of time constants; a model picks the
+// nearest row (within 10%). The device never evaluates exp(): forming the
+// QP when the model changes is a few hundred multiply-adds from the table,
+// and each move's solve is a horizon-length prediction plus a few
+// coordinate-descent sweeps over a 4 x 4 system.
+#pragma once
+
+#include <cstdint>
+
+#include "fixed.h"
+
+namespace thermo {
+
+namespace mpc {
+
+constexpr uint32_t horizon = 24;   // predicted moves
+constexpr uint32_t moves = 4;      // decided moves; the last is held to the horizon
+constexpr uint32_t max_dead = 16;  // dead time the input history covers, in moves
+constexpr uint32_t sweeps = 8;     // coordinate-descent passes per solve
+
+constexpr uint32_t tau_points = 48;
+constexpr double tau_first = 0.5;  // moves
+constexpr double tau_ratio = 1.2;  // grid spacing: up to ~2600 moves
+
+/// exp(x) for x <= 0, usable in constant expressions.
+constexpr double const_exp(double x) {
+    int halvings = 0;
+    while (x < -0.5) {
+        x /= 2;
+        halvings++;
+    }
+    double term = 1, sum = 1;
+    for (int n = 1; n < 16; n++) {
+        term *= x / n;
+        sum += term;
+    }
+    while (halvings--) sum *= sum;
+    return sum;
+}
+
+template <typename T>
+struct HorizonTables {
+    float tau[tau_points];               // grid, in moves
+    T step[tau_points][horizon + 1];     // unit step response n moves in: 1 - e^(-n / tau)
+};
+
+template <typename T>
+constexpr HorizonTables<T> make_tables() {
+    HorizonTables<T> t{};
+    double tau = tau_first;
+    for (uint32_t k = 0; k < tau_points; k++, tau *= tau_ratio) {
+        t.tau[k] = float(tau);
+        const double a = const_exp(-1.0 / tau);
+        double decay = 1;
+        for (uint32_t n = 0; n <= horizon; n++, decay *= a) {
+            t.step[k][n] = T(1.0 - decay);
+        }
+    }
+    return t;
+}
+
+template <typename T>
+inline constexpr HorizonTables<T> tables = make_tables<T>();
+
+} // namespace mpc
+
+struct MpcWeights {
+    float energy;  // cost of a move at full heat, in squared degrees
+    float move;    // cost of a full duty swing between moves, in squared degrees
+};
+
+template <typename T>
+class MpcController {
+public:
+    /// Adopt a model; move_s is the move period. Replacing a model keeps the
+    /// controller state. A gain of zero or less leaves it without a model.
+    void set_model(float gain_c, float tau_s, float dead_s, float move_s,
+                   const MpcWeights &weights);
+    bool has_model() const { return has_model_; }
+    /// Model time constant as tabulated, in moves.
+    float tau_moves() const;
+    uint32_t dead_moves() const { return dead_; }
+
+    /// Once per move: the duty for the next move.
+    T update(T temp_c, T setpoint);
+
+    void reset();
+
+private:
+    // Error terms are kept in units of gain / scale, so the QP's entries stay
+    // within Q16 range for any plausible gain.
+    static constexpr int32_t scale = 8;
+
+    /// Response at prediction step i (1-based) to a unit duty in move j.
+    T response(uint32_t i, uint32_t j) const;
+
+    bool has_model_ = false;
+    uint8_t row_ = 0;   // tables row
+    uint8_t dead_ = 0;  // moves
+    T gain_{};          // degrees
+    T inv_gain_{};      // scale / gain
+    T a_{};             // per-move decay
+    T energy_{};        // normalised weights
+    T move_{};
+    T hessian_[mpc::moves][mpc::moves] = {};
+    T inv_diag_[mpc::moves] = {};
+
+    T rise_{};          // model's heat-induced rise above the baseline, in gains
+    T baseline_{};      // measurement minus the model's rise, degrees
+    bool primed_ = false;
+    T past_[mpc::max_dead + 1] = {};  // duties applied, newest first
+    T plan_[mpc::moves] = {};         // last solution, warm start for the next
+};
+
+extern template class MpcController<float>;
+extern template class MpcController<Q16>;
+
+} // namespace thermo
@@ -0,0 +1,449 @@
+#include "mqtt.h"
+
+#include <cstring>
+
+#if !PICO_ON_DEVICE
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace thermo {
+
+namespace {
+
+// Packet types, as the high nibble of the fixed header.
+constexpr uint8_t connack = 2;
+constexpr uint8_t puback = 4;
+constexpr uint8_t pingresp = 13;
+
+constexpr uint8_t publish_qos1 = 0x32;
+constexpr uint8_t dup_flag = 0x08;
+constexpr uint8_t pingreq[] = {0xc0, 0x00};
+
+// {"t":4294967295,"c":-327.68,"sp":-327.68,"on":1} and its comma.
+constexpr size_t max_reading = 49;
+// The spec only promises brokers accept this much.
+constexpr size_t max_client_id = 23;
+
+uint8_t *put(uint8_t *p, const char *s) {
+    while (*s) *p++ = uint8_t(*s++);
+    return p;
+}
+
+uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    uint8_t digits[10];
+    size_t n = 0;
+    do {
+        digits[n++] = uint8_t('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) *p++ = digits[--n];
+    return p;
+}
+
+// Centi-degrees as degrees with two decimals.
+uint8_t *put_centi(uint8_t *p, int16_t cc) {
+    int32_t v = cc;
+    if (v < 0) {
+        *p++ = '-';
+        v = -v;
+    }
+    p = put_u32(p, uint32_t(v / 100));
+    *p++ = '.';
+    *p++ = uint8_t('0' + v / 10 % 10);
+    *p++ = uint8_t('0' + v % 10);
+    return p;
+}
+
+} // namespace
+
+MqttClient::MqttClient(MqttTransport &transport, Clock &clock, const MqttConfig &config)
+    : transport_(transport), clock_(clock), config_(config),
+      topic_len_(strnlen(config.topic, max_topic)) {
+    if (!config_.batch) config_.batch = 1;
+    if (config_.window < 1) config_.window = 1;
+    if (config_.window > max_window) config_.window = max_window;
+    transport_.attach(this);
+}
+
+size_t MqttClient::buffers_in_use() const {
+    size_t n = 0;
+    for (const Buffer &b : buffers_) n += b.refs != 0;
+    return n;
+}
+
+// --- batches -------------------------------------------------------------------
+
+bool MqttClient::publish(const MqttReading &reading) {
+    stats_.readings++;
+    if (open_ >= 0 && buffers_[open_].len + max_reading + 1 > buffer_bytes) close_batch();
+    if (open_ < 0 && !open_batch()) {
+        stats_.dropped++;
+        return false;
+    }
+    Buffer &b = buffers_[open_];
+    uint8_t *p = b.data + b.len;
+    if (b.readings) *p++ = ',';
+    p = put_u32(put(p, "{\"t\":"), reading.t_ms);
+    p = put_centi(put(p, ",\"c\":"), reading.temp_cc);
+    p = put_centi(put(p, ",\"sp\":"), reading.setpoint_cc);
+    p = put(p, reading.relay ? ",\"on\":1}" : ",\"on\":0}");
+    b.len = uint16_t(p - b.data);
+    if (++b.readings >= config_.batch) close_batch();
+    return true;
+}
+
+void MqttClient::flush() {
+    if (open_ >= 0) close_batch();
+}
+
+bool MqttClient::open_batch() {
+    for (size_t i = 0; i < buffers; i++) {
+        Buffer &b = buffers_[i];
+        if (b.refs) continue;
+        b.refs = 1;
+        b.sent = false;
+        b.readings = 0;
+        b.id = 0;
+        // Variable header: the topic, then the packet id, set when it is sent.
+        uint8_t *p = b.data + header_room;
+        *p++ = uint8_t(topic_len_ >> 8);
+        *p++ = uint8_t(topic_len_);
+        memcpy(p, config_.topic, topic_len_);
+        p += topic_len_ + 2;
+        *p++ = '[';
+        b.len = uint16_t(p - b.data);
+        open_ = int8_t(i);
+        opened_at_ = clock_.now_us();
+        stats_.buffer_allocs++;
+        const uint32_t used = uint32_t(buffers_in_use());
+        if (used > stats_.peak_buffers) stats_.peak_buffers = used;
+        return true;
+    }
+    return false;
+}
+
+void MqttClient::close_batch() {
+    Buffer &b = buffers_[open_];
+    b.data[b.len++] = ']';
+    // The fixed header, right-aligned against the variable header.
+    const size_t remaining = b.len - header_room;
+    uint8_t *p = b.data + header_room;
+    if (remaining >= 128) {
+        *--p = uint8_t(remaining >> 7);
+        *--p = uint8_t(0x80 | (remaining & 0x7f));
+    } else {
+        *--p = uint8_t(remaining);
+    }
+    *--p = publish_qos1;
+    b.start = uint16_t(p - b.data);
+    order_[queued_++] = uint8_t(open_);
+    open_ = -1;
+}
+
+void MqttClient::release(uint8_t slot) {
+    buffers_[slot].refs--;
+}
+
+// --- sending -------------------------------------------------------------------
+
+bool MqttClient::transmit(uint8_t slot, const uint8_t *data, size_t len) {
+    if (seg_count_ == sizeof(segments_) / sizeof(segments_[0])) return false;
+    if (!transport_.send(data, len)) return false;
+    const size_t at = (seg_head_ + seg_count_) % (sizeof(segments_) / sizeof(segments_[0]));
+    segments_[at] = {slot, uint16_t(len)};
+    seg_count_++;
+    if (slot != control_slot) buffers_[slot].refs++;
+    last_send_ = clock_.now_us();
+    return true;
+}
+
+bool MqttClient::send_control(const uint8_t *packet, size_t len) {
+    if (control_busy_) return false;
+    memcpy(control_, packet, len);
+    if (!transmit(control_slot, control_, len)) return false;
+    control_busy_ = true;
+    return true;
+}
+
+void MqttClient::send_queued(uint64_t now) {
+    while (inflight_ < queued_ && inflight_ < config_.window) {
+        const uint8_t slot = order_[inflight_];
+        Buffer &b = buffers_[slot];
+        if (!b.id) {
+            b.id = next_id_;
+            next_id_ = next_id_ == 0xffff ? 1 : next_id_ + 1;
+            uint8_t *id = b.data + header_room + 2 + topic_len_;
+            id[0] = uint8_t(b.id >> 8);
+            id[1] = uint8_t(b.id);
+        }
+        if (b.sent) b.data[b.start] |= dup_flag;
+        if (!transmit(slot, b.data + b.start, b.len - b.start)) break;
+        (b.sent ? stats_.resent : stats_.publishes)++;
+        b.sent = true;
+        if (!inflight_ && !ping_out_) waiting_since_ = now;
+        inflight_++;
+    }
+}
+
+void MqttClient::on_sent(size_t len) {
+    stats_.bytes += len;
+    constexpr size_t cap = sizeof(segments_) / sizeof(segments_[0]);
+    while (len && seg_count_) {
+        Segment &s = segments_[seg_head_];
+        const size_t n = len < s.left ? len : s.left;
+        s.left = uint16_t(s.left - n);
+        len -= n;
+        if (s.left) break;
+        if (s.slot == control_slot) {
+            control_busy_ = false;
+        } else {
+            release(s.slot);
+        }
+        seg_head_ = uint8_t((seg_head_ + 1) % cap);
+        seg_count_--;
+    }
+}
+
+// --- connection ----------------------------------------------------------------
+
+void MqttClient::poll() {
+    transport_.poll();
+    const uint64_t now = clock_.now_us();
+    if (open_ >= 0 && now - opened_at_ >= config_.max_delay_us) close_batch();
+
+    switch (state_) {
+    case State::idle:
+        if (now < retry_at_) break;
+        // open() may report the connection before it returns.
+        state_ = State::connecting;
+        waiting_since_ = now;
+        if (!transport_.open()) {
+            state_ = State::idle;
+            retry_at_ = now + config_.retry_us;
+        }
+        break;
+    case State::up:
+        send_queued(now);
+        if (config_.keepalive_s && !ping_out_ &&
+            now - last_send_ >= uint64_t(config_.keepalive_s) * 500'000 &&
+            send_control(pingreq, sizeof(pingreq))) {
+            if (!inflight_) waiting_since_ = now;
+            ping_out_ = true;
+        }
+        break;
+    default:
+        break;
+    }
+
+    const bool waiting = state_ == State::connecting || state_ == State::handshake ||
+                         (state_ == State::up && (inflight_ || ping_out_));
+    if (waiting && now - waiting_since_ >= config_.ack_timeout_us) drop_connection();
+}
+
+void MqttClient::on_connected() {
+    // CONNECT: protocol name and level 4 (3.1.1), clean session, keepalive.
+    const size_t id_len = strnlen(config_.client_id, max_client_id);
+    const uint8_t head[] = {0x10, uint8_t(10 + 2 + id_len),
+                            0, 4, 'M', 'Q', 'T', 'T', 4, 0x02,
+                            uint8_t(config_.keepalive_s >> 8), uint8_t(config_.keepalive_s)};
+    uint8_t packet[sizeof(head) + 2 + max_client_id];
+    uint8_t *p = packet;
+    memcpy(p, head, sizeof(head));
+    p += sizeof(head);
+    *p++ = 0;
+    *p++ = uint8_t(id_len);
+    memcpy(p, config_.client_id, id_len);
+    p += id_len;
+    state_ = State::handshake;
+    waiting_since_ = clock_.now_us();
+    if (!send_control(packet, size_t(p - packet))) drop_connection();
+}
+
+void MqttClient::on_receive(const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len && state_ != State::idle; i++) {
+        const uint8_t c = data[i];
+        switch (rx_stage_) {
+        case 0:
+            rx_type_ = c;
+            rx_len_ = 0;
+            rx_shift_ = 0;
+            rx_stage_ = 1;
+            break;
+        case 1:
+            rx_len_ |= uint32_t(c & 0x7f) << rx_shift_;
+            rx_shift_ += 7;
+            if (c & 0x80) {
+                if (rx_shift_ > 21) drop_connection();  // malformed length
+                break;
+            }
+            rx_have_ = 0;
+            rx_stage_ = 2;
+            if (!rx_len_) {
+                rx_stage_ = 0;
+                handle_packet();
+            }
+            break;
+        default:
+            if (rx_have_ < sizeof(rx_body_)) rx_body_[rx_have_] = c;
+            if (++rx_have_ == rx_len_) {
+                rx_stage_ = 0;
+                handle_packet();
+            }
+            break;
+        }
+    }
+}
+
+void MqttClient::handle_packet() {
+    const uint64_t now = clock_.now_us();
+    switch (rx_type_ >> 4) {
+    case connack:
+        if (state_ != State::handshake) break;
+        if (rx_len_ < 2 || rx_body_[1] != 0) {
+            drop_connection();  // refused
+            break;
+        }
+        state_ = State::up;
+        stats_.connects++;
+        break;
+    case puback: {
+        if (rx_len_ < 2) break;
+        const uint16_t id = uint16_t(rx_body_[0] << 8 | rx_body_[1]);
+        for (uint8_t i = 0; i < inflight_; i++) {
+            const uint8_t slot = order_[i];
+            if (buffers_[slot].id != id) continue;
+            memmove(order_ + i, order_ + i + 1, size_t(queued_ - i - 1));
+            queued_--;
+            inflight_--;
+            release(slot);
+            stats_.acked++;
+            waiting_since_ = now;
+            break;
+        }
+        break;
+    }
+    case pingresp:
+        ping_out_ = false;
+        waiting_since_ = now;
+        break;
+    default:
+        break;  // SUBACK and the like: not ours
+    }
+}
+
+void MqttClient::drop_connection() {
+    transport_.close();
+    on_closed();
+}
+
+void MqttClient::on_closed() {
+    // The transport has let go of everything; whatever was not acked goes
+    // again, with DUP, after the next CONNACK.
+    constexpr size_t cap = sizeof(segments_) / sizeof(segments_[0]);
+    for (; seg_count_; seg_count_--) {
+        if (segments_[seg_head_].slot != control_slot) release(segments_[seg_head_].slot);
+        seg_head_ = uint8_t((seg_head_ + 1) % cap);
+    }
+    control_busy_ = false;
+    inflight_ = 0;
+    ping_out_ = false;
+    rx_stage_ = 0;
+    state_ = State::idle;
+    retry_at_ = clock_.now_us() + config_.retry_us;
+}
+
+#if !PICO_ON_DEVICE
+
+// --- host socket transport -----------------------------------------------------
+
+bool SocketTransport::open() {
+    close();
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port_);
+    if (inet_pton(AF_INET, broker_, &addr.sin_addr) != 1) return false;
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd_ < 0) return false;
+    const int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+    if (connect(fd_, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0 &&
+        errno != EINPROGRESS) {
+        close();
+        return false;
+    }
+    connecting_ = true;
+    return true;
+}
+
+void SocketTransport::close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    connecting_ = false;
+    head_ = count_ = offset_ = 0;
+}
+
+bool SocketTransport::send(const uint8_t *data, size_t len) {
+    if (fd_ < 0 || count_ == max_pending) return false;
+    pending_[(head_ + count_) % max_pending] = {data, len};
+    count_++;
+    return true;
+}
+
+void SocketTransport::fail() {
+    close();
+    client_->on_closed();
+}
+
+void SocketTransport::poll() {
+    if (fd_ < 0) return;
+    if (connecting_) {
+        pollfd p = {fd_, POLLOUT, 0};
+        if (::poll(&p, 1, 0) <= 0) return;
+        int err = 0;
+        socklen_t n = sizeof(err);
+        if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &err, &n) != 0 || err) return fail();
+        connecting_ = false;
+        client_->on_connected();
+        if (fd_ < 0) return;
+    }
+
+    size_t sent = 0;
+    while (count_) {
+        const Pending &p = pending_[head_];
+        const ssize_t n = ::send(fd_, p.data + offset_, p.len - offset_, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return fail();
+        }
+        sent += size_t(n);
+        offset_ += size_t(n);
+        if (offset_ < p.len) break;
+        offset_ = 0;
+        head_ = (head_ + 1) % max_pending;
+        count_--;
+    }
+    if (sent) client_->on_sent(sent);
+
+    uint8_t buf[256];
+    while (fd_ >= 0) {
+        const ssize_t n = ::recv(fd_, buf, sizeof(buf), 0);
+        if (n > 0) {
+            client_->on_receive(buf, size_t(n));
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) fail();
+        break;
+    }
+}
+
+#endif
+
+} // namespace thermo
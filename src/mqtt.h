@@ -0,0 +1,256 @@
+// MQTT 3.1.1 publisher for the building system.
+//
+// Readings go out in batches, one QoS 1 PUBLISH per `batch` readings (or
+// per max_delay_us, whichever comes first), as a JSON array on the
+// configured topic:
+//
+//   [{"t":123456,"c":20.51,"sp":20.50,"on":1},...]
+//
+// with t in milliseconds since boot and temperatures in degrees. Nothing is
+// formatted into an intermediate buffer: each reading is serialised straight
+// into the packet buffer the transport will send from, behind room left for
+// the fixed header, which is written in front of the variable header once
+// the batch closes and its length is known.
+//
+// The transport takes bytes by reference (lwIP's tcp_write without
+// TCP_WRITE_FLAG_COPY on the Pico W) and reports them sent once it no longer
+// needs them, so a packet buffer can be held by the client and the transport
+// at once, and is reference counted: one reference while it is filled and
+// until its PUBACK arrives, one while the transport holds it. At most
+// `window` PUBLISHes wait for a PUBACK; later batches wait their turn in
+// their buffers, and a reading that finds every buffer taken is dropped and
+// counted. After a reconnect, PUBLISHes still waiting for a PUBACK are sent
+// again with the DUP flag, so every batch arrives at least once.
+//
+// Everything runs from poll(), including the transport's callbacks; the
+// client never blocks and never allocates.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "scheduler.h"
+
+struct tcp_pcb;  // lwIP
+struct pbuf;
+
+namespace thermo {
+
+class MqttClient;
+
+/// A byte stream to the broker that sends from the caller's memory.
+class MqttTransport {
+public:
+    /// Start connecting. The outcome arrives later, from poll(), as
+    /// on_connected() or on_closed(). False if it cannot even start (no
+    /// network yet); the client tries again later.
+    virtual bool open() = 0;
+    /// Drop the connection and every reference to queued bytes, without a
+    /// callback.
+    virtual void close() = 0;
+    /// Queue `len` bytes for sending without copying them: they must stay
+    /// untouched until on_sent() has reported them. False if the transport
+    /// has no room for them now.
+    virtual bool send(const uint8_t *data, size_t len) = 0;
+    /// Drive the network stack; callbacks into the client happen here.
+    virtual void poll() = 0;
+
+    void attach(MqttClient *client) { client_ = client; }
+
+protected:
+    ~MqttTransport() = default;
+    MqttClient *client_ = nullptr;
+};
+
+struct MqttConfig {
+    const char *client_id = "thermostat";
+    const char *topic = "thermostat/readings";  // at most max_topic bytes
+    uint16_t keepalive_s = 60;
+    uint32_t batch = 10;                  // readings per PUBLISH
+    uint32_t max_delay_us = 15'000'000;   // send a partial batch after this long
+    uint32_t window = 4;                  // PUBLISHes awaiting PUBACK, at most max_window
+    uint32_t retry_us = 5'000'000;        // between connection attempts
+    uint32_t ack_timeout_us = 20'000'000; // no CONNACK, PUBACK or PINGRESP: reconnect
+};
+
+struct MqttReading {
+    uint32_t t_ms;
+    int16_t temp_cc;      // centi-degrees
+    int16_t setpoint_cc;
+    bool relay;
+};
+
+struct MqttStats {
+    uint32_t readings = 0;
+    uint32_t dropped = 0;       // no free buffer
+    uint32_t publishes = 0;     // PUBLISH packets sent the first time
+    uint32_t resent = 0;        // sent again with DUP after a reconnect
+    uint32_t acked = 0;
+    uint32_t connects = 0;      // CONNACKs accepted
+    uint32_t buffer_allocs = 0; // packet buffers taken from the pool
+    uint32_t peak_buffers = 0;
+    uint64_t bytes = 0;         // reported sent by the transport
+};
+
+class MqttClient {
+public:
+    static constexpr size_t buffers = 6;
+    static constexpr size_t buffer_bytes = 512;
+    static constexpr size_t max_window = buffers - 1;  // leave one to fill
+    static constexpr size_t max_topic = 64;
+
+    MqttClient(MqttTransport &transport, Clock &clock, const MqttConfig &config = {});
+
+    /// Append a reading to the open batch. False if it was dropped.
+    bool publish(const MqttReading &reading);
+    /// Close the open batch now.
+    void flush();
+    /// Connect, send, time out; call every few tens of milliseconds.
+    void poll();
+
+    bool connected() const { return state_ == State::up; }
+    /// PUBLISHes sent and not yet acknowledged.
+    size_t in_flight() const { return inflight_; }
+    size_t buffers_in_use() const;
+    const MqttStats &stats() const { return stats_; }
+
+    // Transport callbacks.
+    void on_connected();
+    void on_sent(size_t len);
+    void on_receive(const uint8_t *data, size_t len);
+    void on_closed();
+
+private:
+    enum class State : uint8_t { idle, connecting, handshake, up };
+
+    // Fixed header (type byte and up to two length bytes for buffer_bytes)
+    // goes in front of the variable header, which starts here.
+    static constexpr size_t header_room = 3;
+    static constexpr uint8_t control_slot = 0xff;
+
+    struct Buffer {
+        uint8_t refs = 0;
+        bool sent = false;       // has gone out once: later sends carry DUP
+        uint8_t readings = 0;
+        uint16_t start = 0;      // first byte of the packet, once closed
+        uint16_t len = 0;        // end of the data written so far
+        uint16_t id = 0;
+        uint8_t data[buffer_bytes];
+    };
+
+    struct Segment {
+        uint8_t slot;   // buffer index, or control_slot
+        uint16_t left;  // bytes the transport has not reported yet
+    };
+
+    bool open_batch();
+    void close_batch();
+    void release(uint8_t slot);
+    bool transmit(uint8_t slot, const uint8_t *data, size_t len);
+    void send_queued(uint64_t now);
+    bool send_control(const uint8_t *packet, size_t len);
+    void handle_packet();
+    void drop_connection();
+
+    MqttTransport &transport_;
+    Clock &clock_;
+    MqttConfig config_;
+    size_t topic_len_;
+    State state_ = State::idle;
+    uint64_t retry_at_ = 0;
+    uint64_t waiting_since_ = 0;  // oldest CONNECT, PUBLISH or PINGREQ unanswered
+    uint64_t last_send_ = 0;
+    bool ping_out_ = false;
+    uint16_t next_id_ = 1;
+
+    Buffer buffers_[buffers];
+    int8_t open_ = -1;
+    uint64_t opened_at_ = 0;
+    // Closed batches in the order they closed: the first inflight_ have
+    // been sent and wait for their PUBACK.
+    uint8_t order_[buffers];
+    uint8_t queued_ = 0;
+    uint8_t inflight_ = 0;
+
+    // Bytes handed to the transport, in order.
+    Segment segments_[buffers + 1];
+    uint8_t seg_head_ = 0;
+    uint8_t seg_count_ = 0;
+    uint8_t control_[64];  // CONNECT or PINGREQ
+    bool control_busy_ = false;
+
+    // Incoming packet: fixed header, then up to four bytes of body kept.
+    uint8_t rx_type_ = 0;
+    uint32_t rx_len_ = 0;
+    uint32_t rx_have_ = 0;
+    uint8_t rx_shift_ = 0;
+    uint8_t rx_stage_ = 0;  // 0 type, 1 length, 2 body
+    uint8_t rx_body_[4];
+
+    MqttStats stats_;
+};
+
+#if PICO_ON_DEVICE
+
+#if THERMO_MQTT
+/// lwIP raw TCP on the Pico W's CYW43 (pico_cyw43_arch_lwip_poll). Writes
+/// by reference, and reports bytes sent as the broker's TCP acks them.
+class LwipTransport final : public MqttTransport {
+public:
+    /// broker: dotted IPv4 address.
+    LwipTransport(const char *broker, uint16_t port) : broker_(broker), port_(port) {}
+    bool open() override;
+    void close() override;
+    bool send(const uint8_t *data, size_t len) override;
+    void poll() override;
+
+private:
+    // lwIP callbacks (err_t is int8_t).
+    static int8_t on_connect(void *arg, tcp_pcb *pcb, int8_t err);
+    static int8_t on_sent(void *arg, tcp_pcb *pcb, uint16_t len);
+    static int8_t on_recv(void *arg, tcp_pcb *pcb, pbuf *p, int8_t err);
+    static void on_error(void *arg, int8_t err);
+
+    const char *broker_;
+    uint16_t port_;
+    tcp_pcb *pcb_ = nullptr;
+};
+#endif
+
+#else
+
+/// A non-blocking TCP socket. The kernel copies on write, so bytes count as
+/// sent once written; until then they are sent from the caller's memory, as
+/// on the device.
+class SocketTransport final : public MqttTransport {
+public:
+    /// broker: dotted IPv4 address.
+    SocketTransport(const char *broker, uint16_t port) : broker_(broker), port_(port) {}
+    ~SocketTransport() { close(); }
+    bool open() override;
+    void close() override;
+    bool send(const uint8_t *data, size_t len) override;
+    void poll() override;
+
+private:
+    struct Pending {
+        const uint8_t *data;
+        size_t len;
+    };
+    static constexpr size_t max_pending = MqttClient::buffers + 1;
+
+    void fail();
+
+    const char *broker_;
+    uint16_t port_;
+    int fd_ = -1;
+    bool connecting_ = false;
+    Pending pending_[max_pending];
+    size_t head_ = 0;
+    size_t count_ = 0;
+    size_t offset_ = 0;  // into the head entry
+};
+
+#endif
+
+} // namespace thermo
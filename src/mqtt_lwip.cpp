@@ -0,0 +1,106 @@
+// lwIP raw-API transport for the MQTT publisher, on the Pico W's CYW43 in
+// poll mode (pico_cyw43_arch_lwip_poll): everything, callbacks included,
+// runs from cyw43_arch_poll() in the mqtt task. Built with THERMO_MQTT only.
+#include "mqtt.h"
+
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+#include "pico/cyw43_arch.h"
+
+namespace thermo {
+
+bool LwipTransport::open() {
+    close();
+    if (cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA) != CYW43_LINK_UP) return false;
+    ip_addr_t addr;
+    if (!ipaddr_aton(broker_, &addr)) return false;
+    pcb_ = tcp_new_ip_type(IPADDR_TYPE_V4);
+    if (!pcb_) return false;
+    tcp_arg(pcb_, this);
+    tcp_nagle_disable(pcb_);
+    tcp_err(pcb_, on_error);
+    tcp_recv(pcb_, on_recv);
+    tcp_sent(pcb_, on_sent);
+    if (tcp_connect(pcb_, &addr, port_, on_connect) != ERR_OK) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void LwipTransport::close() {
+    if (!pcb_) return;
+    // Abort rather than close: a graceful close would go on sending from
+    // buffers the client reuses as soon as this returns. The error callback
+    // this raises finds no argument and does nothing.
+    tcp_arg(pcb_, nullptr);
+    tcp_abort(pcb_);
+    pcb_ = nullptr;
+}
+
+bool LwipTransport::send(const uint8_t *data, size_t len) {
+    if (!pcb_ || len > tcp_sndbuf(pcb_)) return false;
+    // No TCP_WRITE_FLAG_COPY (and no LWIP_NETIF_TX_SINGLE_PBUF, which would
+    // force it): lwIP chains PBUF_REF pbufs that point into the client's
+    // buffer, and the sent callback hands it back once acked.
+    if (tcp_write(pcb_, data, u16_t(len), 0) != ERR_OK) return false;
+    tcp_output(pcb_);
+    return true;
+}
+
+void LwipTransport::poll() {
+    cyw43_arch_poll();
+}
+
+// A callback that leads the client to close the connection has freed the
+// pcb, and must tell lwIP so.
+
+err_t LwipTransport::on_connect(void *arg, tcp_pcb *, err_t err) {
+    auto *self = static_cast<LwipTransport *>(arg);
+    if (!self) return ERR_OK;
+    if (err != ERR_OK) {
+        self->close();
+        self->client_->on_closed();
+        return ERR_ABRT;
+    }
+    self->client_->on_connected();
+    return self->pcb_ ? ERR_OK : ERR_ABRT;
+}
+
+err_t LwipTransport::on_sent(void *arg, tcp_pcb *, u16_t len) {
+    auto *self = static_cast<LwipTransport *>(arg);
+    if (!self) return ERR_OK;
+    self->client_->on_sent(len);
+    return self->pcb_ ? ERR_OK : ERR_ABRT;
+}
+
+err_t LwipTransport::on_recv(void *arg, tcp_pcb *pcb, pbuf *p, err_t) {
+    auto *self = static_cast<LwipTransport *>(arg);
+    if (!self) {
+        if (p) pbuf_free(p);
+        return ERR_OK;
+    }
+    if (!p) {  // the broker closed
+        self->close();
+        self->client_->on_closed();
+        return ERR_ABRT;
+    }
+    for (const pbuf *q = p; q && self->pcb_; q = q->next) {
+        self->client_->on_receive(static_cast<const uint8_t *>(q->payload), q->len);
+    }
+    const bool open = self->pcb_ != nullptr;
+    if (open) tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+    return open ? ERR_OK : ERR_ABRT;
+}
+
+void LwipTransport::on_error(void *arg, err_t) {
+    // lwIP has already freed the pcb.
+    auto *self = static_cast<LwipTransport *>(arg);
+    if (!self) return;
+    self->pcb_ = nullptr;
+    self->client_->on_closed();
+}
+
+} // namespace thermo
@@ -0,0 +1,39 @@
+// Linked into release device images only (see THERMO_NO_HEAP): newlib's
+// reentrant allocator entry points are wrapped to functions that reference a
+// symbol nobody defines. With --gc-sections the wrappers vanish when nothing
+// allocates; if anything in the image reaches malloc, calloc, realloc or
+// free (operator new included), the link fails naming that symbol.
+//
+// The _r variants are wrapped because pico_malloc already wraps the plain
+// names.
+#include <stddef.h>
+
+struct _reent;
+
+extern void *thermo_heap_use_is_forbidden_in_release_builds(void);
+
+void *__wrap__malloc_r(struct _reent *r, size_t n) {
+    (void)r;
+    (void)n;
+    return thermo_heap_use_is_forbidden_in_release_builds();
+}
+
+void *__wrap__calloc_r(struct _reent *r, size_t n, size_t size) {
+    (void)r;
+    (void)n;
+    (void)size;
+    return thermo_heap_use_is_forbidden_in_release_builds();
+}
+
+void *__wrap__realloc_r(struct _reent *r, void *p, size_t n) {
+    (void)r;
+    (void)p;
+    (void)n;
+    return thermo_heap_use_is_forbidden_in_release_builds();
+}
+
+void __wrap__free_r(struct _reent *r, void *p) {
+    (void)r;
+    (void)p;
+    thermo_heap_use_is_forbidden_in_release_builds();
+}
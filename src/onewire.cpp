@@ -0,0 +1,297 @@
+#include "onewire.h"
+
+#include <cstring>
+
+#include "crc.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "onewire.pio.h"
+#include "pico/stdlib.h"
+#else
+#include <cmath>
+#endif
+
+namespace thermo {
+
+using namespace onewire;
+
+#if PICO_ON_DEVICE
+
+void OneWireBus::init(unsigned gpio) {
+    PIO pio = pio0;
+    sm_ = unsigned(pio_claim_unused_sm(pio, true));
+    uint offset = pio_add_program(pio, &onewire_program);
+    onewire_program_init(pio, sm_, offset, gpio);
+
+    tx_chan_ = dma_claim_unused_channel(true);
+    rx_chan_ = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(tx_chan_);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm_, true));
+    dma_channel_configure(tx_chan_, &c, &pio->txf[sm_], nullptr, 0, false);
+
+    // The program shifts results into the top of the RX word: read the top
+    // byte lane, which still pops the whole FIFO entry.
+    c = dma_channel_get_default_config(rx_chan_);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm_, false));
+    dma_channel_configure(rx_chan_, &c, nullptr,
+                          reinterpret_cast<io_rw_8 *>(&pio->rxf[sm_]) + 3, 0, false);
+}
+
+bool OneWireBus::start(const uint32_t *ops, uint8_t *results, size_t count) {
+    if (busy()) return false;
+    // Arm the receiver first so no result can be missed.
+    dma_channel_set_write_addr(rx_chan_, results, false);
+    dma_channel_set_trans_count(rx_chan_, count, true);
+    dma_channel_set_read_addr(tx_chan_, ops, false);
+    dma_channel_set_trans_count(tx_chan_, count, true);
+    transfers_++;
+    return true;
+}
+
+bool OneWireBus::busy() const {
+    return dma_channel_is_busy(rx_chan_);
+}
+
+void OneWireBus::wait() const {
+    while (busy()) tight_loop_contents();
+}
+
+#else
+
+namespace {
+
+enum : uint8_t {
+    sim_idle,
+    sim_rom_cmd,
+    sim_match_rom,
+    sim_search,
+    sim_func_cmd,
+    sim_read_scratchpad,
+    sim_converting,
+};
+
+// Wire time of one operation, as onewire.pio runs them.
+constexpr uint64_t reset_us = 1031;
+constexpr uint64_t slot_us = 64;
+constexpr uint64_t conversion_us = 750'000;  // 12-bit resolution
+
+int16_t raw_from_celsius(float temp_c) {
+    return int16_t(std::lround(temp_c * 16.0f));
+}
+
+bool rom_bit(const uint8_t *rom, unsigned i) {
+    return (rom[i / 8] >> (i % 8)) & 1;
+}
+
+} // namespace
+
+void OneWireBus::init(unsigned) {}
+
+size_t OneWireBus::host_add_ds18b20(const OneWireRom &rom, float temp_c) {
+    if (sim_count_ == host_max_devices) return host_max_devices;
+    SimDevice &d = sim_[sim_count_];
+    memset(&d, 0, sizeof(d));
+    memcpy(d.rom, rom, sizeof(d.rom));
+    d.raw = raw_from_celsius(temp_c);
+    d.reg = 0x0550;
+    d.state = sim_idle;
+    return sim_count_++;
+}
+
+void OneWireBus::host_set_celsius(size_t device, float temp_c) {
+    if (device < sim_count_) sim_[device].raw = raw_from_celsius(temp_c);
+}
+
+void OneWireBus::host_corrupt_next_read(size_t device) {
+    if (device < sim_count_) sim_[device].corrupt = true;
+}
+
+// One device's view of a slot after the wired-AND settled to `line`.
+void OneWireBus::sim_input(SimDevice &d, bool line) {
+    switch (d.state) {
+    case sim_rom_cmd:
+    case sim_func_cmd:
+        d.acc = uint8_t(d.acc | line << d.bit);
+        if (++d.bit < 8) return;
+        d.bit = 0;
+        if (d.state == sim_rom_cmd) {
+            d.state = d.acc == cmd_skip_rom    ? sim_func_cmd
+                      : d.acc == cmd_match_rom  ? sim_match_rom
+                      : d.acc == cmd_search_rom ? sim_search
+                                                : sim_idle;
+            d.phase = 0;
+        } else if (d.acc == 0x44) {  // Convert T
+            d.pending = d.raw;
+            d.ready_us = sim_now_us_ + conversion_us;
+            d.state = sim_converting;
+        } else if (d.acc == 0xbe) {  // Read Scratchpad
+            if (d.ready_us && sim_now_us_ >= d.ready_us) {
+                d.reg = d.pending;
+                d.ready_us = 0;
+            }
+            const uint8_t pad[8] = {uint8_t(d.reg), uint8_t(uint16_t(d.reg) >> 8), 0x4b, 0x46,
+                                    0x7f, 0xff, 0x0c, 0x10};
+            memcpy(d.scratchpad, pad, 8);
+            d.scratchpad[8] = crc8_maxim(pad, 8);
+            if (d.corrupt) {
+                d.scratchpad[0] ^= 0x04;
+                d.corrupt = false;
+            }
+            d.state = sim_read_scratchpad;
+        } else {
+            d.state = sim_idle;
+        }
+        d.acc = 0;
+        return;
+    case sim_match_rom:
+        if (line != rom_bit(d.rom, d.bit)) {
+            d.state = sim_idle;
+        } else if (++d.bit == 64) {
+            d.bit = 0;
+            d.state = sim_func_cmd;
+        }
+        return;
+    case sim_search:
+        // Two read slots (bit, complement), then the master's choice.
+        if (d.phase < 2) {
+            d.phase++;
+            return;
+        }
+        d.phase = 0;
+        if (line != rom_bit(d.rom, d.bit)) {
+            d.state = sim_idle;
+        } else if (++d.bit == 64) {
+            d.bit = 0;
+            d.state = sim_func_cmd;
+        }
+        return;
+    case sim_read_scratchpad:
+        if (++d.bit == 72) d.state = sim_idle;
+        return;
+    default:
+        return;
+    }
+}
+
+uint8_t OneWireBus::sim_slot(bool write_one) {
+    bool line = write_one;
+    for (size_t i = 0; i < sim_count_ && line; i++) {
+        const SimDevice &d = sim_[i];
+        switch (d.state) {
+        case sim_search:
+            if (d.phase == 0) line = rom_bit(d.rom, d.bit);
+            if (d.phase == 1) line = !rom_bit(d.rom, d.bit);
+            break;
+        case sim_read_scratchpad:
+            line = (d.scratchpad[d.bit / 8] >> (d.bit % 8)) & 1;
+            break;
+        case sim_converting:
+            line = sim_now_us_ >= d.ready_us;
+            break;
+        default:
+            break;
+        }
+    }
+    for (size_t i = 0; i < sim_count_; i++) sim_input(sim_[i], line);
+    sim_now_us_ += slot_us;
+    sim_bus_us_ += slot_us;
+    return line;
+}
+
+bool OneWireBus::start(const uint32_t *ops, uint8_t *results, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t op = ops[i];
+        if (op & 1) {
+            for (size_t d = 0; d < sim_count_; d++) {
+                sim_[d].state = sim_rom_cmd;
+                sim_[d].bit = sim_[d].acc = sim_[d].phase = 0;
+            }
+            results[i] = sim_count_ ? 0x00 : 0x80;
+            sim_now_us_ += reset_us;
+            sim_bus_us_ += reset_us;
+            continue;
+        }
+        const unsigned n = ((op >> 1) & 7) + 1;
+        uint8_t r = 0;
+        for (unsigned k = 0; k < n; k++) {
+            r = uint8_t(r | sim_slot(!((op >> (4 + k)) & 1)) << (8 - n + k));
+        }
+        results[i] = r;
+    }
+    transfers_++;
+    return true;
+}
+
+bool OneWireBus::busy() const {
+    return false;
+}
+
+void OneWireBus::wait() const {}
+
+#endif
+
+// Maxim application note 187: at every bit where devices disagree the
+// search takes 0 first, and revisits the last such fork with 1 next time.
+// A family search presets the first byte and follows it at every fork; the
+// family's devices form one subtree, so the first ROM outside it ends the
+// search.
+size_t OneWireBus::search(OneWireRom *roms, size_t max, int family) {
+    uint8_t rom[8] = {};
+    int last_fork = -1;
+    if (family >= 0) {
+        rom[0] = uint8_t(family);
+        last_fork = 64;
+    }
+    size_t found = 0;
+    while (found < max) {
+        const uint32_t start_ops[2] = {reset_op(), byte_op(cmd_search_rom)};
+        uint8_t res[2];
+        start(start_ops, res, 2);
+        wait();
+        if (!presence(res[0])) break;
+
+        int fork = -1;
+        bool lost = false;
+        for (int i = 0; i < 64; i++) {
+            const uint32_t read_pair = slots_op(0x3, 2);
+            uint8_t r;
+            start(&read_pair, &r, 1);
+            wait();
+            const uint8_t pair = slot_bits(r, 2);
+            bool dir;
+            if (pair == 0x3) {
+                lost = true;  // nobody left on the bus
+                break;
+            } else if (pair != 0) {
+                dir = pair & 1;
+            } else {
+                dir = i < last_fork ? (rom[i / 8] >> (i % 8)) & 1 : i == last_fork;
+                if (!dir) fork = i;
+            }
+            if (dir) {
+                rom[i / 8] = uint8_t(rom[i / 8] | 1u << (i % 8));
+            } else {
+                rom[i / 8] = uint8_t(rom[i / 8] & ~(1u << (i % 8)));
+            }
+            const uint32_t choose = slots_op(dir, 1);
+            start(&choose, &r, 1);
+            wait();
+        }
+        if (lost) break;
+        if (family >= 0 && rom[0] != family) break;
+        if (crc8_maxim(rom, 8) == 0) memcpy(roms[found++], rom, 8);
+        last_fork = fork;
+        if (fork < 0) break;
+    }
+    return found;
+}
+
+} // namespace thermo
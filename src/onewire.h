@@ -0,0 +1,108 @@
+// 1-Wire bus master on a PIO state machine (onewire.pio).
+//
+// The CPU never times a slot: a transfer is a list of encoded operations
+// (reset_op(), slots_op(), byte_op()) that one DMA channel feeds to the state
+// machine while a second collects one result byte per operation. A whole
+// multi-device read (reset, Match ROM, Read Scratchpad, nine bytes, for every
+// device) is therefore a single DMA transfer the CPU only starts and checks.
+//
+// On the host build the state machine is replaced by a slot-level simulation
+// of DS18B20 devices on a wired-AND bus, so enumeration and the read pipeline
+// can be exercised and timed; host_bus_time_us() accumulates the time the
+// same operations would take on the wire.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace thermo {
+
+using OneWireRom = uint8_t[8];
+
+namespace onewire {
+
+constexpr uint8_t cmd_search_rom = 0xf0;
+constexpr uint8_t cmd_match_rom = 0x55;
+constexpr uint8_t cmd_skip_rom = 0xcc;
+
+/// Reset pulse; its result byte says whether any device answered.
+constexpr uint32_t reset_op() { return 1; }
+
+/// 1-8 slots writing `bits` LSB first. Read slots are written as 1s.
+constexpr uint32_t slots_op(uint8_t bits, unsigned count) {
+    return uint32_t(count - 1) << 1 | (~uint32_t(bits) & ((1u << count) - 1)) << 4;
+}
+
+constexpr uint32_t byte_op(uint8_t b) { return slots_op(b, 8); }
+constexpr uint32_t read_byte_op() { return slots_op(0xff, 8); }
+
+/// Decoding of result bytes (the top byte of each RX word).
+constexpr bool presence(uint8_t result) { return !(result & 0x80); }
+constexpr uint8_t slot_bits(uint8_t result, unsigned count) { return uint8_t(result >> (8 - count)); }
+
+} // namespace onewire
+
+class OneWireBus {
+public:
+    /// Claim a PIO state machine and two DMA channels for the bus on `gpio`.
+    void init(unsigned gpio);
+
+    /// Start running `count` operations; `results` receives one byte per
+    /// operation. Both buffers must stay untouched until busy() is false.
+    /// Returns false if the previous transfer is still running.
+    bool start(const uint32_t *ops, uint8_t *results, size_t count);
+    bool busy() const;
+    /// Spin until the running transfer completes. Init-time use only.
+    void wait() const;
+
+    /// Enumerate devices with Search ROM. Blocking (about 13 ms per device),
+    /// so for init only. With `family` >= 0 only devices of that family code
+    /// are searched for. Returns the number of CRC-valid ROM codes found.
+    size_t search(OneWireRom *roms, size_t max, int family = -1);
+
+    uint32_t transfers() const { return transfers_; }
+
+#if !PICO_ON_DEVICE
+    static constexpr size_t host_max_devices = 16;
+    /// Host build only: attach a simulated DS18B20 and return its index.
+    size_t host_add_ds18b20(const OneWireRom &rom, float temp_c);
+    void host_set_celsius(size_t device, float temp_c);
+    /// The next scratchpad the device sends has one bit flipped.
+    void host_corrupt_next_read(size_t device);
+    /// Let simulated time pass (e.g. a conversion wait).
+    void host_advance_us(uint64_t us) { sim_now_us_ += us; }
+    /// Wire time the operations run so far would have taken.
+    uint64_t host_bus_time_us() const { return sim_bus_us_; }
+#endif
+
+private:
+#if PICO_ON_DEVICE
+    unsigned sm_ = 0;  // on pio0
+    int tx_chan_ = -1;
+    int rx_chan_ = -1;
+#else
+    struct SimDevice {
+        uint8_t rom[8];
+        uint8_t scratchpad[9];
+        int16_t raw;       // what the sensor would measure now
+        int16_t pending;   // result of the conversion in progress
+        int16_t reg;       // temperature register (85 C at power-up)
+        uint8_t state;
+        uint8_t bit;
+        uint8_t phase;
+        uint8_t acc;
+        bool corrupt;
+        uint64_t ready_us;
+    };
+    uint8_t sim_slot(bool write_one);
+    void sim_input(SimDevice &d, bool line);
+
+    SimDevice sim_[host_max_devices];
+    size_t sim_count_ = 0;
+    uint64_t sim_now_us_ = 0;
+    uint64_t sim_bus_us_ = 0;
+#endif
+    uint32_t transfers_ = 0;
+};
+
+} // namespace thermo
@@ -0,0 +1,280 @@
+#include "power.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/clocks.h"
+#include "hardware/pll.h"
+#include "hardware/rtc.h"
+#include "hardware/structs/scb.h"
+#include "hardware/timer.h"
+#include "hardware/xosc.h"
+#include "pico/stdlib.h"
+#endif
+
+namespace thermo {
+
+PowerManager::PowerManager(Clock &clock, PowerPort &port)
+    : clock_(clock), port_(port), deepest_(port.deepest()) {
+    for (size_t i = 0; i < power_state_count; i++) exit_us_[i] = power_states[i].exit_us;
+}
+
+void PowerManager::set_deepest(PowerState state) {
+    deepest_ = state < port_.deepest() ? state : port_.deepest();
+}
+
+bool PowerManager::add_busy_check(PowerBusyFn busy, void *ctx) {
+    if (busy_count_ == max_busy_checks) return false;
+    busy_[busy_count_++] = BusyCheck{busy, ctx};
+    return true;
+}
+
+bool PowerManager::busy() const {
+    for (size_t i = 0; i < busy_count_; i++) {
+        if (busy_[i].fn(busy_[i].ctx)) return true;
+    }
+    return false;
+}
+
+// Deepest allowed state that can wake early enough for `t` and still stay
+// its target residency; idle, woken at t itself, if none can.
+PowerState PowerManager::choose(uint64_t now, uint64_t t, uint64_t &wake_at) const {
+    for (size_t i = size_t(deepest_); i > size_t(PowerState::idle); i--) {
+        const PowerState s = PowerState(i);
+        if (t < now + exit_us_[i]) continue;
+        const uint64_t wake = port_.wake_time(s, t - exit_us_[i]);
+        if (wake >= now + power_states[i].enter_us + power_target_residency_us(s)) {
+            wake_at = wake;
+            return s;
+        }
+    }
+    wake_at = t;
+    return PowerState::idle;
+}
+
+void PowerManager::sleep_until(uint64_t t) {
+    for (;;) {
+        const uint64_t now = clock_.now_us();
+        if (now >= t) return;
+        uint64_t wake_at;
+        PowerState s;
+        if (busy()) {
+            // Idle at full speed until the transfer is done, then choose.
+            s = PowerState::idle;
+            wake_at = t < now + busy_poll_us ? t : now + busy_poll_us;
+            busy_waits_++;
+        } else {
+            s = choose(now, t, wake_at);
+        }
+        port_.enter(s, wake_at);
+        const uint64_t back = clock_.now_us();
+
+        PowerStateStats &st = stats_[size_t(s)];
+        st.entries++;
+        const uint64_t in = now + power_states[size_t(s)].enter_us;
+        if (wake_at > in) st.residency_us += wake_at - in;
+        const uint32_t latency = back > wake_at ? uint32_t(back - wake_at) : 0;
+        if (latency > st.worst_wake_us) st.worst_wake_us = latency;
+        // Idle wakes on the release's own alarm, like SystemClock, unless a
+        // transfer cut it short.
+        if (s == PowerState::idle) {
+            if (wake_at == t) return;
+            continue;
+        }
+        if (back > t) st.late++;
+        // Wake that much earlier from now on.
+        if (latency > exit_us_[size_t(s)]) exit_us_[size_t(s)] = latency;
+        // Early by the exit estimate (or by up to a second from dormant):
+        // go round again for the rest.
+    }
+}
+
+#if PICO_ON_DEVICE
+
+namespace {
+
+constexpr uint32_t day_s = 24 * 3600;
+
+void no_callback() {}
+
+// Timer time of the RTC's first second edge, set from the alarm interrupt;
+// 0 until then. Dormant waits count whole seconds from here.
+volatile uint64_t rtc_origin_us = 0;
+
+void rtc_edge() {
+    rtc_origin_us = time_us_64() - 1'000'000;
+}
+
+// The interrupt may land between the two halves of a read.
+uint64_t rtc_origin() {
+    uint64_t t;
+    do {
+        t = rtc_origin_us;
+    } while (t != rtc_origin_us);
+    return t;
+}
+
+// Clocks that run while both cores wait in sleep: the timer that wakes us,
+// the ADC and DMA that keep sampling into SRAM, and the buses, so a
+// transfer already under way completes.
+void narrow_sleep_clocks() {
+    clocks_hw->sleep_en0 =
+        CLOCKS_SLEEP_EN0_CLK_SYS_BUSFABRIC_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_BUSCTRL_BITS |
+        CLOCKS_SLEEP_EN0_CLK_SYS_DMA_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_ADC_BITS |
+        CLOCKS_SLEEP_EN0_CLK_ADC_ADC_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_I2C0_BITS |
+        CLOCKS_SLEEP_EN0_CLK_SYS_I2C1_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_PIO0_BITS |
+        CLOCKS_SLEEP_EN0_CLK_SYS_PIO1_BITS;
+    clocks_hw->sleep_en1 =
+        CLOCKS_SLEEP_EN1_CLK_SYS_TIMER_BITS | CLOCKS_SLEEP_EN1_CLK_SYS_WATCHDOG_BITS |
+        CLOCKS_SLEEP_EN1_CLK_SYS_SRAM0_BITS | CLOCKS_SLEEP_EN1_CLK_SYS_SRAM1_BITS |
+        CLOCKS_SLEEP_EN1_CLK_SYS_SRAM2_BITS | CLOCKS_SLEEP_EN1_CLK_SYS_SRAM3_BITS |
+        CLOCKS_SLEEP_EN1_CLK_SYS_SRAM4_BITS | CLOCKS_SLEEP_EN1_CLK_SYS_SRAM5_BITS |
+        CLOCKS_SLEEP_EN1_CLK_SYS_SPI0_BITS | CLOCKS_SLEEP_EN1_CLK_PERI_SPI0_BITS |
+        CLOCKS_SLEEP_EN1_CLK_SYS_SPI1_BITS | CLOCKS_SLEEP_EN1_CLK_PERI_SPI1_BITS;
+}
+
+void restore_sleep_clocks() {
+    clocks_hw->sleep_en0 = CLOCKS_SLEEP_EN0_BITS;
+    clocks_hw->sleep_en1 = CLOCKS_SLEEP_EN1_BITS;
+}
+
+// Move the stopped-then-restarted timer to `t`. Alarms match the low word
+// exactly, so any the jump went past are fired by hand.
+void set_timer(uint64_t t) {
+    timer_hw->timelw = uint32_t(t);
+    timer_hw->timehw = uint32_t(t >> 32);
+    for (uint alarm = 0; alarm < NUM_ALARMS; alarm++) {
+        const bool passed = int32_t(timer_hw->alarm[alarm] - uint32_t(t)) <= 0;
+        if ((timer_hw->armed & (1u << alarm)) && passed) {
+            hardware_alarm_force_irq(alarm);
+        }
+    }
+}
+
+} // namespace
+
+Rp2040PowerPort::Rp2040PowerPort(int rtc_clock_gpio) {
+    if (rtc_clock_gpio < 0) return;
+    // The RTC counts the external clock, so it keeps time with the crystal
+    // stopped. Only the time of day matters: alarms are never a day out.
+    clock_configure_gpin(clk_rtc, uint(rtc_clock_gpio), 32'768, 32'768);
+    rtc_init();
+    datetime_t start = {2020, 1, 1, 3, 0, 0, 0};
+    rtc_set_datetime(&start);
+    // No waiting here for the first edge: its alarm fires once, a second
+    // from now, and dormant is used from then on.
+    datetime_t edge = start;
+    edge.sec = 1;
+    rtc_set_alarm(&edge, rtc_edge);
+    rtc_ = true;
+}
+
+PowerState Rp2040PowerPort::deepest() const {
+    return rtc_ ? PowerState::dormant : PowerState::sleep;
+}
+
+uint64_t Rp2040PowerPort::wake_time(PowerState state, uint64_t t) const {
+    if (state != PowerState::dormant) return t;
+    const uint64_t origin = rtc_origin();
+    if (!origin || t < origin) return 0;
+    return t - (t - origin) % 1'000'000;
+}
+
+void Rp2040PowerPort::run_from_xosc() {
+    clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                    CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_XOSC_CLKSRC, XOSC_HZ, XOSC_HZ);
+}
+
+void Rp2040PowerPort::run_from_pll() {
+    clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                    CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS, SYS_CLK_HZ, SYS_CLK_HZ);
+}
+
+void Rp2040PowerPort::enter(PowerState state, uint64_t wake_at) {
+    switch (state) {
+    case PowerState::idle:
+        ::sleep_until(from_us_since_boot(wake_at));
+        break;
+    case PowerState::slow:
+        run_from_xosc();
+        ::sleep_until(from_us_since_boot(wake_at));
+        run_from_pll();
+        break;
+    case PowerState::sleep:
+        run_from_xosc();
+        pll_deinit(pll_sys);
+        narrow_sleep_clocks();
+        scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+        ::sleep_until(from_us_since_boot(wake_at));
+        scb_hw->scr &= ~M0PLUS_SCR_SLEEPDEEP_BITS;
+        restore_sleep_clocks();
+        pll_init(pll_sys, PLL_SYS_REFDIV, PLL_SYS_VCO_FREQ_HZ, PLL_SYS_POSTDIV1,
+                 PLL_SYS_POSTDIV2);
+        run_from_pll();
+        break;
+    case PowerState::dormant:
+        dormant_until(wake_at);
+        break;
+    }
+}
+
+void Rp2040PowerPort::dormant_until(uint64_t wake_at) {
+    const uint32_t s = uint32_t((wake_at - rtc_origin()) / 1'000'000 % day_s);
+    datetime_t alarm = {-1, -1, -1, -1, int8_t(s / 3600), int8_t(s / 60 % 60), int8_t(s % 60)};
+    rtc_set_alarm(&alarm, no_callback);
+
+    run_from_xosc();
+    pll_deinit(pll_sys);
+    pll_deinit(pll_usb);
+    const uint64_t stopped = time_us_64();
+    xosc_dormant();  // back once the alarm has restarted the crystal
+
+    pll_init(pll_usb, PLL_USB_REFDIV, PLL_USB_VCO_FREQ_HZ, PLL_USB_POSTDIV1, PLL_USB_POSTDIV2);
+    clock_configure(clk_usb, 0, CLOCKS_CLK_USB_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, USB_CLK_HZ,
+                    USB_CLK_HZ);
+    clock_configure(clk_adc, 0, CLOCKS_CLK_ADC_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, USB_CLK_HZ,
+                    USB_CLK_HZ);
+    pll_init(pll_sys, PLL_SYS_REFDIV, PLL_SYS_VCO_FREQ_HZ, PLL_SYS_POSTDIV1, PLL_SYS_POSTDIV2);
+    run_from_pll();
+    rtc_disable_alarm();
+    // The timer stood still from `stopped` until the alarm restarted the
+    // crystal at wake_at.
+    set_timer(wake_at + (time_us_64() - stopped));
+}
+
+#else
+
+uint64_t PowerModel::wake_time(PowerState state, uint64_t t) const {
+    return state == PowerState::dormant ? t - t % 1'000'000 : t;
+}
+
+void PowerModel::settle() {
+    const uint64_t now = clock_.now_us();
+    if (now <= accounted_) return;
+    run_us_ += now - accounted_;
+    charge_ += double(now - accounted_) * power_run_ma;
+    accounted_ = now;
+}
+
+void PowerModel::enter(PowerState state, uint64_t wake_at) {
+    const PowerStateSpec &p = power_states[size_t(state)];
+    settle();
+    // Exit takes between half and all of the (scaled) spec.
+    const uint32_t spec_us = p.exit_us * exit_percent_ / 100;
+    seed_ = seed_ * 1664525u + 1013904223u;
+    const uint32_t exit_us = spec_us / 2 + (seed_ >> 8) % (spec_us / 2 + 1);
+
+    const uint64_t in = clock_.now_us() + p.enter_us;
+    const uint64_t stay = wake_at > in ? wake_at - in : 0;
+    const uint64_t transitions = p.enter_us + exit_us;
+    clock_.advance(transitions + stay);
+    time_us_[size_t(state)] += stay;
+    charge_ += double(stay) * p.ma + double(transitions) * power_run_ma;
+    accounted_ = clock_.now_us();
+}
+
+double PowerModel::average_ma() const {
+    return accounted_ ? charge_ / double(accounted_) : 0;
+}
+
+#endif
+
+} // namespace thermo
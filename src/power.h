@@ -0,0 +1,206 @@
+// Low-power waits between scheduler releases.
+//
+// PowerManager is the Clock the scheduler sleeps through. For every wait it
+// picks the deepest state whose target residency fits the time left before
+// the next release, wakes early by that state's exit latency so the release
+// is still on time, and finishes any remainder in a shallower state:
+//
+//   idle     WFE at full speed until the timer alarm (what SystemClock does)
+//   slow     clk_sys switched to the 12 MHz crystal; PLL_SYS keeps running
+//   sleep    PLL_SYS off too, and while both cores wait only the timer, SRAM,
+//            DMA, ADC and the buses are clocked, so sampling carries on
+//   dormant  crystal stopped, woken by the RTC on an external 32.768 kHz
+//            clock; everything else, sampling included, pauses. The RTC
+//            alarm has whole-second resolution
+//
+// States below idle run clk_sys from the crystal, but the PIO, SPI and I2C
+// dividers are set once, for the PLL's clk_sys: a transfer under way would
+// run ten times slower than its timing allows. So while any registered busy
+// check reports a transfer, waits stay at idle and look again every
+// busy_poll_us. app_init registers the 1-Wire bus and the display; an I2C
+// or SPI sensor driver must register its BusQueue (BusQueue::busy) too.
+//
+// Exit latency is measured on every wake: the estimate the policy wakes
+// early by only grows, to the worst seen. Each state's entries, residency
+// and worst wake latency are kept, together with wakes that came back past
+// the release.
+//
+// Ports: Rp2040PowerPort drives the clocks, PLLs, crystal and RTC on the
+// device; PowerModel on the host jumps a VirtualClock through the states and
+// integrates the current drawn, so a policy can be scored over simulated
+// days.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "scheduler.h"
+
+namespace thermo {
+
+enum class PowerState : uint8_t { idle, slow, sleep, dormant };
+
+constexpr size_t power_state_count = 4;
+
+/// Characteristics of one state on an RP2040 board at 3.3 V. The currents
+/// are rough board-level figures: enough to rank policies, not to quote.
+struct PowerStateSpec {
+    const char *name;
+    uint32_t enter_us;  // to get in, at run current
+    uint32_t exit_us;   // from the wake event back to running, at run current
+    float ma;           // while in the state
+};
+
+constexpr float power_run_ma = 25.0f;  // core 0 running, core 1 mostly waiting
+
+constexpr PowerStateSpec power_states[power_state_count] = {
+    {"idle", 0, 2, 12.0f},
+    {"slow", 5, 5, 4.5f},
+    {"sleep", 20, 150, 1.8f},
+    {"dormant", 60, 1'500, 0.8f},
+};
+
+/// Shortest stay for which `s` costs less than idling, transitions included.
+constexpr uint32_t power_target_residency_us(PowerState s) {
+    const PowerStateSpec &p = power_states[size_t(s)];
+    const PowerStateSpec &idle = power_states[size_t(PowerState::idle)];
+    if (p.ma >= idle.ma) return 0;
+    const float extra = float(p.enter_us + p.exit_us) * (power_run_ma - p.ma);
+    return uint32_t(extra / (idle.ma - p.ma)) + 1;
+}
+
+static_assert(power_target_residency_us(PowerState::slow) <
+                      power_target_residency_us(PowerState::sleep) &&
+                  power_target_residency_us(PowerState::sleep) <
+                      power_target_residency_us(PowerState::dormant),
+              "deeper states must need longer stays");
+
+/// Puts the chip into a state and returns once it is running again.
+class PowerPort {
+public:
+    /// Deepest state the hardware supports.
+    virtual PowerState deepest() const = 0;
+    /// The latest time at or before `t` the state can be woken at (a timer
+    /// alarm is exact; the RTC only fires on whole seconds).
+    virtual uint64_t wake_time(PowerState state, uint64_t t) const = 0;
+    /// Enter `state` and stay until `wake_at`, then come back. Returns later
+    /// than wake_at by the exit latency.
+    virtual void enter(PowerState state, uint64_t wake_at) = 0;
+
+protected:
+    ~PowerPort() = default;
+};
+
+/// True while a transfer that needs clk_sys at full speed is under way.
+using PowerBusyFn = bool (*)(void *ctx);
+
+struct PowerStateStats {
+    uint32_t entries = 0;
+    uint32_t late = 0;              // back after the release it woke for
+    uint32_t worst_wake_us = 0;     // wake_at -> running again
+    uint64_t residency_us = 0;      // entry done -> wake_at
+};
+
+class PowerManager final : public Clock {
+public:
+    static constexpr size_t max_busy_checks = 4;
+    static constexpr uint32_t busy_poll_us = 1'000;
+
+    PowerManager(Clock &clock, PowerPort &port);
+
+    uint64_t now_us() override { return clock_.now_us(); }
+    /// Wait for `t` through the deepest states that fit.
+    void sleep_until(uint64_t t) override;
+
+    /// Limit the states used, e.g. while USB or Wi-Fi must stay clocked.
+    void set_deepest(PowerState state);
+    PowerState deepest() const { return deepest_; }
+    /// Keep waits at idle while `busy(ctx)` is true. False when full.
+    bool add_busy_check(PowerBusyFn busy, void *ctx);
+
+
+    const PowerStateStats &stats(PowerState state) const { return stats_[size_t(state)]; }
+    /// Exit latency the policy currently allows for.
+    uint32_t exit_estimate_us(PowerState state) const { return exit_us_[size_t(state)]; }
+    /// Idle waits a busy check forced, each up to busy_poll_us long.
+    uint32_t busy_waits() const { return busy_waits_; }
+
+private:
+    struct BusyCheck {
+        PowerBusyFn fn;
+        void *ctx;
+    };
+
+    PowerState choose(uint64_t now, uint64_t t, uint64_t &wake_at) const;
+    bool busy() const;
+
+    Clock &clock_;
+    PowerPort &port_;
+    PowerState deepest_;
+    uint32_t exit_us_[power_state_count];
+    PowerStateStats stats_[power_state_count];
+    BusyCheck busy_[max_busy_checks] = {};
+    size_t busy_count_ = 0;
+    uint32_t busy_waits_ = 0;
+};
+
+#if PICO_ON_DEVICE
+
+/// The real thing. Dormant needs a 32.768 kHz clock on `rtc_clock_gpio`
+/// (GPIO 20 or 22, clk_gpin) to run the RTC while the crystal is stopped;
+/// without one (-1) the deepest state is sleep. With one, the RTC alarm
+/// interrupt catches its first second edge to line the timer up with the
+/// RTC, which then also restores the timer after each dormant stay; until
+/// that edge (within a second of construction) dormant is not woken into.
+class Rp2040PowerPort final : public PowerPort {
+public:
+    explicit Rp2040PowerPort(int rtc_clock_gpio = -1);
+    PowerState deepest() const override;
+    uint64_t wake_time(PowerState state, uint64_t t) const override;
+    void enter(PowerState state, uint64_t wake_at) override;
+
+private:
+    void run_from_xosc();
+    void run_from_pll();
+    void dormant_until(uint64_t wake_at);
+
+    bool rtc_ = false;
+};
+
+#else
+
+/// Simulated states on a VirtualClock, with exit latencies that vary up to
+/// the spec, and the charge drawn over time.
+class PowerModel final : public PowerPort {
+public:
+    /// rtc: whether an RTC clock is fitted, i.e. whether dormant exists.
+    /// exit_percent scales the exit latencies, e.g. for a board whose PLL
+    /// locks slower than the spec says.
+    explicit PowerModel(VirtualClock &clock, bool rtc = true, uint32_t exit_percent = 100)
+        : clock_(clock), rtc_(rtc), exit_percent_(exit_percent) {}
+    PowerState deepest() const override { return rtc_ ? PowerState::dormant : PowerState::sleep; }
+    uint64_t wake_time(PowerState state, uint64_t t) const override;
+    void enter(PowerState state, uint64_t wake_at) override;
+
+    /// Bring the accounting up to now (the time since the last wake is run).
+    void settle();
+    /// Average current since the start, in mA.
+    double average_ma() const;
+    /// Time spent in `state`, transitions excluded.
+    uint64_t time_us(PowerState state) const { return time_us_[size_t(state)]; }
+    uint64_t run_us() const { return run_us_; }
+
+private:
+    VirtualClock &clock_;
+    bool rtc_;
+    uint32_t exit_percent_;
+    uint32_t seed_ = 1;
+    uint64_t accounted_ = 0;  // time up to which charge is counted
+    uint64_t run_us_ = 0;
+    uint64_t time_us_[power_state_count] = {};
+    double charge_ = 0;       // mA * us
+};
+
+#endif
+
+} // namespace thermo
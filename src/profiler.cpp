@@ -0,0 +1,185 @@
+#include "profiler.h"
+
+#include <atomic>
+
+#include "pico/stdlib.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/irq.h"
+#include "hardware/timer.h"
+#else
+#include <dlfcn.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#endif
+
+namespace thermo {
+
+ProfileHistogram profile;
+
+static std::atomic<bool> dump_requested{false};
+static bool running;
+
+void ProfileHistogram::clear() {
+    for (Bucket &b : slots_) b = Bucket{0, 0};
+    samples_ = 0;
+    unbucketed_ = 0;
+}
+
+void profiler_request_dump() {
+    dump_requested.store(true, std::memory_order_relaxed);
+}
+
+bool profiler_take_dump_request() {
+    // Load and store only: the M0+ has no atomic exchange. A request that
+    // lands in between is merged with this one.
+    if (!dump_requested.load(std::memory_order_relaxed)) return false;
+    dump_requested.store(false, std::memory_order_relaxed);
+    return true;
+}
+
+bool profiler_running() {
+    return running;
+}
+
+void profile_write(const ProfileHistogram &h, FILE *out) {
+    fprintf(out, "# thermostat profile\nbase 0x%llx\nsamples %u\nbucket_bytes %u\n",
+            (unsigned long long)profile_image_base(), unsigned(h.samples()),
+            1u << ProfileHistogram::bucket_shift);
+    for (size_t i = 0; i < ProfileHistogram::buckets; i++) {
+        const ProfileHistogram::Bucket &b = h.slot(i);
+        if (b.key) {
+            fprintf(out, "0x%llx %u\n", (unsigned long long)ProfileHistogram::address(b),
+                    unsigned(b.count));
+        }
+    }
+    fflush(out);
+}
+
+#if PICO_ON_DEVICE
+
+static int alarm_num = -1;
+static uint32_t period_us;
+static uint32_t jitter_state = 1;
+
+static void __not_in_flash_func(arm_next)() {
+    jitter_state = jitter_state * 1664525u + 1013904223u;
+    const uint32_t spread = period_us / 2;
+    const uint32_t delay = period_us - period_us / 4 + (spread ? (jitter_state >> 8) % spread : 0);
+    timer_hw->alarm[alarm_num] = timer_hw->timerawl + delay;
+}
+
+// `frame` is the exception stack frame: r0-r3, r12, lr, pc, xpsr.
+extern "C" void __not_in_flash_func(profiler_sample_frame)(const uint32_t *frame) {
+    timer_hw->intr = 1u << alarm_num;
+    profile.add(frame[6]);
+    arm_next();
+}
+
+// Finds the stack the interrupted code was using (EXC_RETURN bit 2) and
+// passes its frame on. Naked, so no prologue moves the stack first.
+extern "C" __attribute__((naked)) void __not_in_flash_func(profiler_isr)() {
+    asm volatile(
+        "movs r0, #4\n"
+        "mov r1, lr\n"
+        "tst r0, r1\n"
+        "beq 1f\n"
+        "mrs r0, psp\n"
+        "b 2f\n"
+        "1: mrs r0, msp\n"
+        "2: ldr r1, =profiler_sample_frame\n"
+        "bx r1\n"
+        ".ltorg\n");
+}
+
+bool profiler_start(uint32_t rate_hz) {
+    if (running || !rate_hz) return running;
+    if (alarm_num < 0) {
+        alarm_num = hardware_alarm_claim_unused(false);
+        if (alarm_num < 0) return false;
+        irq_set_exclusive_handler(TIMER_IRQ_0 + alarm_num, profiler_isr);
+        irq_set_priority(TIMER_IRQ_0 + alarm_num, PICO_HIGHEST_IRQ_PRIORITY);
+    }
+    period_us = rate_hz < 1'000'000 ? 1'000'000 / rate_hz : 1;
+    hw_set_bits(&timer_hw->inte, 1u << alarm_num);
+    irq_set_enabled(TIMER_IRQ_0 + alarm_num, true);
+    running = true;
+    arm_next();
+    return true;
+}
+
+void profiler_stop() {
+    if (!running) return;
+    irq_set_enabled(TIMER_IRQ_0 + alarm_num, false);
+    hw_clear_bits(&timer_hw->inte, 1u << alarm_num);
+    timer_hw->armed = 1u << alarm_num;  // write 1 to disarm
+    timer_hw->intr = 1u << alarm_num;
+    running = false;
+}
+
+uintptr_t profile_image_base() {
+    return 0;
+}
+
+#else
+
+// SIGPROF goes to whichever thread was running; two can arrive at once.
+static std::atomic_flag in_sample = ATOMIC_FLAG_INIT;
+
+static uintptr_t context_pc(void *context) {
+    const ucontext_t *uc = static_cast<const ucontext_t *>(context);
+#if defined(__x86_64__)
+    return uintptr_t(uc->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__aarch64__)
+    return uintptr_t(uc->uc_mcontext.pc);
+#else
+    (void)uc;
+    return 0;  // counted as unbucketed
+#endif
+}
+
+static void on_sigprof(int, siginfo_t *, void *context) {
+    if (in_sample.test_and_set(std::memory_order_acquire)) return;
+    profile.add(context_pc(context));
+    in_sample.clear(std::memory_order_release);
+}
+
+bool profiler_start(uint32_t rate_hz) {
+    if (running || !rate_hz) return running;
+    struct sigaction sa = {};
+    sa.sa_sigaction = on_sigprof;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, nullptr)) return false;
+    struct sigaction usr = {};
+    usr.sa_handler = [](int) { profiler_request_dump(); };
+    usr.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &usr, nullptr);
+
+    const uint32_t period = rate_hz < 1'000'000 ? 1'000'000 / rate_hz : 1;
+    itimerval it = {};
+    it.it_interval.tv_sec = period / 1'000'000;
+    it.it_interval.tv_usec = period % 1'000'000;
+    it.it_value = it.it_interval;
+    if (setitimer(ITIMER_PROF, &it, nullptr)) return false;
+    running = true;
+    return true;
+}
+
+void profiler_stop() {
+    if (!running) return;
+    itimerval it = {};
+    setitimer(ITIMER_PROF, &it, nullptr);
+    running = false;
+}
+
+uintptr_t profile_image_base() {
+    Dl_info info;
+    if (!dladdr(reinterpret_cast<void *>(&profile_image_base), &info)) return 0;
+    return uintptr_t(info.dli_fbase);
+}
+
+#endif
+
+} // namespace thermo
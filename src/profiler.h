@@ -0,0 +1,124 @@
+// Statistical sampling profiler.
+//
+// A sampling interrupt records the program counter it interrupted into a
+// histogram of 16-byte code buckets. The histogram is a small open-addressed
+// hash table: hot code covers few buckets, so a few hundred slots cover a
+// program, and samples that find no free slot are counted as unbucketed.
+// Buckets are mapped to functions on the host, with the ELF symbol table of
+// the exact image that ran (tools/profile_report.py), which keeps the
+// firmware free of symbol data and the sampling interrupt to a hash and an
+// increment.
+//
+// Device: a spare hardware alarm at the highest IRQ priority on core 0, so
+// other interrupt handlers are sampled too (core 1 is not). The period is
+// jittered by +-25% so sampling cannot lock step with periodic tasks.
+// Host: setitimer(ITIMER_PROF) and SIGPROF, reading the PC from the signal
+// context, like perf's software clock; whichever thread is using the CPU is
+// sampled, and the kernel's tick limits the rate.
+//
+// A dump is requested with profiler_request_dump() (the firmware does so on
+// a 'p' from the USB serial port, or SIGUSR1 on the host) and written by the
+// application: as telemetry records, or as text in the format below.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#ifndef THERMO_PROFILE
+#define THERMO_PROFILE 0
+#endif
+
+// Histogram slots; a power of two. Each costs 8 bytes on the device.
+#ifndef THERMO_PROFILE_BUCKETS
+#define THERMO_PROFILE_BUCKETS 512
+#endif
+
+// Sampling rate of the firmware's profiler (THERMO_PROFILE builds).
+#ifndef THERMO_PROFILE_HZ
+#define THERMO_PROFILE_HZ 2000
+#endif
+
+namespace thermo {
+
+class ProfileHistogram {
+    static_assert(THERMO_PROFILE_BUCKETS &&
+                      (THERMO_PROFILE_BUCKETS & (THERMO_PROFILE_BUCKETS - 1)) == 0,
+                  "THERMO_PROFILE_BUCKETS must be a power of two");
+
+public:
+    static constexpr size_t buckets = THERMO_PROFILE_BUCKETS;
+    static constexpr unsigned bucket_shift = 4;
+    static constexpr size_t max_probes = 8;
+
+    struct Bucket {
+        uintptr_t key;  // pc >> bucket_shift; 0 for a free slot
+        uint32_t count;
+    };
+
+    /// Count one sample. Single writer: the sampling interrupt.
+    void add(uintptr_t pc) {
+        const uintptr_t key = pc >> bucket_shift;
+        samples_++;
+        if (!key) {
+            unbucketed_++;
+            return;
+        }
+        size_t i = size_t(uint32_t(key) * 2654435761u) & (buckets - 1);
+        for (size_t n = 0; n < max_probes; n++, i = (i + 1) & (buckets - 1)) {
+            Bucket &b = slots_[i];
+            if (b.key == key) {
+                b.count++;
+                return;
+            }
+            if (!b.key) {
+                b.key = key;
+                b.count = 1;
+                return;
+            }
+        }
+        unbucketed_++;
+    }
+
+    /// Only while sampling is stopped.
+    void clear();
+
+    uint32_t samples() const { return samples_; }
+    uint32_t unbucketed() const { return unbucketed_; }
+    const Bucket &slot(size_t i) const { return slots_[i]; }
+    static uintptr_t address(const Bucket &b) { return b.key << bucket_shift; }
+
+private:
+    Bucket slots_[buckets];
+    uint32_t samples_ = 0;
+    uint32_t unbucketed_ = 0;
+};
+
+/// The histogram the sampling interrupt fills.
+extern ProfileHistogram profile;
+
+/// Start sampling about `rate_hz` times a second. False if no timer was
+/// available.
+bool profiler_start(uint32_t rate_hz);
+void profiler_stop();
+bool profiler_running();
+
+/// Ask the application for a dump; safe from interrupts and signal handlers.
+void profiler_request_dump();
+/// True once per request.
+bool profiler_take_dump_request();
+
+/// Text dump, read by tools/profile_report.py:
+///
+///   # thermostat profile
+///   base 0x...          (load address of the image; 0 on the device)
+///   samples N           (all samples, including unbucketed ones)
+///   bucket_bytes 16
+///   0x<bucket address> <count>     (one line per used bucket)
+void profile_write(const ProfileHistogram &h, FILE *out);
+
+/// Load address of the running image, to subtract from bucket addresses
+/// before looking them up in the ELF file.
+uintptr_t profile_image_base();
+
+} // namespace thermo
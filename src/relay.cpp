@@ -0,0 +1,39 @@
+#include "relay.h"
+
+#include "memory_config.h"
+#include "trace.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/gpio.h"
+#endif
+
+namespace thermo {
+
+#ifndef THERMO_RELAY_GPIO
+#define THERMO_RELAY_GPIO 15
+#endif
+
+static bool relay_state;
+
+void relay_init() {
+#if PICO_ON_DEVICE
+    gpio_init(THERMO_RELAY_GPIO);
+    gpio_set_dir(THERMO_RELAY_GPIO, GPIO_OUT);
+    gpio_put(THERMO_RELAY_GPIO, false);
+#endif
+    relay_state = false;
+}
+
+void THERMO_HOT(relay_set)(bool on) {
+    if (on != relay_state) TRACE_INSTANT(relay, on);
+#if PICO_ON_DEVICE
+    gpio_put(THERMO_RELAY_GPIO, on);
+#endif
+    relay_state = on;
+}
+
+bool relay_get() {
+    return relay_state;
+}
+
+} // namespace thermo
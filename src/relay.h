@@ -0,0 +1,10 @@
+// Heat relay output.
+#pragma once
+
+namespace thermo {
+
+void relay_init();
+void relay_set(bool on);
+bool relay_get();
+
+} // namespace thermo
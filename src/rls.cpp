@@ -0,0 +1,141 @@
+#include "rls.h"
+
+#include <cmath>
+
+#include "memory_config.h"
+
+namespace thermo {
+
+template <typename T>
+void RlsEstimator<T>::configure(uint32_t period_ticks, float tick_s, float forget,
+                                float dead_s) {
+    period_ = period_ticks ? period_ticks : 1;
+    period_s_ = float(period_) * tick_s;
+    const float dead = dead_s / period_s_ + 0.5f;
+    dead_ = uint8_t(dead < max_dead ? uint32_t(dead) : max_dead);
+    forget = clamp(forget, 0.9f, 1.0f);
+    forget_ = Numeric<T>::from_float(forget);
+    inv_forget_ = Numeric<T>::from_float(1 / forget);
+    track_ = Numeric<T>::from_float(1 - forget);
+    reset();
+}
+
+template <typename T>
+void RlsEstimator<T>::reset() {
+    ticks_ = 0;
+    on_ticks_ = 0;
+    primed_ = false;
+    prev_y_ = T(0);
+    for (T &u : past_) u = T(0);
+    for (T &th : theta_) th = T(0);
+    updates_ = 0;
+    restarts_ = 0;
+    restart();
+}
+
+template <typename T>
+void RlsEstimator<T>::restart() {
+    for (uint32_t i = 0; i < params; i++) {
+        for (uint32_t j = 0; j < params; j++) p_[i][j] = T(i == j ? prior : 0);
+    }
+}
+
+template <typename T>
+bool THERMO_HOT(RlsEstimator<T>::sample)(T temp_c, bool heat) {
+    on_ticks_ += heat;
+    if (++ticks_ < period_) return false;
+
+    // The temperature at the block's end, against the heat over the block.
+    ticks_ = 0;
+    for (uint32_t k = max_dead; k > 0; k--) past_[k] = past_[k - 1];
+    past_[0] = Numeric<T>::ratio(int32_t(on_ticks_), int32_t(period_));
+    on_ticks_ = 0;
+    const bool updated = primed_;
+    if (updated) {
+        update(temp_c);
+        recentre((temp_c - ref_) * track_);
+    } else {
+        ref_ = temp_c;
+    }
+    prev_y_ = temp_c;
+    primed_ = true;
+    return updated;
+}
+
+template <typename T>
+void RlsEstimator<T>::update(T y) {
+    const T phi[params] = {prev_y_ - ref_, past_[dead_], T(1)};
+    T err = (y - prev_y_) * scale;
+    // g and the denominator come out multiplied by p_scale, so k does not.
+    T g[params];
+    T denom = forget_ * p_scale;
+    for (uint32_t i = 0; i < params; i++) {
+        err -= theta_[i] * phi[i];
+        g[i] = T(0);
+        for (uint32_t j = 0; j < params; j++) g[i] += p_[i][j] * phi[j];
+        denom += phi[i] * g[i];
+    }
+    if (!(denom > T(0))) {
+        restart();
+        restarts_++;
+        return;
+    }
+    const T inv = T(1) / denom;
+    T k[params];
+    for (uint32_t i = 0; i < params; i++) {
+        k[i] = g[i] * inv;
+        theta_[i] += k[i] * err;
+    }
+    // Symmetric by construction; update the upper triangle and mirror it.
+    const bool inflate = trace() < T(trace_cap);
+    for (uint32_t i = 0; i < params; i++) {
+        for (uint32_t j = i; j < params; j++) {
+            T p = p_[i][j] - k[i] * g[j];
+            if (inflate) p *= inv_forget_;
+            p_[i][j] = p_[j][i] = p;
+        }
+    }
+    for (uint32_t i = 0; i < params; i++) {
+        if (!(p_[i][i] > T(0))) {
+            restart();
+            restarts_++;
+            break;
+        }
+    }
+    updates_++;
+}
+
+// Moving r by delta is an exact change of parameters: th2 += th0 delta, and
+// P follows it as A P A' for A = I + delta e2 e0'.
+template <typename T>
+void RlsEstimator<T>::recentre(T delta) {
+    ref_ += delta;
+    theta_[2] += theta_[0] * delta;
+    for (uint32_t j = 0; j < params; j++) p_[2][j] += delta * p_[0][j];
+    for (uint32_t i = 0; i < params; i++) p_[i][2] += delta * p_[i][0];
+}
+
+template <typename T>
+RoomEstimate RlsEstimator<T>::estimate() const {
+    RoomEstimate e;
+    const float th0 = Numeric<T>::to_float(theta_[0]) / scale;
+    const float th1 = Numeric<T>::to_float(theta_[1]) / scale;
+    const float th2 = Numeric<T>::to_float(theta_[2]) / scale;
+    const float a = 1 + th0;
+    if (!(a > 0 && a < 1)) return e;
+    e.tau_s = -period_s_ / std::log(a);
+    e.gain_c = -th1 / th0;
+    e.baseline_c = Numeric<T>::to_float(ref_) - th2 / th0;
+    // Converged once the forgetting window has filled, and only while the
+    // data still pins the model down better than the prior did: with the
+    // heating off for the summer nothing does, and the fit drifts.
+    const float window = 1 / (1 - Numeric<T>::to_float(forget_) + 1e-6f);
+    e.valid = float(updates_) >= window && trace() < T(prior) && e.gain_c > 0 &&
+              e.gain_c < max_gain_c && e.tau_s < max_tau_s;
+    return e;
+}
+
+template class RlsEstimator<float>;
+template class RlsEstimator<Q16>;
+
+} // namespace thermo
@@ -0,0 +1,108 @@
+// Online identification of the room model by recursive least squares.
+//
+// The control ticks are grouped into blocks of `period` ticks, and each
+// finished block updates a first-order ARX model of the room
+//
+//   s (y_k+1 - y_k) = th0 (y_k - r) + th1 u_k-d + th2
+//
+// where y is the temperature at the end of a block, u the fraction of the
+// block the heat was on, d the dead time in blocks and r a slow running mean
+// of y. The scale s lifts the parameters well clear of Q16's resolution, and
+// centring on r keeps the temperature regressor from lining up with the
+// constant one.
+// From the parameters: per-block decay a = 1 + th0 / s, time constant
+// tau = -period / ln a, gain = -th1 / th0, and the room would settle unheated
+// at r - th2 / th0, which th2 follows as the weather changes.
+//
+// The update is the textbook one with exponential forgetting lambda:
+//
+//   g = P phi,  k = g / (lambda + phi' g),  th += k e,  P = (P - k g') / lambda
+//
+// a fixed 3 x 3 amount of work per block, no matter how long it has run. The
+// covariance is only inflated by 1 / lambda while its trace is below a cap,
+// so long stretches of steady regulation (no excitation) cannot wind it up
+// until Q16 overflows; and if rounding ever leaves it indefinite, it is
+// reset to the prior rather than left to diverge.
+#pragma once
+
+#include <cstdint>
+
+#include "fixed.h"
+
+namespace thermo {
+
+/// The current model in the units ThermostatConfig uses for it.
+struct RoomEstimate {
+    bool valid = false;    // converged and physically plausible
+    float gain_c = 0;      // full heat raises the room this far above baseline
+    float tau_s = 0;
+    float baseline_c = 0;  // where the room would settle unheated
+};
+
+template <typename T>
+class RlsEstimator {
+public:
+    static constexpr uint32_t params = 3;
+    static constexpr uint32_t max_dead = 16;  // blocks
+    // Beyond these an estimate is a fit to noise, not a room.
+    static constexpr float max_gain_c = 100;
+    static constexpr float max_tau_s = 2 * 86400;
+    /// Covariance trace (as trace() reports it) above which it is not inflated.
+    static constexpr int32_t trace_cap = 512;
+
+    /// Block length in ticks, forgetting factor per block (0.9 .. 1) and the
+    /// dead time the heat input is delayed by. Clears the estimate.
+    void configure(uint32_t period_ticks, float tick_s, float forget, float dead_s);
+    void reset();
+
+    /// Once per control tick, with the filtered temperature and whether the
+    /// heat was on. Returns true when the tick completed a block and the
+    /// model was updated.
+    bool sample(T temp_c, bool heat);
+
+    /// Converts the parameters to a model; float, since it is read once per
+    /// block at most.
+    RoomEstimate estimate() const;
+    uint32_t updates() const { return updates_; }
+    /// Times the covariance had to be reset to the prior (numerical guard).
+    uint32_t restarts() const { return restarts_; }
+    const T *theta() const { return theta_; }
+    /// Trace of the covariance, multiplied by p_scale.
+    T trace() const { return p_[0][0] + p_[1][1] + p_[2][2]; }
+
+private:
+    static constexpr int32_t scale = 64;
+    // P is kept multiplied by p_scale: once converged its entries are around
+    // 0.01, which would leave them a few hundred LSB in Q16.
+    static constexpr int32_t p_scale = 256;
+    static constexpr int32_t prior = 128;      // P starts at prior / p_scale * I
+
+    void update(T y);
+    void restart();
+    void recentre(T delta);
+
+    uint32_t period_ = 300;
+    float period_s_ = 300;
+    uint8_t dead_ = 0;
+    T forget_{};
+    T inv_forget_{};
+    T track_{};  // 1 - lambda: the running mean's rate
+
+    // Block in progress.
+    uint32_t ticks_ = 0;
+    uint32_t on_ticks_ = 0;
+
+    bool primed_ = false;
+    T ref_{};
+    T prev_y_{};
+    T past_[max_dead + 1] = {};  // block duties, newest first
+    T theta_[params] = {};
+    T p_[params][params] = {};
+    uint32_t updates_ = 0;
+    uint32_t restarts_ = 0;
+};
+
+extern template class RlsEstimator<float>;
+extern template class RlsEstimator<Q16>;
+
+} // namespace thermo
@@ -0,0 +1,159 @@
+#include "rollup.h"
+
+#include <cstring>
+
+namespace thermo {
+
+constexpr uint32_t RollupIndex::width[];
+constexpr uint32_t RollupIndex::slots[];
+
+void RollupIndex::clear() {
+    memset(minutes_, 0, sizeof(minutes_));
+    memset(hours_, 0, sizeof(hours_));
+    memset(days_, 0, sizeof(days_));
+    newest_t_ = 0;
+    has_data_ = false;
+}
+
+uint32_t RollupIndex::oldest_id(size_t i) const {
+    uint32_t newest = newest_t_ / width[i];
+    return newest >= slots[i] ? newest - slots[i] + 1 : 0;
+}
+
+const RollupIndex::Bucket *RollupIndex::find(size_t i, uint32_t id) const {
+    if (!has_data_ || id < oldest_id(i) || id > newest_t_ / width[i]) return nullptr;
+    const Bucket &b = ring(i)[id % slots[i]];
+    return b.count && b.lap == uint16_t(id / slots[i]) ? &b : nullptr;
+}
+
+void RollupIndex::merge(size_t i, uint32_t id, const HistorySummary &s) {
+    if (!s.count || id < oldest_id(i) || id > newest_t_ / width[i]) return;
+    Bucket &b = ring(i)[id % slots[i]];
+    const uint16_t lap = uint16_t(id / slots[i]);
+    if (!b.count || b.lap != lap) {
+        // Empty, or left over from an earlier lap of the ring.
+        b.sum = int32_t(s.sum);
+        b.min = s.min;
+        b.max = s.max;
+        b.count = uint16_t(s.count);
+        b.lap = lap;
+        return;
+    }
+    b.sum += int32_t(s.sum);
+    if (s.min < b.min) b.min = s.min;
+    if (s.max > b.max) b.max = s.max;
+    b.count = uint16_t(b.count + s.count);
+}
+
+void RollupIndex::add(uint32_t t, int16_t centi) {
+    if (!has_data_ || t > newest_t_) newest_t_ = t;
+    has_data_ = true;
+    HistorySummary one;
+    one.add(t, centi);
+    for (size_t i = 0; i < level_count; i++) merge(i, t / width[i], one);
+}
+
+// Whole buckets of level i inside [a, b], the partial ones at either edge
+// from level i - 1 as long as that level still holds them. An edge the finer
+// level no longer holds is widened to the enclosing bucket of this level.
+void RollupIndex::cover(size_t i, uint32_t a, uint32_t b, HistorySummary &out,
+                        uint32_t &buckets) const {
+    const uint64_t w = width[i];
+    // The finer level must hold all of an edge's partial bucket: from a for
+    // the left edge, from the start of b's bucket for the right.
+    const bool fine_a = i > 0 && a / width[i - 1] >= oldest_id(i - 1);
+    const bool fine_b = i > 0 && (uint64_t(b) + 1) / w * w / width[i - 1] >= oldest_id(i - 1);
+    uint64_t first = fine_a ? (a + w - 1) / w : a / w;
+    uint64_t end = fine_b ? (uint64_t(b) + 1) / w : b / w + 1;
+    if (first >= end) {
+        if (fine_a) {
+            // No whole bucket at this level: the window lies inside one.
+            cover(i - 1, a, b, out, buckets);
+            return;
+        }
+        end = first + 1;
+    }
+    if (fine_a && a < first * w) cover(i - 1, a, uint32_t(first * w - 1), out, buckets);
+    if (fine_b && uint64_t(b) + 1 > end * w) cover(i - 1, uint32_t(end * w), b, out, buckets);
+
+    uint64_t lo = first > oldest_id(i) ? first : oldest_id(i);
+    uint64_t hi = end - 1 < newest_t_ / w ? end - 1 : newest_t_ / w;
+    for (uint64_t id = lo; id <= hi; id++) {
+        const Bucket *bk = find(i, uint32_t(id));
+        if (!bk) continue;
+        HistorySummary s;
+        s.t_first = uint32_t(id * w);
+        s.t_last = uint32_t(id * w + w - 1);
+        s.count = bk->count;
+        s.min = bk->min;
+        s.max = bk->max;
+        s.sum = bk->sum;
+        out.merge(s);
+        buckets++;
+    }
+}
+
+HistorySummary RollupIndex::query(uint32_t t0, uint32_t t1, uint32_t *buckets) const {
+    HistorySummary out;
+    uint32_t n = 0;
+    if (has_data_ && t0 <= t1) cover(level_count - 1, t0, t1, out, n);
+    if (buckets) *buckets = n;
+    return out;
+}
+
+uint32_t RollupIndex::rebuild(HistoryStore &store) {
+    clear();
+    // Pass 1: the newest timestamp fixes what each ring retains.
+    store.for_each_chunk(
+        [](void *ctx, const uint8_t *data, size_t len) {
+            RollupIndex &self = *static_cast<RollupIndex *>(ctx);
+            HistoryChunkReader reader;
+            if (!reader.open(data, len)) return;
+            if (!self.has_data_ || reader.summary().t_last > self.newest_t_) {
+                self.newest_t_ = reader.summary().t_last;
+            }
+            self.has_data_ = true;
+        },
+        this);
+
+    // Pass 2: a chunk inside one bucket is merged from its header; samples
+    // are only decoded for levels where it straddles buckets.
+    struct Rebuild {
+        RollupIndex *self;
+        uint32_t decoded;
+    } ctx{this, 0};
+    store.for_each_chunk(
+        [](void *p, const uint8_t *data, size_t len) {
+            Rebuild &r = *static_cast<Rebuild *>(p);
+            RollupIndex &self = *r.self;
+            HistoryChunkReader reader;
+            if (!reader.open(data, len)) return;
+            const HistorySummary &s = reader.summary();
+            bool decode[level_count] = {};
+            bool any = false;
+            for (size_t i = 0; i < level_count; i++) {
+                const uint32_t w = width[i];
+                if (s.t_last / w < self.oldest_id(i)) continue;
+                if (s.t_first / w == s.t_last / w) {
+                    self.merge(i, s.t_first / w, s);
+                } else {
+                    decode[i] = any = true;
+                }
+            }
+            if (!any) return;
+            r.decoded++;
+            uint32_t t;
+            int16_t centi;
+            while (reader.next(t, centi)) {
+                HistorySummary one;
+                one.add(t, centi);
+                for (size_t i = 0; i < level_count; i++) {
+                    if (decode[i]) self.merge(i, t / width[i], one);
+                }
+            }
+        },
+        &ctx);
+    return ctx.decoded;
+}
+
+} // namespace thermo
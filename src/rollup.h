@@ -0,0 +1,76 @@
+// Multi-resolution rollup of the temperature history.
+//
+// Three rings of pre-aggregated buckets (count, min, max, sum) at minute,
+// hour and day width are updated as each sample arrives. A window query
+// takes whole buckets from the coarsest level that fits and only descends a
+// level for the partial buckets at the window's edges, so its cost is
+// bounded by the ring sizes, not by the number of samples behind it.
+//
+// Resolution follows retention: the last day is answered to the minute, the
+// last two weeks to the hour, older windows to the day. A query whose edge
+// lies beyond a level's ring is widened to the enclosing coarser bucket; the
+// returned summary's t_first/t_last give the span actually covered.
+//
+// At boot, rebuild() repopulates the rings from the flash history, taking
+// chunk header summaries wherever a chunk falls inside one bucket and
+// decoding only the chunks that straddle a bucket boundary.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "history.h"
+
+namespace thermo {
+
+class RollupIndex {
+public:
+    static constexpr size_t level_count = 3;
+    static constexpr uint32_t minute_slots = 24 * 60;
+    static constexpr uint32_t hour_slots = 14 * 24;
+    static constexpr uint32_t day_slots = 400;
+
+    /// Fold one sample (seconds, centi-degrees) into every level. Samples
+    /// older than a level's ring are ignored by that level.
+    void add(uint32_t t, int16_t centi);
+
+    /// Summary of [t0, t1] (inclusive). `buckets`, if given, receives the
+    /// number of buckets merged.
+    HistorySummary query(uint32_t t0, uint32_t t1, uint32_t *buckets = nullptr) const;
+
+    /// Clear and repopulate from every chunk in `store`. Returns the number
+    /// of chunks that had to be decoded.
+    uint32_t rebuild(HistoryStore &store);
+
+    void clear();
+    bool empty() const { return !has_data_; }
+    /// Timestamp of the newest sample added.
+    uint32_t newest() const { return newest_t_; }
+
+private:
+    struct Bucket {
+        int32_t sum;
+        int16_t min;
+        int16_t max;
+        uint16_t count;  // 0: empty
+        uint16_t lap;    // id / slots, tells this bucket from the one a lap earlier
+    };
+
+    static constexpr uint32_t width[level_count] = {60, 60 * 60, 24 * 60 * 60};
+    static constexpr uint32_t slots[level_count] = {minute_slots, hour_slots, day_slots};
+
+    Bucket *ring(size_t i) { return i == 0 ? minutes_ : i == 1 ? hours_ : days_; }
+    const Bucket *ring(size_t i) const { return i == 0 ? minutes_ : i == 1 ? hours_ : days_; }
+    const Bucket *find(size_t i, uint32_t id) const;
+    uint32_t oldest_id(size_t i) const;
+    void merge(size_t i, uint32_t id, const HistorySummary &s);
+    void cover(size_t i, uint32_t a, uint32_t b, HistorySummary &out, uint32_t &buckets) const;
+
+    Bucket minutes_[minute_slots] = {};
+    Bucket hours_[hour_slots] = {};
+    Bucket days_[day_slots] = {};
+    uint32_t newest_t_ = 0;
+    bool has_data_ = false;
+};
+
+} // namespace thermo
@@ -0,0 +1,159 @@
+#include "scheduler.h"
+
+#include "pico/stdlib.h"
+
+#include "memory_config.h"
+#include "trace.h"
+
+namespace thermo {
+
+uint64_t SystemClock::now_us() {
+    return time_us_64();
+}
+
+void SystemClock::sleep_until(uint64_t t) {
+#if PICO_ON_DEVICE
+    // Arms an alarm on the default alarm pool and WFEs until it fires.
+    ::sleep_until(from_us_since_boot(t));
+#else
+    uint64_t now = time_us_64();
+    if (t > now) sleep_us(t - now);
+#endif
+}
+
+int Scheduler::add(const char *name, uint64_t release, uint32_t period, uint32_t deadline,
+                   TaskFn fn, void *ctx) {
+    for (size_t i = 0; i < max_tasks; i++) {
+        Task &t = tasks_[i];
+        if (t.active || int(i) == running_) continue;
+        const uint16_t generation = uint16_t((t.generation + 1) & 0x7fff);
+        t = Task{name, fn, ctx, release, period, deadline ? deadline : (period ? period : UINT32_MAX),
+                 true, generation, {}};
+        return int(generation * max_tasks + i);
+    }
+    return invalid_task;
+}
+
+int Scheduler::add_periodic(const char *name, uint32_t period_us, TaskFn fn, void *ctx,
+                            uint32_t phase_us, uint32_t deadline_us) {
+    if (!period_us) return invalid_task;
+    return add(name, clock_.now_us() + phase_us, period_us, deadline_us, fn, ctx);
+}
+
+int Scheduler::add_oneshot(const char *name, uint32_t delay_us, TaskFn fn, void *ctx,
+                           uint32_t deadline_us) {
+    return add(name, clock_.now_us() + delay_us, 0, deadline_us, fn, ctx);
+}
+
+int Scheduler::slot(int id) const {
+    if (id < 0) return invalid_task;
+    const size_t i = size_t(id) % max_tasks;
+    return tasks_[i].generation == size_t(id) / max_tasks ? int(i) : invalid_task;
+}
+
+void Scheduler::cancel(int id) {
+    const int i = slot(id);
+    if (i != invalid_task) tasks_[i].active = false;
+}
+
+void Scheduler::reschedule(int id, uint64_t t) {
+    const int i = slot(id);
+    if (i != invalid_task && tasks_[i].active) tasks_[i].release = t;
+}
+
+const TaskStats *Scheduler::stats(int id) const {
+    const int i = slot(id);
+    return i != invalid_task ? &tasks_[i].stats : nullptr;
+}
+
+const char *Scheduler::name(int id) const {
+    const int i = slot(id);
+    return i != invalid_task ? tasks_[i].name : nullptr;
+}
+
+uint64_t THERMO_HOT(Scheduler::next_release)() const {
+    uint64_t next = UINT64_MAX;
+    for (const Task &t : tasks_) {
+        if (t.active && t.release < next) next = t.release;
+    }
+    return next;
+}
+
+// Earliest release among the tasks that are due; ties go to the lower slot,
+// so registration order doubles as priority.
+int THERMO_HOT(Scheduler::next_due)(uint64_t now) const {
+    int best = invalid_task;
+    for (size_t i = 0; i < max_tasks; i++) {
+        const Task &t = tasks_[i];
+        if (!t.active || t.release > now) continue;
+        if (best == invalid_task || t.release < tasks_[best].release) best = int(i);
+    }
+    return best;
+}
+
+// The slot stays reserved while the task runs: a one-shot that re-arms
+// itself gets a different slot, and this run is credited to the task that
+// made it, against its own deadline.
+void THERMO_HOT(Scheduler::run_task)(size_t slot, uint64_t now) {
+    Task &task = tasks_[slot];
+    running_ = int(slot);
+    uint64_t release = task.release;
+    uint32_t latency = uint32_t(now - release);
+    if (task.period) {
+        task.release += task.period;
+    } else {
+        task.active = false;
+    }
+
+    task.fn(task.ctx);
+
+    uint64_t end = clock_.now_us();
+    uint32_t ran = uint32_t(end - now);
+    TaskStats &s = task.stats;
+    s.runs++;
+    s.total_run_us += ran;
+    if (latency > s.worst_latency_us) s.worst_latency_us = latency;
+    if (ran > s.worst_run_us) s.worst_run_us = ran;
+    if (end > release + task.deadline) {
+        s.overruns++;
+        TRACE_INSTANT(overrun, slot);
+    }
+
+    // Never queue a backlog of releases: if a whole period or more was
+    // missed, drop every release up to now and resume from the next one
+    // after it. A release that is late by less than a period still runs.
+    if (task.period && task.active && task.release + task.period <= end) {
+        uint64_t missed = (end - task.release) / task.period + 1;
+        s.skipped += uint32_t(missed);
+        TRACE_INSTANT(skipped, missed);
+        task.release += missed * task.period;
+    }
+    running_ = invalid_task;
+}
+
+size_t THERMO_HOT(Scheduler::run_once)() {
+    size_t ran = 0;
+    for (;;) {
+        uint64_t now = clock_.now_us();
+        int id = next_due(now);
+        if (id == invalid_task) break;
+        run_task(size_t(id), now);
+        ran++;
+    }
+    // With nothing released (every task held at `never`), idle in bounded
+    // steps rather than spin.
+    uint64_t before = clock_.now_us();
+    uint64_t next = next_release();
+    if (next == never) next = before + max_idle_us;
+    TRACE_BEGIN(idle);
+    clock_.sleep_until(next);
+    TRACE_END(idle);
+    idle_us_ += clock_.now_us() - before;
+    return ran;
+}
+
+void Scheduler::run() {
+    for (;;) run_once();
+}
+
+} // namespace thermo
@@ -0,0 +1,128 @@
+// Tickless cooperative scheduler.
+//
+// Tasks are plain functions released periodically or once. run_once() runs
+// every task that is due, earliest release first, then sleeps the core until
+// the next release instead of polling. Each task records how late it started
+// (latency against its release), how long it ran and how often it finished
+// past its deadline.
+//
+// Time comes from a Clock: SystemClock sleeps through the pico-sdk default
+// alarm pool (sleep_until, WFE between alarms); VirtualClock, for host
+// simulation, jumps straight to the next deadline so days of schedule run in
+// seconds.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace thermo {
+
+class Clock {
+public:
+    virtual uint64_t now_us() = 0;
+    /// Block until now_us() >= t (returns immediately if already past).
+    virtual void sleep_until(uint64_t t) = 0;
+
+protected:
+    ~Clock() = default;
+};
+
+class SystemClock final : public Clock {
+public:
+    uint64_t now_us() override;
+    void sleep_until(uint64_t t) override;
+};
+
+/// Simulated time. sleep_until() jumps; tasks model their own cost by calling
+/// advance().
+class VirtualClock final : public Clock {
+public:
+    uint64_t now_us() override { return now_; }
+    void sleep_until(uint64_t t) override {
+        if (t > now_) now_ = t;
+    }
+    void advance(uint64_t us) { now_ += us; }
+
+private:
+    uint64_t now_ = 0;
+};
+
+using TaskFn = void (*)(void *ctx);
+
+struct TaskStats {
+    uint32_t runs = 0;
+    uint32_t overruns = 0;  // finished after release + deadline
+    uint32_t skipped = 0;   // periodic releases dropped because a whole period was missed
+    uint32_t worst_latency_us = 0;
+    uint32_t worst_run_us = 0;
+    uint64_t total_run_us = 0;
+};
+
+class Scheduler {
+public:
+    static constexpr size_t max_tasks = 16;
+    static constexpr int invalid_task = -1;
+    static constexpr uint64_t never = UINT64_MAX;
+    /// run_once() sleeps at most this long when no task has a release, e.g.
+    /// while every task is held at `never`.
+    static constexpr uint32_t max_idle_us = 100'000;
+
+    explicit Scheduler(Clock &clock) : clock_(clock) {}
+
+    /// First release at now + phase_us, then every period_us. deadline_us of 0
+    /// means the deadline is the period. Returns a task id or invalid_task.
+    int add_periodic(const char *name, uint32_t period_us, TaskFn fn, void *ctx = nullptr,
+                     uint32_t phase_us = 0, uint32_t deadline_us = 0);
+    /// Single release at now + delay_us; the slot frees itself after running.
+    int add_oneshot(const char *name, uint32_t delay_us, TaskFn fn, void *ctx = nullptr,
+                    uint32_t deadline_us = 0);
+    /// Ids carry their slot's generation: once the task has finished or been
+    /// cancelled its id refers to nothing, even after the slot is reused, so
+    /// cancel() ignores it and stats() and name() return null.
+    void cancel(int id);
+    /// Move the next release of `id` to `t`; a periodic task carries on every
+    /// period from there. With `never` the task keeps its slot, and so its
+    /// priority, but does not run until moved again.
+    void reschedule(int id, uint64_t t);
+
+    /// Run everything due now, then sleep until the next release, or for
+    /// max_idle_us if there is none. Returns the number of tasks run.
+    size_t run_once();
+    [[noreturn]] void run();
+
+    const TaskStats *stats(int id) const;
+    const char *name(int id) const;
+    /// Time of the earliest pending release, or `never` if none.
+    uint64_t next_release() const;
+    uint64_t idle_us() const { return idle_us_; }
+    Clock &clock() { return clock_; }
+
+private:
+    struct Task {
+        const char *name;
+        TaskFn fn;
+        void *ctx;
+        uint64_t release;
+        uint32_t period;  // 0 for one-shot
+        uint32_t deadline;
+        bool active;
+        uint16_t generation;  // bumped on every add() to the slot
+        TaskStats stats;
+    };
+
+    int add(const char *name, uint64_t release, uint32_t period, uint32_t deadline, TaskFn fn,
+            void *ctx);
+    int next_due(uint64_t now) const;
+    void run_task(size_t slot, uint64_t now);
+    /// The slot `id` names, or invalid_task if it is out of date.
+    int slot(int id) const;
+
+    Clock &clock_;
+    Task tasks_[max_tasks] = {};
+    // The slot whose task is running: add() leaves it alone until its run
+    // is accounted, even if the task ended or cancelled itself.
+    int running_ = invalid_task;
+    uint64_t idle_us_ = 0;
+};
+
+} // namespace thermo
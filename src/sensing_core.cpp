@@ -0,0 +1,105 @@
+#include "sensing_core.h"
+
+#include "pico/stdlib.h"
+
+#include "arena.h"
+#include "boot.h"
+#include "sensor.h"
+#include "trace.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/structs/scb.h"
+#include "hardware/sync.h"
+#include "pico/flash.h"
+#include "pico/multicore.h"
+#else
+#include <thread>
+#endif
+
+namespace thermo {
+
+THERMO_ARENA(corelink, THERMO_RAM_CORELINK);
+
+static ReadingQueue *queue;
+static std::atomic<uint32_t> drops{0};
+
+#if !PICO_ON_DEVICE
+static std::atomic<bool> host_stop{false};
+static std::thread host_core1;
+#endif
+
+static void THERMO_HOT(core1_main)() {
+    boot_mark(BootStage::core1);
+#if PICO_ON_DEVICE
+    // Let core 0 park this core while it programs or erases flash.
+    flash_safe_execute_core_init();
+    // Waits here count towards chip sleep, so the clocks PowerManager gates
+    // stop while both cores wait (the default SLEEP_EN gates nothing).
+    scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+#else
+    trace_set_core(1);
+#endif
+    sensor_start();
+    uint32_t seq = 0;
+    for (;;) {
+#if !PICO_ON_DEVICE
+        if (host_stop.load(std::memory_order_relaxed)) return;
+#endif
+        real_t temp_c;
+        if (!sensor_poll(temp_c)) {
+#if PICO_ON_DEVICE
+            // Sleep until the next DMA block interrupt.
+            __wfe();
+#endif
+            continue;
+        }
+        TRACE_INSTANT(reading, seq);
+        boot_mark(BootStage::first_reading);
+        SensorReading reading{seq++, time_us_32(), temp_c};
+        if (!queue->push(reading)) {
+            // Single writer: a load/store pair is enough, and avoids the
+            // read-modify-write atomics the M0+ does not have.
+            drops.store(drops.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+#if !PICO_ON_DEVICE
+            // The host may have fewer cores than threads; let core 0 run.
+            std::this_thread::yield();
+#endif
+        }
+    }
+}
+
+void sensing_core_init() {
+    if (queue) return;
+    queue = corelink_arena.create<ReadingQueue>();
+    sensor_init();
+}
+
+#if PICO_ON_DEVICE
+
+void sensing_core_start() {
+    multicore_launch_core1(core1_main);
+}
+
+#else
+
+void sensing_core_start() {
+    host_stop = false;
+    host_core1 = std::thread(core1_main);
+}
+
+void sensing_core_stop() {
+    host_stop = true;
+    if (host_core1.joinable()) host_core1.join();
+}
+
+#endif
+
+bool sensing_core_pop(SensorReading &reading) {
+    return queue->pop(reading);
+}
+
+uint32_t sensing_core_drops() {
+    return drops.load(std::memory_order_relaxed);
+}
+
+} // namespace thermo
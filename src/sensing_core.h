@@ -0,0 +1,41 @@
+// Core split: sensing and filtering run on core 1 and hand filtered readings
+// to the control loop on core 0 through an SpscQueue.
+//
+// On the host build "core 1" is a std::thread, so the same producer and
+// consumer code can be stress-tested as two pthreads.
+#pragma once
+
+#include <cstdint>
+
+#include "fixed.h"
+#include "spsc_queue.h"
+
+namespace thermo {
+
+struct SensorReading {
+    uint32_t seq;      // consecutive per reading; gaps mean queue-full drops
+    uint32_t time_us;  // when core 1 produced it
+    real_t temp_c;
+};
+
+using ReadingQueue = SpscQueue<SensorReading, 32>;
+
+/// Allocate the queue and the sensor pipeline. Call during init on core 0.
+void sensing_core_init();
+
+/// Launch the sensing loop on core 1. The sampler is started there, so the
+/// ADC DMA interrupt is serviced on core 1 too.
+void sensing_core_start();
+
+/// Core 0: the next reading in order, or false if none is waiting.
+bool sensing_core_pop(SensorReading &reading);
+
+/// Readings core 1 could not enqueue because core 0 fell behind.
+uint32_t sensing_core_drops();
+
+#if !PICO_ON_DEVICE
+/// Host build only: stop and join the emulated core 1.
+void sensing_core_stop();
+#endif
+
+} // namespace thermo
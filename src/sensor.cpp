@@ -0,0 +1,85 @@
+#include "sensor.h"
+
+#include "adc_sampler.h"
+#include "arena.h"
+#include "block_filter.h"
+
+namespace thermo {
+
+// On-chip temperature sensor on ADC input 4; see RP2040 datasheet 4.9.5:
+// T = 27 - (V - 0.706) / 0.001721, with V = counts * 3.3 / 4096. Folded into
+// T = offset - slope * counts so the conversion stays in the numeric backend.
+static constexpr unsigned sensor_adc_input = 4;
+static constexpr float sensor_offset_f = 27.0f + 0.706f / 0.001721f;
+static constexpr float sensor_slope_f = 3.3f / 4096.0f / 0.001721f;
+static constexpr real_t sensor_offset_c = real_t(sensor_offset_f);
+static constexpr real_t sensor_slope_c = real_t(sensor_slope_f);
+
+THERMO_ARENA(sensor, THERMO_RAM_SENSOR);
+
+static AdcSampler *sampler;
+static FilterChain *chain;
+static real_t last_temp_c = real_t(20);
+
+void sensor_init() {
+    if (sampler) return;
+    sampler = sensor_arena.create<AdcSampler>();
+    // 1 kHz raw -> 16:1 oversampling (62.5 Hz) -> IIR (time constant ~8
+    // outputs, 128 ms) -> median-of-3 to drop single-sample spikes the IIR
+    // did not absorb.
+    chain = sensor_arena.create<FilterChain>();
+    chain->add(*sensor_arena.create<DecimateStage>(16))
+        .add(*sensor_arena.create<IirStage>(3))
+        .add(*sensor_arena.create<MedianStage>(3));
+}
+
+void sensor_start() {
+    chain->reset();
+    AdcSamplerConfig config;
+    config.input_mask = 1u << sensor_adc_input;
+    sampler->start(config);
+}
+
+bool THERMO_HOT(sensor_poll)(real_t &temp_c) {
+    bool fresh = false;
+    uint16_t latest = 0;  // counts x 8
+    AdcBlock block;
+    while (sampler->acquire(block)) {
+        size_t n = chain->process(block.samples, AdcSampler::block_samples);
+        if (n) {
+            latest = block.samples[n - 1];
+            fresh = true;
+        }
+        sampler->release();
+#if !PICO_ON_DEVICE
+        // The host model always has another block ready; one is enough.
+        break;
+#endif
+    }
+    if (!fresh) return false;
+    real_t counts = Numeric<real_t>::ratio(latest, 1 << filter_frac_bits);
+    temp_c = sensor_offset_c - sensor_slope_c * counts;
+    return true;
+}
+
+real_t sensor_read_temp() {
+    sensor_poll(last_temp_c);
+    return last_temp_c;
+}
+
+AdcSampler &sensor_sampler() {
+    return *sampler;
+}
+
+#if !PICO_ON_DEVICE
+
+void sensor_host_set_celsius(float temp_c) {
+    static uint16_t recording[1];
+    float counts = (sensor_offset_f - temp_c) / sensor_slope_f;
+    recording[0] = uint16_t(counts < 0 ? 0 : (counts > 4095 ? 4095 : counts + 0.5f));
+    sampler->host_replay(recording, 1);
+}
+
+#endif
+
+} // namespace thermo
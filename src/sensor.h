@@ -0,0 +1,35 @@
+// Temperature sensor front end, fed by the free-running ADC sampler.
+#pragma once
+
+#include "fixed.h"
+
+namespace thermo {
+
+class AdcSampler;
+
+/// Allocate the sampler and filter chain. Call once during init, before the
+/// arenas are sealed.
+void sensor_init();
+
+/// Start continuous sampling. Call on the core that should service the ADC
+/// DMA interrupt.
+void sensor_start();
+
+/// Run every block completed since the previous call through the filter
+/// chain. Returns true and the newest filtered temperature (degrees Celsius)
+/// if at least one block completed. Never waits for a conversion.
+bool sensor_poll(real_t &temp_c);
+
+/// sensor_poll(), falling back to the previous reading when nothing is new.
+real_t sensor_read_temp();
+
+/// The sampler behind the sensor, for diagnostics (overruns, block count).
+AdcSampler &sensor_sampler();
+
+#if !PICO_ON_DEVICE
+/// Host build only: replay a constant reading equivalent to temp_c. Call
+/// after sensor_init() and before the sensing core starts.
+void sensor_host_set_celsius(float temp_c);
+#endif
+
+} // namespace thermo
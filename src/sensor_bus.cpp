@@ -0,0 +1,337 @@
+#include "sensor_bus.h"
+
+#include <cstring>
+
+#if PICO_ON_DEVICE
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "hardware/spi.h"
+#include "hardware/sync.h"
+#include "pico/stdlib.h"
+#endif
+
+namespace thermo {
+
+namespace {
+
+// The queue is shared between task context (submit, dispatch) and the
+// port's completion interrupt on the same core.
+struct IrqGuard {
+#if PICO_ON_DEVICE
+    uint32_t saved = save_and_disable_interrupts();
+    ~IrqGuard() { restore_interrupts(saved); }
+#else
+    IrqGuard() {}  // the host mock completes from the caller's thread
+#endif
+};
+
+void append(BusTransaction *&head, BusTransaction *&tail, BusTransaction *t) {
+    t->next = nullptr;
+    if (tail) {
+        tail->next = t;
+    } else {
+        head = t;
+    }
+    tail = t;
+}
+
+BusTransaction *pop(BusTransaction *&head, BusTransaction *&tail) {
+    BusTransaction *t = head;
+    if (t) {
+        head = t->next;
+        if (!head) tail = nullptr;
+        t->next = nullptr;
+    }
+    return t;
+}
+
+} // namespace
+
+// --- queue -------------------------------------------------------------------
+
+bool BusQueue::submit(BusTransaction &t) {
+    if (t.status != BusStatus::idle || (!t.tx_len && !t.rx_len) ||
+        size_t(t.tx_len) + t.rx_len > BusPort::max_transfer) {
+        stats_.rejected++;
+        return false;
+    }
+    t.queued_us = uint32_t(clock_.now_us());
+    t.status = BusStatus::queued;
+    IrqGuard guard;
+    append(pending_head_, pending_tail_, &t);
+    if (!running_) start_next();
+    return true;
+}
+
+// Interrupts are off here: called from submit() under the guard or from
+// the port's completion interrupt.
+void BusQueue::start_next() {
+    BusTransaction *t = pop(pending_head_, pending_tail_);
+    running_ = t;
+    if (!t) return;
+    t->status = BusStatus::running;
+    t->started_us = uint32_t(clock_.now_us());
+    port_.start(*t);
+}
+
+void BusQueue::complete(bool ok) {
+    BusTransaction *t = running_;
+    if (!t) return;
+    t->finished_us = uint32_t(clock_.now_us());
+    t->ok = ok;
+    t->status = BusStatus::done;
+    append(done_head_, done_tail_, t);
+    start_next();
+}
+
+size_t BusQueue::dispatch() {
+    size_t n = 0;
+    for (;;) {
+        BusTransaction *t;
+        {
+            IrqGuard guard;
+            t = pop(done_head_, done_tail_);
+        }
+        if (!t) break;
+        const uint32_t total = uint32_t(clock_.now_us()) - t->queued_us;
+        if (t->ok) {
+            stats_.completed++;
+        } else {
+            stats_.failed++;
+        }
+        if (t->wait_us() > stats_.worst_wait_us) stats_.worst_wait_us = t->wait_us();
+        if (t->bus_us() > stats_.worst_bus_us) stats_.worst_bus_us = t->bus_us();
+        if (total > stats_.worst_total_us) stats_.worst_total_us = total;
+        stats_.total_wait_us += t->wait_us();
+        stats_.total_bus_us += t->bus_us();
+        stats_.total_total_us += total;
+        // Idle before the callback, so it may resubmit the transaction.
+        t->status = BusStatus::idle;
+        if (t->done) t->done(t->ctx, *t);
+        n++;
+    }
+    return n;
+}
+
+#if PICO_ON_DEVICE
+
+// --- I2C -----------------------------------------------------------------------
+
+static I2cPort *i2c_ports[2];
+
+static i2c_inst_t *i2c_instance(unsigned index) {
+    return index ? i2c1 : i2c0;
+}
+
+void I2cPort::init(unsigned index, unsigned sda, unsigned scl, uint32_t baud) {
+    index_ = index;
+    i2c_inst_t *i2c = i2c_instance(index);
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    i2c_init(i2c, baud);
+    gpio_set_function(sda, GPIO_FUNC_I2C);
+    gpio_set_function(scl, GPIO_FUNC_I2C);
+    gpio_pull_up(sda);
+    gpio_pull_up(scl);
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+
+    // Commands (data byte plus read/restart/stop bits) go out as halfwords.
+    tx_chan_ = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(tx_chan_);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, i2c_get_dreq(i2c, true));
+    dma_channel_configure(tx_chan_, &c, &hw->data_cmd, cmds_, 0, false);
+
+    rx_chan_ = dma_claim_unused_channel(true);
+    c = dma_channel_get_default_config(rx_chan_);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, i2c_get_dreq(i2c, false));
+    dma_channel_configure(rx_chan_, &c, nullptr, &hw->data_cmd, 0, false);
+
+    // STOP_DET marks the end of every transaction, aborted or not.
+    i2c_ports[index] = this;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+    irq_set_exclusive_handler(I2C0_IRQ + index, index ? irq_handler1 : irq_handler0);
+    irq_set_enabled(I2C0_IRQ + index, true);
+}
+
+void I2cPort::start(BusTransaction &t) {
+    i2c_hw_t *hw = i2c_get_hw(i2c_instance(index_));
+    hw->enable = 0;
+    hw->tar = t.address;
+    hw->enable = 1;
+
+    size_t n = 0;
+    for (size_t i = 0; i < t.tx_len; i++) {
+        const bool last = i + 1 == t.tx_len && !t.rx_len;
+        cmds_[n++] = uint16_t(t.tx[i] | (last ? I2C_IC_DATA_CMD_STOP_BITS : 0));
+    }
+    for (size_t i = 0; i < t.rx_len; i++) {
+        uint16_t cmd = I2C_IC_DATA_CMD_CMD_BITS;
+        if (i == 0 && t.tx_len) cmd |= I2C_IC_DATA_CMD_RESTART_BITS;
+        if (i + 1 == t.rx_len) cmd |= I2C_IC_DATA_CMD_STOP_BITS;
+        cmds_[n++] = cmd;
+    }
+    aborted_ = false;
+    if (t.rx_len) {
+        dma_channel_set_write_addr(rx_chan_, t.rx, false);
+        dma_channel_set_trans_count(rx_chan_, t.rx_len, true);
+    }
+    dma_channel_set_read_addr(tx_chan_, cmds_, false);
+    dma_channel_set_trans_count(tx_chan_, n, true);
+}
+
+void I2cPort::on_irq() {
+    i2c_hw_t *hw = i2c_get_hw(i2c_instance(index_));
+    const uint32_t stat = hw->intr_stat;
+    if (stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        (void)hw->clr_tx_abrt;
+        aborted_ = true;
+        dma_channel_abort(tx_chan_);
+        dma_channel_abort(rx_chan_);
+    }
+    if (stat & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+        (void)hw->clr_stop_det;
+        // The last byte may still be on its way from the FIFO.
+        while (!aborted_ && dma_channel_is_busy(rx_chan_)) tight_loop_contents();
+        queue_->complete(!aborted_);
+    }
+}
+
+void I2cPort::irq_handler0() {
+    i2c_ports[0]->on_irq();
+}
+
+void I2cPort::irq_handler1() {
+    i2c_ports[1]->on_irq();
+}
+
+// --- SPI -----------------------------------------------------------------------
+
+static SpiPort *spi_ports[2];
+
+static spi_inst_t *spi_instance(unsigned index) {
+    return index ? spi1 : spi0;
+}
+
+void SpiPort::init(unsigned index, unsigned sck, unsigned mosi, unsigned miso, uint32_t baud) {
+    index_ = index;
+    spi_inst_t *spi = spi_instance(index);
+    spi_init(spi, baud);
+    gpio_set_function(sck, GPIO_FUNC_SPI);
+    gpio_set_function(mosi, GPIO_FUNC_SPI);
+    gpio_set_function(miso, GPIO_FUNC_SPI);
+
+    tx_chan_ = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(tx_chan_);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, spi_get_dreq(spi, true));
+    dma_channel_configure(tx_chan_, &c, &spi_get_hw(spi)->dr, tx_buf_, 0, false);
+
+    rx_chan_ = dma_claim_unused_channel(true);
+    c = dma_channel_get_default_config(rx_chan_);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, spi_get_dreq(spi, false));
+    dma_channel_configure(rx_chan_, &c, rx_buf_, &spi_get_hw(spi)->dr, 0, false);
+
+    // DMA_IRQ_0 belongs to the ADC sampler; the bus ports share DMA_IRQ_1.
+    spi_ports[index] = this;
+    dma_channel_set_irq1_enabled(rx_chan_, true);
+    irq_add_shared_handler(DMA_IRQ_1, dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+}
+
+// SPI is full duplex: clock out the write bytes then 0xff filler, and keep
+// the bytes received during the filler.
+void SpiPort::start(BusTransaction &t) {
+    const size_t n = size_t(t.tx_len) + t.rx_len;
+    memcpy(tx_buf_, t.tx, t.tx_len);
+    memset(tx_buf_ + t.tx_len, 0xff, t.rx_len);
+    current_ = &t;
+    gpio_put(t.address, false);
+    dma_channel_set_write_addr(rx_chan_, rx_buf_, false);
+    dma_channel_set_trans_count(rx_chan_, n, true);
+    dma_channel_set_read_addr(tx_chan_, tx_buf_, false);
+    dma_channel_set_trans_count(tx_chan_, n, true);
+}
+
+void SpiPort::on_rx_done() {
+    BusTransaction &t = *current_;
+    gpio_put(t.address, true);
+    memcpy(t.rx, rx_buf_ + t.tx_len, t.rx_len);
+    current_ = nullptr;
+    queue_->complete(true);
+}
+
+void SpiPort::dma_irq_handler() {
+    for (SpiPort *p : spi_ports) {
+        if (p && dma_channel_get_irq1_status(p->rx_chan_)) {
+            dma_channel_acknowledge_irq1(p->rx_chan_);
+            p->on_rx_done();
+        }
+    }
+}
+
+#else
+
+// --- host mock -------------------------------------------------------------------
+
+MockBusPort::MockBusPort(VirtualClock &clock, uint32_t bit_rate_hz, bool i2c)
+    : clock_(clock), bit_rate_hz_(bit_rate_hz), i2c_(i2c) {}
+
+uint8_t *MockBusPort::add_device(uint8_t address) {
+    if (devices_ == max_devices) return nullptr;
+    addresses_[devices_] = address;
+    memset(regs_[devices_], 0, sizeof(regs_[0]));
+    return regs_[devices_++];
+}
+
+void MockBusPort::start(BusTransaction &t) {
+    // I2C: start, address frame and 9 clocks per byte for each phase, a
+    // repeated start between them, stop. SPI: 8 clocks per byte.
+    uint64_t bits;
+    if (i2c_) {
+        bits = 2;
+        if (t.tx_len) bits += 9 * (1 + uint64_t(t.tx_len));
+        if (t.rx_len) bits += 9 * (1 + uint64_t(t.rx_len)) + (t.tx_len ? 1 : 0);
+    } else {
+        bits = 8 * (uint64_t(t.tx_len) + t.rx_len);
+    }
+    const uint64_t us = (bits * 1'000'000 + bit_rate_hz_ - 1) / bit_rate_hz_;
+    running_ = &t;
+    done_at_ = clock_.now_us() + us;
+    busy_us_ += us;
+    bytes_ += t.tx_len + t.rx_len;
+}
+
+bool MockBusPort::poll() {
+    if (!running_ || clock_.now_us() < done_at_) return false;
+    BusTransaction &t = *running_;
+    running_ = nullptr;
+    size_t d = 0;
+    while (d < devices_ && addresses_[d] != t.address) d++;
+    if (d == devices_) {
+        queue_->complete(false);
+        return true;
+    }
+    if (t.tx_len) {
+        pointer_[d] = t.tx[0];
+        for (size_t i = 1; i < t.tx_len; i++) regs_[d][pointer_[d]++] = t.tx[i];
+    }
+    for (size_t i = 0; i < t.rx_len; i++) t.rx[i] = regs_[d][pointer_[d]++];
+    queue_->complete(true);
+    return true;
+}
+
+#endif
+
+} // namespace thermo
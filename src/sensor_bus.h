@@ -0,0 +1,198 @@
+// Asynchronous transaction queue for the I2C and SPI sensor buses.
+//
+// A transaction is a write phase followed by a read phase (typically a
+// register address, then the register contents). Callers own their
+// BusTransaction structs and link them into a per-bus queue with submit();
+// nothing is copied and nothing allocates. The port moves the bytes with DMA
+// and reports completion from its interrupt, where the queue immediately
+// starts the next pending transaction, so reads from several devices run
+// back to back without waiting for the CPU. Completion callbacks run later,
+// from dispatch() in task context, in submission order.
+//
+// Each transaction records when it was queued, started and finished; the
+// queue keeps worst and total wait, bus and end-to-end latency.
+//
+// Ports: I2cPort and SpiPort over pico-sdk hardware_i2c / hardware_spi on
+// the device; MockBusPort on the host, which serves register files at
+// simulated wire speed against a VirtualClock.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "scheduler.h"
+
+namespace thermo {
+
+class BusQueue;
+struct BusTransaction;
+
+using BusCallback = void (*)(void *ctx, BusTransaction &t);
+
+enum class BusStatus : uint8_t {
+    idle,     // free to submit (also while its callback runs)
+    queued,
+    running,
+    done,     // finished, callback pending
+};
+
+struct BusTransaction {
+    // Filled in by the caller.
+    uint8_t address = 0;          // I2C 7-bit address, or SPI chip-select GPIO
+    uint8_t tx_len = 0;
+    uint8_t rx_len = 0;
+    const uint8_t *tx = nullptr;
+    uint8_t *rx = nullptr;
+    BusCallback done = nullptr;   // may be null
+    void *ctx = nullptr;
+
+    // Maintained by the queue.
+    volatile BusStatus status = BusStatus::idle;
+    bool ok = false;              // false: NACK or abort
+    uint32_t queued_us = 0;
+    uint32_t started_us = 0;
+    uint32_t finished_us = 0;
+    BusTransaction *next = nullptr;
+
+    uint32_t wait_us() const { return started_us - queued_us; }
+    uint32_t bus_us() const { return finished_us - started_us; }
+};
+
+struct BusStats {
+    uint32_t completed = 0;
+    uint32_t failed = 0;
+    uint32_t rejected = 0;         // submit() refused
+    uint32_t worst_wait_us = 0;    // queued -> started
+    uint32_t worst_bus_us = 0;     // started -> finished
+    uint32_t worst_total_us = 0;   // queued -> callback
+    uint64_t total_wait_us = 0;
+    uint64_t total_bus_us = 0;
+    uint64_t total_total_us = 0;
+};
+
+/// Moves one transaction at a time and calls BusQueue::complete() when done.
+class BusPort {
+public:
+    /// Largest tx_len + rx_len a port accepts.
+    static constexpr size_t max_transfer = 64;
+
+    virtual void start(BusTransaction &t) = 0;
+    void bind(BusQueue &queue) { queue_ = &queue; }
+
+protected:
+    ~BusPort() = default;
+    BusQueue *queue_ = nullptr;
+};
+
+class BusQueue {
+public:
+    BusQueue(BusPort &port, Clock &clock) : port_(port), clock_(clock) { port_.bind(*this); }
+
+    /// Queue `t` and start it if the bus is idle. False if `t` is still in
+    /// flight or awaiting its callback, or its lengths exceed the port's.
+    bool submit(BusTransaction &t);
+    /// Port interrupt: the running transaction finished. Starts the next.
+    void complete(bool ok);
+    /// Run the callbacks of finished transactions, oldest first. Returns how
+    /// many ran.
+    size_t dispatch();
+
+    bool idle() const { return !running_ && !pending_head_; }
+    /// Busy check for PowerManager::add_busy_check(), with the queue as its
+    /// context: true while a transaction runs or waits to.
+    static bool busy(void *queue) { return !static_cast<const BusQueue *>(queue)->idle(); }
+    const BusStats &stats() const { return stats_; }
+
+private:
+    void start_next();
+
+    BusPort &port_;
+    Clock &clock_;
+    BusTransaction *pending_head_ = nullptr;
+    BusTransaction *pending_tail_ = nullptr;
+    BusTransaction *volatile running_ = nullptr;
+    BusTransaction *done_head_ = nullptr;
+    BusTransaction *done_tail_ = nullptr;
+    BusStats stats_;
+};
+
+#if PICO_ON_DEVICE
+
+class I2cPort final : public BusPort {
+public:
+    /// `index` selects i2c0 or i2c1.
+    void init(unsigned index, unsigned sda, unsigned scl, uint32_t baud);
+    void start(BusTransaction &t) override;
+
+private:
+    static void irq_handler0();
+    static void irq_handler1();
+    void on_irq();
+
+    unsigned index_ = 0;
+    int tx_chan_ = -1;
+    int rx_chan_ = -1;
+    bool aborted_ = false;
+    uint16_t cmds_[max_transfer];
+};
+
+class SpiPort final : public BusPort {
+public:
+    /// `index` selects spi0 or spi1. Transactions address devices by their
+    /// chip-select GPIO, which must be set up as an output idling high.
+    void init(unsigned index, unsigned sck, unsigned mosi, unsigned miso, uint32_t baud);
+    void start(BusTransaction &t) override;
+
+private:
+    static void dma_irq_handler();
+    void on_rx_done();
+
+    unsigned index_ = 0;
+    int tx_chan_ = -1;
+    int rx_chan_ = -1;
+    BusTransaction *current_ = nullptr;
+    uint8_t tx_buf_[max_transfer];
+    uint8_t rx_buf_[max_transfer];
+};
+
+#else
+
+/// Host stand-in for a bus: devices are 256-byte register files. A write
+/// sets the register pointer (first byte) and stores the rest; a read
+/// returns consecutive registers. Unknown addresses fail like a NACK.
+class MockBusPort final : public BusPort {
+public:
+    static constexpr size_t max_devices = 8;
+
+    /// `i2c` selects I2C framing (address, ACK bits, restart) over SPI.
+    MockBusPort(VirtualClock &clock, uint32_t bit_rate_hz, bool i2c);
+
+    /// Register file of a new device at `address`, or null if full.
+    uint8_t *add_device(uint8_t address);
+    void start(BusTransaction &t) override;
+    /// The "interrupt": completes the running transaction once its wire
+    /// time has passed. Returns true if one completed.
+    bool poll();
+    /// When the running transaction will finish (0 if idle).
+    uint64_t busy_until() const { return running_ ? done_at_ : 0; }
+
+    uint64_t busy_us() const { return busy_us_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    VirtualClock &clock_;
+    uint32_t bit_rate_hz_;
+    bool i2c_;
+    uint8_t addresses_[max_devices];
+    uint8_t regs_[max_devices][256];
+    uint8_t pointer_[max_devices] = {};
+    size_t devices_ = 0;
+    BusTransaction *running_ = nullptr;
+    uint64_t done_at_ = 0;
+    uint64_t busy_us_ = 0;
+    uint64_t bytes_ = 0;
+};
+
+#endif
+
+} // namespace thermo
@@ -0,0 +1,62 @@
+// Lock-free single-producer / single-consumer ring for passing data between
+// the two RP2040 cores (or two host threads in the emulation).
+//
+// Only plain atomic loads and stores are used: the Cortex-M0+ has no
+// exclusive-access instructions, but aligned 32-bit accesses are atomic and
+// acquire/release ordering compiles to DMB barriers. The producer publishes a
+// slot by storing head_ with release semantics after writing the payload; the
+// consumer frees it by storing tail_ after reading. Indices run freely and
+// wrap modulo 2^32, so N must be a power of two.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace thermo {
+
+#if PICO_ON_DEVICE
+// No data cache on the RP2040; just keep the indices word aligned.
+constexpr size_t spsc_index_align = 4;
+#else
+// Keep producer and consumer indices on separate cache lines.
+constexpr size_t spsc_index_align = 64;
+#endif
+
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert(N && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+    /// Producer side. Returns false (and leaves the queue untouched) if full.
+    bool push(const T &item) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= N) return false;
+        slots_[head & (N - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Consumer side. Returns false if empty.
+    bool pop(T &item) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail) return false;
+        item = slots_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Approximate when called from either side while the other is active.
+    size_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() { return N; }
+
+private:
+    alignas(spsc_index_align) std::atomic<uint32_t> head_{0};
+    alignas(spsc_index_align) std::atomic<uint32_t> tail_{0};
+    T slots_[N];
+};
+
+} // namespace thermo
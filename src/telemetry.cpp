@@ -0,0 +1,187 @@
+#include "telemetry.h"
+
+#include <cstring>
+
+#include "crc.h"
+
+#if PICO_ON_DEVICE
+#include "pico/stdio_usb.h"
+#include "tusb.h"
+#else
+#include <unistd.h>
+#endif
+
+namespace thermo {
+
+using namespace telemetry;
+
+size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t code_at = 0;
+    size_t o = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (in[i]) {
+            out[o++] = in[i];
+            if (++code != 0xff || i + 1 == len) continue;
+        }
+        out[code_at] = code;
+        code_at = o++;
+        code = 1;
+    }
+    out[code_at] = code;
+    return o;
+}
+
+size_t cobs_decode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t o = 0;
+    size_t i = 0;
+    while (i < len) {
+        const uint8_t code = in[i++];
+        if (!code || i + code - 1 > len) return 0;
+        for (uint8_t k = 1; k < code; k++) {
+            if (!in[i]) return 0;
+            out[o++] = in[i++];
+        }
+        if (code != 0xff && i < len) out[o++] = 0;
+    }
+    return o;
+}
+
+// --- encoder -------------------------------------------------------------------
+
+bool Telemetry::record(uint8_t type, const void *payload, size_t len) {
+    if (len > max_payload) {
+        stats_.rejected++;
+        return false;
+    }
+    if (frame_len_ && frame_len_ + record_header + len > max_frame - crc_size) close_frame();
+    if (!frame_len_) {
+        frame_len_ = header_size;  // filled in by close_frame()
+        frame_opened_us_ = clock_.now_us();
+    }
+    frame_[frame_len_++] = type;
+    frame_[frame_len_++] = uint8_t(len);
+    memcpy(frame_ + frame_len_, payload, len);
+    frame_len_ += len;
+    frame_records_++;
+    stats_.records++;
+    return true;
+}
+
+void Telemetry::flush() {
+    close_frame();
+}
+
+void Telemetry::close_frame() {
+    if (!frame_len_) return;
+    const uint16_t dropped = uint16_t(stats_.dropped_records);
+    frame_[0] = schema_version;
+    frame_[1] = uint8_t(seq_);
+    frame_[2] = uint8_t(seq_ >> 8);
+    frame_[3] = uint8_t(dropped);
+    frame_[4] = uint8_t(dropped >> 8);
+    const uint16_t crc = crc16_ccitt(frame_, frame_len_);
+    frame_[frame_len_++] = uint8_t(crc);
+    frame_[frame_len_++] = uint8_t(crc >> 8);
+
+    Packet p;
+    p.len = uint8_t(cobs_encode(frame_, frame_len_, p.bytes));
+    p.bytes[p.len++] = 0;
+    seq_++;
+    if (queue_.push(p)) {
+        stats_.frames++;
+    } else {
+        stats_.dropped_frames++;
+        stats_.dropped_records += frame_records_;
+    }
+    frame_len_ = 0;
+    frame_records_ = 0;
+}
+
+void Telemetry::pump() {
+    if (frame_len_ && clock_.now_us() - frame_opened_us_ >= max_delay_us_) close_frame();
+    for (;;) {
+        if (!have_sending_) {
+            if (!queue_.pop(sending_)) return;
+            have_sending_ = true;
+            sent_ = 0;
+        }
+        const size_t n = sink_.write(sending_.bytes + sent_, sending_.len - sent_);
+        sent_ += n;
+        stats_.bytes += n;
+        if (sent_ < sending_.len) return;
+        have_sending_ = false;
+    }
+}
+
+// --- decoder -------------------------------------------------------------------
+
+void TelemetryDecoder::feed(const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (!data[i]) {
+            frame_done();
+        } else if (len_ < sizeof(buf_)) {
+            buf_[len_++] = data[i];
+        } else {
+            overflow_ = true;
+        }
+    }
+}
+
+void TelemetryDecoder::frame_done() {
+    // Before the first delimiter the reader may have joined mid-frame:
+    // decode what arrived, but do not count a failure.
+    const bool counted = synced_;
+    synced_ = true;
+    const size_t encoded = len_;
+    const bool overflow = overflow_;
+    len_ = 0;
+    overflow_ = false;
+    if (!encoded && !overflow) return;
+
+    uint8_t raw[sizeof(buf_)];
+    const size_t n = overflow ? 0 : cobs_decode(buf_, encoded, raw);
+    if (n < header_size + crc_size || raw[0] != schema_version ||
+        crc16_ccitt(raw, n - crc_size) != (raw[n - 2] | raw[n - 1] << 8)) {
+        if (counted) bad_frames_++;
+        return;
+    }
+    const Frame frame{raw[0], uint16_t(raw[1] | raw[2] << 8), uint16_t(raw[3] | raw[4] << 8)};
+    if (have_seq_) lost_frames_ += uint16_t(frame.seq - next_seq_);
+    next_seq_ = uint16_t(frame.seq + 1);
+    have_seq_ = true;
+    device_dropped_ = frame.dropped;
+    frames_++;
+
+    const uint8_t *p = raw + header_size;
+    const uint8_t *end = raw + n - crc_size;
+    while (end - p >= ptrdiff_t(record_header) && end - p - ptrdiff_t(record_header) >= p[1]) {
+        fn_(ctx_, frame, p[0], p + record_header, p[1]);
+        records_++;
+        p += record_header + p[1];
+    }
+}
+
+#if PICO_ON_DEVICE
+
+size_t UsbCdcSink::write(const uint8_t *data, size_t len) {
+    if (!stdio_usb_connected()) return 0;
+    // Hand stdio only what the FIFO holds right now, so its out_chars
+    // (which takes the stdio USB mutex and flushes) never waits for the
+    // host.
+    const size_t room = tud_cdc_write_available();
+    const size_t n = len < room ? len : room;
+    if (n) stdio_usb.out_chars(reinterpret_cast<const char *>(data), int(n));
+    return n;
+}
+
+#else
+
+size_t FdSink::write(const uint8_t *data, size_t len) {
+    const ssize_t n = ::write(fd_, data, len);
+    return n > 0 ? size_t(n) : 0;
+}
+
+#endif
+
+} // namespace thermo
@@ -0,0 +1,199 @@
+// Binary telemetry stream for the USB serial port.
+//
+// Records are small TLV structs batched into frames. A frame is
+//
+//   version u8 | seq u16 | dropped u16 | records... | crc16 u16
+//
+// (little-endian; crc16_ccitt over everything before it), COBS-encoded and
+// terminated by a 0x00 byte, so a reader can join the stream at any point
+// and resynchronise after garbage at the next zero. A frame is sized to fill
+// one 64-byte USB full-speed packet once encoded. `seq` counts every frame
+// built, including those dropped, so the reader sees losses as gaps;
+// `dropped` is the running count of records lost that way (mod 2^16).
+//
+// Each record is `type u8 | len u8 | payload`. Readers skip types they do
+// not know, so new record types do not need a new schema version; changing
+// an existing payload does. Payloads (schema version 1):
+//
+//   status (1): t_ms u32, temp centi-degrees i16, setpoint centi-degrees
+//               i16, relay u8, sensing-queue drops u16
+//   probe  (2): t_ms u32, index u8, valid u8, raw 1/16 degrees i16
+//   trace  (3): a block of trace events (see trace.h), THERMO_TRACE builds
+//   profile (4): dump id (t_ms) u32, samples u32, then up to five of
+//               bucket address u32, count u32 (see profiler.h), on request
+//               in THERMO_PROFILE builds
+//   boot   (5): stages u8, then microseconds from power-on to each stage
+//               u32 (0: not reached), in BootStage order (see boot.h); once,
+//               when the last stage is done
+//
+// Producers never block: record() appends to the open frame, and a frame
+// that finds the packet queue full is discarded and counted. pump() moves
+// queued packets to the TelemetrySink as fast as it takes them, and closes
+// the open frame once its oldest record has waited max_delay_us.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "scheduler.h"
+#include "spsc_queue.h"
+
+namespace thermo {
+
+namespace telemetry {
+
+constexpr uint8_t schema_version = 1;
+
+enum RecordType : uint8_t {
+    record_status = 1,
+    record_probe = 2,
+    record_trace = 3,
+    record_profile = 4,
+    record_boot = 5,
+};
+
+constexpr size_t packet_size = 64;
+/// Largest frame before encoding: COBS adds one byte (frames are under 254
+/// bytes), the delimiter another.
+constexpr size_t max_frame = packet_size - 2;
+constexpr size_t header_size = 5;
+constexpr size_t crc_size = 2;
+constexpr size_t record_header = 2;
+constexpr size_t max_payload = max_frame - header_size - crc_size - record_header;
+
+} // namespace telemetry
+
+/// COBS-encode `len` bytes (at most 254) into `out`, which needs len + 1
+/// bytes. No delimiter is added. Returns the encoded length.
+size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out);
+/// Decode one frame (without its delimiter) into `out`, which needs `len`
+/// bytes. Returns the decoded length, or 0 if the input is not valid COBS.
+size_t cobs_decode(const uint8_t *in, size_t len, uint8_t *out);
+
+/// Where encoded packets go.
+class TelemetrySink {
+public:
+    /// Take up to `len` bytes without blocking. Returns how many were taken.
+    virtual size_t write(const uint8_t *data, size_t len) = 0;
+
+protected:
+    ~TelemetrySink() = default;
+};
+
+struct TelemetryStats {
+    uint32_t records = 0;
+    uint32_t frames = 0;
+    uint32_t dropped_records = 0;
+    uint32_t dropped_frames = 0;
+    uint32_t rejected = 0;  // record() with an oversized payload
+    uint64_t bytes = 0;     // handed to the sink
+};
+
+class Telemetry {
+public:
+    static constexpr size_t queue_packets = 16;
+
+    Telemetry(TelemetrySink &sink, Clock &clock, uint32_t max_delay_us = 100'000)
+        : sink_(sink), clock_(clock), max_delay_us_(max_delay_us) {}
+
+    /// Append a record. False if the payload is too long for a frame.
+    bool record(uint8_t type, const void *payload, size_t len);
+    /// Close the open frame now.
+    void flush();
+    /// Close the open frame if it is due, then feed the sink.
+    void pump();
+
+    /// Packets waiting for the sink (not counting the open frame).
+    size_t queued() const { return queue_.size(); }
+    const TelemetryStats &stats() const { return stats_; }
+
+private:
+    struct Packet {
+        uint8_t len;
+        uint8_t bytes[telemetry::packet_size];
+    };
+
+    void close_frame();
+
+    TelemetrySink &sink_;
+    Clock &clock_;
+    uint32_t max_delay_us_;
+    uint8_t frame_[telemetry::max_frame];
+    size_t frame_len_ = 0;  // 0: no frame open
+    uint32_t frame_records_ = 0;
+    uint64_t frame_opened_us_ = 0;
+    uint16_t seq_ = 0;
+    SpscQueue<Packet, queue_packets> queue_;
+    Packet sending_;
+    size_t sent_ = 0;  // bytes of sending_ already taken by the sink
+    bool have_sending_ = false;
+    TelemetryStats stats_;
+};
+
+/// Reassembles frames from a byte stream (the firmware's own stream, or a
+/// host reading the serial port) and hands out their records.
+class TelemetryDecoder {
+public:
+    struct Frame {
+        uint8_t version;
+        uint16_t seq;
+        uint16_t dropped;
+    };
+    using RecordFn = void (*)(void *ctx, const Frame &frame, uint8_t type,
+                              const uint8_t *payload, size_t len);
+
+    TelemetryDecoder(RecordFn fn, void *ctx) : fn_(fn), ctx_(ctx) {}
+
+    void feed(const uint8_t *data, size_t len);
+
+    uint32_t frames() const { return frames_; }
+    uint32_t records() const { return records_; }
+    /// Frames that failed COBS, length, CRC or version checks.
+    uint32_t bad_frames() const { return bad_frames_; }
+    /// Frames missing according to the sequence numbers.
+    uint32_t lost_frames() const { return lost_frames_; }
+    /// The device's running count of dropped records, from the last frame.
+    uint16_t device_dropped() const { return device_dropped_; }
+
+private:
+    void frame_done();
+
+    RecordFn fn_;
+    void *ctx_;
+    uint8_t buf_[telemetry::packet_size];
+    size_t len_ = 0;
+    bool overflow_ = false;
+    bool synced_ = false;  // a delimiter has been seen
+    bool have_seq_ = false;
+    uint16_t next_seq_ = 0;
+    uint32_t frames_ = 0;
+    uint32_t records_ = 0;
+    uint32_t bad_frames_ = 0;
+    uint32_t lost_frames_ = 0;
+    uint16_t device_dropped_ = 0;
+};
+
+#if PICO_ON_DEVICE
+
+/// The stdio USB CDC interface. Writes only what fits in the TinyUSB FIFO,
+/// so a host that stops reading costs nothing but queued packets.
+class UsbCdcSink final : public TelemetrySink {
+public:
+    size_t write(const uint8_t *data, size_t len) override;
+};
+
+#else
+
+/// A file descriptor opened non-blocking (a pty master in the benchmark).
+class FdSink final : public TelemetrySink {
+public:
+    explicit FdSink(int fd) : fd_(fd) {}
+    size_t write(const uint8_t *data, size_t len) override;
+
+private:
+    int fd_;
+};
+
+#endif
+
+} // namespace thermo
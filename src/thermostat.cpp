@@ -0,0 +1,337 @@
+#include "thermostat.h"
+
+#include <cmath>
+
+#include "memory_config.h"
+
+namespace thermo {
+
+template <typename T>
+BasicThermostat<T>::BasicThermostat(const ThermostatConfig &config)
+    : config_(config),
+      setpoint_(Numeric<T>::from_float(config.setpoint_c)),
+      band_(Numeric<T>::from_float(config.hysteresis_c)),
+      kp_(Numeric<T>::from_float(config.kp)),
+      ki_dt_(Numeric<T>::from_float(config.ki * config.tick_s)),
+      kd_over_dt_(Numeric<T>::from_float(config.kd / config.tick_s)) {
+    load_model();
+    rls_.configure(config.rls_period_ticks, config.tick_s, config.rls_forget,
+                   config.model_dead_s);
+}
+
+template <typename T>
+void BasicThermostat<T>::set_setpoint(float setpoint_c) {
+    config_.setpoint_c = setpoint_c;
+    setpoint_ = Numeric<T>::from_float(setpoint_c);
+}
+
+template <typename T>
+void BasicThermostat<T>::set_gains(float kp, float ki, float kd) {
+    config_.kp = kp;
+    config_.ki = ki;
+    config_.kd = kd;
+    kp_ = Numeric<T>::from_float(kp);
+    ki_dt_ = Numeric<T>::from_float(ki * config_.tick_s);
+    kd_over_dt_ = Numeric<T>::from_float(kd / config_.tick_s);
+}
+
+template <typename T>
+void BasicThermostat<T>::set_mode(ControlMode mode) {
+    if (mode == config_.mode) return;
+    config_.mode = mode;
+    integral_ = T(0);
+    window_pos_ = 0;
+    mpc_.reset();
+}
+
+template <typename T>
+void BasicThermostat<T>::set_model(float gain_c, float tau_s, float dead_s) {
+    config_.model_gain_c = gain_c;
+    config_.model_tau_s = tau_s;
+    if (dead_s != config_.model_dead_s) {
+        // The estimator's regressor depends on the dead time; start over.
+        config_.model_dead_s = dead_s;
+        rls_.configure(config_.rls_period_ticks, config_.tick_s, config_.rls_forget, dead_s);
+    }
+    load_model();
+    window_pos_ = 0;
+}
+
+template <typename T>
+void BasicThermostat<T>::load_model() {
+    mpc_.set_model(config_.model_gain_c, config_.model_tau_s, config_.model_dead_s,
+                   float(config_.mpc_move_ticks) * config_.tick_s,
+                   MpcWeights{config_.mpc_energy_weight, config_.mpc_move_weight});
+}
+
+// Refines the model in place: the controller keeps its history, and the
+// dead time stays as autotune measured it.
+template <typename T>
+void BasicThermostat<T>::adapt_model() {
+    const RoomEstimate e = rls_.estimate();
+    if (!e.valid) return;
+    config_.model_gain_c = e.gain_c;
+    config_.model_tau_s = e.tau_s;
+    if (!mpc_.has_model()) window_pos_ = 0;
+    load_model();
+}
+
+template <typename T>
+bool THERMO_HOT(BasicThermostat<T>::step)(T temp_c) {
+    if (tune_state_ == AutotuneState::running) {
+        if (tune_ticks_ < tune_max_ticks_) {
+            relay_ = step_autotune(temp_c);
+            rls_.sample(temp_c, relay_);
+            return relay_;
+        }
+        // Out of time: give up, and this tick is the previous mode's.
+        tune_state_ = AutotuneState::failed;
+    }
+    switch (config_.mode) {
+    case ControlMode::hysteresis:
+        relay_ = step_hysteresis(temp_c);
+        break;
+    case ControlMode::pid:
+        relay_ = step_pid(temp_c);
+        break;
+    case ControlMode::mpc:
+        relay_ = step_mpc(temp_c);
+        break;
+    }
+    if (rls_.sample(temp_c, relay_) && config_.model_adapt && config_.mode == ControlMode::mpc) {
+        adapt_model();
+    }
+    return relay_;
+}
+
+template <typename T>
+void BasicThermostat<T>::start_autotune() {
+    tune_state_ = AutotuneState::running;
+    tune_result_ = AutotuneResult{};
+    tune_band_ = Numeric<T>::from_float(config_.autotune_band_c);
+    tune_ticks_ = 0;
+    tune_max_ticks_ = uint32_t(config_.autotune_max_s / config_.tick_s);
+    cycle_start_ = 0;
+    cycles_seen_ = 0;
+    duty_ = relay_ ? T(1) : T(0);
+}
+
+template <typename T>
+void BasicThermostat<T>::abort_autotune() {
+    if (tune_state_ == AutotuneState::running) tune_state_ = AutotuneState::off;
+}
+
+template <typename T>
+bool BasicThermostat<T>::step_autotune(T temp_c) {
+    const uint32_t now = ++tune_ticks_;
+    const bool was_on = duty_ > T(0);
+    bool on = was_on;
+    if (was_on && temp_c > setpoint_ + tune_band_) on = false;
+    if (!was_on && temp_c < setpoint_ - tune_band_) on = true;
+    duty_ = on ? T(1) : T(0);
+
+    if (on && !was_on) {
+        // A switch-on closes the cycle that the previous one opened.
+        if (cycle_start_) {
+            Cycle &c = cycles_[cycles_seen_ % tune_window];
+            c.ticks = now - cycle_start_;
+            c.on_ticks = cycle_on_;
+            const uint32_t after_off =
+                cycle_hi_at_ > cycle_off_at_ ? cycle_hi_at_ - cycle_off_at_ : 0;
+            c.dead_ticks = (cycle_lo_at_ + after_off) / 2;
+            c.amplitude = (cycle_hi_ - cycle_lo_) * Numeric<T>::ratio(1, 2);
+            cycles_seen_++;
+        }
+        cycle_start_ = now;
+        cycle_on_ = 0;
+        cycle_off_at_ = cycle_hi_at_ = cycle_lo_at_ = 0;
+        cycle_hi_ = cycle_lo_ = temp_c;
+    }
+    if (cycle_start_) {
+        const uint32_t at = now - cycle_start_;
+        if (!on && was_on) cycle_off_at_ = at;
+        if (temp_c > cycle_hi_) {
+            cycle_hi_ = temp_c;
+            cycle_hi_at_ = at;
+        }
+        if (temp_c < cycle_lo_) {
+            cycle_lo_ = temp_c;
+            // The trough comes early in the cycle, while the heat is on.
+            if (on) cycle_lo_at_ = at;
+        }
+        cycle_on_ += on;
+    }
+
+    // The first cycle starts from wherever the room was; after it, wait for
+    // tune_window consecutive cycles that agree within 15%.
+    if (on && !was_on && cycles_seen_ > tune_window) {
+        uint32_t min_ticks = UINT32_MAX, max_ticks = 0;
+        T min_amp = cycles_[0].amplitude, max_amp = cycles_[0].amplitude;
+        for (const Cycle &c : cycles_) {
+            if (c.ticks < min_ticks) min_ticks = c.ticks;
+            if (c.ticks > max_ticks) max_ticks = c.ticks;
+            if (c.amplitude < min_amp) min_amp = c.amplitude;
+            if (c.amplitude > max_amp) max_amp = c.amplitude;
+        }
+        const T tolerance = Numeric<T>::ratio(115, 100);
+        if (max_ticks * 100 <= min_ticks * 115 && max_amp <= min_amp * tolerance) {
+            finish_autotune(temp_c);
+        }
+    }
+    return on;
+}
+
+// Period at which a relay with hysteresis e, on a fraction `bias` of the
+// time, makes an FOPDT plant with dead time theta and time constant tau
+// oscillate with amplitude a; also gives the plant gain K. Infinite where
+// no such plant exists.
+static float relay_period(float a, float e, float bias, float theta, float tau, float &k) {
+    const float x = std::exp(-theta / tau);
+    k = 2 * (a - e * x) / (1 - x);
+    const float up = k * (1 - bias), down = k * bias;  // drive above/below the setpoint
+    if (up <= e || down <= e) return INFINITY;
+    const float peak = up - (up - e) * x;
+    const float trough = -down + (down - e) * x;
+    return 2 * theta + tau * (std::log((peak + down) / (down - e)) +
+                              std::log((up - trough) / (up - e)));
+}
+
+// Runs once, so the arithmetic is done in float on either backend.
+template <typename T>
+void BasicThermostat<T>::finish_autotune(T temp_c) {
+    float ticks = 0, on_ticks = 0, dead_ticks = 0, amplitude = 0;
+    for (const Cycle &c : cycles_) {
+        ticks += float(c.ticks);
+        on_ticks += float(c.on_ticks);
+        dead_ticks += float(c.dead_ticks);
+        amplitude += Numeric<T>::to_float(c.amplitude);
+    }
+    amplitude /= tune_window;
+    const float band = config_.autotune_band_c;
+    // Describing function of a relay with hysteresis: the band shifts the
+    // switching points, not the swing.
+    const float effective = amplitude > band ? std::sqrt(amplitude * amplitude - band * band)
+                                             : amplitude;
+    const float d = 0.5f;
+    const float pi = 3.14159265f;
+
+    AutotuneResult &r = tune_result_;
+    r.ku = 4 * d / (pi * effective);
+    r.pu_s = ticks / tune_window * config_.tick_s;
+    r.amplitude_c = amplitude;
+    r.bias = on_ticks / ticks;
+    r.cycles = cycles_seen_;
+
+    // FOPDT fit: the period grows with tau, so bisect for it (on a log
+    // scale); the amplitude then gives the gain. On a higher-order plant
+    // the turning points understate the effective delay and the fit runs
+    // off towards an integrator; past max_tau, tau is held there and the
+    // dead time is fitted to the period instead.
+    r.dead_s = dead_ticks / tune_window * config_.tick_s;
+    if (amplitude > band) {
+        const float max_tau = 2 * r.pu_s;
+        float k = 0;
+        float lo = config_.tick_s, hi = max_tau;
+        if (relay_period(amplitude, band, r.bias, r.dead_s, hi, k) < r.pu_s) {
+            r.tau_s = max_tau;
+            lo = r.dead_s;
+            hi = r.pu_s / 2;
+            for (int i = 0; i < 40; i++) {
+                const float mid = (lo + hi) / 2;
+                if (relay_period(amplitude, band, r.bias, mid, r.tau_s, k) < r.pu_s) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            r.dead_s = (lo + hi) / 2;
+        } else {
+            for (int i = 0; i < 40; i++) {
+                const float mid = std::sqrt(lo * hi);
+                if (relay_period(amplitude, band, r.bias, r.dead_s, mid, k) < r.pu_s) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            r.tau_s = std::sqrt(lo * hi);
+        }
+        relay_period(amplitude, band, r.bias, r.dead_s, r.tau_s, k);
+        r.gain_c = k;
+    }
+    set_model(r.gain_c, r.tau_s, r.dead_s);
+
+    const float kp = r.ku / 3.2f;
+    set_gains(kp, kp / (2.2f * r.pu_s), 0.0f);
+    config_.mode = ControlMode::pid;
+    // Bumpless start: the integrator holds the duty that kept the room
+    // oscillating around the setpoint.
+    integral_ = Numeric<T>::from_float(r.bias);
+    prev_error_ = setpoint_ - temp_c;
+    window_pos_ = 0;
+    tune_state_ = AutotuneState::done;
+}
+
+template <typename T>
+bool THERMO_HOT(BasicThermostat<T>::step_hysteresis)(T temp_c) {
+    if (temp_c < setpoint_ - band_) {
+        duty_ = T(1);
+    } else if (temp_c > setpoint_ + band_) {
+        duty_ = T(0);
+    }
+    return duty_ > T(0);
+}
+
+template <typename T>
+bool THERMO_HOT(BasicThermostat<T>::step_mpc)(T temp_c) {
+    if (!mpc_.has_model()) return step_pid(temp_c);
+    if (window_pos_ == 0) {
+        duty_ = mpc_.update(temp_c, setpoint_);
+        mpc_late_ = !mpc_late_;
+    }
+    // Time-proportioning over the move, with the on-time alternately at the
+    // end of one move and the start of the next, so that the two merge into
+    // one burner start.
+    const uint32_t move = config_.mpc_move_ticks;
+    const uint32_t on_ticks = uint32_t(Numeric<T>::round(duty_ * int32_t(move)));
+    const bool on = mpc_late_ ? window_pos_ >= move - on_ticks : window_pos_ < on_ticks;
+    if (++window_pos_ >= move) window_pos_ = 0;
+    return on;
+}
+
+template <typename T>
+bool THERMO_HOT(BasicThermostat<T>::step_pid)(T temp_c) {
+    const T zero(0), one(1);
+    T error = setpoint_ - temp_c;
+    T p = kp_ * error;
+    T d = kd_over_dt_ * (error - prev_error_);
+    prev_error_ = error;
+
+    // Conditional integration: only wind the integrator while the output is
+    // not pinned against a rail in the same direction.
+    T candidate = integral_ + ki_dt_ * error;
+    T out = p + candidate + d;
+    if ((out < one || error < zero) && (out > zero || error > zero)) {
+        integral_ = candidate;
+    }
+    duty_ = clamp(p + integral_ + d, zero, one);
+
+    // Time-proportioning: the relay is on for the first duty * window ticks.
+    uint32_t on_ticks = uint32_t(Numeric<T>::round(duty_ * int32_t(config_.window_ticks)));
+    bool on = window_pos_ < on_ticks;
+    if (++window_pos_ >= config_.window_ticks) {
+        window_pos_ = 0;
+    }
+    // Minimum run and rest: the relay holds for min_run_ticks after each
+    // switch, so a duty that wanders across the window position, or a short
+    // pulse, costs no extra burner starts; the integrator makes up the
+    // difference.
+    if (since_switch_ < config_.min_run_ticks && on != relay_) on = relay_;
+    since_switch_ = on != relay_ ? 0 : since_switch_ + 1;
+    return on;
+}
+
+template class BasicThermostat<float>;
+template class BasicThermostat<Q16>;
+
+} // namespace thermo
@@ -0,0 +1,176 @@
+// Thermostat control law: hysteresis or PID driving a single heat relay.
+//
+// PID gains can be found by relay-feedback autotuning (Astrom-Hagglund):
+// the relay is driven fully on below the setpoint band and fully off above
+// it, which makes the room oscillate at the plant's ultimate period Pu. The
+// oscillation amplitude a gives the ultimate gain Ku = 4d / (pi sqrt(a^2 -
+// e^2)) for relay half-swing d = 0.5 and band half-width e. Tyreus-Luyben
+// rules turn (Ku, Pu) into PI gains, trading rise time for little overshoot:
+// Kp = Ku / 3.2, Ti = 2.2 Pu. The tuner runs one control tick at a time
+// inside step(), never blocking.
+//
+// The same experiment also fits the first-order-plus-dead-time model the
+// MPC mode (mpc.h) predicts with. The dead time is how long the room keeps
+// going the old way after each switch; given it, the amplitude and period of
+// a relay with hysteresis e on an FOPDT plant fix the gain and time
+// constant. Peak to peak, 2a = K (1 - x) + 2 e x with x = exp(-theta / tau);
+// the period is 2 theta plus the two exponential legs between the switching
+// points, which for bias b (the fraction of time on) head for K (1 - b)
+// above the setpoint and K b below it.
+#pragma once
+
+#include <cstdint>
+
+#include "fixed.h"
+#include "mpc.h"
+#include "rls.h"
+
+namespace thermo {
+
+enum class ControlMode : uint8_t {
+    hysteresis,
+    pid,
+    mpc,  // falls back to PID until it has a room model
+};
+
+/// User-facing settings, kept in float for readability; converted once into
+/// the controller's numeric backend at construction.
+struct ThermostatConfig {
+    ControlMode mode = ControlMode::hysteresis;
+    float setpoint_c = 20.0f;
+    float hysteresis_c = 0.5f;  // half-width of the on/off band
+    float kp = 0.8f;
+    float ki = 0.002f;          // per second
+    float kd = 0.0f;            // seconds
+    float tick_s = 1.0f;        // control period
+    // Time-proportioning window for PID output, and the shortest the relay
+    // stays on or off under PID: each burner start costs fuel, so a few
+    // starts an hour, not one a minute.
+    uint32_t window_ticks = 900;
+    uint32_t min_run_ticks = 180;
+    float autotune_band_c = 0.1f;        // relay band half-width while tuning
+    float autotune_max_s = 24 * 3600.0f; // give up after this long
+    // Room model for MPC, normally learned by autotune: full heat would
+    // raise the room model_gain_c above where it settles unheated, with time
+    // constant model_tau_s, after model_dead_s. A zero gain means no model.
+    float model_gain_c = 0.0f;
+    float model_tau_s = 0.0f;
+    float model_dead_s = 0.0f;
+    uint32_t mpc_move_ticks = 600;    // MPC decision period and relay window
+    float mpc_energy_weight = 0.05f;  // see MpcWeights
+    float mpc_move_weight = 0.1f;
+    // Online identification (rls.h) runs in every mode; with model_adapt
+    // set, MPC adopts its estimate whenever it is valid, so the model keeps
+    // up with the seasons and MPC can start without autotuning.
+    bool model_adapt = false;
+    uint32_t rls_period_ticks = 300;  // one update per block of this many ticks
+    float rls_forget = 0.995f;        // per block: a memory of ~17 h at 300 s
+};
+
+enum class AutotuneState : uint8_t {
+    off,
+    running,
+    done,    // gains applied, mode switched to PID
+    failed,  // no steady oscillation in time; previous mode and gains kept
+};
+
+struct AutotuneResult {
+    float ku = 0;    // ultimate gain, duty per degree
+    float pu_s = 0;  // ultimate period
+    float amplitude_c = 0;
+    float bias = 0;  // fraction of the time the heat was on
+    uint32_t cycles = 0;  // full oscillations observed
+    float dead_s = 0;     // FOPDT fit
+    float gain_c = 0;
+    float tau_s = 0;
+};
+
+/// One control channel. step() is called once per control tick with the
+/// latest filtered temperature and returns the relay state to apply.
+/// T is the numeric backend: float or Q16.
+template <typename T>
+class BasicThermostat {
+public:
+    explicit BasicThermostat(const ThermostatConfig &config = {});
+
+    bool step(T temp_c);
+
+    void set_setpoint(float setpoint_c);
+    /// Replace the PID gains (ki per second, kd in seconds).
+    void set_gains(float kp, float ki, float kd);
+    void set_mode(ControlMode mode);
+    /// Replace the MPC room model (see ThermostatConfig).
+    void set_model(float gain_c, float tau_s, float dead_s);
+
+    /// Start relay-feedback tuning around the current setpoint. step() runs
+    /// it until it settles (or gives up), then switches to PID.
+    void start_autotune();
+    void abort_autotune();
+    AutotuneState autotune_state() const { return tune_state_; }
+    const AutotuneResult &autotune_result() const { return tune_result_; }
+    const ThermostatConfig &config() const { return config_; }
+    T setpoint() const { return setpoint_; }
+    T duty() const { return duty_; }
+    const MpcController<T> &mpc() const { return mpc_; }
+    const RlsEstimator<T> &estimator() const { return rls_; }
+    bool relay() const { return relay_; }
+
+private:
+    bool step_hysteresis(T temp_c);
+    bool step_pid(T temp_c);
+    bool step_mpc(T temp_c);
+    void load_model();
+    void adapt_model();
+    bool step_autotune(T temp_c);
+    void finish_autotune(T temp_c);
+
+    ThermostatConfig config_;
+    // Backend copies of the config, with the tick period folded into the
+    // integral and derivative gains so step() never divides.
+    T setpoint_;
+    T band_;
+    T kp_;
+    T ki_dt_;
+    T kd_over_dt_;
+
+    T integral_{};
+    T prev_error_{};
+    T duty_{};
+    uint32_t window_pos_ = 0;
+    uint32_t since_switch_ = UINT32_MAX / 2;  // ticks the relay has held
+    bool relay_ = false;
+    MpcController<T> mpc_;
+    bool mpc_late_ = false;  // this move's on-time goes at its end
+    RlsEstimator<T> rls_;
+
+    // Autotune: the last few full oscillations, measured from one switch-on
+    // to the next.
+    static constexpr uint32_t tune_window = 3;
+    struct Cycle {
+        uint32_t ticks;
+        uint32_t on_ticks;
+        uint32_t dead_ticks;  // mean of switch-on to trough, switch-off to peak
+        T amplitude;  // half of peak-to-peak
+    };
+    AutotuneState tune_state_ = AutotuneState::off;
+    AutotuneResult tune_result_;
+    T tune_band_{};
+    uint32_t tune_ticks_ = 0;
+    uint32_t tune_max_ticks_ = 0;
+    uint32_t cycle_start_ = 0;  // tick of the last switch-on; 0 before the first
+    uint32_t cycle_on_ = 0;
+    uint32_t cycle_off_at_ = 0;  // ticks into the cycle
+    uint32_t cycle_hi_at_ = 0;
+    uint32_t cycle_lo_at_ = 0;
+    T cycle_hi_{};
+    T cycle_lo_{};
+    uint32_t cycles_seen_ = 0;
+    Cycle cycles_[tune_window] = {};
+};
+
+extern template class BasicThermostat<float>;
+extern template class BasicThermostat<Q16>;
+
+using Thermostat = BasicThermostat<real_t>;
+
+} // namespace thermo
@@ -0,0 +1,169 @@
+#include "trace.h"
+
+#include "flash_log.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/exception.h"
+#include "hardware/structs/psm.h"
+#include "hardware/structs/sio.h"
+#include "hardware/structs/timer.h"
+#include "hardware/structs/watchdog.h"
+#endif
+
+namespace thermo {
+
+static constexpr uint32_t fault_marker = 0x54524346;  // "FCRT"
+
+const char *trace_name(uint8_t id) {
+    static const char *const names[] = {
+#define THERMO_TRACE_NAME(name) #name,
+        THERMO_TRACE_IDS(THERMO_TRACE_NAME)
+#undef THERMO_TRACE_NAME
+    };
+    return id < uint8_t(TraceId::count) ? names[id] : nullptr;
+}
+
+size_t TraceRing::read(uint32_t &cursor, TraceEvent *out, size_t max, uint32_t &lost) const {
+    const uint32_t head = this->head();
+    if (head - cursor > capacity) {
+        lost += head - cursor - capacity;
+        cursor = head - capacity;
+    }
+    size_t n = head - cursor;
+    if (n > max) n = max;
+    for (size_t i = 0; i < n; i++) out[i] = events_[(cursor + i) & (capacity - 1)];
+
+    // The writer may have lapped the copy. Event j is intact only while the
+    // head is below j + capacity: at j + capacity its slot is being reused.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint32_t after = head_.load(std::memory_order_relaxed);
+    size_t stale = after - cursor >= capacity ? after - cursor - capacity + 1 : 0;
+    if (stale > n) stale = n;
+    for (size_t i = stale; i < n; i++) out[i - stale] = out[i];
+    lost += uint32_t(stale);
+    cursor += uint32_t(n);
+    return n - stale;
+}
+
+void Tracer::reset() {
+    frozen_.store(true, std::memory_order_relaxed);
+    fault_magic_ = 0;
+    for (TraceRing &r : rings_) r.reset();
+    frozen_.store(false, std::memory_order_release);
+}
+
+void Tracer::freeze(bool faulted) {
+    frozen_.store(true, std::memory_order_release);
+    if (faulted) fault_magic_ = fault_marker;
+}
+
+bool Tracer::faulted() const {
+    return frozen() && fault_magic_ == fault_marker;
+}
+
+size_t trace_read_block(const Tracer &tracer, size_t core, uint32_t &cursor, uint8_t *out,
+                        size_t size) {
+    TraceEvent events[32];
+    size_t max = size > trace::block_header ? (size - trace::block_header) / trace::event_size : 0;
+    if (max > sizeof(events) / sizeof(events[0])) max = sizeof(events) / sizeof(events[0]);
+    uint32_t lost = 0;
+    const size_t n = tracer.ring(core).read(cursor, events, max, lost);
+    if (lost > 0xffff) lost = 0xffff;
+    out[0] = uint8_t(core);
+    out[1] = uint8_t(lost);
+    out[2] = uint8_t(lost >> 8);
+    uint8_t *p = out + trace::block_header;
+    for (size_t i = 0; i < n; i++, p += trace::event_size) {
+        const TraceEvent &e = events[i];
+        for (int b = 0; b < 4; b++) p[b] = uint8_t(e.time_us >> (8 * b));
+        p[4] = e.id;
+        p[5] = e.kind;
+        p[6] = uint8_t(e.arg);
+        p[7] = uint8_t(e.arg >> 8);
+    }
+    return size_t(p - out);
+}
+
+bool trace_dump(const Tracer &tracer, FlashLog &log) {
+    uint8_t block[FlashLog::max_record_size];
+    for (size_t core = 0; core < Tracer::cores; core++) {
+        // Everything still in the ring, oldest first. A full ring's oldest
+        // slot is the one a write in progress would be replacing, which
+        // read() never trusts, so start after it.
+        const uint32_t head = tracer.ring(core).head();
+        const uint32_t keep = TraceRing::capacity - 1;
+        uint32_t cursor = head - (head < keep ? head : keep);
+        for (;;) {
+            const size_t len = trace_read_block(tracer, core, cursor, block, sizeof(block));
+            if (len == trace::block_header) break;
+            if (!log.append(trace::record_trace_dump, block, len)) return false;
+        }
+    }
+    return log.flush();
+}
+
+#if !PICO_ON_DEVICE
+thread_local uint8_t trace::host_core = 0;
+#endif
+
+#if THERMO_TRACE
+
+#if PICO_ON_DEVICE
+
+// Left alone by the runtime's RAM clearing, so a crash snapshot survives the
+// watchdog reboot.
+Tracer __uninitialized_ram(tracer);
+
+// The fault may have come from a flash operation, with XIP off, so this and
+// everything it runs is in RAM: record() and freeze() are not, and neither
+// are the SDK's time and watchdog functions, so the event is written and the
+// reset requested here through the registers. Atomics are always inlined.
+void __not_in_flash_func(Tracer::fault)() {
+    if (!frozen_.load(std::memory_order_relaxed)) {
+        TraceRing &ring = rings_[sio_hw->cpuid];
+        const uint32_t head = ring.head_.load(std::memory_order_relaxed);
+        TraceEvent &e = ring.events_[head & (TraceRing::capacity - 1)];
+        e.time_us = timer_hw->timerawl;
+        e.id = uint8_t(TraceId::fault);
+        e.kind = uint8_t(TraceKind::instant);
+        e.arg = 0;
+        ring.head_.store(head + 1, std::memory_order_release);
+    }
+    frozen_.store(true, std::memory_order_release);
+    fault_magic_ = fault_marker;
+}
+
+// As watchdog_reboot(0, 0, 0): reset everything but the oscillators, and
+// boot normally.
+static void __not_in_flash_func(trace_hard_fault)() {
+    tracer.fault();
+    psm_hw->wdsel = PSM_WDSEL_BITS & ~(PSM_WDSEL_ROSC_BITS | PSM_WDSEL_XOSC_BITS);
+    watchdog_hw->scratch[4] = 0;
+    watchdog_hw->ctrl = WATCHDOG_CTRL_TRIGGER_BITS;
+    for (;;) {}
+}
+
+#else
+
+Tracer tracer;
+
+#endif
+
+bool trace_init() {
+    if (tracer.faulted()) return true;
+    tracer.reset();
+    return false;
+}
+
+void trace_start() {
+    tracer.reset();
+#if PICO_ON_DEVICE
+    static bool installed;
+    if (!installed) exception_set_exclusive_handler(HARDFAULT_EXCEPTION, trace_hard_fault);
+    installed = true;
+#endif
+}
+
+#endif
+
+} // namespace thermo
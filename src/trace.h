@@ -0,0 +1,256 @@
+// Event tracing into a per-core flight-recorder ring.
+//
+// TRACE_BEGIN/END/SCOPE/INSTANT/COUNTER write one 8-byte event (timer
+// timestamp, event id, kind, 16-bit argument) into the ring of the core they
+// run on. Each ring has a single writer, so a write is a few stores and a
+// release store of the head index: no locks, and on the device interrupts are
+// masked only for those few stores so an ISR cannot interleave with the code
+// it preempted. A full ring overwrites its oldest events; readers detect
+// being lapped and count what they missed.
+//
+// Timestamps are the 1 MHz timer (time_us_32). The M0+ has no cycle counter
+// and SysTick is 24 bits per core; the shared timer orders events across
+// cores, which matters more here than sub-microsecond resolution.
+//
+// Tracing is compiled in only with THERMO_TRACE=1 (CMake option
+// THERMO_TRACE). Otherwise the macros expand to nothing and the rings do not
+// exist. When on:
+//  - the application drains the rings into telemetry records (record_trace,
+//    see telemetry.h) for tools/trace_to_json;
+//  - on the device a hard fault freezes the rings and reboots. The rings sit
+//    in RAM the runtime does not clear, so the next boot finds them intact
+//    and writes them to the flash log (record_trace_dump) before tracing
+//    resumes.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "pico/stdlib.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/sync.h"
+#endif
+
+#ifndef THERMO_TRACE
+#define THERMO_TRACE 0
+#endif
+
+// Events kept per core; a power of two.
+#ifndef THERMO_TRACE_EVENTS
+#define THERMO_TRACE_EVENTS 256
+#endif
+
+namespace thermo {
+
+class FlashLog;
+
+// Every event id with its display name; tools/trace_to_json uses the same
+// table.
+#define THERMO_TRACE_IDS(X) \
+    X(idle)                 \
+    X(task_control)         \
+    X(task_status)          \
+    X(task_history)         \
+    X(task_flash)           \
+    X(task_probes)          \
+    X(task_display)         \
+    X(task_telemetry)       \
+    X(overrun)              \
+    X(skipped)              \
+    X(relay)                \
+    X(temp)                 \
+    X(reading)              \
+    X(flash_program)        \
+    X(flash_erase)          \
+    X(fault)                \
+    X(task_mqtt)            \
+    X(task_http)
+
+enum class TraceId : uint8_t {
+#define THERMO_TRACE_ENUM(name) name,
+    THERMO_TRACE_IDS(THERMO_TRACE_ENUM)
+#undef THERMO_TRACE_ENUM
+    count
+};
+
+/// Name of an event id, or nullptr if unknown.
+const char *trace_name(uint8_t id);
+
+enum class TraceKind : uint8_t {
+    begin,    // start of a span on this core
+    end,      // end of the innermost open span
+    instant,  // point event; arg is free-form
+    counter,  // arg is the new value of the counter
+};
+
+struct TraceEvent {
+    uint32_t time_us;
+    uint8_t id;
+    uint8_t kind;
+    uint16_t arg;
+};
+static_assert(sizeof(TraceEvent) == 8, "trace events are stored and sent as 8 bytes");
+
+/// One core's ring. Trivially constructible so it can live in RAM that
+/// survives a reset; call reset() before first use.
+class TraceRing {
+    static_assert(THERMO_TRACE_EVENTS && (THERMO_TRACE_EVENTS & (THERMO_TRACE_EVENTS - 1)) == 0,
+                  "THERMO_TRACE_EVENTS must be a power of two");
+
+public:
+    static constexpr size_t capacity = THERMO_TRACE_EVENTS;
+
+    void reset() { head_.store(0, std::memory_order_release); }
+
+    /// Writer side: the owning core only, not reentrantly.
+    void write(const TraceEvent &e) {
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        events_[head & (capacity - 1)] = e;
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    /// Events ever written (mod 2^32).
+    uint32_t head() const { return head_.load(std::memory_order_acquire); }
+
+    /// Copy up to `max` events from `cursor` on and advance it. Events the
+    /// writer overwrote before (or while) they were copied are skipped and
+    /// added to `lost`. Any thread may read while the owner writes.
+    size_t read(uint32_t &cursor, TraceEvent *out, size_t max, uint32_t &lost) const;
+
+private:
+    friend class Tracer;  // the hard-fault path writes the ring directly
+
+    std::atomic<uint32_t> head_;
+    TraceEvent events_[capacity];
+};
+
+/// A ring per core, plus the fault marker.
+class Tracer {
+public:
+    static constexpr size_t cores = 2;
+
+    void reset();
+
+    /// Append an event to the calling core's ring (dropped while frozen).
+    void record(TraceId id, TraceKind kind, uint16_t arg);
+
+    /// Stop recording, keeping the rings as they are; `faulted` marks them
+    /// as a crash snapshot for the next boot.
+    void freeze(bool faulted);
+    bool frozen() const { return frozen_.load(std::memory_order_relaxed); }
+    /// The rings hold a snapshot taken by freeze(true).
+    bool faulted() const;
+#if PICO_ON_DEVICE
+    /// Hard-fault path: record the fault event on the calling core and
+    /// freeze(true), touching nothing but RAM and registers.
+    void fault();
+#endif
+
+    TraceRing &ring(size_t core) { return rings_[core]; }
+    const TraceRing &ring(size_t core) const { return rings_[core]; }
+
+private:
+    std::atomic<bool> frozen_;
+    uint32_t fault_magic_;
+    TraceRing rings_[cores];
+};
+
+namespace trace {
+
+/// Telemetry and flash-log payload: core u8 | lost u16 | events (8 bytes
+/// each: time_us u32, id u8, kind u8, arg u16; little-endian).
+constexpr size_t block_header = 3;
+constexpr size_t event_size = 8;
+
+/// Flash log record type for a crash snapshot (one record per block).
+constexpr uint8_t record_trace_dump = 0x12;
+
+} // namespace trace
+
+/// Encode the events of `core` from `cursor` on as one block of at most
+/// `size` bytes. Returns its length; block_header means there was nothing
+/// new (the lost count may still be non-zero).
+size_t trace_read_block(const Tracer &tracer, size_t core, uint32_t &cursor, uint8_t *out,
+                        size_t size);
+
+/// Write every event in `tracer` to `log` as record_trace_dump records and
+/// flush. False if the log refused a record.
+bool trace_dump(const Tracer &tracer, FlashLog &log);
+
+/// Core index of the caller. On the host the emulated core 1 thread calls
+/// trace_set_core(1).
+#if PICO_ON_DEVICE
+inline size_t trace_core() {
+    return get_core_num();
+}
+#else
+namespace trace {
+extern thread_local uint8_t host_core;
+}
+inline size_t trace_core() {
+    return trace::host_core;
+}
+inline void trace_set_core(size_t core) {
+    trace::host_core = uint8_t(core);
+}
+#endif
+
+inline void Tracer::record(TraceId id, TraceKind kind, uint16_t arg) {
+    if (frozen()) return;
+#if PICO_ON_DEVICE
+    // Stamp and store with interrupts off, so an ISR's events neither split
+    // this one nor land out of time order before it.
+    const uint32_t irq = save_and_disable_interrupts();
+    rings_[get_core_num()].write(TraceEvent{time_us_32(), uint8_t(id), uint8_t(kind), arg});
+    restore_interrupts(irq);
+#else
+    rings_[trace_core()].write(TraceEvent{time_us_32(), uint8_t(id), uint8_t(kind), arg});
+#endif
+}
+
+#if THERMO_TRACE
+
+/// The firmware's tracer, in no-init RAM on the device.
+extern Tracer tracer;
+
+/// First thing at boot. Returns true if the rings hold a crash snapshot from
+/// before the reset; it stays readable until trace_start().
+bool trace_init();
+/// Clear the rings and start recording. On the device, also installs the
+/// hard-fault handler that freezes the rings and reboots.
+void trace_start();
+
+#define TRACE_BEGIN(id) \
+    ::thermo::tracer.record(::thermo::TraceId::id, ::thermo::TraceKind::begin, 0)
+#define TRACE_END(id) ::thermo::tracer.record(::thermo::TraceId::id, ::thermo::TraceKind::end, 0)
+#define TRACE_INSTANT(id, arg) \
+    ::thermo::tracer.record(::thermo::TraceId::id, ::thermo::TraceKind::instant, uint16_t(arg))
+#define TRACE_COUNTER(id, value) \
+    ::thermo::tracer.record(::thermo::TraceId::id, ::thermo::TraceKind::counter, uint16_t(value))
+/// Begin now and end when the enclosing block exits.
+#define TRACE_SCOPE(id) ::thermo::TraceScope trace_scope_##id(::thermo::TraceId::id)
+
+class TraceScope {
+public:
+    explicit TraceScope(TraceId id) : id_(id) { tracer.record(id, TraceKind::begin, 0); }
+    ~TraceScope() { tracer.record(id_, TraceKind::end, 0); }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    TraceId id_;
+};
+
+#else
+
+#define TRACE_BEGIN(id) ((void)0)
+#define TRACE_END(id) ((void)0)
+#define TRACE_INSTANT(id, arg) ((void)0)
+#define TRACE_COUNTER(id, value) ((void)0)
+#define TRACE_SCOPE(id) ((void)0)
+
+#endif
+
+} // namespace thermo
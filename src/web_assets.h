@@ -0,0 +1,26 @@
+// The web UI (web/), gzipped at build time by tools/web_pack.py into const
+// arrays. On the device they stay in XIP flash and cost no RAM; the HTTP
+// server (http.h) sends them as they are, with Content-Encoding: gzip.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace thermo {
+
+struct WebAsset {
+    const char *path;     // "/index.html"
+    const char *type;     // Content-Type
+    const char *etag;     // quoted, CRC-32 of the gzipped bytes
+    const uint8_t *data;  // gzipped
+    uint32_t size;
+    uint32_t raw_size;    // before compression
+};
+
+extern const WebAsset web_assets[];
+extern const size_t web_asset_count;
+
+/// The asset at `path` (not terminated), or nullptr.
+const WebAsset *web_asset_find(const char *path, size_t len);
+
+} // namespace thermo
@@ -0,0 +1,174 @@
+#include "zones.h"
+
+#include "memory_config.h"
+
+namespace thermo {
+
+template <typename T, uint32_t N>
+BasicZoneController<T, N>::BasicZoneController(const ZoneBankConfig &config)
+    : config_(config) {
+    if (config_.window_ticks == 0) config_.window_ticks = 1;
+}
+
+template <typename T, uint32_t N>
+int BasicZoneController<T, N>::add_zone(const ZoneConfig &config) {
+    if (count_ >= N || config.group >= max_groups) return -1;
+    const uint32_t i = count_++;
+    setpoint_[i] = Numeric<T>::from_float(config.setpoint_c);
+    temp_[i] = setpoint_[i];
+    band_[i] = Numeric<T>::from_float(config.hysteresis_c);
+    kp_[i] = Numeric<T>::from_float(config.kp);
+    ki_dt_[i] = Numeric<T>::from_float(config.ki * config_.tick_s);
+    integral_[i] = T(0);
+    duty_[i] = T(0);
+    min_run_[i] = config.min_run_ticks;
+    since_switch_[i] = UINT32_MAX / 2;
+    if (config.mode != ControlMode::hysteresis) {
+        pi_zones_[pi_count_++] = uint16_t(i);
+    } else {
+        hyst_zones_[i - pi_count_] = uint16_t(i);
+    }
+    enabled_[i] = 1;
+    on_[i] = 0;
+    group_[i] = config.group;
+    equipment_[i] = group_equipment_[config.group];
+    assign_phases();
+    return int(i);
+}
+
+template <typename T, uint32_t N>
+void BasicZoneController<T, N>::set_group_equipment(uint8_t group, uint8_t equipment) {
+    if (group >= max_groups || equipment >= max_equipment) return;
+    group_equipment_[group] = equipment;
+    for (uint32_t i = 0; i < count_; i++) {
+        if (group_[i] == group) equipment_[i] = equipment;
+    }
+    assign_phases();
+}
+
+template <typename T, uint32_t N>
+void BasicZoneController<T, N>::set_group_setpoint(uint8_t group, float setpoint_c) {
+    const T sp = Numeric<T>::from_float(setpoint_c);
+    for (uint32_t i = 0; i < count_; i++) {
+        if (group_[i] == group) setpoint_[i] = sp;
+    }
+}
+
+template <typename T, uint32_t N>
+void BasicZoneController<T, N>::set_setpoint(uint32_t zone, float setpoint_c) {
+    if (zone < count_) setpoint_[zone] = Numeric<T>::from_float(setpoint_c);
+}
+
+template <typename T, uint32_t N>
+void BasicZoneController<T, N>::set_gains(uint32_t zone, float kp, float ki) {
+    if (zone >= count_) return;
+    kp_[zone] = Numeric<T>::from_float(kp);
+    ki_dt_[zone] = Numeric<T>::from_float(ki * config_.tick_s);
+}
+
+template <typename T, uint32_t N>
+void BasicZoneController<T, N>::set_enabled(uint32_t zone, bool enabled) {
+    if (zone < count_) enabled_[zone] = enabled;
+}
+
+// The k-th of the n zones on each item of equipment starts k n-ths of a
+// window in. Runs when zones or groups change, not per tick.
+template <typename T, uint32_t N>
+void BasicZoneController<T, N>::assign_phases() {
+    uint32_t zones[max_equipment] = {};
+    for (uint32_t i = 0; i < count_; i++) zones[equipment_[i]]++;
+    uint32_t seen[max_equipment] = {};
+    const uint32_t window = config_.window_ticks;
+    for (uint32_t i = 0; i < count_; i++) {
+        const uint8_t e = equipment_[i];
+        phase_[i] = config_.stagger ? uint16_t(seen[e]++ * window / zones[e]) : 0;
+    }
+}
+
+// One pass over the PI zones, then one over the hysteresis zones, each
+// through the index list add_zone() keeps: a zone's mode never changes, so
+// splitting by it once costs nothing per tick, and neither pass computes a
+// law it then throws away. Within a pass no branch depends on a zone's
+// temperature or state. The arrays are walked through locals: the byte
+// arrays could otherwise alias everything else, and each store would force
+// the rest to be reloaded.
+template <typename T, uint32_t N>
+void THERMO_HOT(BasicZoneController<T, N>::step)() {
+    const T zero(0), one(1);
+    const uint32_t count = count_;
+    const uint32_t window = config_.window_ticks;
+    const int32_t window_k = int32_t(window);
+    const uint32_t window_pos = window_pos_;
+    const T *__restrict temp = temp_;
+    const T *__restrict setpoint = setpoint_;
+    const T *__restrict band = band_;
+    const T *__restrict kp = kp_;
+    const T *__restrict ki_dt = ki_dt_;
+    const uint32_t *__restrict min_run = min_run_;
+    uint32_t *__restrict since_switch = since_switch_;
+    const uint16_t *__restrict phase = phase_;
+    const uint8_t *__restrict enabled_zone = enabled_;
+    T *__restrict integral = integral_;
+    T *__restrict duty = duty_;
+    uint8_t *__restrict on = on_;
+
+    const uint16_t *__restrict pi_zone = pi_zones_;
+    const uint32_t pi_count = pi_count_;
+    for (uint32_t k = 0; k < pi_count; k++) {
+        const uint32_t i = pi_zone[k];
+        const T error = setpoint[i] - temp[i];
+        const bool enabled = enabled_zone[i];
+
+        // Conditional integration: only wind the integrator while the
+        // output is not pinned against a rail in the same direction.
+        const T p = kp[i] * error;
+        const T candidate = integral[i] + ki_dt[i] * error;
+        const T out = p + candidate;
+        const bool wind = (out < one || error < zero) && (out > zero || error > zero);
+        const T held = wind && enabled ? candidate : integral[i];
+        integral[i] = held;
+        const T pi_duty = clamp(p + held, zero, one);
+        duty[i] = pi_duty;
+
+        // Time-proportioning from the zone's own phase in the shared window.
+        uint32_t pos = window_pos + phase[i];
+        pos -= pos >= window ? window : 0;
+        const uint32_t on_ticks = uint32_t(Numeric<T>::round(pi_duty * window_k));
+        const bool want = pos < on_ticks;
+
+        // Minimum run: the output holds for min_run ticks after each
+        // switch. A disabled zone goes off at once.
+        const bool was_on = on[i];
+        const bool hold = since_switch[i] < min_run[i] && want != was_on;
+        const bool next = (hold ? was_on : want) && enabled;
+        since_switch[i] = next != was_on ? 0 : since_switch[i] + 1;
+        on[i] = next;
+    }
+
+    // Hysteresis: on below the band, off above it, as it was within.
+    const uint16_t *__restrict hyst_zone = hyst_zones_;
+    const uint32_t hyst_count = count - pi_count;
+    for (uint32_t k = 0; k < hyst_count; k++) {
+        const uint32_t i = hyst_zone[k];
+        const bool below = temp[i] < setpoint[i] - band[i];
+        const bool above = temp[i] > setpoint[i] + band[i];
+        const bool hyst_on = below || (duty[i] > zero && !above);
+        duty[i] = hyst_on ? one : zero;
+        on[i] = hyst_on && enabled_zone[i];
+    }
+    window_pos_ = window_pos + 1 >= window ? 0 : window_pos + 1;
+
+    for (uint32_t &w : calls_) w = 0;
+    for (uint32_t &d : demand_) d = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        calls_[i / 32] |= uint32_t(on[i]) << (i % 32);
+        demand_[equipment_[i]] += on[i];
+    }
+}
+
+template class BasicZoneController<float, zone_limit>;
+template class BasicZoneController<Q16, zone_limit>;
+template class BasicZoneController<float, 256>;
+template class BasicZoneController<Q16, 256>;
+
+} // namespace thermo
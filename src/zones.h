@@ -0,0 +1,125 @@
+// Multi-zone control: up to N rooms, each with its own sensor and damper or
+// valve, driven from one Pico in one call per control tick.
+//
+// Zone state is kept as parallel arrays (temperature, setpoint, band, gains,
+// integrator, duty, output), not as one BasicThermostat per zone. A tick
+// runs the PI zones in one pass and the hysteresis zones in another, each
+// through an index list fixed when the zone is added, and each control law
+// is written with selects instead of branches, so a zone costs the same
+// whatever its state. On the host that is 1.1-1.3x the throughput of a loop
+// over BasicThermostat objects for Q16, and level to 1.1x for float, from
+// 16 to 256 zones (bench_zones). Zones run hysteresis or PI (the gains autotune produces;
+// no derivative, no MPC) with the same conditional integration,
+// time-proportioning and minimum run as BasicThermostat, which they match
+// tick for tick when not staggered.
+//
+// Zones are grouped (a floor, a wing), and each group is served by one item
+// of equipment (a boiler, a pump, an air handler) that runs while any of its
+// zones calls for heat. Groups share a setpoint change, and zones sharing
+// equipment have their PI windows staggered: the k-th of n zones starts its
+// on-time k/n of a window later, so their calls spread over the window
+// instead of all starting together, and the equipment sees fewer zones at
+// once.
+#pragma once
+
+#include <cstdint>
+
+#include "fixed.h"
+#include "thermostat.h"
+
+namespace thermo {
+
+struct ZoneConfig {
+    float setpoint_c = 20.0f;
+    ControlMode mode = ControlMode::pid;  // hysteresis or pid
+    float hysteresis_c = 0.5f;            // half-width of the on/off band
+    float kp = 0.8f;
+    float ki = 0.002f;                    // per second
+    uint32_t min_run_ticks = 180;         // shortest a PI zone stays on or off
+    uint8_t group = 0;
+};
+
+struct ZoneBankConfig {
+    float tick_s = 1.0f;          // control period
+    uint32_t window_ticks = 900;  // time-proportioning window for PI zones
+    bool stagger = true;          // spread the windows of zones sharing equipment
+};
+
+template <typename T, uint32_t N>
+class BasicZoneController {
+public:
+    static constexpr uint32_t max_zones = N;
+    static constexpr uint32_t max_groups = 32;
+    static constexpr uint32_t max_equipment = 16;
+
+    explicit BasicZoneController(const ZoneBankConfig &config = {});
+
+    /// Returns the new zone's index, or -1 when full or the group is out of
+    /// range. Zones start enabled, at their setpoint (no call for heat).
+    int add_zone(const ZoneConfig &config);
+    uint32_t size() const { return count_; }
+
+    /// Every group starts on equipment 0.
+    void set_group_equipment(uint8_t group, uint8_t equipment);
+    void set_group_setpoint(uint8_t group, float setpoint_c);
+    void set_setpoint(uint32_t zone, float setpoint_c);
+    void set_gains(uint32_t zone, float kp, float ki);
+    /// A disabled zone (e.g. its probe stopped answering) stays off and
+    /// holds its integrator.
+    void set_enabled(uint32_t zone, bool enabled);
+
+    /// The latest temperature of every zone, written in place before step().
+    T *temperatures() { return temp_; }
+
+    /// One control tick for every zone, then the equipment outputs.
+    void step();
+
+    bool zone_on(uint32_t zone) const { return on_[zone] != 0; }
+    /// Zone outputs as a bitmap, bit (zone % 32) of word zone / 32.
+    const uint32_t *zone_calls() const { return calls_; }
+    T duty(uint32_t zone) const { return duty_[zone]; }
+    bool equipment_on(uint8_t equipment) const { return demand_[equipment] != 0; }
+    /// Zones calling on this equipment in the last tick.
+    uint32_t equipment_demand(uint8_t equipment) const { return demand_[equipment]; }
+
+private:
+    void assign_phases();
+
+    ZoneBankConfig config_;
+    uint32_t count_ = 0;
+    uint32_t window_pos_ = 0;
+
+    T temp_[N] = {};
+    T setpoint_[N] = {};
+    T band_[N] = {};
+    T kp_[N] = {};
+    T ki_dt_[N] = {};
+    T integral_[N] = {};
+    T duty_[N] = {};
+    uint32_t min_run_[N] = {};
+    uint32_t since_switch_[N] = {};  // ticks the output has held
+    uint16_t phase_[N] = {};   // window offset, in ticks
+    uint16_t pi_zones_[N] = {};    // PI zones, in the order added
+    uint16_t hyst_zones_[N] = {};  // hysteresis zones, likewise
+    uint32_t pi_count_ = 0;
+    uint8_t enabled_[N] = {};
+    uint8_t on_[N] = {};
+    uint8_t group_[N] = {};
+    uint8_t equipment_[N] = {};  // the zone's group's, cached for the tick
+
+    uint8_t group_equipment_[max_groups] = {};
+    uint32_t calls_[(N + 31) / 32] = {};
+    uint32_t demand_[max_equipment] = {};
+};
+
+/// The firmware's bank: one Pico drives up to 16 zones.
+constexpr uint32_t zone_limit = 16;
+
+extern template class BasicZoneController<float, zone_limit>;
+extern template class BasicZoneController<Q16, zone_limit>;
+extern template class BasicZoneController<float, 256>;
+extern template class BasicZoneController<Q16, 256>;
+
+using ZoneController = BasicZoneController<real_t, zone_limit>;
+
+} // namespace thermo
@@ -0,0 +1,138 @@
+// Parameter sweep of the thermostat's controllers over simulated houses and
+// climates (see sim/simulator.h), reporting comfort and energy per year for
+// every combination. Scenarios run in parallel, one per core.
+//
+// usage: house_sim [-y years] [-j threads] [-s seed] [--csv]
+//
+// Comfort is counted while the household is awake, after the morning
+// warm-up: degree-hours below the band (cold), degree-hours above it while
+// the heating is in use (hot), and the RMS deviation from the day setpoint
+// with the heating in use. Energy is fuel burned, including a fixed loss per
+// burner start; cycles are burner starts per day.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "simulator.h"
+
+using namespace sim;
+using thermo::AutotuneState;
+using thermo::ControlMode;
+
+namespace {
+
+struct Controller {
+    const char *label;
+    ControlMode mode;
+    float hysteresis_c;
+    uint32_t window_ticks;  // PID time-proportioning window
+    bool autotune;
+    bool adapt = false;     // MPC refits its model online
+    uint32_t min_run = 0;   // PID minimum relay on/off time, in ticks
+};
+
+const Controller controllers[] = {
+    {"hyst 0.25", ControlMode::hysteresis, 0.25f, 60, false},
+    {"hyst 0.5", ControlMode::hysteresis, 0.5f, 60, false},
+    {"hyst 1.0", ControlMode::hysteresis, 1.0f, 60, false},
+    {"pid", ControlMode::pid, 0.5f, 60, false},
+    {"pid 10min", ControlMode::pid, 0.5f, 600, false},
+    {"pid tuned", ControlMode::pid, 0.5f, 60, true},
+    {"pid device", ControlMode::pid, 0.5f, 900, true, false, 180},
+    {"mpc", ControlMode::mpc, 0.5f, 60, true},
+    {"mpc adapt", ControlMode::mpc, 0.5f, 60, true, true},
+};
+
+int usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-y years] [-j threads] [-s seed] [--csv]\n", argv0);
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    double years = 1;
+    unsigned threads = 0;
+    uint32_t seed = 1;
+    bool csv = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--csv")) {
+            csv = true;
+        } else if (i + 1 < argc && !strcmp(argv[i], "-y")) {
+            years = atof(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-j")) {
+            threads = unsigned(atoi(argv[++i]));
+        } else if (i + 1 < argc && !strcmp(argv[i], "-s")) {
+            seed = uint32_t(strtoul(argv[++i], nullptr, 0));
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    const uint32_t days = uint32_t(std::lround(years * 365));
+    if (!days) return usage(argv[0]);
+    if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<Scenario> scenarios;
+    for (const HouseParams &h : reference_houses) {
+        for (const Climate &c : reference_climates) {
+            for (const Controller &k : controllers) {
+                Scenario s;
+                s.label = k.label;
+                s.house = h;
+                s.climate = c;
+                s.control.mode = k.mode;
+                s.control.hysteresis_c = k.hysteresis_c;
+                s.control.window_ticks = k.window_ticks;
+                s.control.min_run_ticks = k.min_run;
+                s.autotune = k.autotune;
+                s.control.model_adapt = k.adapt;
+                s.days = days;
+                s.seed = seed;
+                scenarios.push_back(s);
+            }
+        }
+    }
+    std::vector<Metrics> results(scenarios.size());
+    const auto t0 = std::chrono::steady_clock::now();
+    sweep(scenarios.data(), results.data(), scenarios.size(), threads);
+    const double wall_s =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    const double per_year = 365.0 / days;
+    if (csv) {
+        printf("house,climate,control,kwh_per_year,cycles_per_day,cold_dh_per_year,"
+               "hot_dh_per_year,rms_c,worst_cold_c,kp,ki\n");
+    } else {
+        printf("%-18s %-12s %-10s %8s %8s %8s %8s %6s %6s\n", "house", "climate", "control",
+               "kWh/yr", "cyc/day", "cold Ch", "hot Ch", "rms C", "dip C");
+    }
+    double sim_years = 0;
+    for (size_t i = 0; i < scenarios.size(); i++) {
+        const Scenario &s = scenarios[i];
+        const Metrics &m = results[i];
+        sim_years += m.seconds / (365 * 86400.0);
+        char label[32];
+        snprintf(label, sizeof label, "%s%s", s.label,
+                 s.autotune && m.tune != AutotuneState::done ? " (untuned)" : "");
+        if (csv) {
+            printf("\"%s\",%s,%s,%.1f,%.2f,%.2f,%.2f,%.3f,%.2f,%.4f,%.6f\n", s.house.name,
+                   s.climate.name, label, m.kwh * per_year, m.cycles / double(days),
+                   m.cold_dh * per_year, m.hot_dh * per_year, m.rms_c, m.worst_cold_c, m.kp,
+                   m.ki);
+        } else {
+            printf("%-18s %-12s %-10s %8.0f %8.1f %8.1f %8.1f %6.2f %6.2f\n", s.house.name,
+                   s.climate.name, label, m.kwh * per_year, m.cycles / double(days),
+                   m.cold_dh * per_year, m.hot_dh * per_year, m.rms_c, m.worst_cold_c);
+        }
+    }
+    fflush(stdout);
+    fprintf(stderr, "%zu scenarios, %.1f simulated years in %.1f s on %u threads: "
+                    "%.0f years per minute\n",
+            scenarios.size(), sim_years, wall_s, threads, sim_years / wall_s * 60);
+    return 0;
+}
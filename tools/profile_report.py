@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""Rank functions by samples from a sampling-profiler dump (src/profiler.h).
+
+The dump is either the profiler's text format (host builds, or device builds
+without telemetry) or telemetry_decode output containing profile records.
+Bucket addresses are looked up in the symbol table of the ELF image that
+produced them, read with nm: arm-none-eabi-nm (installed with the toolchain
+setup.sh lists) for ARM images, nm otherwise.
+
+usage: profile_report.py ELF [DUMP] [-n 25] [--nm PATH]
+
+  telemetry_decode /dev/ttyACM0 > dump.txt &   # then: printf p > /dev/ttyACM0
+  profile_report.py build/src/thermostat.elf dump.txt
+  kill -USR1 $(pidof thermostat)               # host build: dump to stdout
+"""
+import argparse
+import bisect
+import re
+import shutil
+import subprocess
+import sys
+
+EM_ARM = 40
+ET_DYN = 3
+
+
+def elf_header(path):
+    """Returns (e_type, e_machine)."""
+    with open(path, "rb") as f:
+        ident = f.read(20)
+    if ident[:4] != b"\x7fELF":
+        sys.exit("%s: not an ELF file" % path)
+    order = "little" if ident[5] == 1 else "big"
+    return int.from_bytes(ident[16:18], order), int.from_bytes(ident[18:20], order)
+
+
+def symbols(nm, path, arm):
+    """Sorted [(address, size or None, name)] of the functions in `path`."""
+    out = subprocess.run([nm, "-C", "-n", "-S", "--defined-only", path], check=True,
+                         capture_output=True, text=True).stdout
+    syms = []
+    for line in out.splitlines():
+        m = re.match(r"^([0-9a-fA-F]+)(?:\s+([0-9a-fA-F]+))?\s+([tTwW])\s+(.+)$", line)
+        if not m:
+            continue
+        addr = int(m.group(1), 16)
+        if arm:
+            addr &= ~1  # Thumb bit
+        size = int(m.group(2), 16) if m.group(2) else None
+        syms.append((addr, size, m.group(4)))
+    syms.sort()
+    return syms
+
+
+def parse(lines):
+    """Returns (base, total samples, bucket bytes, {address: count})."""
+    base, total, bucket_bytes = 0, 0, 16
+    counts = {}
+    dumps = set()
+    for line in lines:
+        line = line.strip()
+        m = re.match(r"^\s*([\d.]+) profile samples=(\d+)(.*)$", line)
+        if m:
+            # One telemetry record; every record of a dump repeats its total.
+            if m.group(1) not in dumps:
+                dumps.add(m.group(1))
+                total += int(m.group(2))
+            for addr, count in re.findall(r"0x([0-9a-fA-F]+):(\d+)", m.group(3)):
+                counts[int(addr, 16)] = counts.get(int(addr, 16), 0) + int(count)
+            continue
+        fields = line.split()
+        if len(fields) != 2:
+            continue
+        if fields[0] == "base":
+            base = int(fields[1], 16)
+        elif fields[0] == "samples":
+            total += int(fields[1])
+        elif fields[0] == "bucket_bytes":
+            bucket_bytes = int(fields[1])
+        elif fields[0].startswith("0x"):
+            addr = int(fields[0], 16)
+            counts[addr] = counts.get(addr, 0) + int(fields[1])
+    return base, total, bucket_bytes, counts
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("elf")
+    ap.add_argument("dump", nargs="?", help="default: stdin")
+    ap.add_argument("-n", type=int, default=25, help="functions to list")
+    ap.add_argument("--nm", help="nm to use (default: by ELF machine)")
+    args = ap.parse_args()
+
+    e_type, machine = elf_header(args.elf)
+    arm = machine == EM_ARM
+    nm = args.nm or ("arm-none-eabi-nm" if arm else "nm")
+    if not shutil.which(nm):
+        sys.exit("%s not found; pass --nm" % nm)
+    syms = symbols(nm, args.elf, arm)
+    starts = [s[0] for s in syms]
+
+    with (open(args.dump) if args.dump else sys.stdin) as f:
+        base, total, bucket_bytes, counts = parse(f)
+    # Position-independent host executables were loaded at `base`.
+    offset = base if e_type == ET_DYN else 0
+
+    per_function = {}
+    for addr, count in counts.items():
+        a = addr - offset
+        i = bisect.bisect_right(starts, a) - 1
+        name = "(unknown)"
+        if i >= 0:
+            start, size, sym = syms[i]
+            # A bucket can start just before its function: also try its end.
+            if size is None or a < start + size:
+                name = sym
+        if name == "(unknown)":
+            j = bisect.bisect_right(starts, a + bucket_bytes - 1) - 1
+            if j >= 0 and syms[j][0] > a:
+                name = syms[j][2]
+        per_function[name] = per_function.get(name, 0) + count
+
+    bucketed = sum(counts.values())
+    if total > bucketed:
+        per_function["(unbucketed)"] = total - bucketed
+    total = max(total, bucketed)
+    if not total:
+        sys.exit("no samples")
+    print("%d samples" % total)
+    print("%8s %6s %6s  %s" % ("samples", "self%", "cum%", "function"))
+    cum = 0
+    ranked = sorted(per_function.items(), key=lambda kv: -kv[1])
+    for name, count in ranked[:args.n]:
+        cum += count
+        print("%8d %5.1f%% %5.1f%%  %s" % (count, 100.0 * count / total, 100.0 * cum / total, name))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Per-subsystem RAM usage from a GNU ld link map.
+
+Arenas declared with THERMO_ARENA(name, bytes) live in input sections named
+.bss.ram_<name>. Code that runs from SRAM is "code in RAM": the THERMO_HOT
+functions (.time_critical.* input sections, copied with .data) and, in a
+copy_to_ram build, any output section placed at an SRAM address. Everything
+else in the RAM output sections is reported as "other static" (SDK state,
+libc, stacks on the device).
+
+usage: ram_report.py thermostat.elf.map [-o report.txt] [--ram-kb 264]
+"""
+import argparse
+import re
+import sys
+
+RAM_OUTPUT_SECTIONS = {
+    ".data", ".bss", ".tdata", ".tbss", ".ram_vector_table", ".uninitialized_data",
+    ".heap", ".stack_dummy", ".stack1_dummy", ".scratch_x", ".scratch_y",
+}
+ARENA_PREFIX = ".bss.ram_"
+CODE_PREFIX = ".time_critical"
+SRAM_BASE, SRAM_END = 0x20000000, 0x20042000
+HEX = r"0x[0-9a-fA-F]+"
+
+
+def parse(lines):
+    """Returns ({output section: size}, {arena: size}, {"input"|"output": code
+    in RAM}): input is .time_critical.* inside .data, output is whole output
+    sections at SRAM addresses."""
+    outputs, arenas = {}, {}
+    code = {"input": 0, "output": 0}
+    in_memory_map = False
+    pending = None
+    for line in lines:
+        if line.startswith("Linker script and memory map"):
+            in_memory_map = True
+            continue
+        if not in_memory_map:
+            continue
+        # Output section: name in column 0, optionally with address/size.
+        m = re.match(r"^(\.[\w.]+)(?:\s+(%s)\s+(%s))?\s*$" % (HEX, HEX), line)
+        if m:
+            if m.group(3):
+                size = int(m.group(3), 16)
+                outputs[m.group(1)] = size
+                in_sram = SRAM_BASE <= int(m.group(2), 16) < SRAM_END
+                if in_sram and m.group(1) not in RAM_OUTPUT_SECTIONS:
+                    code["output"] += size
+            continue
+        # Input section: one leading space; long names wrap onto the next line.
+        m = re.match(r"^ (\.[\w.]+)(?:\s+(%s)\s+(%s)\s+(.*))?$" % (HEX, HEX), line)
+        if m:
+            pending = None
+            if m.group(3):
+                record(arenas, code, m.group(1), int(m.group(3), 16))
+            else:
+                pending = m.group(1)
+            continue
+        m = re.match(r"^\s+(%s)\s+(%s)\s+\S" % (HEX, HEX), line)
+        if m and pending:
+            record(arenas, code, pending, int(m.group(2), 16))
+        pending = None
+    return outputs, arenas, code
+
+
+def record(arenas, code, section, size):
+    if section.startswith(CODE_PREFIX):
+        code["input"] += size
+    elif section.startswith(ARENA_PREFIX) and size:
+        name = section[len(ARENA_PREFIX):]
+        arenas[name] = arenas.get(name, 0) + size
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("map")
+    ap.add_argument("-o", "--output")
+    ap.add_argument("--ram-kb", type=int, default=264)
+    args = ap.parse_args()
+
+    with open(args.map, errors="replace") as f:
+        outputs, arenas, code = parse(f)
+
+    total = sum(size for name, size in outputs.items() if name in RAM_OUTPUT_SECTIONS)
+    total += code["output"]
+    code_total = code["input"] + code["output"]
+    arena_total = sum(arenas.values())
+    ram = args.ram_kb * 1024
+    rows = [("arena:" + name, size) for name, size in sorted(arenas.items())]
+    rows.append(("code in RAM", code_total))
+    rows.append(("other static", total - arena_total - code_total))
+    rows.append(("total", total))
+
+    out = ["RAM usage (%s)" % args.map]
+    for name, size in rows:
+        out.append("  %-20s %8d bytes  %5.1f%%" % (name, size, 100.0 * size / ram))
+    text = "\n".join(out) + "\n"
+    sys.stdout.write(text)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,111 @@
+// Decode the firmware's binary telemetry (see src/telemetry.h) from the USB
+// serial port, or any file or pipe, one text line per record.
+//
+// usage: telemetry_decode [-q] [device|file|-]     (default /dev/ttyACM0)
+//   -q  print only the summary (frames, losses, CRC failures) at the end
+//
+// A tty is switched to raw mode first. Ctrl-C or end of input prints the
+// summary to stderr.
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+
+#include "boot.h"
+#include "telemetry.h"
+
+using namespace thermo;
+
+namespace {
+
+volatile sig_atomic_t stop = 0;
+
+int get16(const uint8_t *p) {
+    return int16_t(p[0] | p[1] << 8);
+}
+
+uint32_t get32(const uint8_t *p) {
+    return uint32_t(p[0] | p[1] << 8 | p[2] << 16) | uint32_t(p[3]) << 24;
+}
+
+void print_record(void *ctx, const TelemetryDecoder::Frame &, uint8_t type, const uint8_t *p,
+                  size_t len) {
+    if (*static_cast<bool *>(ctx)) return;
+    if (type == telemetry::record_status && len >= 11) {
+        printf("%10.3f status temp=%.2f set=%.2f relay=%d drops=%u\n", get32(p) / 1e3,
+               get16(p + 4) / 100.0, get16(p + 6) / 100.0, p[8], unsigned(uint16_t(get16(p + 9))));
+    } else if (type == telemetry::record_probe && len >= 8) {
+        if (p[5]) {
+            printf("%10.3f probe%u %.4f\n", get32(p) / 1e3, p[4], get16(p + 6) / 16.0);
+        } else {
+            printf("%10.3f probe%u invalid\n", get32(p) / 1e3, p[4]);
+        }
+    } else if (type == telemetry::record_profile && len >= 8) {
+        // tools/profile_report.py reads these lines.
+        printf("%10.3f profile samples=%u", get32(p) / 1e3, get32(p + 4));
+        for (size_t i = 8; i + 8 <= len; i += 8) printf(" 0x%08x:%u", get32(p + i), get32(p + i + 4));
+        printf("\n");
+    } else if (type == telemetry::record_boot && len >= 1 && len >= 1 + 4 * size_t(p[0])) {
+        // As boot_print() on the device; stages this build does not know
+        // are named by number.
+        uint32_t prev = 0;
+        for (size_t i = 0; i < p[0]; i++) {
+            const uint32_t t = get32(p + 1 + 4 * i);
+            if (!t) continue;
+            if (const char *name = boot_stage_name(BootStage(i))) {
+                printf("boot %-14s %9.3f ms  +%.3f\n", name, t / 1e3, int32_t(t - prev) / 1e3);
+            } else {
+                printf("boot stage%-9zu %9.3f ms  +%.3f\n", i, t / 1e3, int32_t(t - prev) / 1e3);
+            }
+            prev = t;
+        }
+    } else {
+        printf("record type %u, %zu bytes\n", type, len);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    bool quiet = false;
+    const char *path = "/dev/ttyACM0";
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-q")) {
+            quiet = true;
+        } else if (argv[i][0] == '-' && argv[i][1]) {
+            fprintf(stderr, "usage: %s [-q] [device|file|-]\n", argv[0]);
+            return 2;
+        } else {
+            path = argv[i];
+        }
+    }
+    const int fd = strcmp(path, "-") ? open(path, O_RDONLY | O_NOCTTY) : 0;
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    termios tio;
+    if (isatty(fd) && tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    struct sigaction sa = {};
+    sa.sa_handler = [](int) { stop = 1; };
+    sigaction(SIGINT, &sa, nullptr);
+
+    TelemetryDecoder decoder(print_record, &quiet);
+    uint8_t buf[4096];
+    while (!stop) {
+        const ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        decoder.feed(buf, size_t(n));
+        if (!quiet) fflush(stdout);
+    }
+    fprintf(stderr, "%u frames, %u records; %u frames lost (device dropped %u records), %u bad\n",
+            decoder.frames(), decoder.records(), decoder.lost_frames(), decoder.device_dropped(),
+            decoder.bad_frames());
+    return 0;
+}
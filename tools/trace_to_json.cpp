@@ -0,0 +1,179 @@
+// Convert firmware event traces (see src/trace.h) to the Chrome trace event
+// JSON format, for chrome://tracing or ui.perfetto.dev.
+//
+// usage: trace_to_json [device|file|-] > trace.json   (default /dev/ttyACM0)
+//        trace_to_json -f flash.bin > trace.json
+//
+// The first form reads trace records from the telemetry stream of a
+// THERMO_TRACE build until Ctrl-C or end of input. The second reads the crash
+// snapshots that a build saved to its flash log (a host thermostat_flash.bin
+// or a dump of the device's log region). Each core is one thread; events the
+// rings overwrote before they were read show up as "lost" instants.
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+
+#include "flash_log.h"
+#include "telemetry.h"
+#include "trace.h"
+
+using namespace thermo;
+
+namespace {
+
+volatile sig_atomic_t stop = 0;
+
+struct Output {
+    uint32_t events = 0;
+    uint32_t lost = 0;
+    bool have_time = false;
+    uint32_t last_raw = 0;
+    int64_t last_us = 0;
+
+    // The timer is 32 bits of microseconds (71 minutes). Consecutive events
+    // are never that far apart, so the signed difference unwraps it, even
+    // across blocks from different cores that overlap in time.
+    int64_t unwrap(uint32_t raw) {
+        if (have_time) last_us += int32_t(raw - last_raw);
+        have_time = true;
+        last_raw = raw;
+        return last_us;
+    }
+
+    void begin(bool flash) {
+        printf("{\"traceEvents\":[\n");
+        printf("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"%s\"}}",
+               flash ? "thermostat (crash snapshot)" : "thermostat");
+        for (size_t core = 0; core < Tracer::cores; core++) {
+            printf(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,"
+                   "\"args\":{\"name\":\"core %zu\"}}",
+                   core, core);
+        }
+    }
+
+    void block(const uint8_t *p, size_t len) {
+        if (len < trace::block_header) return;
+        const unsigned core = p[0];
+        const unsigned lost_here = p[1] | p[2] << 8;
+        const uint8_t *e = p + trace::block_header;
+        const uint8_t *end = p + len;
+        if (lost_here && e + trace::event_size <= end) {
+            const uint32_t raw = uint32_t(e[0] | e[1] << 8 | e[2] << 16) | uint32_t(e[3]) << 24;
+            printf(",\n{\"name\":\"lost\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%lld,\"pid\":1,"
+                   "\"tid\":%u,\"args\":{\"events\":%u}}",
+                   (long long)unwrap(raw), core, lost_here);
+        }
+        lost += lost_here;
+        for (; e + trace::event_size <= end; e += trace::event_size) {
+            const uint32_t raw = uint32_t(e[0] | e[1] << 8 | e[2] << 16) | uint32_t(e[3]) << 24;
+            const char *name = trace_name(e[4]);
+            const uint16_t arg = uint16_t(e[6] | e[7] << 8);
+            char unknown[16];
+            if (!name) {
+                snprintf(unknown, sizeof(unknown), "id%u", e[4]);
+                name = unknown;
+            }
+            printf(",\n{\"name\":\"%s\",\"ts\":%lld,\"pid\":1,\"tid\":%u", name,
+                   (long long)unwrap(raw), core);
+            switch (TraceKind(e[5])) {
+            case TraceKind::begin:
+                printf(",\"ph\":\"B\"}");
+                break;
+            case TraceKind::end:
+                printf(",\"ph\":\"E\"}");
+                break;
+            case TraceKind::counter:
+                printf(",\"ph\":\"C\",\"args\":{\"value\":%d}}", int16_t(arg));
+                break;
+            default:
+                printf(",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"arg\":%u}}", arg);
+                break;
+            }
+            events++;
+        }
+    }
+
+    void end() {
+        printf("\n],\"displayTimeUnit\":\"ms\"}\n");
+        fprintf(stderr, "%u events, %u lost\n", events, lost);
+    }
+};
+
+void on_record(void *ctx, const TelemetryDecoder::Frame &, uint8_t type, const uint8_t *p,
+               size_t len) {
+    if (type == telemetry::record_trace) static_cast<Output *>(ctx)->block(p, len);
+}
+
+void on_flash_record(void *ctx, uint8_t type, const uint8_t *p, size_t len) {
+    if (type == trace::record_trace_dump) static_cast<Output *>(ctx)->block(p, len);
+}
+
+int from_flash(const char *path) {
+    struct stat st;
+    if (stat(path, &st) || st.st_size <= 0 || st.st_size % FlashDevice::sector_size) {
+        fprintf(stderr, "%s: not a flash log image\n", path);
+        return 1;
+    }
+    FileFlash flash(path, size_t(st.st_size));
+    if (!flash.ok()) {
+        perror(path);
+        return 1;
+    }
+    FlashLog log(flash);
+    log.mount();
+    Output out;
+    out.begin(true);
+    log.for_each(on_flash_record, &out);
+    out.end();
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *path = "/dev/ttyACM0";
+    const char *flash_path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+            flash_path = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1]) {
+            fprintf(stderr, "usage: %s [device|file|-]\n       %s -f flash.bin\n", argv[0],
+                    argv[0]);
+            return 2;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (flash_path) return from_flash(flash_path);
+
+    const int fd = strcmp(path, "-") ? open(path, O_RDONLY | O_NOCTTY) : 0;
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    termios tio;
+    if (isatty(fd) && tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    struct sigaction sa = {};
+    sa.sa_handler = [](int) { stop = 1; };
+    sigaction(SIGINT, &sa, nullptr);
+
+    Output out;
+    out.begin(false);
+    TelemetryDecoder decoder(on_record, &out);
+    uint8_t buf[4096];
+    while (!stop) {
+        const ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        decoder.feed(buf, size_t(n));
+    }
+    out.end();
+    return 0;
+}
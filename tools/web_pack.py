@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""Packs the web UI into C++ const arrays, gzipped, with their ETags.
+
+The arrays are const, so on the device they stay in XIP flash and the HTTP
+server (src/http.h) sends straight from them. Output is reproducible: gzip
+gets no timestamp or name, and the ETag is the CRC-32 of the gzipped bytes.
+
+usage: web_pack.py -o web_assets.cpp file...
+"""
+import argparse
+import gzip
+import os
+import sys
+import zlib
+
+TYPES = {
+    ".html": "text/html; charset=utf-8",
+    ".css": "text/css",
+    ".js": "text/javascript",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".ico": "image/x-icon",
+    ".png": "image/png",
+}
+
+
+def c_bytes(data, indent="    ", per_line=16):
+    lines = []
+    for i in range(0, len(data), per_line):
+        lines.append(indent + ", ".join("0x%02x" % b for b in data[i:i + per_line]) + ",")
+    return "\n".join(lines)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("files", nargs="+")
+    ap.add_argument("-o", "--output", required=True)
+    args = ap.parse_args()
+
+    assets = []
+    for path in sorted(args.files, key=os.path.basename):
+        name = os.path.basename(path)
+        ext = os.path.splitext(name)[1]
+        if ext not in TYPES:
+            sys.stderr.write("web_pack: no content type for %s\n" % path)
+            return 1
+        with open(path, "rb") as f:
+            raw = f.read()
+        packed = gzip.compress(raw, compresslevel=9, mtime=0)
+        etag = "%08x" % zlib.crc32(packed)
+        assets.append((name, TYPES[ext], etag, raw, packed))
+
+    out = ["// Generated by tools/web_pack.py from web/; do not edit.",
+           '#include "web_assets.h"', "", "namespace thermo {", "", "namespace {", ""]
+    for i, (name, _, _, raw, packed) in enumerate(assets):
+        out.append("// %s: %d bytes, %d gzipped" % (name, len(raw), len(packed)))
+        out.append("const uint8_t asset_%d[] = {" % i)
+        out.append(c_bytes(packed))
+        out.append("};")
+        out.append("")
+    out.append("} // namespace")
+    out.append("")
+    out.append("const WebAsset web_assets[] = {")
+    for i, (name, ctype, etag, raw, packed) in enumerate(assets):
+        out.append('    {"/%s", "%s", "\\"%s\\"", asset_%d, %d, %d},'
+                   % (name, ctype, etag, i, len(packed), len(raw)))
+    out.append("};")
+    out.append("const size_t web_asset_count = %d;" % len(assets))
+    out.append("")
+    out.append("} // namespace thermo")
+    with open(args.output, "w") as f:
+        f.write("\n".join(out) + "\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,33 @@
+// Polls /api/status and posts setpoint changes to /api/setpoint.
+"use strict";
+
+const $ = (id) => document.getElementById(id);
+
+function show(s) {
+  $("temp").textContent = s.temp.toFixed(2);
+  $("setpoint").textContent = s.setpoint.toFixed(1);
+  $("relay").textContent = s.relay ? "on" : "off";
+  $("mode").textContent = s.mode;
+  const h = Math.floor(s.uptime_s / 3600);
+  $("uptime").textContent = `${h} h ${Math.floor((s.uptime_s % 3600) / 60)} min`;
+}
+
+async function refresh() {
+  try {
+    const r = await fetch("/api/status", { cache: "no-store" });
+    if (r.ok) show(await r.json());
+  } catch (e) {
+    $("message").textContent = "Thermostat not reachable";
+  }
+}
+
+$("setpoint-form").addEventListener("submit", async (ev) => {
+  ev.preventDefault();
+  const c = $("setpoint-input").value;
+  const r = await fetch(`/api/setpoint?c=${encodeURIComponent(c)}`, { method: "POST" });
+  $("message").textContent = r.ok ? `Setpoint ${c} °C saved` : "Setpoint rejected";
+  refresh();
+});
+
+refresh();
+setInterval(refresh, 5000);